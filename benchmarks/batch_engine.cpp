@@ -0,0 +1,187 @@
+// Times the batch engine of the extension module from C++ alone: clustering
+// a batch into an output_wrapper, extracting the inclusive jets and their
+// constituent indices, and clustering it again with compact_history, where
+// each thread reuses one ClusterSequence, with no Python call in the timed
+// sections. The events
+// are read from a file written by
+//
+//   python benchmarks/bench_clustering.py --replicas 20 --dump events.bin
+//
+// and the harness is built against the same FastJet and pybind11 as the
+// module, for instance from an installed tree with the one command
+//
+//   c++ -O3 -std=c++17 -pthread benchmarks/batch_engine.cpp -o batch_engine
+//     -I src/fastjet/_fastjet_core/include $(python3 -m pybind11 --includes)
+//     -L src/fastjet/_fastjet_core/lib -Wl,-rpath,src/fastjet/_fastjet_core/lib
+//     -lfastjettools -lfastjet -lfastjetcontribfragile
+//     $(python3-config --ldflags --embed)
+//
+//   ./batch_engine events.bin [algorithm] [R] [strategy] [n_threads] [repeat]
+//
+// The interpreter is only started because the engine releases the GIL around
+// its parallel sections. Allocations are counted by the replaced global
+// operator new, which sees those made inside FastJet as well.
+
+#include <pybind11/embed.h>
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <new>
+
+#include "../src/_ext.cpp"
+
+namespace {
+
+std::atomic<std::size_t> allocated_bytes{0};
+std::atomic<std::size_t> allocation_count{0};
+
+struct batch {
+  std::vector<int64_t> starts, stops;
+  std::vector<double> px, py, pz, E;
+};
+
+batch read_batch(const char *path) {
+  std::ifstream in(path, std::ios::binary);
+  int64_t counts[2];
+  if (!in.read(reinterpret_cast<char *>(counts), sizeof(counts))) {
+    throw std::runtime_error(std::string("Cannot read events from ") + path);
+  }
+  std::vector<int64_t> offsets(counts[0] + 1);
+  batch b;
+  in.read(reinterpret_cast<char *>(offsets.data()),
+          offsets.size() * sizeof(int64_t));
+  for (auto column : {&b.px, &b.py, &b.pz, &b.E}) {
+    column->resize(counts[1]);
+    in.read(reinterpret_cast<char *>(column->data()),
+            column->size() * sizeof(double));
+  }
+  if (!in) {
+    throw std::runtime_error(std::string("Truncated events file ") + path);
+  }
+  b.starts.assign(offsets.begin(), offsets.end() - 1);
+  b.stops.assign(offsets.begin() + 1, offsets.end());
+  return b;
+}
+
+fj::JetAlgorithm parse_algorithm(const std::string &name) {
+  if (name == "antikt") {
+    return fj::antikt_algorithm;
+  } else if (name == "kt") {
+    return fj::kt_algorithm;
+  } else if (name == "cambridge") {
+    return fj::cambridge_algorithm;
+  }
+  throw std::invalid_argument("Unknown algorithm " + name +
+                              "; expected antikt, kt or cambridge");
+}
+
+fj::Strategy parse_strategy(const std::string &name) {
+  static const std::map<std::string, fj::Strategy> strategies = {
+      {"Best", fj::Best},
+      {"N2Plain", fj::N2Plain},
+      {"N2Tiled", fj::N2Tiled},
+      {"N2MinHeapTiled", fj::N2MinHeapTiled},
+      {"NlnN", fj::NlnN},
+      {"N2MHTLazy9", fj::N2MHTLazy9},
+      {"N2MHTLazy25", fj::N2MHTLazy25},
+  };
+  auto found = strategies.find(name);
+  if (found == strategies.end()) {
+    throw std::invalid_argument("Unknown strategy " + name);
+  }
+  return found->second;
+}
+
+// Best wall time of f over repeat runs, with the bytes and number of
+// allocations of the last run, in total and per event.
+template <typename F> void report(const char *phase, std::size_t n_events,
+                                  int repeat, F f) {
+  double best = std::numeric_limits<double>::infinity();
+  std::size_t bytes = 0, count = 0;
+  for (int r = 0; r < repeat; r++) {
+    std::size_t bytes_before = allocated_bytes, count_before = allocation_count;
+    auto start = std::chrono::steady_clock::now();
+    f();
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    best = std::min(best, elapsed.count());
+    bytes = allocated_bytes - bytes_before;
+    count = allocation_count - count_before;
+  }
+  std::printf("%-22s %12.0f ev/s %10.3f s %12.1f MiB %12zu allocations "
+              "%10.2f per event\n",
+              phase, n_events / best, best, bytes / 1048576.0, count,
+              static_cast<double>(count) / n_events);
+}
+
+} // namespace
+
+void *operator new(std::size_t size) {
+  allocated_bytes += size;
+  allocation_count++;
+  if (void *p = std::malloc(size ? size : 1)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    std::fprintf(stderr,
+                 "usage: %s events.bin [algorithm] [R] [strategy] "
+                 "[n_threads] [repeat]\n",
+                 argv[0]);
+    return 2;
+  }
+  py::scoped_interpreter interpreter;
+  try {
+    batch b = read_batch(argv[1]);
+    std::string algorithm = argc > 2 ? argv[2] : "antikt";
+    double R = argc > 3 ? std::atof(argv[3]) : 0.4;
+    std::string strategy = argc > 4 ? argv[4] : "Best";
+    int n_threads = argc > 5 ? std::atoi(argv[5]) : 1;
+    int repeat = argc > 6 ? std::atoi(argv[6]) : 3;
+
+    fj::JetDefinition jet_def(parse_algorithm(algorithm), R, fj::E_scheme,
+                              parse_strategy(strategy));
+    std::size_t n_events = b.starts.size();
+    std::printf("%zu events, %zu particles, %s\n", n_events, b.px.size(),
+                jet_def.description().c_str());
+
+    output_wrapper ow;
+    auto cluster = [&] {
+      ow = output_wrapper();
+      cluster_events_into(ow, b.px.data(), b.py.data(), b.pz.data(),
+                          b.E.data(), b.starts.data(), b.stops.data(),
+                          n_events, &jet_def, n_threads);
+    };
+    report("cluster", n_events, repeat, cluster);
+    report("inclusive_jets", n_events, repeat, [&] {
+      ow.cache->clear();
+      ow.jets(jet_cache::inclusive, 0);
+    });
+    auto jets = ow.jets(jet_cache::inclusive, 0);
+    report("constituent_indices", n_events, repeat, [&] {
+      for (std::size_t i = 0; i < n_events; i++) {
+        constituent_indices indices(*ow.cse[i], (*jets)[i]);
+      }
+    });
+    // the runs after the first find the sequence of each thread warm, so
+    // what is left per event is what the reuse does not save, such as the
+    // working arrays FastJet's strategies allocate for every event
+    output_wrapper compact;
+    report("cluster_compact", n_events, repeat, [&] {
+      compact = output_wrapper();
+      cluster_events_into(compact, b.px.data(), b.py.data(), b.pz.data(),
+                          b.E.data(), b.starts.data(), b.stops.data(),
+                          n_events, &jet_def, n_threads, true);
+    });
+  } catch (const std::exception &e) {
+    std::fprintf(stderr, "%s\n", e.what());
+    return 1;
+  }
+  return 0;
+}
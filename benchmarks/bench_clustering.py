@@ -0,0 +1,255 @@
+"""Clustering benchmarks on the bundled tests/samples/pfnano_skim.root sample.
+
+Clusters the particle-flow candidates of the sample, replicated to the
+requested number of copies, with every combination of jet algorithm, R and
+clustering strategy, and times the clustering and each public method of
+AwkwardClusterSequence on the result, with its cache of found jets cleared
+before every call. Runs offline; only uproot and vector are needed besides
+fastjet.
+
+    python benchmarks/bench_clustering.py --replicas 20 --algorithms antikt kt \\
+        --R 0.4 0.8 --strategies Best N2Tiled N2MHTLazy9 NlnN --json results.json
+
+Every measurement is the best of --repeat runs and reports events/s and the
+peak of the allocations traced by tracemalloc during the call. Those are the
+numpy outputs and Python objects only; tracemalloc does not see the
+allocations made in C++, which batch_engine.cpp counts.
+
+--dump writes the input momenta in the format read by batch_engine.cpp, which
+times the batch engine from C++ alone.
+"""
+
+import argparse
+import json
+import os
+import platform
+import time
+import tracemalloc
+from pathlib import Path
+
+import awkward as ak
+import numpy as np
+
+import fastjet
+
+SAMPLE = Path(__file__).parent.parent / "tests" / "samples" / "pfnano_skim.root"
+
+ALGORITHMS = {
+    "antikt": fastjet.antikt_algorithm,
+    "kt": fastjet.kt_algorithm,
+    "cambridge": fastjet.cambridge_algorithm,
+}
+
+STRATEGIES = {
+    name: getattr(fastjet, name)
+    for name in ("Best", "N2Plain", "N2Tiled", "N2MinHeapTiled", "NlnN", "N2MHTLazy9")
+}
+
+# the public methods of AwkwardClusterSequence with the arguments they are
+# timed with; methods about one jet per event get the leading inclusive jet
+METHODS = {
+    "inclusive_jets": {},
+    "unclustered_particles": {},
+    "exclusive_jets": {"n_jets": 2},
+    "exclusive_jets_up_to": {"n_jets": 2},
+    "exclusive_jets_ycut": {"ycut": 0.01},
+    "constituent_index": {},
+    "constituents": {},
+    "exclusive_jets_constituent_index": {"njets": 2},
+    "exclusive_jets_constituents": {"njets": 2},
+    "exclusive_jets_softdrop_grooming": {"njets": 2},
+    "njettiness": {"njets": 2},
+    "jet_observables": {"observables": ["momentum", "constituent_index"]},
+    "exclusive_jets_energy_correlator": {"njets": 2},
+    "exclusive_jets_lund_declusterings": {"njets": 2},
+    "exclusive_jets_multi": {"n_jets": [2, 3, 4]},
+    "exclusive_dmerge_spectrum": {},
+    "exclusive_dmerge": {"njets": 2},
+    "exclusive_dmerge_max": {"njets": 2},
+    "exclusive_ymerge_max": {"njets": 2},
+    "exclusive_ymerge": {"njets": 2},
+    "Q": {},
+    "Q2": {},
+    "unique_history_order": {},
+    "n_particles": {},
+    "n_exclusive_jets": {"dcut": 100.0},
+    "childless_pseudojets": {},
+    "jets": {},
+    "background_estimate": {"rap_max": 2.5},
+    "exclusive_subjets": {"nsub": 2, "jet": True},
+    "exclusive_subjets_up_to": {"nsub": 2, "jet": True},
+    "exclusive_subdmerge": {"nsub": 2, "jet": True},
+    "exclusive_subdmerge_max": {"nsub": 2, "jet": True},
+    "n_exclusive_subjets": {"dcut": 100.0, "jet": True},
+    "has_parents": {"jet": True},
+    "has_child": {"jet": True},
+    "jet_scale_for_algorithm": {"jet": True},
+    "get_parents": {"jet": True},
+    "get_child": {"jet": True},
+}
+
+
+def load_events(replicas):
+    import uproot
+    import vector
+
+    events = uproot.open({SAMPLE: "Events"}).arrays(
+        ["PFCands_pt", "PFCands_eta", "PFCands_phi", "PFCands_mass"]
+    )
+    pfcands = ak.zip(
+        {
+            "pt": events.PFCands_pt,
+            "eta": events.PFCands_eta,
+            "phi": events.PFCands_phi,
+            "mass": events.PFCands_mass,
+        },
+        with_name="Momentum4D",
+        behavior=vector.backends.awkward.behavior,
+    )
+    # cartesian components, which the batch interface reads in place
+    pfcands = ak.zip(
+        {"px": pfcands.px, "py": pfcands.py, "pz": pfcands.pz, "E": pfcands.E},
+        with_name="Momentum4D",
+        behavior=vector.backends.awkward.behavior,
+    )
+    return ak.to_packed(ak.concatenate([pfcands] * replicas))
+
+
+def dump_events(events, path):
+    # int64 event and particle counts, int64 event offsets, then px, py, pz
+    # and E as float64 columns
+    counts = ak.to_numpy(ak.num(events)).astype(np.int64)
+    offsets = np.concatenate([[0], np.cumsum(counts)]).astype(np.int64)
+    with open(path, "wb") as f:
+        f.write(np.array([len(counts), offsets[-1]], dtype=np.int64).tobytes())
+        f.write(offsets.tobytes())
+        for field in ("px", "py", "pz", "E"):
+            column = ak.to_numpy(ak.flatten(events[field])).astype(np.float64)
+            f.write(column.tobytes())
+
+
+def measure(call, repeat, reset=lambda: None):
+    # reset runs untimed before every call, so that each one starts cold
+    best = float("inf")
+    for _ in range(repeat):
+        reset()
+        start = time.perf_counter()
+        call()
+        best = min(best, time.perf_counter() - start)
+    # tracing slows allocations down, so it gets a run of its own
+    reset()
+    tracemalloc.start()
+    call()
+    traced = tracemalloc.get_traced_memory()[1]
+    tracemalloc.stop()
+    return best, traced
+
+
+def method_call(sequence, name, leading):
+    kwargs = dict(METHODS[name])
+    inputs = (leading,) if kwargs.pop("jet", False) else ()
+    method = getattr(sequence, name)
+    return lambda: method(*inputs, **kwargs)
+
+
+def run(events, args):
+    n_events = len(events)
+    results = []
+    for algorithm in args.algorithms:
+        for R in args.R:
+            for strategy in args.strategies:
+                jetdef = fastjet.JetDefinition(
+                    ALGORITHMS[algorithm], R, fastjet.E_scheme, STRATEGIES[strategy]
+                )
+                config = {"algorithm": algorithm, "R": R, "strategy": strategy}
+
+                def cluster(jetdef=jetdef):
+                    return fastjet.ClusterSequence(
+                        events, jetdef, n_threads=args.n_threads
+                    )
+
+                timings = {"cluster": measure(cluster, args.repeat)}
+                sequence = cluster()
+                leading = sequence.inclusive_jets()[:, 0]
+                # the jets found by a query are cached on the sequence; clearing
+                # them times jet finding rather than the export of cached jets
+                clear_cache = sequence._internalrep._results.clear_cache
+                for name in args.methods:
+                    try:
+                        timings[name] = measure(
+                            method_call(sequence, name, leading),
+                            args.repeat,
+                            clear_cache,
+                        )
+                    except Exception as error:  # noqa: BLE001
+                        timings[name] = error
+                for name, timing in timings.items():
+                    label = f"{algorithm:>9} R={R:<4} {strategy:>14} {name:<34}"
+                    if isinstance(timing, Exception):
+                        results.append({**config, "method": name, "error": str(timing)})
+                        print(f"{label} error: {timing}")
+                        continue
+                    seconds, traced = timing
+                    results.append(
+                        {
+                            **config,
+                            "method": name,
+                            "seconds": seconds,
+                            "events_per_second": n_events / seconds,
+                            "traced_bytes": traced,
+                        }
+                    )
+                    print(
+                        f"{label} {n_events / seconds:>12.0f} ev/s "
+                        f"{traced / 2**20:>9.1f} MiB traced"
+                    )
+    return results
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--replicas", type=int, default=10)
+    parser.add_argument(
+        "--algorithms", nargs="+", default=["antikt"], choices=sorted(ALGORITHMS)
+    )
+    parser.add_argument("--R", nargs="+", type=float, default=[0.4, 0.8])
+    parser.add_argument(
+        "--strategies", nargs="+", default=["Best"], choices=sorted(STRATEGIES)
+    )
+    parser.add_argument(
+        "--methods", nargs="+", default=sorted(METHODS), choices=sorted(METHODS)
+    )
+    parser.add_argument("--repeat", type=int, default=3)
+    parser.add_argument("--n-threads", type=int, default=None)
+    parser.add_argument("--json", help="write the measurements to this file")
+    parser.add_argument(
+        "--dump", help="write the input momenta for batch_engine.cpp and exit"
+    )
+    args = parser.parse_args()
+
+    events = load_events(args.replicas)
+    if args.dump:
+        dump_events(events, args.dump)
+        return
+    print(f"{len(events)} events, {ak.count(events.px)} particles")
+    results = run(events, args)
+    if args.json:
+        with open(args.json, "w") as f:
+            json.dump(
+                {
+                    "fastjet": fastjet.__version__,
+                    "python": platform.python_version(),
+                    "machine": platform.machine(),
+                    "cpus": os.cpu_count(),
+                    "n_threads": args.n_threads or fastjet.get_num_threads(),
+                    "replicas": args.replicas,
+                    "n_events": len(events),
+                    "results": results,
+                },
+                f,
+                indent=1,
+            )
+
+
+if __name__ == "__main__":
+    main()
@@ -190,7 +190,7 @@ ext_modules = [
     Pybind11Extension(
         "fastjet._ext",
         ["src/_ext.cpp"],
-        cxx_std=11,
+        cxx_std=17,
         include_dirs=[str(OUTPUT / "include")],
         library_dirs=[str(OUTPUT / "lib")],
         runtime_library_dirs=["$ORIGIN/_fastjet_core/lib"],
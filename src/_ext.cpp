@@ -2,19 +2,46 @@
 // https://github.com/scikit-hep/fastjet/blob/main/LICENSE
 
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <cmath>
+#include <condition_variable>
+#include <cstdint>
 #include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <functional>
 #include <iostream>
 #include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <type_traits>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
+#include <unistd.h>
+
 #include <fastjet/AreaDefinition.hh>
 #include <fastjet/ClusterSequence.hh>
 #include <fastjet/ClusterSequenceArea.hh>
+#include <fastjet/ClusterSequenceStructure.hh>
 #include <fastjet/GhostedAreaSpec.hh>
 #include <fastjet/JetDefinition.hh>
 #include <fastjet/PseudoJet.hh>
+#include <fastjet/Selector.hh>
+#include <fastjet/tools/GridMedianBackgroundEstimator.hh>
+#include <fastjet/tools/JetMedianBackgroundEstimator.hh>
+#include <fastjet/tools/Subtractor.hh>
 #include <fastjet/contrib/EnergyCorrelator.hh>
 #include <fastjet/contrib/LundGenerator.hh>
 #include <fastjet/contrib/Njettiness.hh>
@@ -97,1550 +124,4001 @@ template <typename T> T swigtocpp(py::object obj) {
   auto objpointer = reinterpret_cast<T>(objpointervoid);
   return objpointer;
 }
-class output_wrapper {
+
+// Persistent work-stealing pool used to spread independent per-event work
+// over several cores. Each participating thread owns a deque of event ranges:
+// it pops from the back of its own deque and, once that runs dry, steals from
+// the front of the others. The calling thread always takes part as slot 0, so
+// a pool with no workers simply runs everything inline.
+class thread_pool {
 public:
-  std::vector<std::shared_ptr<fj::ClusterSequence>> cse;
-  std::vector<std::shared_ptr<std::vector<fj::PseudoJet>>> parts;
+  typedef std::function<void(std::size_t, std::size_t)> range_function;
+
+  static thread_pool &instance() {
+    // threads do not survive a fork, so a child process (multiprocessing,
+    // dask "processes" scheduler, ...) gets a fresh pool; the parent's copy
+    // is deliberately leaked since its mutexes may be in any state
+    static thread_pool *pool = nullptr;
+    static pid_t owner = 0;
+    static std::mutex creation;
+    std::lock_guard<std::mutex> lock(creation);
+    if (pool == nullptr || owner != getpid()) {
+      pool = new thread_pool();
+      owner = getpid();
+    }
+    return *pool;
+  }
 
-  std::shared_ptr<fj::ClusterSequence> getCluster() {
-    auto a = cse[0];
-    return a;
+  static unsigned int hardware_threads() {
+    unsigned int n = std::thread::hardware_concurrency();
+    return n == 0 ? 1 : n;
   }
-  void setCluster() {}
+
+  ~thread_pool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    wake_.notify_all();
+    for (auto &worker : workers_) {
+      worker.join();
+    }
+  }
+
+  // Calls body(begin, end) on disjoint ranges covering [0, n), using at most
+  // n_threads threads. Returns once every range has been processed and
+  // rethrows the first exception raised by any of them.
+  void parallel_for(std::size_t n, unsigned int n_threads,
+                    const range_function &body) {
+    if (n == 0) {
+      return;
+    }
+    std::size_t threads = std::min<std::size_t>(std::max(n_threads, 1u), n);
+    if (threads == 1) {
+      body(0, n);
+      return;
+    }
+    std::lock_guard<std::mutex> serial(run_mutex_);
+    std::unique_lock<std::mutex> lock(mutex_);
+    // stragglers from the previous job must be gone before its queues refill
+    done_.wait(lock, [this] { return active_ == 0; });
+    ensure_workers(threads - 1);
+
+    // a few chunks per thread so that stealing can even out the load
+    std::size_t n_chunks = std::min<std::size_t>(n, threads * 8);
+    std::size_t per_slot = (n_chunks + threads - 1) / threads;
+    for (std::size_t c = 0; c < n_chunks; c++) {
+      std::size_t begin = n * c / n_chunks;
+      std::size_t end = n * (c + 1) / n_chunks;
+      queues_[c / per_slot]->ranges.push_back(std::make_pair(begin, end));
+    }
+    remaining_ = n_chunks;
+    participants_ = threads;
+    job_ = &body;
+    error_ = nullptr;
+    cancelled_ = false;
+    generation_++;
+    lock.unlock();
+    wake_.notify_all();
+
+    run_ranges(0, body);
+
+    lock.lock();
+    done_.wait(lock, [this] { return remaining_ == 0 && active_ == 0; });
+    job_ = nullptr;
+    if (error_) {
+      std::exception_ptr error = error_;
+      error_ = nullptr;
+      std::rethrow_exception(error);
+    }
+  }
+
+private:
+  typedef std::pair<std::size_t, std::size_t> range;
+  struct range_queue {
+    std::mutex lock;
+    std::deque<range> ranges;
+  };
+
+  thread_pool() { queues_.emplace_back(new range_queue()); }
+
+  // called with mutex_ held and no job in flight
+  void ensure_workers(std::size_t n_workers) {
+    while (workers_.size() < n_workers) {
+      queues_.emplace_back(new range_queue());
+      std::size_t slot = workers_.size() + 1;
+      workers_.emplace_back(&thread_pool::worker_loop, this, slot);
+    }
+  }
+
+  bool pop_range(std::size_t slot, range &out) {
+    {
+      range_queue &own = *queues_[slot];
+      std::lock_guard<std::mutex> lock(own.lock);
+      if (!own.ranges.empty()) {
+        out = own.ranges.back();
+        own.ranges.pop_back();
+        return true;
+      }
+    }
+    for (std::size_t k = 1; k < queues_.size(); k++) {
+      range_queue &victim = *queues_[(slot + k) % queues_.size()];
+      std::lock_guard<std::mutex> lock(victim.lock);
+      if (!victim.ranges.empty()) {
+        out = victim.ranges.front();
+        victim.ranges.pop_front();
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void run_ranges(std::size_t slot, const range_function &body) {
+    range r;
+    while (pop_range(slot, r)) {
+      if (!cancelled_.load(std::memory_order_relaxed)) {
+        try {
+          body(r.first, r.second);
+        } catch (...) {
+          std::lock_guard<std::mutex> lock(mutex_);
+          if (!error_) {
+            error_ = std::current_exception();
+          }
+          cancelled_ = true;
+        }
+      }
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (--remaining_ == 0) {
+        done_.notify_all();
+      }
+    }
+  }
+
+  void worker_loop(std::size_t slot) {
+    std::size_t seen = 0;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      wake_.wait(lock, [&] { return stop_ || generation_ != seen; });
+      if (stop_) {
+        return;
+      }
+      seen = generation_;
+      if (slot >= participants_ || job_ == nullptr) {
+        continue;
+      }
+      const range_function *job = job_;
+      active_++;
+      lock.unlock();
+      run_ranges(slot, *job);
+      lock.lock();
+      if (--active_ == 0) {
+        done_.notify_all();
+      }
+    }
+  }
+
+  std::vector<std::thread> workers_;
+  std::vector<std::unique_ptr<range_queue>> queues_;
+  std::mutex run_mutex_;
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::condition_variable done_;
+  const range_function *job_ = nullptr;
+  std::exception_ptr error_;
+  std::atomic<bool> cancelled_{false};
+  std::size_t remaining_ = 0;
+  std::size_t participants_ = 0;
+  std::size_t active_ = 0;
+  std::size_t generation_ = 0;
+  bool stop_ = false;
 };
 
-output_wrapper interfacemulti(
-    py::array_t<double, py::array::c_style | py::array::forcecast> pxi,
-    py::array_t<double, py::array::c_style | py::array::forcecast> pyi,
-    py::array_t<double, py::array::c_style | py::array::forcecast> pzi,
-    py::array_t<double, py::array::c_style | py::array::forcecast> Ei,
-    py::array_t<int, py::array::c_style | py::array::forcecast> starts,
-    py::array_t<int, py::array::c_style | py::array::forcecast> stops,
-    py::object jetdef) {
-  // requesting buffer information of the input
-  py::buffer_info infostarts = starts.request();
-  py::buffer_info infostops = stops.request();
-  py::buffer_info infopx = pxi.request();
-  py::buffer_info infopy = pyi.request();
-  py::buffer_info infopz = pzi.request();
-  py::buffer_info infoE = Ei.request();
+// process-wide default for the number of threads used by the batch interface
+std::atomic<unsigned int> default_n_threads{1};
 
-  // pointers to the initial values
-  auto startsptr = static_cast<int *>(infostarts.ptr);
-  auto stopsptr = static_cast<int *>(infostops.ptr);
-  auto pxptr = static_cast<double *>(infopx.ptr);
-  auto pyptr = static_cast<double *>(infopy.ptr);
-  auto pzptr = static_cast<double *>(infopz.ptr);
-  auto Eptr = static_cast<double *>(infoE.ptr);
-
-  int dimoff = infostarts.shape[0];
-  output_wrapper ow;
-  ow.cse.reserve(dimoff);
-  ow.parts.reserve(dimoff);
-  for (int i = 0; i < dimoff; i++) {
-    std::vector<fj::PseudoJet> particles;
-    particles.reserve(*stopsptr - *startsptr);
-    for (int j = *startsptr; j < *stopsptr; j++) {
-      particles.push_back(fj::PseudoJet(*pxptr, *pyptr, *pzptr, *Eptr));
-      pxptr++;
-      pyptr++;
-      pzptr++;
-      Eptr++;
+unsigned int resolve_n_threads(int n_threads) {
+  if (n_threads < 0) {
+    return default_n_threads.load();
+  }
+  if (n_threads == 0) {
+    return thread_pool::hardware_threads();
+  }
+  return static_cast<unsigned int>(n_threads);
+}
+
+void set_num_threads(int n_threads) {
+  default_n_threads =
+      n_threads <= 0 ? thread_pool::hardware_threads() : n_threads;
+}
+
+unsigned int get_num_threads() { return default_n_threads.load(); }
+
+// Optional instrumentation of the batch engine: wall time per phase and
+// counts of what went through it, summed over every batch of the process
+// until reset. Disabled by default, when each instrumented point costs one
+// relaxed atomic load. Phases run on the worker threads (construct, cluster)
+// are summed over the threads; the Python phases are added from Python.
+class batch_stats {
+public:
+  enum phase {
+    extract_cons,
+    correct_byteorder,
+    construct,
+    cluster,
+    jets,
+    export_columns,
+    assembly,
+    n_phases
+  };
+
+  static batch_stats &instance() {
+    static batch_stats stats;
+    return stats;
+  }
+
+  bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+  void set_enabled(bool enabled) { enabled_ = enabled; }
+
+  void add_time(phase p, int64_t ns) {
+    nanoseconds_[p].fetch_add(ns, std::memory_order_relaxed);
+    on_thread_[p] += ns;
+  }
+  void add_time(const std::string &name, double seconds) {
+    for (int p = 0; p < n_phases; p++) {
+      if (name == phase_names()[p]) {
+        add_time(static_cast<phase>(p), static_cast<int64_t>(seconds * 1e9));
+        return;
+      }
     }
-    std::vector<fj::PseudoJet> jets;
-    auto jet_def = swigtocpp<fj::JetDefinition *>(jetdef);
-    std::shared_ptr<std::vector<fj::PseudoJet>> pj =
-        std::make_shared<std::vector<fj::PseudoJet>>(particles);
-    std::shared_ptr<fastjet::ClusterSequence> cs =
-        std::make_shared<fastjet::ClusterSequence>(*pj, *jet_def);
-    startsptr++;
-    stopsptr++;
-    ow.cse.push_back(cs);
-    ow.parts.push_back(pj);
+    throw std::invalid_argument("Unknown batch phase " + name);
   }
-  return ow;
+  void count_batch(std::size_t n_events, std::size_t n_particles) {
+    batches_.fetch_add(1, std::memory_order_relaxed);
+    events_.fetch_add(n_events, std::memory_order_relaxed);
+    particles_.fetch_add(n_particles, std::memory_order_relaxed);
+  }
+  void count_jets(std::size_t n) {
+    jets_.fetch_add(n, std::memory_order_relaxed);
+  }
+  void count_bytes(std::size_t n) {
+    bytes_.fetch_add(n, std::memory_order_relaxed);
+  }
+
+  // time recorded by the calling thread, to tell the time spent in the
+  // engine apart from the Python around it
+  int64_t on_thread(phase p) const { return on_thread_[p]; }
+
+  void reset() {
+    for (auto &ns : nanoseconds_) {
+      ns = 0;
+    }
+    batches_ = events_ = particles_ = jets_ = bytes_ = 0;
+  }
+
+  py::dict seconds() const {
+    py::dict out;
+    for (int p = 0; p < n_phases; p++) {
+      out[phase_names()[p]] = nanoseconds_[p].load() * 1e-9;
+    }
+    return out;
+  }
+  std::size_t n_batches() const { return batches_; }
+  std::size_t n_events() const { return events_; }
+  std::size_t n_particles() const { return particles_; }
+  std::size_t n_jets() const { return jets_; }
+  std::size_t n_bytes() const { return bytes_; }
+
+  static const std::array<const char *, n_phases> &phase_names() {
+    static const std::array<const char *, n_phases> names = {
+        "extract_cons", "correct_byteorder", "construct", "cluster",
+        "jets",         "export",            "assembly"};
+    return names;
+  }
+
+private:
+  std::atomic<bool> enabled_{false};
+  std::array<std::atomic<int64_t>, n_phases> nanoseconds_{};
+  std::atomic<std::size_t> batches_{0}, events_{0}, particles_{0}, jets_{0},
+      bytes_{0};
+  static thread_local std::array<int64_t, n_phases> on_thread_;
+};
+
+thread_local std::array<int64_t, batch_stats::n_phases>
+    batch_stats::on_thread_{};
+
+// Adds the wall time of a scope to a phase when the stats are enabled.
+class phase_timer {
+public:
+  typedef std::chrono::steady_clock clock;
+
+  explicit phase_timer(batch_stats::phase p)
+      : phase_(p), enabled_(batch_stats::instance().enabled()) {
+    if (enabled_) {
+      start_ = clock::now();
+    }
+  }
+  ~phase_timer() { stop(); }
+  phase_timer(const phase_timer &) = delete;
+  phase_timer &operator=(const phase_timer &) = delete;
+
+  // ends the phase before the end of the scope
+  void stop() {
+    if (enabled_) {
+      batch_stats::instance().add_time(phase_, elapsed(start_));
+      enabled_ = false;
+    }
+  }
+
+  static int64_t elapsed(clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() -
+                                                                start)
+        .count();
+  }
+
+private:
+
+  batch_stats::phase phase_;
+  bool enabled_;
+  clock::time_point start_;
+};
+
+// Call guard of the output_wrapper queries: the time spent building their
+// numpy columns, without the jet extraction they trigger, which is its own
+// phase.
+class timed_export {
+public:
+  timed_export()
+      : enabled_(batch_stats::instance().enabled()),
+        jets_before_(batch_stats::instance().on_thread(batch_stats::jets)) {
+    if (enabled_) {
+      start_ = phase_timer::clock::now();
+    }
+  }
+  ~timed_export() {
+    if (enabled_) {
+      auto &stats = batch_stats::instance();
+      int64_t total = phase_timer::elapsed(start_);
+      int64_t jets = stats.on_thread(batch_stats::jets) - jets_before_;
+      stats.add_time(batch_stats::export_columns, total - jets);
+    }
+  }
+
+private:
+  bool enabled_;
+  int64_t jets_before_;
+  phase_timer::clock::time_point start_;
+};
+
+// Input particles of a whole batch, stored back to back in one allocation.
+// Event i owns particles[offsets[i], offsets[i + 1]).
+class particle_arena {
+public:
+  std::vector<fj::PseudoJet> particles;
+  std::vector<int64_t> offsets;
+
+  // lays out the events described by starts/stops and sizes the storage;
+  // the particles themselves are filled in afterwards, event by event
+  void allocate(const int64_t *starts, const int64_t *stops,
+                std::size_t n_events) {
+    offsets.resize(n_events + 1);
+    offsets[0] = 0;
+    for (std::size_t i = 0; i < n_events; i++) {
+      offsets[i + 1] = offsets[i] + (stops[i] - starts[i]);
+    }
+    particles.resize(offsets[n_events]);
+  }
+
+  // the same, for events of the given sizes
+  void allocate(const int64_t *sizes, std::size_t n_events) {
+    offsets.resize(n_events + 1);
+    offsets[0] = 0;
+    for (std::size_t i = 0; i < n_events; i++) {
+      offsets[i + 1] = offsets[i] + sizes[i];
+    }
+    particles.resize(offsets[n_events]);
+  }
+
+  std::size_t n_events() const {
+    return offsets.empty() ? 0 : offsets.size() - 1;
+  }
+  std::size_t size(std::size_t event) const {
+    return offsets[event + 1] - offsets[event];
+  }
+  fj::PseudoJet *begin(std::size_t event) {
+    return particles.data() + offsets[event];
+  }
+  const fj::PseudoJet *begin(std::size_t event) const {
+    return particles.data() + offsets[event];
+  }
+  const fj::PseudoJet *end(std::size_t event) const {
+    return particles.data() + offsets[event + 1];
+  }
+};
+
+// ClusterSequence and the contrib tools want a std::vector, so events are
+// staged through a per-thread buffer whose capacity is reused across events
+std::vector<fj::PseudoJet> &event_scratch(const particle_arena &arena,
+                                          std::size_t event) {
+  static thread_local std::vector<fj::PseudoJet> scratch;
+  scratch.assign(arena.begin(event), arena.end(event));
+  return scratch;
 }
 
-PYBIND11_MODULE(_ext, m) {
-  using namespace fastjet;
-  m.def("interfacemulti", &interfacemulti,
-        py::return_value_policy::take_ownership);
-  //m.def("set_recombiner", )  
+// A ClusterSequence that one thread reuses from event to event, for batches
+// that keep only what they copy out of each clustering (compact_history).
+// Its jets, history and N2Tiled tiles are cleared rather than freed, so
+// once the largest event of the thread has been seen the clustering only
+// allocates the working arrays local to the other strategies.
+class reusable_sequence : public fj::ClusterSequence {
+public:
+  reusable_sequence() {
+    _writeout_combinations = false;
+    _structure_shared_ptr.reset(new fj::ClusterSequenceStructure(this));
+  }
+  reusable_sequence(const reusable_sequence &) = delete;
+  reusable_sequence &operator=(const reusable_sequence &) = delete;
+
+  // clusters the particles [begin, end) as the ClusterSequence constructor
+  // does; the result stays valid until the next call
+  const fj::ClusterSequence &cluster(const fj::PseudoJet *begin,
+                                     const fj::PseudoJet *end,
+                                     const fj::JetDefinition &jet_def) {
+    _jets.clear();
+    _history.clear();
+    _jets.reserve(2 * (end - begin));
+    _jets.insert(_jets.end(), begin, end);
+    _jet_def = jet_def;
+    _decant_options_partial();
+    _initialise_and_run_no_decant();
+    return *this;
+  }
 
-  /// Jet algorithm definitions
+  static reusable_sequence &for_this_thread() {
+    static thread_local reusable_sequence sequence;
+    return sequence;
+  }
+};
 
-  py::class_<output_wrapper>(m, "output_wrapper")
-    .def_property("cse", &output_wrapper::getCluster,&output_wrapper::setCluster)
-    .def("to_numpy",
-      [](const output_wrapper ow, double min_pt = 0) {
-        auto css = ow.cse;
-        int64_t len = css.size();
-        // Don't specify the size if using push_back.
-        auto jk = 0;
-        for(int i = 0; i < len; i++){
-        jk += css[i]->inclusive_jets(min_pt).size();
-        }
-        auto px = py::array(py::buffer_info(nullptr, sizeof(double), py::format_descriptor<double>::value, 1, {jk}, {sizeof(double)}));
-        auto bufpx = px.request();
-        double *ptrpx = (double *)bufpx.ptr;
-
-        auto py = py::array(py::buffer_info(nullptr, sizeof(double), py::format_descriptor<double>::value, 1, {jk}, {sizeof(double)}));
-        auto bufpy = py.request();
-        double *ptrpy = (double *)bufpy.ptr;
-
-        auto pz = py::array(py::buffer_info(nullptr, sizeof(double), py::format_descriptor<double>::value, 1, {jk}, {sizeof(double)}));
-        auto bufpz = pz.request();
-        double *ptrpz = (double *)bufpz.ptr;
-
-        auto E = py::array(py::buffer_info(nullptr, sizeof(double), py::format_descriptor<double>::value, 1, {jk}, {sizeof(double)}));
-        auto bufE = E.request();
-        double *ptrE = (double *)bufE.ptr;
-
-        auto off = py::array(py::buffer_info(nullptr, sizeof(int), py::format_descriptor<int>::value, 1, {len+1}, {sizeof(int)}));
-        auto bufoff = off.request();
-        int *ptroff = (int *)bufoff.ptr;
-        size_t idxe = 0;
-        *ptroff = 0;
-        ptroff++;
-        for(int i = 0; i < len; i++){
-        auto jets = ow.cse[i]->inclusive_jets(min_pt);
-        for (unsigned int j = 0; j < jets.size(); j++)
-        {
-          ptrpx[idxe] = jets[j].px();
-          ptrpy[idxe] = jets[j].py();
-          ptrpz[idxe] = jets[j].pz();
-          ptrE[idxe] = jets[j].E();
-          idxe++;
-        }
-        *ptroff = jets.size()+*(ptroff-1);
-        ptroff++;
-        }
-        return std::make_tuple(
-            px,
-            py,
-            pz,
-            E,
-            off
-          );
-      }, "min_pt"_a = 0, R"pbdoc(
-        Retrieves the inclusive jets from multievent clustering and converts them to numpy arrays.
-        Args:
-          min_pt: Minimum jet pt to include. Default: 0.
-        Returns:
-          pt, eta, phi, m of inclusive jets.
-      )pbdoc")
-      .def("to_numpy_with_constituents",
-      [](const output_wrapper ow, double min_pt = 0) {
-        auto css = ow.cse;
-        int64_t len = css.size();
-        auto jk = 0;
-        auto sizepar = 0;
-
-        for(int i = 0; i < len; i++){
-        jk += css[i]->inclusive_jets(min_pt).size();
-        sizepar += css[i]->n_particles();
+// Cuts applied to the input particles as they are read, so that rejected
+// particles are never stored or clustered. Simple pt, |y| and E ranges are
+// checked directly; any other jet-by-jet Selector can be added on top.
+class particle_selection {
+public:
+  particle_selection() = default;
+
+  particle_selection(py::object selector, py::dict cuts) {
+    for (auto item : cuts) {
+      auto key = item.first.cast<std::string>();
+      double value = item.second.cast<double>();
+      if (key == "pt_min") {
+        pt2_min_ = value * value;
+      } else if (key == "pt_max") {
+        pt2_max_ = value * value;
+      } else if (key == "abs_rap_min") {
+        abs_rap_min_ = value;
+      } else if (key == "abs_rap_max") {
+        abs_rap_max_ = value;
+      } else if (key == "E_min") {
+        E_min_ = value;
+      } else if (key == "E_max") {
+        E_max_ = value;
+      } else {
+        throw std::invalid_argument(
+            "Unknown particle cut " + key +
+            "; expected pt_min, pt_max, abs_rap_min, abs_rap_max, E_min or "
+            "E_max");
+      }
+      active_ = true;
+    }
+    if (!selector.is_none()) {
+      selector_ = *swigtocpp<fj::Selector *>(selector);
+      if (!selector_.applies_jet_by_jet() || selector_.takes_reference()) {
+        throw std::invalid_argument(
+            "Particle selectors must apply particle by particle, without a "
+            "reference: " + selector_.description());
+      }
+      has_selector_ = true;
+      active_ = true;
+    }
+  }
+
+  bool active() const { return active_; }
+
+  // A Selector given from Python may call back into it (SelectorPython),
+  // directly or inside a combination of Selectors whose workers the Selector
+  // interface does not expose, so it is only applied with the GIL held.
+  bool needs_gil() const { return has_selector_; }
+
+  bool pass(const fj::PseudoJet &p) const {
+    double pt2 = p.pt2();
+    if (pt2 < pt2_min_ || pt2 > pt2_max_ || p.E() < E_min_ || p.E() > E_max_) {
+      return false;
+    }
+    if (abs_rap_min_ > 0 || abs_rap_max_ < inf) {
+      double abs_rap = std::abs(p.rap());
+      if (abs_rap < abs_rap_min_ || abs_rap > abs_rap_max_) {
+        return false;
+      }
+    }
+    return !has_selector_ || selector_.pass(p);
+  }
+
+private:
+  static constexpr double inf = std::numeric_limits<double>::infinity();
+  bool active_ = false;
+  double pt2_min_ = 0, pt2_max_ = inf;
+  double abs_rap_min_ = 0, abs_rap_max_ = inf;
+  double E_min_ = -inf, E_max_ = inf;
+  bool has_selector_ = false;
+  fj::Selector selector_;
+};
+
+// Where the particles kept by a particle_selection came from: particle k of
+// event i was at position index[offsets[i] + k] of the input event.
+struct input_positions {
+  std::vector<int> index;
+  std::vector<int64_t> offsets;
+
+  const int *of(std::size_t event) const {
+    return index.data() + offsets[event];
+  }
+};
+
+// Jet lists already extracted from a batch of clusterings, kept per
+// (query, parameter) so that successive accessors (jets, then constituents,
+// then substructure, ...) do not rescan the history of every event again.
+// Only the capacity most recently used lists are kept, so that scanning many
+// dcut or ycut values does not keep a jet table per value.
+class jet_cache {
+public:
+  enum query {
+    inclusive,
+    exclusive_njets,
+    exclusive_dcut,
+    exclusive_up_to,
+    exclusive_ycut
+  };
+  typedef std::vector<std::vector<fj::PseudoJet>> event_jets;
+
+  static constexpr std::size_t capacity = 8;
+
+  // find(i, q, param) extracts the jets of event i on a cache miss
+  template <typename Find>
+  std::shared_ptr<const event_jets> get(query q, double param,
+                                        std::size_t n_events, Find find) {
+    auto key = std::make_pair(static_cast<int>(q), param);
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto found = entries_.find(key);
+      if (found != entries_.end()) {
+        found->second.last_used = ++clock_;
+        return found->second.jets;
+      }
+    }
+    // extracted without the lock, so that readers of other keys are not
+    // held up; two threads missing the same key both extract it
+    auto jets = std::make_shared<event_jets>(n_events);
+    {
+      phase_timer timer(batch_stats::jets);
+      for (std::size_t i = 0; i < n_events; i++) {
+        (*jets)[i] = find(i, q, param);
+      }
+    }
+    auto &stats = batch_stats::instance();
+    if (stats.enabled()) {
+      std::size_t n_jets = 0;
+      for (const auto &event : *jets) {
+        n_jets += event.size();
+      }
+      stats.count_jets(n_jets);
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto inserted = entries_.emplace(key, entry{jets, 0});
+    inserted.first->second.last_used = ++clock_;
+    if (!inserted.second) {
+      return inserted.first->second.jets;
+    }
+    if (entries_.size() > capacity) {
+      auto oldest = entries_.begin();
+      for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+        if (it->second.last_used < oldest->second.last_used) {
+          oldest = it;
         }
-        jk++;
+      }
+      entries_.erase(oldest);
+    }
+    return jets;
+  }
 
-        auto parid = py::array(py::buffer_info(nullptr, sizeof(int), py::format_descriptor<int>::value, 1, {sizepar}, {sizeof(int)}));
-        auto bufparid = parid.request();
-        int *ptrid = (int *)bufparid.ptr;
+  void clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+  }
 
-        auto eventoffsets = py::array(py::buffer_info(nullptr, sizeof(int), py::format_descriptor<int>::value, 1, {len+1}, {sizeof(int)}));
-        auto bufeventoffsets = eventoffsets.request();
-        int *ptreventoffsets = (int *)bufeventoffsets.ptr;
-        size_t eventidx = 0;
+  std::size_t size() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+  }
 
-        ptreventoffsets[eventidx] = 0;
-        eventidx++;
+private:
+  struct entry {
+    std::shared_ptr<const event_jets> jets;
+    uint64_t last_used;
+  };
 
-        auto jetoffsets = py::array(py::buffer_info(nullptr, sizeof(int), py::format_descriptor<int>::value, 1, {jk}, {sizeof(int)}));
-        auto bufjetoffsets = jetoffsets.request();
-        int *ptrjetoffsets = (int *)bufjetoffsets.ptr;
-        size_t jetidx = 0;
+  std::mutex mutex_;
+  uint64_t clock_ = 0;
+  std::map<std::pair<int, double>, entry> entries_;
+};
 
-        size_t idxh = 0;
-        ptrjetoffsets[jetidx] = 0;
-        jetidx++;
-        auto eventprev = 0;
+// The jets of one event for a cached query, from a ClusterSequence or from a
+// compact_history::event.
+template <typename Sequence>
+std::vector<fj::PseudoJet> find_jets(const Sequence &cs, jet_cache::query q,
+                                     double param) {
+  switch (q) {
+  case jet_cache::inclusive:
+    return cs.inclusive_jets(param);
+  case jet_cache::exclusive_njets:
+    return cs.exclusive_jets(static_cast<int>(param));
+  case jet_cache::exclusive_dcut:
+    return cs.exclusive_jets(param);
+  case jet_cache::exclusive_up_to:
+    return cs.exclusive_jets_up_to(static_cast<int>(param));
+  case jet_cache::exclusive_ycut:
+    return cs.exclusive_jets_ycut(param);
+  }
+  return {};
+}
 
+// The parents of one history element and the largest merging distance up to
+// it, as read by the walks that need the raw merge tree.
+struct history_element {
+  int parent1, parent2;
+  double max_dij_so_far;
+};
 
-        for (unsigned int i = 0; i < css.size(); i++){
+// The merge trees of a batch of clusterings as flat columns, with one entry
+// per history element of every event: its parents, its child, the merging
+// distances and the four-momentum of the jet it produced. Exclusive jets,
+// subjets and history queries only need this, which takes a fraction of the
+// memory of a ClusterSequence with its jets, structures and strategy state.
+class compact_history {
+public:
+  std::vector<int> parent1, parent2, child;
+  std::vector<double> dij, max_dij_so_far;
+  std::vector<double> px, py, pz, E;
+  // the history of event i spans [offsets[i], offsets[i + 1])
+  std::vector<int64_t> offsets;
+  std::vector<double> Q;
+
+  // a complete clustering of n particles has 2n history elements
+  void allocate(const particle_arena &arena) {
+    std::size_t n_events = arena.n_events();
+    offsets.resize(n_events + 1);
+    for (std::size_t i = 0; i <= n_events; i++) {
+      offsets[i] = 2 * arena.offsets[i];
+    }
+    std::size_t size = offsets[n_events];
+    for (auto column : {&parent1, &parent2, &child}) {
+      column->resize(size);
+    }
+    for (auto column : {&dij, &max_dij_so_far, &px, &py, &pz, &E}) {
+      column->resize(size);
+    }
+    Q.resize(n_events);
+  }
 
-        auto jets = css[i]->inclusive_jets(min_pt);
-        int size = css[i]->inclusive_jets(min_pt).size();
-        auto idx = css[i]->particle_jet_indices(jets);
-        int64_t sizz = css[i]->n_particles();
-        auto prev = ptrjetoffsets[jetidx-1];
+  // copies the history of event i out of its clustering; events only write
+  // their own entries, so events may be filled concurrently
+  void fill(std::size_t i, const fj::ClusterSequence &cs) {
+    const auto &history = cs.history();
+    if (static_cast<int64_t>(history.size()) != offsets[i + 1] - offsets[i]) {
+      throw std::runtime_error(
+          "compact_history requires every particle to be clustered");
+    }
+    const auto &jets = cs.jets();
+    for (std::size_t h = 0; h < history.size(); h++) {
+      auto k = offsets[i] + h;
+      parent1[k] = history[h].parent1;
+      parent2[k] = history[h].parent2;
+      child[k] = history[h].child;
+      dij[k] = history[h].dij;
+      max_dij_so_far[k] = history[h].max_dij_so_far;
+      // mergings with the beam produce no jet
+      if (history[h].jetp_index >= 0) {
+        const auto &jet = jets[history[h].jetp_index];
+        px[k] = jet.px();
+        py[k] = jet.py();
+        pz[k] = jet.pz();
+        E[k] = jet.E();
+      } else {
+        px[k] = py[k] = pz[k] = E[k] = 0;
+      }
+    }
+    Q[i] = cs.Q();
+  }
 
-        for (unsigned int j = 0; j < jets.size(); j++){
-        ptrjetoffsets[jetidx] = jets[j].constituents().size() + prev;
-        prev = ptrjetoffsets[jetidx];
-        jetidx++;
-        }
-        for(int k = 0; k < size; k++){
-          for(int j = 0; j <sizz; j++){
-            if(idx[j] == k){
-              ptrid[idxh] = j;
-              idxh++;
-            }
-          }
-        }
-        ptreventoffsets[eventidx] = jets.size()+eventprev;
-        eventprev = ptreventoffsets[eventidx];
-        eventidx++;
-          }
-        return std::make_tuple(
-            jetoffsets,
-            parid,
-            eventoffsets
-          );
-      }, "min_pt"_a = 0, R"pbdoc(
-        Retrieves the inclusive jets and converts them to numpy arrays.
-        Args:
-          min_pt: Minimum jet pt to include. Default: 0.
-        Returns:
-          pt, eta, phi, m of inclusive jets.
-      )pbdoc")
-      .def("to_numpy_exclusive_njet",
-      [](const output_wrapper ow, const int n_jets = 0) {
-        auto css = ow.cse;
-        int64_t len = css.size();
-        // Don't specify the size if using push_back.
-        auto jk = 0;
-        for(int i = 0; i < len; i++){
-        jk += css[i]->exclusive_jets(n_jets).size();
-        }
+  class event;
+  event at(std::size_t i) const;
+};
 
-        auto px = py::array(py::buffer_info(nullptr, sizeof(double), py::format_descriptor<double>::value, 1, {jk}, {sizeof(double)}));
-        auto bufpx = px.request();
-        double *ptrpx = (double *)bufpx.ptr;
-
-        auto py = py::array(py::buffer_info(nullptr, sizeof(double), py::format_descriptor<double>::value, 1, {jk}, {sizeof(double)}));
-        auto bufpy = py.request();
-        double *ptrpy = (double *)bufpy.ptr;
-
-        auto pz = py::array(py::buffer_info(nullptr, sizeof(double), py::format_descriptor<double>::value, 1, {jk}, {sizeof(double)}));
-        auto bufpz = pz.request();
-        double *ptrpz = (double *)bufpz.ptr;
-
-        auto E = py::array(py::buffer_info(nullptr, sizeof(double), py::format_descriptor<double>::value, 1, {jk}, {sizeof(double)}));
-        auto bufE = E.request();
-        double *ptrE = (double *)bufE.ptr;
-
-        auto off = py::array(py::buffer_info(nullptr, sizeof(int), py::format_descriptor<int>::value, 1, {len+1}, {sizeof(int)}));
-        auto bufoff = off.request();
-        int *ptroff = (int *)bufoff.ptr;
-        size_t idxe = 0;
-        *ptroff = 0;
-        ptroff++;
-        for(int i = 0; i < len; i++){
-        auto jets = ow.cse[i]->exclusive_jets(n_jets);
-        for (unsigned int j = 0; j < jets.size(); j++)
-        {
-          ptrpx[idxe] = jets[j].px();
-          ptrpy[idxe] = jets[j].py();
-          ptrpz[idxe] = jets[j].pz();
-          ptrE[idxe] = jets[j].E();
-          idxe++;
-        }
-        *ptroff = jets.size()+*(ptroff-1);
-        ptroff++;
-        }
-        return std::make_tuple(
-            px,
-            py,
-            pz,
-            E,
-            off
-          );
-      }, "n_jets"_a = 0, R"pbdoc(
-        Retrieves the exclusive n jets from multievent clustering and converts them to numpy arrays.
-        Args:
-          n_jets: Number of exclusive jets. Default: 0.
-        Returns:
-          pt, eta, phi, m of exclusive jets.
-      )pbdoc")
-      .def("to_numpy_exclusive_njet_up_to",
-      [](const output_wrapper ow, const int n_jets = 0) {
-        auto css = ow.cse;
-        int64_t len = css.size();
-        // Don't specify the size if using push_back.
-        auto jk = 0;
-        for(int i = 0; i < len; i++){
-        jk += css[i]->exclusive_jets_up_to(n_jets).size();
-        }
+// The history of one event, answering the ClusterSequence queries that only
+// depend on the merge tree the way FastJet does. Jets are handed out as plain
+// PseudoJets carrying their cluster_hist_index.
+class compact_history::event {
+public:
+  event(const compact_history &history, std::size_t i)
+      : h_(history), first_(history.offsets[i]),
+        size_(static_cast<int>(history.offsets[i + 1] - first_)),
+        Q_(history.Q[i]) {}
+
+  unsigned int n_particles() const { return size_ / 2; }
+  int history_size() const { return size_; }
+  history_element element(int h) const {
+    return {parent1(h), parent2(h), max_dij_so_far(h)};
+  }
+  double Q() const { return Q_; }
+  double Q2() const { return Q_ * Q_; }
 
-        auto px = py::array(py::buffer_info(nullptr, sizeof(double), py::format_descriptor<double>::value, 1, {jk}, {sizeof(double)}));
-        auto bufpx = px.request();
-        double *ptrpx = (double *)bufpx.ptr;
-
-        auto py = py::array(py::buffer_info(nullptr, sizeof(double), py::format_descriptor<double>::value, 1, {jk}, {sizeof(double)}));
-        auto bufpy = py.request();
-        double *ptrpy = (double *)bufpy.ptr;
-
-        auto pz = py::array(py::buffer_info(nullptr, sizeof(double), py::format_descriptor<double>::value, 1, {jk}, {sizeof(double)}));
-        auto bufpz = pz.request();
-        double *ptrpz = (double *)bufpz.ptr;
-
-        auto E = py::array(py::buffer_info(nullptr, sizeof(double), py::format_descriptor<double>::value, 1, {jk}, {sizeof(double)}));
-        auto bufE = E.request();
-        double *ptrE = (double *)bufE.ptr;
-
-        auto off = py::array(py::buffer_info(nullptr, sizeof(int), py::format_descriptor<int>::value, 1, {len+1}, {sizeof(int)}));
-        auto bufoff = off.request();
-        int *ptroff = (int *)bufoff.ptr;
-        size_t idxe = 0;
-        *ptroff = 0;
-        ptroff++;
-        for(int i = 0; i < len; i++){
-        auto jets = ow.cse[i]->exclusive_jets_up_to(n_jets);
-        for (unsigned int j = 0; j < jets.size(); j++)
-        {
-          ptrpx[idxe] = jets[j].px();
-          ptrpy[idxe] = jets[j].py();
-          ptrpz[idxe] = jets[j].pz();
-          ptrE[idxe] = jets[j].E();
-          idxe++;
-        }
-        *ptroff = jets.size()+*(ptroff-1);
-        ptroff++;
-        }
-        return std::make_tuple(
-            px,
-            py,
-            pz,
-            E,
-            off
-          );
-      }, "n_jets"_a = 0, R"pbdoc(
-        Retrieves the exclusive jets up to n jets from multievent clustering and converts them to numpy arrays.
-        Args:
-          n_jets: Number of exclusive jets. Default: 0.
-        Returns:
-          pt, eta, phi, m of exclusive jets.
-      )pbdoc")
-      .def("to_numpy_exclusive_njet_with_constituents",
-      [](const output_wrapper ow, const int n_jets = 0) {
-        auto css = ow.cse;
-        int64_t len = css.size();
-        auto jk = 0;
-        auto sizepar = 0;
-
-        for(int i = 0; i < len; i++){
-          jk += css[i]->exclusive_jets(n_jets).size();
-          sizepar += css[i]->n_particles();
-        }
-        jk++;
-
-        auto parid = py::array(py::buffer_info(nullptr, sizeof(int), py::format_descriptor<int>::value, 1, {sizepar}, {sizeof(int)}));
-        auto bufparid = parid.request();
-        int *ptrid = (int *)bufparid.ptr;
-
-        auto eventoffsets = py::array(py::buffer_info(nullptr, sizeof(int), py::format_descriptor<int>::value, 1, {len+1}, {sizeof(int)}));
-        auto bufeventoffsets = eventoffsets.request();
-        int *ptreventoffsets = (int *)bufeventoffsets.ptr;
-        size_t eventidx = 0;
-
-        ptreventoffsets[eventidx] = 0;
-        eventidx++;
-
-        auto jetoffsets = py::array(py::buffer_info(nullptr, sizeof(int), py::format_descriptor<int>::value, 1, {jk}, {sizeof(int)}));
-        auto bufjetoffsets = jetoffsets.request();
-        int *ptrjetoffsets = (int *)bufjetoffsets.ptr;
-        size_t jetidx = 0;
-
-        size_t idxh = 0;
-        ptrjetoffsets[jetidx] = 0;
-        jetidx++;
-        auto eventprev = 0;
-
-
-        for (unsigned int i = 0; i < css.size(); i++){  // iterate through events
-            auto jets = css[i]->exclusive_jets(n_jets);
-            int size = css[i]->exclusive_jets(n_jets).size();
-            auto idx = css[i]->particle_jet_indices(jets);
-            int64_t sizz = css[i]->n_particles();
-            auto prev = ptrjetoffsets[jetidx-1];
-
-            for (unsigned int j = 0; j < jets.size(); j++){
-              ptrjetoffsets[jetidx] = jets[j].constituents().size() + prev;
-              prev = ptrjetoffsets[jetidx];
-              jetidx++;
-            }
-            for(int k = 0; k < size; k++){  // iterate through jets in event
-              for(int j = 0; j <sizz; j++){  // iterate through particles in event
-                if(idx[j] == k){  // if particle jet index matches jet index assign it to jet j
-                  ptrid[idxh] = j;
-                  idxh++;
-                }
-              }
-            }
-            ptreventoffsets[eventidx] = jets.size()+eventprev;
-            eventprev = ptreventoffsets[eventidx];
-            eventidx++;
-          }
-        return std::make_tuple(
-            jetoffsets,
-            parid,
-            eventoffsets
-          );
-      }, "n_jets"_a = 0, R"pbdoc(
-        Retrieves the constituents of n exclusive jets from multievent clustering and converts them to numpy arrays.
-        Args:
-          n_jets: Number of exclusive subjets. Default: 0.
-        Returns:
-          jet offsets, particle indices, and event offsets
-      )pbdoc")
-      .def("to_numpy_exclusive_dcut",
-      [](const output_wrapper ow, const double dcut = 100) {
-        auto css = ow.cse;
-        int64_t len = css.size();
-        // Don't specify the size if using push_back.
-        auto jk = 0;
-        for(int i = 0; i < len; i++){
-        jk += css[i]->exclusive_jets(dcut).size();
-        }
+  bool has_jet(int64_t h) const {
+    return h >= 0 && h < size_ && parent2(h) != fj::ClusterSequence::BeamJet;
+  }
+  fj::PseudoJet jet(int h) const {
+    auto k = first_ + h;
+    fj::PseudoJet j(h_.px[k], h_.py[k], h_.pz[k], h_.E[k]);
+    j.set_cluster_hist_index(h);
+    return j;
+  }
 
-        auto px = py::array(py::buffer_info(nullptr, sizeof(double), py::format_descriptor<double>::value, 1, {jk}, {sizeof(double)}));
-        auto bufpx = px.request();
-        double *ptrpx = (double *)bufpx.ptr;
-
-        auto py = py::array(py::buffer_info(nullptr, sizeof(double), py::format_descriptor<double>::value, 1, {jk}, {sizeof(double)}));
-        auto bufpy = py.request();
-        double *ptrpy = (double *)bufpy.ptr;
-
-        auto pz = py::array(py::buffer_info(nullptr, sizeof(double), py::format_descriptor<double>::value, 1, {jk}, {sizeof(double)}));
-        auto bufpz = pz.request();
-        double *ptrpz = (double *)bufpz.ptr;
-
-        auto E = py::array(py::buffer_info(nullptr, sizeof(double), py::format_descriptor<double>::value, 1, {jk}, {sizeof(double)}));
-        auto bufE = E.request();
-        double *ptrE = (double *)bufE.ptr;
-
-        auto off = py::array(py::buffer_info(nullptr, sizeof(int), py::format_descriptor<int>::value, 1, {len+1}, {sizeof(int)}));
-        auto bufoff = off.request();
-        int *ptroff = (int *)bufoff.ptr;
-        size_t idxe = 0;
-        *ptroff = 0;
-        ptroff++;
-        for(int i = 0; i < len; i++){
-        auto jets = ow.cse[i]->exclusive_jets(dcut);
-        for (unsigned int j = 0; j < jets.size(); j++)
-        {
-          ptrpx[idxe] = jets[j].px();
-          ptrpy[idxe] = jets[j].py();
-          ptrpz[idxe] = jets[j].pz();
-          ptrE[idxe] = jets[j].E();
-          idxe++;
+  std::vector<fj::PseudoJet> inclusive_jets(double ptmin = 0) const {
+    double dcut = ptmin * ptmin;
+    std::vector<fj::PseudoJet> jets;
+    for (int i = size_ - 1; i >= 0; i--) {
+      if (parent2(i) == fj::ClusterSequence::BeamJet) {
+        auto jet = this->jet(parent1(i));
+        if (jet.perp2() >= dcut) {
+          jets.push_back(jet);
         }
-        *ptroff = jets.size()+*(ptroff-1);
-        ptroff++;
+      }
+    }
+    return jets;
+  }
+
+  int n_exclusive_jets(double dcut) const {
+    int i = size_ - 1;
+    while (i >= 0 && max_dij_so_far(i) > dcut) {
+      i--;
+    }
+    return size_ - (i + 1);
+  }
+  std::vector<fj::PseudoJet> exclusive_jets(double dcut) const {
+    return exclusive_jets(n_exclusive_jets(dcut));
+  }
+  std::vector<fj::PseudoJet> exclusive_jets(int njets) const {
+    if (njets > static_cast<int>(n_particles())) {
+      throw fj::Error("Requested " + std::to_string(njets) +
+                      " exclusive jets, but there were only " +
+                      std::to_string(n_particles()) +
+                      " particles in the event");
+    }
+    return exclusive_jets_up_to(njets);
+  }
+  std::vector<fj::PseudoJet> exclusive_jets_up_to(int njets) const {
+    int stop_point = std::max(size_ - njets, size_ / 2);
+    std::vector<fj::PseudoJet> jets;
+    for (int i = stop_point; i < size_; i++) {
+      if (parent1(i) < stop_point) {
+        jets.push_back(jet(parent1(i)));
+      }
+      if (parent2(i) < stop_point && parent2(i) > 0) {
+        jets.push_back(jet(parent2(i)));
+      }
+    }
+    return jets;
+  }
+  std::vector<fj::PseudoJet> exclusive_jets_ycut(double ycut) const {
+    return exclusive_jets(n_exclusive_jets(ycut * Q2()));
+  }
+
+  double exclusive_dmerge(int njets) const {
+    return njets >= static_cast<int>(n_particles())
+               ? 0.0
+               : dij(merging_to(njets));
+  }
+  double exclusive_dmerge_max(int njets) const {
+    return njets >= static_cast<int>(n_particles())
+               ? 0.0
+               : max_dij_so_far(merging_to(njets));
+  }
+  double exclusive_ymerge(int njets) const {
+    return exclusive_dmerge(njets) / Q2();
+  }
+  double exclusive_ymerge_max(int njets) const {
+    return exclusive_dmerge_max(njets) / Q2();
+  }
+
+  // for every particle, the index of the jet it ended up in, or -1
+  std::vector<int>
+  particle_jet_indices(const std::vector<fj::PseudoJet> &jets) const {
+    std::vector<int> indices(n_particles(), -1);
+    std::vector<int> pending;
+    for (std::size_t k = 0; k < jets.size(); k++) {
+      pending.push_back(jets[k].cluster_hist_index());
+      while (!pending.empty()) {
+        int h = pending.back();
+        pending.pop_back();
+        if (parent1(h) < 0) {
+          indices[h] = static_cast<int>(k);
+        } else {
+          pending.push_back(parent1(h));
+          pending.push_back(parent2(h));
         }
-        return std::make_tuple(
-            px,
-            py,
-            pz,
-            E,
-            off
-          );
-      }, "dcut"_a = 100, R"pbdoc(
-        Retrieves the exclusive jets upto the given dcut from multievent clustering and converts them to numpy arrays.
-        Args:
-          min_pt: Minimum jet pt to include. Default: 0.
-        Returns:
-          pt, eta, phi, m of inclusive jets.
-      )pbdoc")
-      .def("to_numpy_exclusive_ycut",
-      [](const output_wrapper ow, const double ycut = 100) {
-        auto css = ow.cse;
-        int64_t len = css.size();
-        // Don't specify the size if using push_back.
-        auto jk = 0;
-        for(int i = 0; i < len; i++){
-        jk += css[i]->exclusive_jets_ycut(ycut).size();
+      }
+    }
+    return indices;
+  }
+
+  std::vector<fj::PseudoJet> exclusive_subjets(const fj::PseudoJet &jet,
+                                               double dcut) const {
+    return jets_of(subhistory(jet, dcut, 0));
+  }
+  std::vector<fj::PseudoJet> exclusive_subjets(const fj::PseudoJet &jet,
+                                               int nsub) const {
+    auto subjets = exclusive_subjets_up_to(jet, nsub);
+    if (static_cast<int>(subjets.size()) < nsub) {
+      throw fj::Error("Requested " + std::to_string(nsub) +
+                      " exclusive subjets, but there were only " +
+                      std::to_string(subjets.size()) +
+                      " particles in the jet");
+    }
+    return subjets;
+  }
+  std::vector<fj::PseudoJet> exclusive_subjets_up_to(const fj::PseudoJet &jet,
+                                                     int nsub) const {
+    if (nsub < 0) {
+      throw fj::Error("Requested a negative number of subjets. This is "
+                      "nonsensical.");
+    }
+    if (nsub == 0) {
+      return {};
+    }
+    return jets_of(subhistory(jet, -1.0, nsub));
+  }
+  int n_exclusive_subjets(const fj::PseudoJet &jet, double dcut) const {
+    return static_cast<int>(subhistory(jet, dcut, 0).size());
+  }
+  double exclusive_subdmerge(const fj::PseudoJet &jet, int nsub) const {
+    return dij(*subhistory(jet, -1.0, nsub).rbegin());
+  }
+  double exclusive_subdmerge_max(const fj::PseudoJet &jet, int nsub) const {
+    return max_dij_so_far(*subhistory(jet, -1.0, nsub).rbegin());
+  }
+
+  bool has_parents(const fj::PseudoJet &jet, fj::PseudoJet &p1,
+                   fj::PseudoJet &p2) const {
+    int h = jet.cluster_hist_index();
+    if (parent1(h) < 0) {
+      p1 = p2 = fj::PseudoJet(0, 0, 0, 0);
+      return false;
+    }
+    p1 = this->jet(parent1(h));
+    p2 = this->jet(parent2(h));
+    if (p1.perp2() < p2.perp2()) {
+      std::swap(p1, p2);
+    }
+    return true;
+  }
+  bool has_child(const fj::PseudoJet &jet, fj::PseudoJet &c) const {
+    int h = child(jet.cluster_hist_index());
+    if (h >= 0 && has_jet(h)) {
+      c = this->jet(h);
+      return true;
+    }
+    c = fj::PseudoJet(0, 0, 0, 0);
+    return false;
+  }
+
+  // the history elements in the order FastJet's unique_history_order lists
+  // them: each particle, then the clusterings it takes part in, with the
+  // parents of a clustering listed before it, lowest constituent first
+  std::vector<int> unique_history_order() const {
+    std::vector<int> lowest(size_, size_);
+    for (int i = 0; i < size_; i++) {
+      lowest[i] = std::min(lowest[i], i);
+      if (child(i) > 0) {
+        lowest[child(i)] = std::min(lowest[child(i)], lowest[i]);
+      }
+    }
+    std::vector<bool> extracted(size_, false);
+    std::vector<int> order;
+    order.reserve(size_);
+    for (int i = 0; i < static_cast<int>(n_particles()); i++) {
+      if (!extracted[i]) {
+        order.push_back(i);
+        extracted[i] = true;
+        extract_children(i, extracted, lowest, order);
+      }
+    }
+    return order;
+  }
+
+private:
+  // the clustering that went from njets + 1 to njets jets
+  int merging_to(int njets) const {
+    if (njets < 0) {
+      throw std::invalid_argument("njets must be >= 0");
+    }
+    return size_ - njets - 1;
+  }
+
+  int parent1(int64_t h) const { return h_.parent1[first_ + h]; }
+  int parent2(int64_t h) const { return h_.parent2[first_ + h]; }
+  int child(int64_t h) const { return h_.child[first_ + h]; }
+  double dij(int64_t h) const { return h_.dij[first_ + h]; }
+  double max_dij_so_far(int64_t h) const {
+    return h_.max_dij_so_far[first_ + h];
+  }
+
+  // the history elements a jet is split into, undoing its clusterings from
+  // the last one until maxjet pieces are reached (when > 0) or the next
+  // clustering happened at a distance <= dcut
+  std::set<int> subhistory(const fj::PseudoJet &jet, double dcut,
+                           int maxjet) const {
+    std::set<int> subhist{jet.cluster_hist_index()};
+    int njet = 1;
+    while (true) {
+      int highest = *subhist.rbegin();
+      if (njet == maxjet || parent1(highest) < 0 ||
+          max_dij_so_far(highest) <= dcut) {
+        break;
+      }
+      subhist.erase(highest);
+      subhist.insert(parent1(highest));
+      subhist.insert(parent2(highest));
+      njet++;
+    }
+    return subhist;
+  }
+  std::vector<fj::PseudoJet> jets_of(const std::set<int> &subhist) const {
+    std::vector<fj::PseudoJet> jets;
+    jets.reserve(subhist.size());
+    for (int h : subhist) {
+      jets.push_back(jet(h));
+    }
+    return jets;
+  }
+
+  void extract_children(int h, std::vector<bool> &extracted,
+                        const std::vector<int> &lowest,
+                        std::vector<int> &order) const {
+    if (!extracted[h]) {
+      extract_parents(h, extracted, lowest, order);
+    }
+    if (child(h) >= 0) {
+      extract_children(child(h), extracted, lowest, order);
+    }
+  }
+  void extract_parents(int h, std::vector<bool> &extracted,
+                       const std::vector<int> &lowest,
+                       std::vector<int> &order) const {
+    if (extracted[h]) {
+      return;
+    }
+    int p1 = parent1(h);
+    int p2 = parent2(h);
+    if (p1 >= 0 && p2 >= 0 && lowest[p1] > lowest[p2]) {
+      std::swap(p1, p2);
+    }
+    if (p1 >= 0 && !extracted[p1]) {
+      extract_parents(p1, extracted, lowest, order);
+    }
+    if (p2 >= 0 && !extracted[p2]) {
+      extract_parents(p2, extracted, lowest, order);
+    }
+    order.push_back(h);
+    extracted[h] = true;
+  }
+
+  const compact_history &h_;
+  int64_t first_;
+  int size_;
+  double Q_;
+};
+
+inline compact_history::event compact_history::at(std::size_t i) const {
+  return event(*this, i);
+}
+
+// The jet at a history index of one event, or out_of_range if that element
+// produced no jet.
+fj::PseudoJet history_jet(const fj::ClusterSequence &cs, int64_t h) {
+  const auto &history = cs.history();
+  if (h < 0 || h >= static_cast<int64_t>(history.size()) ||
+      history[h].jetp_index < 0) {
+    throw std::out_of_range("Jet Not in this ClusterSequence");
+  }
+  return cs.jets()[history[h].jetp_index];
+}
+fj::PseudoJet history_jet(const compact_history::event &cs, int64_t h) {
+  if (!cs.has_jet(h)) {
+    throw std::out_of_range("Jet Not in this ClusterSequence");
+  }
+  return cs.jet(static_cast<int>(h));
+}
+
+int history_size(const fj::ClusterSequence &cs) {
+  return static_cast<int>(cs.history().size());
+}
+int history_size(const compact_history::event &cs) { return cs.history_size(); }
+history_element history_at(const fj::ClusterSequence &cs, int h) {
+  const auto &element = cs.history()[h];
+  return {element.parent1, element.parent2, element.max_dij_so_far};
+}
+history_element history_at(const compact_history::event &cs, int h) {
+  return cs.element(h);
+}
+
+// The exclusive jets of one event for several numbers of jets, or several
+// dcut or ycut values, from a single backward walk over its history. The
+// clusterings are undone from the last one; undoing one removes the jet it
+// produced from the current jets and puts its parents first, which keeps the
+// jets in the order exclusive_jets lists them. Each configuration is copied
+// out when the walk reaches it.
+template <typename Sequence>
+std::vector<std::vector<fj::PseudoJet>>
+exclusive_jets_multi(const Sequence &cs, jet_cache::query q,
+                     const std::vector<double> &params) {
+  int size = history_size(cs);
+  int n_particles = static_cast<int>(cs.n_particles());
+  // the configuration for njets jets starts at history element stop
+  std::vector<int> stops(params.size());
+  for (std::size_t k = 0; k < params.size(); k++) {
+    int njets;
+    if (q == jet_cache::exclusive_njets) {
+      njets = static_cast<int>(params[k]);
+    } else {
+      double dcut = q == jet_cache::exclusive_ycut ? params[k] * cs.Q2()
+                                                   : params[k];
+      // max_dij_so_far never decreases along the history, so the elements
+      // above dcut are a suffix of it
+      int lo = 0, hi = size;
+      while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (history_at(cs, mid).max_dij_so_far > dcut) {
+          hi = mid;
+        } else {
+          lo = mid + 1;
+        }
+      }
+      njets = size - lo;
+    }
+    if (njets > n_particles) {
+      throw fj::Error("Requested " + std::to_string(njets) +
+                      " exclusive jets, but there were only " +
+                      std::to_string(n_particles) + " particles in the event");
+    }
+    stops[k] = std::max(size - njets, n_particles);
+  }
+  std::vector<std::size_t> order(params.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&](std::size_t a,
+                                                   std::size_t b) {
+    return stops[a] > stops[b];
+  });
+
+  // the current jets as a doubly linked list of history indices
+  const int none = -1;
+  std::vector<int> next(size, none), prev(size, none);
+  std::vector<bool> current(size, false);
+  int head = none;
+  auto push_front = [&](int h) {
+    next[h] = head;
+    prev[h] = none;
+    if (head != none) {
+      prev[head] = h;
+    }
+    head = h;
+    current[h] = true;
+  };
+  auto remove = [&](int h) {
+    if (prev[h] != none) {
+      next[prev[h]] = next[h];
+    } else {
+      head = next[h];
+    }
+    if (next[h] != none) {
+      prev[next[h]] = prev[h];
+    }
+    current[h] = false;
+  };
+
+  std::vector<std::vector<fj::PseudoJet>> configurations(params.size());
+  int stop = size;
+  for (std::size_t k : order) {
+    for (; stop > stops[k]; stop--) {
+      int h = stop - 1;
+      if (current[h]) {
+        remove(h);
+      }
+      // like exclusive_jets, which skips a second parent at index 0
+      auto element = history_at(cs, h);
+      if (element.parent2 > 0) {
+        push_front(element.parent2);
+      }
+      push_front(element.parent1);
+    }
+    auto &jets = configurations[k];
+    for (int h = head; h != none; h = next[h]) {
+      jets.push_back(history_jet(cs, h));
+    }
+  }
+  return configurations;
+}
+
+// Coordinates of the exported jet four-momenta.
+enum class momentum_coordinates { cartesian, pt_eta_phi_m, pt_eta_phi_e };
+
+momentum_coordinates parse_coordinates(const std::string &name) {
+  if (name == "cartesian") {
+    return momentum_coordinates::cartesian;
+  }
+  if (name == "ptetaphim") {
+    return momentum_coordinates::pt_eta_phi_m;
+  }
+  if (name == "ptetaphie") {
+    return momentum_coordinates::pt_eta_phi_e;
+  }
+  throw std::invalid_argument("Unknown momentum coordinates: " + name);
+}
+
+class output_wrapper {
+public:
+  // one slot per event, all empty when only the compact history is kept
+  std::vector<std::shared_ptr<fj::ClusterSequence>> cse;
+  std::shared_ptr<particle_arena> parts;
+  // set when a particle_selection dropped some of the input particles
+  std::shared_ptr<input_positions> positions;
+  // set instead of the ClusterSequences in compact history mode
+  std::shared_ptr<compact_history> history;
+  // four-momentum columns are exported as float32 instead of float64
+  bool single_precision = false;
+  momentum_coordinates coordinates = momentum_coordinates::cartesian;
+  // the events were clustered with an AreaDefinition, and exported jets
+  // carry area columns
+  bool with_area = false;
+  // shared so that the by-value copies made by the bindings see one cache
+  std::shared_ptr<jet_cache> cache = std::make_shared<jet_cache>();
+
+  // calls f with the ClusterSequence of event i or, in compact history mode,
+  // with its compact_history::event, which answer the same queries
+  template <typename F> auto visit(std::size_t i, F f) const {
+    if (history) {
+      return f(history->at(i));
+    }
+    return f(*cse[i]);
+  }
+
+  std::shared_ptr<const jet_cache::event_jets> jets(jet_cache::query q,
+                                                    double param = 0) const {
+    return cache->get(q, param, cse.size(),
+                      [this](std::size_t i, jet_cache::query q, double param) {
+                        return visit(i, [&](const auto &cs) {
+                          return find_jets(cs, q, param);
+                        });
+                      });
+  }
+
+  // input position of each clustered particle of event i, or nullptr when
+  // every input particle was clustered and positions are unchanged
+  const int *input_positions_of(std::size_t i) const {
+    return positions ? positions->of(i) : nullptr;
+  }
+
+  // for queries that need the jets' structure or the input particles
+  void require_sequences(const char *query) const {
+    if (history) {
+      throw std::runtime_error(std::string(query) +
+                               " needs the full ClusterSequence of every "
+                               "event, which compact_history does not keep");
+    }
+  }
+
+  std::shared_ptr<fj::ClusterSequence> getCluster() {
+    auto a = cse[0];
+    return a;
+  }
+  void setCluster() {}
+};
+
+// Area measurement for batched clustering. The AreaDefinition, and with it
+// the layout of the ghost grid, is set up once per batch; each event then
+// gets its ghosts from a fixed seed derived from seed and its index, so that
+// the areas are reproducible whatever the number of threads and the order
+// in which they pick up the events.
+class area_clustering {
+public:
+  area_clustering() = default;
+
+  area_clustering(const fj::AreaDefinition &definition, uint64_t seed)
+      : active_(true), seed_(seed), definition_(definition) {}
+
+  area_clustering(py::object area_definition, uint64_t seed) {
+    if (area_definition.is_none()) {
+      return;
+    }
+    auto definition = *swigtocpp<fj::AreaDefinition *>(area_definition);
+    if (definition.area_type() == fj::active_area_explicit_ghosts) {
+      // the ghosts would become constituents and history entries
+      throw std::invalid_argument(
+          "active_area_explicit_ghosts is not supported for batches of "
+          "events; use active_area");
+    }
+    *this = area_clustering(definition, seed);
+  }
+
+  bool active() const { return active_; }
+
+  fj::AreaDefinition for_event(std::size_t event) const {
+    if (definition_.area_type() == fj::voronoi_area) {
+      return definition_;
+    }
+    return definition_.with_fixed_seed(event_seed(event));
+  }
+
+private:
+  static uint64_t mix(uint64_t x) {
+    // splitmix64
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+  }
+
+  // the two seeds of FastJet's generator, each within its valid range
+  std::vector<int> event_seed(std::size_t event) const {
+    uint64_t h = mix(seed_ ^ mix(event));
+    return {static_cast<int>(1 + (h & 0xffffffffULL) % 2147483562ULL),
+            static_cast<int>(1 + (h >> 32) % 2147483398ULL)};
+  }
+
+  bool active_ = false;
+  uint64_t seed_ = 0;
+  fj::AreaDefinition definition_;
+};
+
+// The background density of one event: the median rho of the transverse
+// momentum per unit area, its fluctuation sigma and, when requested, the
+// same for the mass density rho_m.
+struct background_values {
+  double rho = 0, sigma = 0, rho_m = 0, sigma_m = 0;
+};
+
+// Background estimation for a batch of events, configured once from a dict
+// of options and then run on the particles of each event as they sit in the
+// arena, with one estimator per event so that events can be estimated
+// concurrently. The "grid" estimator takes the median over the cells of a
+// rapidity-azimuth grid; the "jet_median" estimator the median over the
+// jets of a kt clustering with explicit ghosts, whose ghosts are seeded per
+// event as for area_clustering.
+class background_estimation {
+public:
+  explicit background_estimation(py::dict options) {
+    py::object jet_definition = py::none(), area_definition = py::none(),
+               rho_range = py::none();
+    for (auto item : options) {
+      auto key = item.first.cast<std::string>();
+      if (key == "estimator") {
+        auto name = item.second.cast<std::string>();
+        if (name != "grid" && name != "jet_median") {
+          throw std::invalid_argument("Unknown background estimator " + name +
+                                      "; expected grid or jet_median");
+        }
+        jet_median_ = name == "jet_median";
+      } else if (key == "rap_max") {
+        rap_max_ = item.second.cast<double>();
+      } else if (key == "grid_spacing") {
+        grid_spacing_ = item.second.cast<double>();
+      } else if (key == "rho_m") {
+        compute_rho_m_ = item.second.cast<bool>();
+      } else if (key == "seed") {
+        seed_ = item.second.cast<uint64_t>();
+      } else if (key == "jet_definition") {
+        jet_definition = item.second.cast<py::object>();
+      } else if (key == "area_definition") {
+        area_definition = item.second.cast<py::object>();
+      } else if (key == "rho_range") {
+        rho_range = item.second.cast<py::object>();
+      } else {
+        throw std::invalid_argument(
+            "Unknown background estimation option " + key +
+            "; expected estimator, rap_max, grid_spacing, rho_m, seed, "
+            "jet_definition, area_definition or rho_range");
+      }
+    }
+    if (!jet_median_) {
+      if (!jet_definition.is_none() || !area_definition.is_none() ||
+          !rho_range.is_none()) {
+        throw std::invalid_argument(
+            "jet_definition, area_definition and rho_range only apply to the "
+            "jet_median estimator");
+      }
+      return;
+    }
+    jet_def_ = jet_definition.is_none()
+                   ? fj::JetDefinition(fj::kt_algorithm, 0.4)
+                   : *swigtocpp<fj::JetDefinition *>(jet_definition);
+    if (jet_def_.jet_algorithm() == fj::plugin_algorithm ||
+        jet_def_.recombination_scheme() == fj::external_scheme) {
+      throw std::invalid_argument(
+          "Background estimation runs events concurrently and needs a jet "
+          "definition without plugins or external recombiners");
+    }
+    area_ = area_clustering(
+        area_definition.is_none()
+            ? fj::AreaDefinition(fj::active_area_explicit_ghosts,
+                                 fj::GhostedAreaSpec(rap_max_))
+            : *swigtocpp<fj::AreaDefinition *>(area_definition),
+        seed_);
+    if (rho_range.is_none()) {
+      rho_range_ = fj::SelectorAbsRapMax(rap_max_ - jet_def_.R());
+      return;
+    }
+    rho_range_ = *swigtocpp<fj::Selector *>(rho_range);
+    if (!rho_range_.applies_jet_by_jet() || rho_range_.takes_reference()) {
+      throw std::invalid_argument(
+          "rho_range must apply jet by jet, without a reference: " +
+          rho_range_.description());
+    }
+    // as for particle_selection, a Selector given from Python may call back
+    // into it, so events are then estimated one after the other
+    serial_ = true;
+  }
+
+  bool computes_rho_m() const { return compute_rho_m_; }
+
+  // runs body over the n events, concurrently unless the estimation has to
+  // keep the GIL
+  void for_each_event(std::size_t n, int n_threads,
+                      const thread_pool::range_function &body) const {
+    if (serial_) {
+      body(0, n);
+    } else {
+      py::gil_scoped_release release;
+      thread_pool::instance().parallel_for(n, resolve_n_threads(n_threads),
+                                           body);
+    }
+  }
+
+  // an estimator set up with the particles of event i
+  std::unique_ptr<fj::BackgroundEstimatorBase>
+  estimate(std::size_t i, const std::vector<fj::PseudoJet> &particles) const {
+    std::unique_ptr<fj::BackgroundEstimatorBase> estimator;
+    if (jet_median_) {
+      auto median = std::make_unique<fj::JetMedianBackgroundEstimator>(
+          rho_range_, jet_def_, area_.for_event(i));
+      median->set_compute_rho_m(compute_rho_m_);
+      estimator = std::move(median);
+    } else {
+      auto grid = std::make_unique<fj::GridMedianBackgroundEstimator>(
+          rap_max_, grid_spacing_);
+      grid->set_compute_rho_m(compute_rho_m_);
+      estimator = std::move(grid);
+    }
+    estimator->set_particles(particles);
+    return estimator;
+  }
+
+  background_values values(const fj::BackgroundEstimatorBase &estimator) const {
+    background_values out;
+    out.rho = estimator.rho();
+    out.sigma = estimator.sigma();
+    if (compute_rho_m_) {
+      out.rho_m = estimator.rho_m();
+      out.sigma_m = estimator.sigma_m();
+    }
+    return out;
+  }
+
+private:
+  bool jet_median_ = false;
+  bool compute_rho_m_ = false;
+  bool serial_ = false;
+  double rap_max_ = 5.0;
+  double grid_spacing_ = 0.55;
+  uint64_t seed_ = 0;
+  fj::JetDefinition jet_def_;
+  area_clustering area_;
+  fj::Selector rho_range_;
+};
+
+// Recombiners compiled into the module. They hold no state besides their
+// parameters, so unlike external recombiners in general they can be shared by
+// the threads clustering a batch, and their name and parameter are enough to
+// make them again (see with_recombiner).
+struct compiled_recombiner : fj::JetDefinition::Recombiner {
+  virtual std::string name() const = 0;
+  virtual double param() const { return 1; }
+};
+
+// The winner of each merging, the constituent with the larger energy, sets
+// the direction of a massless result carrying the summed energy.
+struct wta_E_recombiner : compiled_recombiner {
+  std::string name() const override { return "wta_E"; }
+  std::string description() const override {
+    return "winner-take-all E scheme recombination";
+  }
+  void recombine(const fj::PseudoJet &pa, const fj::PseudoJet &pb,
+                 fj::PseudoJet &pab) const override {
+    const fj::PseudoJet &winner = pa.E() >= pb.E() ? pa : pb;
+    double E = pa.E() + pb.E();
+    double modp = winner.modp();
+    if (modp > 0) {
+      double scale = E / modp;
+      pab.reset_momentum(winner.px() * scale, winner.py() * scale,
+                         winner.pz() * scale, E);
+    } else {
+      pab.reset_momentum(0, 0, 0, E);
+    }
+  }
+};
+
+// The E-scheme sum of the three-momenta, with the energy set to their
+// modulus; inputs are made massless in the same way.
+struct massless_E_recombiner : compiled_recombiner {
+  std::string name() const override { return "massless_E"; }
+  std::string description() const override {
+    return "massless E scheme recombination";
+  }
+  void recombine(const fj::PseudoJet &pa, const fj::PseudoJet &pb,
+                 fj::PseudoJet &pab) const override {
+    double px = pa.px() + pb.px();
+    double py = pa.py() + pb.py();
+    double pz = pa.pz() + pb.pz();
+    pab.reset_momentum(px, py, pz, std::sqrt(px * px + py * py + pz * pz));
+  }
+  void preprocess(fj::PseudoJet &p) const override {
+    p.reset_momentum(p.px(), p.py(), p.pz(), p.modp());
+  }
+};
+
+// Summed pt, with the rapidity and azimuth averaged with weights pt^delta:
+// delta = 1 is the pt scheme and delta -> infinity the winner-take-all pt
+// scheme. Inputs are made massless as in the pt scheme.
+struct generalized_wta_recombiner : compiled_recombiner {
+  double delta;
+
+  explicit generalized_wta_recombiner(double delta) : delta(delta) {
+    if (!(delta > 0)) {
+      throw std::invalid_argument(
+          "generalized_wta recombination needs delta > 0");
+    }
+  }
+  std::string name() const override { return "generalized_wta"; }
+  double param() const override { return delta; }
+  std::string description() const override {
+    return "generalized winner-take-all recombination with delta = " +
+           std::to_string(delta);
+  }
+  void recombine(const fj::PseudoJet &pa, const fj::PseudoJet &pb,
+                 fj::PseudoJet &pab) const override {
+    double pta = pa.pt();
+    double ptb = pb.pt();
+    // the weight of b, written as a ratio so that a large delta cannot
+    // overflow
+    double wb = ptb > 0 ? 1 / (1 + std::pow(pta / ptb, delta))
+                        : (pta > 0 ? 0.0 : 0.5);
+    double dphi = pb.phi() - pa.phi();
+    if (dphi > fj::pi) {
+      dphi -= fj::twopi;
+    } else if (dphi < -fj::pi) {
+      dphi += fj::twopi;
+    }
+    double rap = pa.rap() + wb * (pb.rap() - pa.rap());
+    pab = fj::PtYPhiM(pta + ptb, rap, pa.phi() + wb * dphi, 0);
+  }
+  void preprocess(fj::PseudoJet &p) const override {
+    p.reset_momentum(p.px(), p.py(), p.pz(), p.modp());
+  }
+};
+
+// A copy of jet_def using the named recombination; an empty name keeps the
+// scheme of jet_def.
+fj::JetDefinition with_recombiner(const fj::JetDefinition &jet_def,
+                                  const std::string &name, double param) {
+  fj::JetDefinition out(jet_def);
+  if (name.empty()) {
+    return out;
+  }
+  if (name == "wta_pt") {
+    out.set_recombination_scheme(fj::WTA_pt_scheme);
+    return out;
+  }
+  if (name == "pt_weighted") {
+    out.set_recombination_scheme(fj::pt_scheme);
+    return out;
+  }
+  fj::JetDefinition::Recombiner *recombiner;
+  if (name == "wta_E") {
+    recombiner = new wta_E_recombiner();
+  } else if (name == "massless_E") {
+    recombiner = new massless_E_recombiner();
+  } else if (name == "generalized_wta") {
+    recombiner = new generalized_wta_recombiner(param);
+  } else {
+    throw std::invalid_argument(
+        "Unknown recombiner " + name +
+        "; expected wta_pt, wta_E, massless_E, pt_weighted or generalized_wta");
+  }
+  out.set_recombiner(recombiner);
+  // the ClusterSequences keep copies of out, which share the recombiner
+  out.delete_recombiner_when_unused();
+  return out;
+}
+
+// The clustering strategies of the adaptive mode, by their FastJet names.
+const std::map<std::string, fj::Strategy> &adaptive_strategies() {
+  static const std::map<std::string, fj::Strategy> strategies = {
+      {"N2Plain", fj::N2Plain},       {"N2Tiled", fj::N2Tiled},
+      {"N2MinHeapTiled", fj::N2MinHeapTiled},
+      {"N2MHTLazy9", fj::N2MHTLazy9}, {"N2MHTLazy25", fj::N2MHTLazy25},
+      {"NlnN", fj::NlnN}};
+  return strategies;
+}
+
+// Whether FastJet can cluster with strategy here: without CGAL, NlnN throws
+// for every event. Each strategy is tried once, on three particles.
+bool strategy_available(fj::Strategy strategy) {
+  static const std::map<fj::Strategy, bool> available = [] {
+    std::vector<fj::PseudoJet> particles = {fj::PtYPhiM(1, 0, 0),
+                                            fj::PtYPhiM(1, 1, 1),
+                                            fj::PtYPhiM(1, -1, 2)};
+    std::map<fj::Strategy, bool> out;
+    for (const auto &named : adaptive_strategies()) {
+      try {
+        fj::ClusterSequence cs(particles,
+                               fj::JetDefinition(fj::antikt_algorithm, 0.4,
+                                                 fj::E_scheme, named.second));
+        out[named.second] = true;
+      } catch (const fj::Error &) {
+        out[named.second] = false;
+      }
+    }
+    return out;
+  }();
+  return available.at(strategy);
+}
+
+// Multiplicity crossovers between clustering strategies, measured for a few
+// values of R: for each, the strategies in order of the largest number of
+// particles they are used for, the last one without a bound. Strategies only
+// change how FastJet finds the closest pairs, so the histories they record
+// agree except where exact ties between distances are broken differently.
+// Every strategy of a table must be able to run with this FastJet.
+class strategy_table {
+public:
+  struct band {
+    int64_t max_particles; // -1 for no bound
+    fj::Strategy strategy;
+  };
+  typedef std::map<double, std::vector<std::pair<std::string, int64_t>>> spec;
+
+  explicit strategy_table(const spec &rows) {
+    for (const auto &row : rows) {
+      if (!(row.first > 0) || row.second.empty()) {
+        throw std::invalid_argument(
+            "Strategy table rows need R > 0 and at least one strategy");
+      }
+      auto &bands = rows_[row.first];
+      for (std::size_t k = 0; k < row.second.size(); k++) {
+        const auto &name = row.second[k].first;
+        int64_t bound = row.second[k].second;
+        auto found = adaptive_strategies().find(name);
+        if (found == adaptive_strategies().end()) {
+          throw std::invalid_argument(
+              "Unknown strategy " + name +
+              "; expected N2Plain, N2Tiled, N2MinHeapTiled, N2MHTLazy9, "
+              "N2MHTLazy25 or NlnN");
+        }
+        if (!strategy_available(found->second)) {
+          throw std::invalid_argument(
+              "Strategy " + name +
+              " cannot run with this FastJet build (NlnN needs CGAL)");
+        }
+        bool last = k + 1 == row.second.size();
+        if (!last && (bound < 0 || (!bands.empty() &&
+                                    bound <= bands.back().max_particles))) {
+          throw std::invalid_argument(
+              "Strategy table bounds must increase along each row");
+        }
+        bands.push_back({last ? -1 : bound, found->second});
+      }
+    }
+  }
+
+  // the strategy for n particles, from the row of the calibrated R closest
+  // to R on a logarithmic scale
+  fj::Strategy choose(double R, std::size_t n) const {
+    auto above = rows_.lower_bound(R);
+    if (above == rows_.end() ||
+        (above != rows_.begin() &&
+         std::log(R / std::prev(above)->first) < std::log(above->first / R))) {
+      --above;
+    }
+    for (const auto &b : above->second) {
+      if (b.max_particles < 0 || static_cast<int64_t>(n) <= b.max_particles) {
+        return b.strategy;
+      }
+    }
+    return above->second.back().strategy;
+  }
+
+  spec rows() const {
+    spec out;
+    for (const auto &row : rows_) {
+      for (const auto &b : row.second) {
+        for (const auto &named : adaptive_strategies()) {
+          if (named.second == b.strategy) {
+            out[row.first].emplace_back(named.first, b.max_particles);
+          }
+        }
+      }
+    }
+    return out;
+  }
+
+private:
+  std::map<double, std::vector<band>> rows_;
+};
+
+// process-wide table of the adaptive mode; none means FastJet's own choice
+std::mutex strategy_table_mutex;
+std::shared_ptr<const strategy_table> current_strategy_table;
+
+void set_strategy_table(py::object rows) {
+  std::shared_ptr<const strategy_table> table;
+  if (!rows.is_none()) {
+    table = std::make_shared<strategy_table>(rows.cast<strategy_table::spec>());
+  }
+  std::lock_guard<std::mutex> lock(strategy_table_mutex);
+  current_strategy_table = std::move(table);
+}
+
+py::object get_strategy_table() {
+  std::shared_ptr<const strategy_table> table;
+  {
+    std::lock_guard<std::mutex> lock(strategy_table_mutex);
+    table = current_strategy_table;
+  }
+  if (!table) {
+    return py::none();
+  }
+  return py::cast(table->rows());
+}
+
+// The jet definitions of a batch, one per strategy of the adaptive mode. It
+// applies to anti-kt under Best, the algorithm calibrate_strategies times:
+// the crossovers of kt and C/A differ, and the table is keyed by R alone.
+// Any other definition is used as given for every event.
+class event_jet_definitions {
+public:
+  event_jet_definitions(const fj::JetDefinition &jet_def, bool with_area)
+      : jet_def_(jet_def) {
+    {
+      std::lock_guard<std::mutex> lock(strategy_table_mutex);
+      table_ = current_strategy_table;
+    }
+    auto algorithm = jet_def.jet_algorithm();
+    bool adaptive = table_ && !with_area && jet_def.strategy() == fj::Best &&
+                    algorithm == fj::antikt_algorithm;
+    if (!adaptive) {
+      table_.reset();
+      return;
+    }
+    for (const auto &named : adaptive_strategies()) {
+      fj::JetDefinition def(algorithm, jet_def.R(), fj::E_scheme, named.second);
+      // shares the recombiner, compiled or external, of jet_def
+      def.set_recombiner(jet_def);
+      by_strategy_.emplace(named.second, def);
+    }
+  }
+
+  const fj::JetDefinition &for_event(std::size_t n_particles) const {
+    if (!table_) {
+      return jet_def_;
+    }
+    return by_strategy_.at(table_->choose(jet_def_.R(), n_particles));
+  }
+
+private:
+  const fj::JetDefinition &jet_def_;
+  std::shared_ptr<const strategy_table> table_;
+  std::map<fj::Strategy, fj::JetDefinition> by_strategy_;
+};
+
+// Plugins and external recombiners (e.g. RecombinerPython) may call back
+// into Python or keep unsynchronised state, so clusterings that use them stay
+// serial and keep the GIL; the compiled recombiners are safe to share.
+bool calls_external_recombiner(const fj::JetDefinition &jet_def) {
+  return jet_def.recombination_scheme() == fj::external_scheme &&
+         !dynamic_cast<const compiled_recombiner *>(jet_def.recombiner());
+}
+
+// Clusters n_events events given as flat momentum columns of either float or
+// double precision, which are read in place, into ow.
+template <typename Real>
+void cluster_events_into(output_wrapper &ow, const Real *pxptr,
+                         const Real *pyptr, const Real *pzptr,
+                         const Real *Eptr, const int64_t *startsptr,
+                         const int64_t *stopsptr, std::size_t dimoff,
+                         const fj::JetDefinition *jet_def, int n_threads,
+                         bool compact = false,
+                         const particle_selection &selection = {},
+                         const area_clustering &area = {}) {
+  bool serial = jet_def->jet_algorithm() == fj::plugin_algorithm ||
+                calls_external_recombiner(*jet_def);
+  auto for_each_event = [&](const thread_pool::range_function &body,
+                            bool keep_gil) {
+    if (keep_gil) {
+      body(0, dimoff);
+    } else {
+      py::gil_scoped_release release;
+      thread_pool::instance().parallel_for(
+          dimoff, resolve_n_threads(n_threads), body);
+    }
+  };
+
+  ow.cse.resize(dimoff);
+  ow.parts = std::make_shared<particle_arena>();
+  particle_arena &arena = *ow.parts;
+  // with a selection, a first pass marks the particles that pass it so that
+  // only those are stored, along with their input positions
+  std::vector<char> keep;
+  std::vector<int64_t> input_offsets;
+  if (selection.active()) {
+    input_offsets.resize(dimoff + 1);
+    input_offsets[0] = 0;
+    for (std::size_t i = 0; i < dimoff; i++) {
+      input_offsets[i + 1] = input_offsets[i] + (stopsptr[i] - startsptr[i]);
+    }
+    keep.resize(input_offsets[dimoff]);
+    std::vector<int64_t> n_kept(dimoff);
+    for_each_event(
+        [&](std::size_t begin, std::size_t end) {
+          phase_timer construct(batch_stats::construct);
+          for (std::size_t i = begin; i < end; i++) {
+            char *kept = keep.data() + input_offsets[i] - startsptr[i];
+            for (int64_t j = startsptr[i]; j < stopsptr[i]; j++) {
+              kept[j] = selection.pass(
+                  fj::PseudoJet(pxptr[j], pyptr[j], pzptr[j], Eptr[j]));
+              n_kept[i] += kept[j];
+            }
+          }
+        },
+        serial || selection.needs_gil());
+    arena.allocate(n_kept.data(), dimoff);
+    ow.positions = std::make_shared<input_positions>();
+    ow.positions->index.resize(arena.particles.size());
+    ow.positions->offsets = arena.offsets;
+  } else {
+    arena.allocate(startsptr, stopsptr, dimoff);
+  }
+  if (compact) {
+    ow.history = std::make_shared<compact_history>();
+    ow.history->allocate(arena);
+  }
+  event_jet_definitions jet_defs(*jet_def, area.active());
+  // only the compact history outlives the clustering of an event; plugins
+  // may attach state of their own to it, so they get a fresh one
+  bool reuse = compact && !area.active() &&
+               jet_def->jet_algorithm() != fj::plugin_algorithm;
+  auto &stats = batch_stats::instance();
+  if (stats.enabled()) {
+    stats.count_batch(dimoff, arena.particles.size());
+    stats.count_bytes(arena.particles.size() * sizeof(fj::PseudoJet));
+  }
+
+  // every event is independent; each one only writes its own slot so the
+  // output order matches the input order whatever the thread scheduling
+  auto cluster_events = [&](std::size_t begin, std::size_t end) {
+    for (std::size_t i = begin; i < end; i++) {
+      fj::PseudoJet *pj = arena.begin(i);
+      phase_timer construct(batch_stats::construct);
+      if (keep.empty()) {
+        for (int64_t j = startsptr[i]; j < stopsptr[i]; j++) {
+          *pj++ = fj::PseudoJet(pxptr[j], pyptr[j], pzptr[j], Eptr[j]);
+        }
+      } else {
+        const char *kept = keep.data() + input_offsets[i] - startsptr[i];
+        int *position = ow.positions->index.data() + arena.offsets[i];
+        for (int64_t j = startsptr[i]; j < stopsptr[i]; j++) {
+          if (kept[j]) {
+            *pj++ = fj::PseudoJet(pxptr[j], pyptr[j], pzptr[j], Eptr[j]);
+            *position++ = static_cast<int>(j - startsptr[i]);
+          }
+        }
+      }
+      construct.stop();
+      phase_timer clustering(batch_stats::cluster);
+      if (reuse) {
+        ow.history->fill(i, reusable_sequence::for_this_thread().cluster(
+                                arena.begin(i), arena.end(i),
+                                jet_defs.for_event(arena.size(i))));
+        continue;
+      }
+      std::shared_ptr<fj::ClusterSequence> cs;
+      if (area.active()) {
+        cs = std::make_shared<fj::ClusterSequenceArea>(
+            event_scratch(arena, i), *jet_def, area.for_event(i));
+      } else {
+        cs = std::make_shared<fj::ClusterSequence>(
+            event_scratch(arena, i), jet_defs.for_event(arena.size(i)));
+      }
+      if (compact) {
+        ow.history->fill(i, *cs);
+      } else {
+        ow.cse[i] = std::move(cs);
+      }
+    }
+  };
+
+  for_each_event(cluster_events, serial);
+  // the history holds the recombined momenta; the inputs are not needed
+  if (compact) {
+    ow.parts.reset();
+  }
+}
+
+// Clusters a batch of events given as flat momentum columns of either float
+// or double precision, which are read in place.
+template <typename Real>
+output_wrapper interfacemulti(
+    py::array_t<Real, py::array::c_style | py::array::forcecast> pxi,
+    py::array_t<Real, py::array::c_style | py::array::forcecast> pyi,
+    py::array_t<Real, py::array::c_style | py::array::forcecast> pzi,
+    py::array_t<Real, py::array::c_style | py::array::forcecast> Ei,
+    py::array_t<int64_t, py::array::c_style | py::array::forcecast> starts,
+    py::array_t<int64_t, py::array::c_style | py::array::forcecast> stops,
+    py::object jetdef, int n_threads = -1, bool single_precision = false,
+    bool compact_history = false, const std::string &coordinates = "cartesian",
+    const std::string &recombiner = "", double recombiner_param = 1,
+    py::object selector = py::none(), py::dict cuts = py::dict(),
+    py::object area_definition = py::none(), uint64_t area_seed = 0) {
+  area_clustering area(area_definition, area_seed);
+  if (area.active() && compact_history) {
+    throw std::invalid_argument(
+        "Jet areas need the full ClusterSequence of every event, which "
+        "compact_history does not keep");
+  }
+  // requesting buffer information of the input
+  py::buffer_info infostarts = starts.request();
+  py::buffer_info infostops = stops.request();
+  py::buffer_info infopx = pxi.request();
+  py::buffer_info infopy = pyi.request();
+  py::buffer_info infopz = pzi.request();
+  py::buffer_info infoE = Ei.request();
+
+  // pointers to the initial values
+  auto startsptr = static_cast<int64_t *>(infostarts.ptr);
+  auto stopsptr = static_cast<int64_t *>(infostops.ptr);
+  auto pxptr = static_cast<const Real *>(infopx.ptr);
+  auto pyptr = static_cast<const Real *>(infopy.ptr);
+  auto pzptr = static_cast<const Real *>(infopz.ptr);
+  auto Eptr = static_cast<const Real *>(infoE.ptr);
+
+  std::size_t dimoff = infostarts.shape[0];
+  auto jet_def = with_recombiner(*swigtocpp<fj::JetDefinition *>(jetdef),
+                                 recombiner, recombiner_param);
+  output_wrapper ow;
+  ow.single_precision = single_precision;
+  ow.coordinates = parse_coordinates(coordinates);
+  ow.with_area = area.active();
+  cluster_events_into(ow, pxptr, pyptr, pzptr, Eptr, startsptr, stopsptr,
+                      dimoff, &jet_def, n_threads, compact_history,
+                      particle_selection(selector, cuts), area);
+  return ow;
+}
+
+// Offsets returned next to flattened columns; event i of a column spans
+// [offsets[i], offsets[i + 1]). 64-bit so that merged batches can exceed
+// 2^31 entries and Python can wrap them as ak.index.Index64 without a copy.
+typedef int64_t offset_t;
+
+// numpy has no packed boolean layout, so boolean columns are staged as bytes
+template <typename T> struct column_storage {
+  typedef T type;
+};
+template <> struct column_storage<bool> {
+  typedef uint8_t type;
+};
+
+// Hands a filled buffer over to numpy without copying it: the array keeps the
+// vector alive through a capsule that frees it once numpy is done with it.
+template <typename T>
+py::array as_pyarray(std::vector<typename column_storage<T>::type> &&values) {
+  typedef std::vector<typename column_storage<T>::type> storage;
+  static_assert(sizeof(T) == sizeof(typename storage::value_type),
+                "column storage must match the numpy item size");
+  if (batch_stats::instance().enabled()) {
+    batch_stats::instance().count_bytes(values.size() * sizeof(T));
+  }
+  auto owner = new storage(std::move(values));
+  py::capsule free_when_done(
+      owner, [](void *p) { delete reinterpret_cast<storage *>(p); });
+  return py::array(py::dtype::of<T>(),
+                   {static_cast<py::ssize_t>(owner->size())}, owner->data(),
+                   free_when_done);
+}
+
+// Growable output column of one numpy dtype.
+template <typename T> class column {
+public:
+  std::vector<typename column_storage<T>::type> values;
+
+  void push_back(T value) { values.push_back(value); }
+  py::array release() { return as_pyarray<T>(std::move(values)); }
+};
+
+template <typename Produce>
+using produced_t = decltype(std::declval<Produce &>()(std::size_t()));
+template <typename Container>
+using item_t =
+    typename std::decay<decltype(*std::begin(std::declval<Container &>()))>::type;
+template <typename Item, typename... Extract>
+using columns_t = std::tuple<column<typename std::decay<
+    decltype(std::declval<Extract &>()(std::declval<const Item &>()))>::type>...>;
+
+template <typename Columns, typename Item, std::size_t... I,
+          typename... Extract>
+void fill_columns(Columns &columns, const Item &item,
+                  std::index_sequence<I...>, Extract &...extract) {
+  (std::get<I>(columns).push_back(extract(item)), ...);
+}
+
+py::tuple as_tuple(const std::vector<py::object> &items) {
+  py::tuple out(items.size());
+  for (std::size_t k = 0; k < items.size(); k++) {
+    out[k] = items[k];
+  }
+  return out;
+}
+
+template <typename Columns, std::size_t... I>
+std::vector<py::object> release_columns(Columns &columns,
+                                        std::index_sequence<I...>) {
+  return {std::get<I>(columns).release()...};
+}
+
+// Flattens per-event lists into columns in a single pass over the events.
+// produce(i) returns the items of event i (any iterable) and every extractor
+// maps an item to the value of its column. Returns the columns followed by
+// the event offsets.
+template <typename Produce, typename... Extract>
+py::tuple export_columns(std::size_t n_events, Produce produce,
+                         Extract... extract) {
+  typedef item_t<produced_t<Produce>> item;
+  columns_t<item, Extract...> columns;
+  column<offset_t> event_offsets;
+  event_offsets.values.reserve(n_events + 1);
+  event_offsets.push_back(0);
+  offset_t n_items = 0;
+  for (std::size_t i = 0; i < n_events; i++) {
+    auto &&items = produce(i);
+    for (const auto &it : items) {
+      fill_columns(columns, it, std::index_sequence_for<Extract...>(),
+                   extract...);
+      n_items++;
+    }
+    event_offsets.push_back(n_items);
+  }
+  auto out = release_columns(columns, std::index_sequence_for<Extract...>());
+  out.push_back(event_offsets.release());
+  return as_tuple(out);
+}
+
+// As export_columns, for events made of groups of items (e.g. the
+// constituents of each jet). Returns the group offsets, the item columns and
+// the event offsets.
+template <typename Produce, typename... Extract>
+py::tuple export_nested_columns(std::size_t n_events, Produce produce,
+                                Extract... extract) {
+  typedef item_t<produced_t<Produce>> group;
+  typedef item_t<group> item;
+  columns_t<item, Extract...> columns;
+  column<offset_t> group_offsets;
+  column<offset_t> event_offsets;
+  event_offsets.values.reserve(n_events + 1);
+  group_offsets.push_back(0);
+  event_offsets.push_back(0);
+  offset_t n_items = 0;
+  offset_t n_groups = 0;
+  for (std::size_t i = 0; i < n_events; i++) {
+    auto &&groups = produce(i);
+    for (const auto &g : groups) {
+      for (const auto &it : g) {
+        fill_columns(columns, it, std::index_sequence_for<Extract...>(),
+                     extract...);
+        n_items++;
+      }
+      group_offsets.push_back(n_items);
+      n_groups++;
+    }
+    event_offsets.push_back(n_groups);
+  }
+  std::vector<py::object> out{group_offsets.release()};
+  auto values = release_columns(columns, std::index_sequence_for<Extract...>());
+  out.insert(out.end(), values.begin(), values.end());
+  out.push_back(event_offsets.release());
+  return as_tuple(out);
+}
+
+// One value per event, returned with its (trivial) event offsets.
+template <typename Value>
+py::tuple export_event_values(std::size_t n_events, Value value) {
+  typedef decltype(value(std::size_t())) value_type;
+  return export_columns(
+      n_events,
+      [&](std::size_t i) { return std::array<value_type, 1>{{value(i)}}; },
+      [](value_type v) { return v; });
+}
+
+// Number of ghosts in a jet with an active area, from which its area was
+// measured, or -1 for jets without one.
+int ghost_count(const fj::PseudoJet &jet) {
+  if (!jet.has_area()) {
+    return -1;
+  }
+  auto csa = dynamic_cast<const fj::ClusterSequenceArea *>(jet.associated_cs());
+  if (csa == nullptr || csa->area_def().area_type() != fj::active_area) {
+    return -1;
+  }
+  double ghost_area = csa->area_def().ghost_spec().actual_ghost_area();
+  return static_cast<int>(std::lround(jet.area() / ghost_area));
+}
+
+namespace extract {
+constexpr auto value = [](const auto &v) { return v; };
+constexpr auto px = [](const fj::PseudoJet &j) { return j.px(); };
+constexpr auto py = [](const fj::PseudoJet &j) { return j.py(); };
+constexpr auto pz = [](const fj::PseudoJet &j) { return j.pz(); };
+constexpr auto E = [](const fj::PseudoJet &j) { return j.E(); };
+constexpr auto cluster_hist_index = [](const fj::PseudoJet &j) {
+  return j.cluster_hist_index();
+};
+// areas are 0 for particles and other PseudoJets without one
+constexpr auto area = [](const fj::PseudoJet &j) {
+  return j.has_area() ? j.area() : 0.0;
+};
+constexpr auto area_px = [](const fj::PseudoJet &j) {
+  return j.has_area() ? j.area_4vector().px() : 0.0;
+};
+constexpr auto area_py = [](const fj::PseudoJet &j) {
+  return j.has_area() ? j.area_4vector().py() : 0.0;
+};
+constexpr auto area_pz = [](const fj::PseudoJet &j) {
+  return j.has_area() ? j.area_4vector().pz() : 0.0;
+};
+constexpr auto area_E = [](const fj::PseudoJet &j) {
+  return j.has_area() ? j.area_4vector().E() : 0.0;
+};
+constexpr auto n_ghosts = [](const fj::PseudoJet &j) { return ghost_count(j); };
+} // namespace extract
+
+// Casts the values of an extractor to the precision of their column.
+template <typename Real, typename Extract>
+auto as_precision(Extract extract) {
+  return [extract](const fj::PseudoJet &j) {
+    return static_cast<Real>(extract(j));
+  };
+}
+
+// With areas, the area, the components of the area four-vector and the
+// ghost count follow cluster_hist_index.
+template <typename Real, typename Produce>
+py::tuple export_momenta_as(std::size_t n_events, Produce produce,
+                            bool with_area = false) {
+  if (with_area) {
+    return export_columns(
+        n_events, produce, as_precision<Real>(extract::px),
+        as_precision<Real>(extract::py), as_precision<Real>(extract::pz),
+        as_precision<Real>(extract::E), extract::cluster_hist_index,
+        extract::area, extract::area_px, extract::area_py, extract::area_pz,
+        extract::area_E, extract::n_ghosts);
+  }
+  return export_columns(n_events, produce, as_precision<Real>(extract::px),
+                        as_precision<Real>(extract::py),
+                        as_precision<Real>(extract::pz),
+                        as_precision<Real>(extract::E),
+                        extract::cluster_hist_index);
+}
+
+// pt, eta, phi and mass of a batch of four-momenta given as columns. Each is
+// one loop over contiguous columns, free of calls into PseudoJet and of
+// data-dependent branches. The pt and mass loops vectorise; the eta and phi
+// loops stay scalar calls to asinh and atan2, which have no vector versions
+// without a vector math library, but they no longer go through PseudoJet's
+// cached rapidity and phi. The conventions are those of the vector package:
+// phi in [-pi, pi], eta = asinh(pz / pt), and negative masses for spacelike
+// momenta.
+template <typename Real> struct cylindrical_momenta {
+  std::vector<Real> pt, eta, phi, mass;
+
+  cylindrical_momenta(const Real *x, const Real *y, const Real *z,
+                      const Real *t, std::size_t n, bool with_mass)
+      : pt(n), eta(n), phi(n) {
+    for (std::size_t i = 0; i < n; i++) {
+      pt[i] = std::sqrt(x[i] * x[i] + y[i] * y[i]);
+    }
+    for (std::size_t i = 0; i < n; i++) {
+      eta[i] = std::asinh(z[i] / pt[i]);
+    }
+    for (std::size_t i = 0; i < n; i++) {
+      phi[i] = std::atan2(y[i], x[i]);
+    }
+    if (with_mass) {
+      mass.resize(n);
+      for (std::size_t i = 0; i < n; i++) {
+        Real m2 = t[i] * t[i] - x[i] * x[i] - y[i] * y[i] - z[i] * z[i];
+        mass[i] = std::copysign(std::sqrt(std::abs(m2)), m2);
+      }
+    }
+  }
+
+  // pt, eta, phi, then the mass or, without it, the given energy column
+  std::array<py::object, 4> release(py::object energy) {
+    return {{as_pyarray<Real>(std::move(pt)), as_pyarray<Real>(std::move(eta)),
+             as_pyarray<Real>(std::move(phi)),
+             mass.empty() ? energy : as_pyarray<Real>(std::move(mass))}};
+  }
+};
+
+template <typename Real>
+std::array<py::object, 4>
+cylindrical_columns(const std::array<py::array, 4> &momentum, bool with_mass) {
+  cylindrical_momenta<Real> cylindrical(
+      static_cast<const Real *>(momentum[0].data()),
+      static_cast<const Real *>(momentum[1].data()),
+      static_cast<const Real *>(momentum[2].data()),
+      static_cast<const Real *>(momentum[3].data()), momentum[0].size(),
+      with_mass);
+  return cylindrical.release(momentum[3]);
+}
+
+// The px, py, pz, E columns exported from a batch, at positions first to
+// first + 3 of columns, in the coordinates requested for the batch.
+py::tuple with_coordinates(const output_wrapper &ow, py::tuple columns,
+                           std::size_t first) {
+  if (ow.coordinates == momentum_coordinates::cartesian) {
+    return columns;
+  }
+  bool with_mass = ow.coordinates == momentum_coordinates::pt_eta_phi_m;
+  std::array<py::array, 4> momentum;
+  for (std::size_t k = 0; k < 4; k++) {
+    momentum[k] = columns[first + k].cast<py::array>();
+  }
+  auto cylindrical = ow.single_precision
+                         ? cylindrical_columns<float>(momentum, with_mass)
+                         : cylindrical_columns<double>(momentum, with_mass);
+  std::vector<py::object> out;
+  for (std::size_t k = 0; k < columns.size(); k++) {
+    out.push_back(k >= first && k < first + 4 ? cylindrical[k - first]
+                                              : py::object(columns[k]));
+  }
+  return as_tuple(out);
+}
+
+// Four-momentum columns of per-event PseudoJet lists, in the output
+// precision and coordinates of the batch, their cluster_hist_index, their
+// area columns when the batch has areas, and the event offsets.
+template <typename Produce>
+py::tuple export_momenta(const output_wrapper &ow, Produce produce) {
+  return with_coordinates(
+      ow, ow.single_precision
+              ? export_momenta_as<float>(ow.cse.size(), produce, ow.with_area)
+              : export_momenta_as<double>(ow.cse.size(), produce, ow.with_area),
+      0);
+}
+
+template <typename Real, typename Produce>
+py::tuple export_nested_momenta_as(std::size_t n_events, Produce produce,
+                                   bool with_area = false) {
+  if (with_area) {
+    return export_nested_columns(
+        n_events, produce, as_precision<Real>(extract::px),
+        as_precision<Real>(extract::py), as_precision<Real>(extract::pz),
+        as_precision<Real>(extract::E), extract::cluster_hist_index,
+        extract::area, extract::area_px, extract::area_py, extract::area_pz,
+        extract::area_E, extract::n_ghosts);
+  }
+  return export_nested_columns(
+      n_events, produce, as_precision<Real>(extract::px),
+      as_precision<Real>(extract::py), as_precision<Real>(extract::pz),
+      as_precision<Real>(extract::E), extract::cluster_hist_index);
+}
+
+// As export_momenta, for several PseudoJet lists per event: the list offsets,
+// the momentum and cluster_hist_index columns, and the event offsets.
+template <typename Produce>
+py::tuple export_nested_momenta(const output_wrapper &ow, Produce produce) {
+  return with_coordinates(
+      ow,
+      ow.single_precision
+          ? export_nested_momenta_as<float>(ow.cse.size(), produce, ow.with_area)
+          : export_nested_momenta_as<double>(ow.cse.size(), produce,
+                                             ow.with_area),
+      1);
+}
+
+typedef py::array_t<double, py::array::c_style | py::array::forcecast>
+    double_array;
+typedef py::array_t<int64_t, py::array::c_style | py::array::forcecast>
+    index_array;
+
+// Indices of the particles clustered into each jet, in increasing order,
+// bucketed by jet in one flat buffer: a counting sort over
+// particle_jet_indices, linear in the number of particles and jets.
+class constituent_indices {
+public:
+  // the particles of one jet
+  struct bucket {
+    const int *first;
+    const int *last;
+    const int *begin() const { return first; }
+    const int *end() const { return last; }
+  };
+
+  // positions, when given, maps the clustered particles back to their
+  // positions in the input event
+  template <typename Sequence>
+  constituent_indices(const Sequence &cs,
+                      const std::vector<fj::PseudoJet> &jets,
+                      const int *positions = nullptr) {
+    auto jet_of = cs.particle_jet_indices(jets);
+    std::vector<std::size_t> starts(jets.size() + 1, 0);
+    for (int k : jet_of) {
+      if (k >= 0) {
+        starts[k + 1]++;
+      }
+    }
+    for (std::size_t k = 0; k < jets.size(); k++) {
+      starts[k + 1] += starts[k];
+    }
+    index_.resize(starts.back());
+    // scanning the particles in order keeps every bucket sorted
+    auto next = starts;
+    for (std::size_t j = 0; j < jet_of.size(); j++) {
+      if (jet_of[j] >= 0) {
+        index_[next[jet_of[j]]++] =
+            positions ? positions[j] : static_cast<int>(j);
+      }
+    }
+    buckets_.reserve(jets.size());
+    for (std::size_t k = 0; k < jets.size(); k++) {
+      buckets_.push_back({index_.data() + starts[k], index_.data() + starts[k + 1]});
+    }
+  }
+  // the buckets point into index_, which must not be copied away from them
+  constituent_indices(const constituent_indices &) = delete;
+  constituent_indices &operator=(const constituent_indices &) = delete;
+
+  std::vector<bucket>::const_iterator begin() const { return buckets_.begin(); }
+  std::vector<bucket>::const_iterator end() const { return buckets_.end(); }
+
+private:
+  std::vector<int> index_;
+  std::vector<bucket> buckets_;
+};
+
+// For every event, finds the inclusive jet with the rapidity of the jet
+// handed back from Python. Only used for jets that do not carry their
+// cluster_hist_index; two jets of equal rapidity cannot be told apart.
+std::vector<fj::PseudoJet> match_inclusive_jets(const output_wrapper &ow,
+                                                const double_array &pxi,
+                                                const double_array &pyi,
+                                                const double_array &pzi,
+                                                const double_array &Ei) {
+  auto inclusive_jets = ow.jets(jet_cache::inclusive);
+  auto pxptr = pxi.data();
+  auto pyptr = pyi.data();
+  auto pzptr = pzi.data();
+  auto Eptr = Ei.data();
+
+  std::vector<fj::PseudoJet> matched;
+  matched.reserve(ow.cse.size());
+  for (std::size_t i = 0; i < ow.cse.size(); i++) {
+    double rap = fj::PseudoJet(pxptr[i], pyptr[i], pzptr[i], Eptr[i]).rap();
+    const auto &jets = (*inclusive_jets)[i];
+    auto got = std::find_if(jets.begin(), jets.end(),
+                            [&](const fj::PseudoJet &j) { return j.rap() == rap; });
+    if (got == jets.end()) {
+      throw "Jet Not in this ClusterSequence";
+    }
+    matched.push_back(*got);
+  }
+  return matched;
+}
+
+// For every event, the jet stored at the given cluster_hist_index, read
+// directly from the clustering history.
+std::vector<fj::PseudoJet> jets_at(const output_wrapper &ow,
+                                   const index_array &hist_index) {
+  if (static_cast<std::size_t>(hist_index.size()) != ow.cse.size()) {
+    throw std::invalid_argument("Expected one cluster_hist_index per event");
+  }
+  auto index = hist_index.data();
+  std::vector<fj::PseudoJet> jets;
+  jets.reserve(ow.cse.size());
+  for (std::size_t i = 0; i < ow.cse.size(); i++) {
+    jets.push_back(ow.visit(
+        i, [&](const auto &cs) { return history_jet(cs, index[i]); }));
+  }
+  return jets;
+}
+
+// Whether exclusive jets are meaningful for a jet definition, as FastJet
+// decides before warning about them.
+bool exclusive_sequence_meaningful(const fj::JetDefinition &jet_def) {
+  switch (jet_def.jet_algorithm()) {
+  case fj::kt_algorithm:
+  case fj::cambridge_algorithm:
+  case fj::ee_kt_algorithm:
+    return true;
+  case fj::genkt_algorithm:
+  case fj::ee_genkt_algorithm:
+    return jet_def.extra_param() >= 0;
+  case fj::plugin_algorithm:
+    return jet_def.plugin()->exclusive_sequence_meaningful();
+  default:
+    return false;
+  }
+}
+
+// A batch of clusterings as one binary buffer: a header followed by 8-byte
+// aligned columns holding the input particles (unless only the compact
+// history was kept), their input positions when a selection dropped some,
+// and the merge history of every event in the layout of compact_history.
+namespace serialized {
+
+enum flag : uint32_t { single_precision = 1, compact = 2, positions = 4 };
+
+struct header {
+  char magic[4];
+  uint32_t version;
+  uint32_t flags;
+  uint32_t coordinates;
+  // the jet definition the events were clustered with, as far as the
+  // restored sequences need it: a compiled recombiner by its name and
+  // parameter, any other by its scheme
+  int32_t algorithm;
+  uint32_t recombination_scheme;
+  uint32_t exclusive_meaningful;
+  uint32_t spherical;
+  double R, extra_param, recombiner_param;
+  char recombiner[32];
+  uint64_t n_events, n_particles, n_history;
+};
+
+constexpr char magic[4] = {'F', 'J', 'O', 'W'};
+constexpr uint32_t version = 2;
+
+class writer {
+public:
+  std::vector<uint8_t> bytes;
+
+  template <typename T> void put(const T *values, std::size_t n) {
+    std::size_t size = n * sizeof(T);
+    std::size_t at = bytes.size();
+    bytes.resize(at + ((size + 7) & ~std::size_t(7)));
+    if (size > 0) {
+      std::memcpy(bytes.data() + at, values, size);
+    }
+  }
+  template <typename T> void put(const std::vector<T> &values) {
+    put(values.data(), values.size());
+  }
+};
+
+class reader {
+public:
+  reader(const uint8_t *data, std::size_t size) : data_(data), size_(size) {}
+
+  template <typename T> void get(T *values, std::size_t n) {
+    std::size_t size = n * sizeof(T);
+    std::size_t padded = (size + 7) & ~std::size_t(7);
+    check<T>(n);
+    if (padded > size_ - at_) {
+      throw std::invalid_argument("Truncated serialized clustering");
+    }
+    if (size > 0) {
+      std::memcpy(values, data_ + at_, size);
+    }
+    at_ += padded;
+  }
+  // the size comes from the buffer, so it is checked before anything is
+  // allocated for it
+  template <typename T> void get(std::vector<T> &values, std::size_t n) {
+    check<T>(n);
+    values.resize(n);
+    get(values.data(), n);
+  }
+
+private:
+  template <typename T> void check(std::size_t n) const {
+    if (n > (size_ - at_) / sizeof(T)) {
+      throw std::invalid_argument("Truncated serialized clustering");
+    }
+  }
+
+  const uint8_t *data_;
+  std::size_t size_;
+  std::size_t at_ = 0;
+};
+
+// Rebuilds the ClusterSequence of one event from its recorded history. The
+// merge steps are replayed in their original order with their recorded
+// distances and momenta, so nothing is recomputed and the history, and with
+// it every query, comes out as it was.
+class history_replay : public fj::JetDefinition::Plugin {
+public:
+  history_replay(std::shared_ptr<const compact_history> history,
+                 std::size_t event, const header &h)
+      : history_(std::move(history)), event_(event), R_(h.R),
+        exclusive_meaningful_(h.exclusive_meaningful != 0),
+        spherical_(h.spherical != 0) {}
+
+  std::string description() const override {
+    return "clustering history restored from a serialized batch";
+  }
+  double R() const override { return R_; }
+  bool exclusive_sequence_meaningful() const override {
+    return exclusive_meaningful_;
+  }
+  bool is_spherical() const override { return spherical_; }
+
+  // the inputs as FastJet held them, after any preprocessing by the
+  // recombiner
+  std::vector<fj::PseudoJet> inputs() const {
+    const auto &h = *history_;
+    int64_t first = h.offsets[event_];
+    int64_t n = (h.offsets[event_ + 1] - first) / 2;
+    std::vector<fj::PseudoJet> out;
+    out.reserve(n);
+    for (int64_t k = first; k < first + n; k++) {
+      out.emplace_back(h.px[k], h.py[k], h.pz[k], h.E[k]);
+    }
+    return out;
+  }
+
+  void run_clustering(fj::ClusterSequence &cs) const override {
+    const auto &h = *history_;
+    int64_t first = h.offsets[event_];
+    int size = static_cast<int>(h.offsets[event_ + 1] - first);
+    // the parents were checked by check_history as the buffer was read
+    for (int k = size / 2; k < size; k++) {
+      int p1 = h.parent1[first + k];
+      int p2 = h.parent2[first + k];
+      int j1 = cs.history()[p1].jetp_index;
+      if (p2 == fj::ClusterSequence::BeamJet) {
+        cs.plugin_record_iB_recombination(j1, h.dij[first + k]);
+      } else {
+        int k_new;
+        cs.plugin_record_ij_recombination(
+            j1, cs.history()[p2].jetp_index, h.dij[first + k],
+            fj::PseudoJet(h.px[first + k], h.py[first + k], h.pz[first + k],
+                          h.E[first + k]),
+            k_new);
+      }
+    }
+  }
+
+private:
+  std::shared_ptr<const compact_history> history_;
+  std::size_t event_;
+  double R_;
+  bool exclusive_meaningful_, spherical_;
+};
+
+// A ClusterSequence replayed by history_replay that then takes the jet
+// definition the batch was clustered with, as reusable_sequence does between
+// events, so that the queries depending on the algorithm or the recombiner
+// (jet_scale_for_algorithm, reclustering for SoftDrop) behave as they did.
+class restored_sequence : public fj::ClusterSequence {
+public:
+  restored_sequence(const std::vector<fj::PseudoJet> &inputs,
+                    const fj::JetDefinition &replay,
+                    const fj::JetDefinition &original)
+      : fj::ClusterSequence(inputs, replay) {
+    _jet_def = original;
+    _decant_options_partial();
+  }
+};
+
+// The jet definition recorded in h; a plugin, which cannot be restored, is
+// stood in for by stand_in.
+fj::JetDefinition recorded_jet_definition(const header &h,
+                                          const fj::JetDefinition &stand_in) {
+  auto algorithm = static_cast<fj::JetAlgorithm>(h.algorithm);
+  std::string recombiner(
+      h.recombiner,
+      std::find(h.recombiner, h.recombiner + sizeof(h.recombiner), '\0'));
+  fj::JetDefinition jet_def(stand_in);
+  try {
+    if (algorithm != fj::plugin_algorithm &&
+        algorithm != fj::undefined_jet_algorithm) {
+      jet_def = fj::JetDefinition(algorithm, h.R, fj::E_scheme, fj::Best,
+                                  fj::n_parameters_for_algorithm(algorithm));
+      jet_def.set_extra_param(h.extra_param);
+    }
+    if (recombiner.empty()) {
+      jet_def.set_recombination_scheme(
+          static_cast<fj::RecombinationScheme>(h.recombination_scheme));
+    }
+  } catch (const fj::Error &) {
+    throw std::invalid_argument("Corrupt serialized jet definition");
+  }
+  return with_recombiner(jet_def, recombiner, h.recombiner_param);
+}
+
+// Every event of a history read from a buffer has two entries per particle;
+// particles have no parents, each clustering only refers to earlier entries
+// of its own event, and a child is a later entry. Replays and the queries
+// answered from a compact history rely on this.
+void check_history(const compact_history &history) {
+  for (std::size_t i = 0; i + 1 < history.offsets.size(); i++) {
+    int64_t first = history.offsets[i];
+    int64_t size = history.offsets[i + 1] - first;
+    if (size % 2 != 0 || size > std::numeric_limits<int>::max()) {
+      throw std::invalid_argument("Corrupt serialized clustering history");
+    }
+    for (int64_t k = 0; k < size; k++) {
+      int p1 = history.parent1[first + k];
+      int p2 = history.parent2[first + k];
+      int child = history.child[first + k];
+      bool parents =
+          k < size / 2
+              ? p1 < 0 && p2 < 0
+              : p1 >= 0 && p1 < k &&
+                    (p2 == fj::ClusterSequence::BeamJet || (p2 >= 0 && p2 < k));
+      if (!parents || child >= size || (child >= 0 && child <= k)) {
+        throw std::invalid_argument("Corrupt serialized clustering history");
+      }
+    }
+  }
+}
+
+// The input positions of the kept particles of every event, one per
+// particle of its history, strictly increasing within the event.
+void check_positions(const input_positions &positions,
+                     const compact_history &history) {
+  for (std::size_t i = 0; i + 1 < history.offsets.size(); i++) {
+    if (2 * positions.offsets[i] != history.offsets[i]) {
+      throw std::invalid_argument("Corrupt serialized clustering offsets");
+    }
+    int previous = -1;
+    for (int64_t k = positions.offsets[i]; k < positions.offsets[i + 1]; k++) {
+      if (positions.index[k] <= previous) {
+        throw std::invalid_argument("Corrupt serialized input positions");
+      }
+      previous = positions.index[k];
+    }
+  }
+}
+
+bool increasing(const std::vector<int64_t> &offsets, uint64_t total) {
+  for (std::size_t i = 1; i < offsets.size(); i++) {
+    if (offsets[i] < offsets[i - 1]) {
+      return false;
+    }
+  }
+  return !offsets.empty() && offsets.front() == 0 &&
+         static_cast<uint64_t>(offsets.back()) == total;
+}
+
+py::array serialize(const output_wrapper &ow) {
+  if (ow.with_area) {
+    throw std::invalid_argument(
+        "Batches clustered with jet areas cannot be serialized");
+  }
+  std::size_t n_events = ow.cse.size();
+  auto history = ow.history;
+  if (!history) {
+    history = std::make_shared<compact_history>();
+    history->allocate(*ow.parts);
+    for (std::size_t i = 0; i < n_events; i++) {
+      history->fill(i, *ow.cse[i]);
+    }
+  }
+
+  header h{};
+  std::memcpy(h.magic, magic, sizeof(magic));
+  h.version = version;
+  h.flags = (ow.single_precision ? single_precision : 0) |
+            (ow.history ? compact : 0) | (ow.positions ? positions : 0);
+  h.coordinates = static_cast<uint32_t>(ow.coordinates);
+  h.algorithm = static_cast<int32_t>(fj::undefined_jet_algorithm);
+  if (!ow.history && n_events > 0) {
+    const auto &jet_def = ow.cse[0]->jet_def();
+    if (calls_external_recombiner(jet_def)) {
+      throw std::invalid_argument(
+          "Batches clustered with an external recombiner cannot be "
+          "serialized");
+    }
+    h.algorithm = static_cast<int32_t>(jet_def.jet_algorithm());
+    h.recombination_scheme =
+        static_cast<uint32_t>(jet_def.recombination_scheme());
+    if (auto compiled = dynamic_cast<const compiled_recombiner *>(
+            jet_def.recombiner())) {
+      std::string name = compiled->name();
+      std::memcpy(h.recombiner, name.data(),
+                  std::min(name.size(), sizeof(h.recombiner)));
+      h.recombiner_param = compiled->param();
+    }
+    h.exclusive_meaningful = exclusive_sequence_meaningful(jet_def);
+    h.spherical = jet_def.is_spherical();
+    h.R = jet_def.R();
+    h.extra_param = jet_def.extra_param();
+  }
+  h.n_events = n_events;
+  h.n_particles = ow.parts ? ow.parts->particles.size() : 0;
+  h.n_history = history->offsets.back();
+
+  writer out;
+  out.put(&h, 1);
+  if (ow.parts) {
+    const auto &particles = ow.parts->particles;
+    out.put(ow.parts->offsets);
+    std::vector<double> column(particles.size());
+    for (auto component : {&fj::PseudoJet::px, &fj::PseudoJet::py,
+                           &fj::PseudoJet::pz, &fj::PseudoJet::E}) {
+      for (std::size_t k = 0; k < particles.size(); k++) {
+        column[k] = (particles[k].*component)();
+      }
+      out.put(column);
+    }
+  }
+  if (ow.positions) {
+    out.put(ow.positions->offsets);
+    out.put(ow.positions->index);
+  }
+  out.put(history->offsets);
+  for (auto column : {&history->parent1, &history->parent2, &history->child}) {
+    out.put(*column);
+  }
+  for (auto column : {&history->dij, &history->max_dij_so_far, &history->px,
+                      &history->py, &history->pz, &history->E}) {
+    out.put(*column);
+  }
+  out.put(history->Q);
+  return as_pyarray<uint8_t>(std::move(out.bytes));
+}
+
+output_wrapper deserialize(py::buffer buffer, int n_threads) {
+  py::buffer_info info = buffer.request();
+  reader in(static_cast<const uint8_t *>(info.ptr),
+            static_cast<std::size_t>(info.size * info.itemsize));
+  header h;
+  in.get(&h, 1);
+  if (std::memcmp(h.magic, magic, sizeof(magic)) != 0 || h.version != version) {
+    throw std::invalid_argument(
+        "Not a serialized clustering of a supported version");
+  }
+  output_wrapper ow;
+  ow.single_precision = h.flags & single_precision;
+  if (h.coordinates >
+      static_cast<uint32_t>(momentum_coordinates::pt_eta_phi_e)) {
+    throw std::invalid_argument("Corrupt serialized momentum coordinates");
+  }
+  ow.coordinates = static_cast<momentum_coordinates>(h.coordinates);
+
+  if (!(h.flags & compact)) {
+    ow.parts = std::make_shared<particle_arena>();
+    auto &arena = *ow.parts;
+    in.get(arena.offsets, h.n_events + 1);
+    if (!increasing(arena.offsets, h.n_particles)) {
+      throw std::invalid_argument("Corrupt serialized clustering offsets");
+    }
+    std::vector<double> px, py, pz, E;
+    for (auto column : {&px, &py, &pz, &E}) {
+      in.get(*column, h.n_particles);
+    }
+    arena.particles.resize(h.n_particles);
+    for (std::size_t k = 0; k < h.n_particles; k++) {
+      arena.particles[k] = fj::PseudoJet(px[k], py[k], pz[k], E[k]);
+    }
+  }
+  if (h.flags & positions) {
+    ow.positions = std::make_shared<input_positions>();
+    in.get(ow.positions->offsets, h.n_events + 1);
+    // one position per particle, which is half of the history
+    if (!increasing(ow.positions->offsets, h.n_history / 2)) {
+      throw std::invalid_argument("Corrupt serialized clustering offsets");
+    }
+    in.get(ow.positions->index, h.n_history / 2);
+  }
+  auto history = std::make_shared<compact_history>();
+  in.get(history->offsets, h.n_events + 1);
+  if (!increasing(history->offsets, h.n_history)) {
+    throw std::invalid_argument("Corrupt serialized clustering offsets");
+  }
+  for (auto column : {&history->parent1, &history->parent2, &history->child}) {
+    in.get(*column, h.n_history);
+  }
+  for (auto column : {&history->dij, &history->max_dij_so_far, &history->px,
+                      &history->py, &history->pz, &history->E}) {
+    in.get(*column, h.n_history);
+  }
+  in.get(history->Q, h.n_events);
+  check_history(*history);
+  if (ow.positions) {
+    check_positions(*ow.positions, *history);
+  }
+
+  ow.cse.resize(h.n_events);
+  if (h.flags & compact) {
+    ow.history = std::move(history);
+    return ow;
+  }
+  for (std::size_t i = 0; i < h.n_events; i++) {
+    if (history->offsets[i] != 2 * ow.parts->offsets[i]) {
+      throw std::invalid_argument("Corrupt serialized clustering offsets");
+    }
+  }
+  // a plugin is stood in for by a replay, which only reports R and how the
+  // jets are to be read
+  fj::JetDefinition stand_in(new history_replay(history, 0, h));
+  stand_in.delete_plugin_when_unused();
+  fj::JetDefinition original = recorded_jet_definition(h, stand_in);
+  // every event is replayed independently into its own slot
+  py::gil_scoped_release release;
+  thread_pool::instance().parallel_for(
+      h.n_events, resolve_n_threads(n_threads),
+      [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; i++) {
+          auto replay = new history_replay(history, i, h);
+          fj::JetDefinition jet_def(replay);
+          jet_def.delete_plugin_when_unused();
+          ow.cse[i] = std::make_shared<restored_sequence>(replay->inputs(),
+                                                          jet_def, original);
+        }
+      });
+  return ow;
+}
+
+} // namespace serialized
+
+// Binds a query about one jet per event under two signatures: the jets given
+// by their cluster_hist_index, or by their four-momenta for arrays that do
+// not carry the index.
+template <typename... Params, typename Query>
+void def_jet_query(py::class_<output_wrapper> &cls, const char *name,
+                   Query query, const char *doc) {
+  cls.def(name,
+          [query](const output_wrapper &ow, const index_array &hist_index,
+                  Params... params) {
+            return query(ow, jets_at(ow, hist_index), params...);
+          },
+          py::call_guard<timed_export>(), doc);
+  cls.def(name,
+          [query](const output_wrapper &ow, const double_array &pxi,
+                  const double_array &pyi, const double_array &pzi,
+                  const double_array &Ei, Params... params) {
+            return query(ow, match_inclusive_jets(ow, pxi, pyi, pzi, Ei),
+                         params...);
+          },
+          py::call_guard<timed_export>(), doc);
+}
+
+// SoftDrop groomer configured from the string options of the Python interface.
+std::shared_ptr<fastjet::contrib::SoftDrop>
+make_softdrop(double beta, double symmetry_cut,
+              const std::string &symmetry_measure, double R0,
+              const std::string &recursion_choice, double mu_cut) {
+  fastjet::contrib::RecursiveSymmetryCutBase::SymmetryMeasure sym_meas = fastjet::contrib::RecursiveSymmetryCutBase::SymmetryMeasure::scalar_z;
+  if (symmetry_measure == "scalar_z") {
+    sym_meas = fastjet::contrib::RecursiveSymmetryCutBase::SymmetryMeasure::scalar_z;
+  }
+  else if (symmetry_measure == "vector_z") {
+    sym_meas = fastjet::contrib::RecursiveSymmetryCutBase::SymmetryMeasure::vector_z;
+  }
+  else if (symmetry_measure == "y") {
+    sym_meas = fastjet::contrib::RecursiveSymmetryCutBase::SymmetryMeasure::y;
+  }
+  else if (symmetry_measure == "theta_E") {
+    sym_meas = fastjet::contrib::RecursiveSymmetryCutBase::SymmetryMeasure::theta_E;
+  }
+  else if (symmetry_measure == "cos_theta_E") {
+    sym_meas = fastjet::contrib::RecursiveSymmetryCutBase::SymmetryMeasure::cos_theta_E;
+  }
+
+  fastjet::contrib::RecursiveSymmetryCutBase::RecursionChoice rec_choice = fastjet::contrib::RecursiveSymmetryCutBase::RecursionChoice::larger_pt;
+  if (recursion_choice == "larger_pt") {
+    rec_choice = fastjet::contrib::RecursiveSymmetryCutBase::RecursionChoice::larger_pt;
+  }
+  else if (recursion_choice == "larger_mt") {
+    rec_choice = fastjet::contrib::RecursiveSymmetryCutBase::RecursionChoice::larger_mt;
+  }
+  else if (recursion_choice == "larger_m") {
+    rec_choice = fastjet::contrib::RecursiveSymmetryCutBase::RecursionChoice::larger_m;
+  }
+  else if (recursion_choice == "larger_E") {
+    rec_choice = fastjet::contrib::RecursiveSymmetryCutBase::RecursionChoice::larger_E;
+  }
+
+  return std::make_shared<fastjet::contrib::SoftDrop>(beta, symmetry_cut, sym_meas, R0, mu_cut, rec_choice/*, subtractor*/);
+}
+
+// SoftDrop, and with beta = 0 and a finite mu_cut the modified mass drop
+// tagger, applied to the jets of a whole batch by walking their C/A
+// declustering, the way RecursiveSymmetryCutBase does in grooming mode but
+// without building a groomed jet and its structure. Jets clustered with C/A
+// are declustered through their own history; others are first reclustered
+// with C/A in a ClusterSequence reused by each thread. The e+e- symmetry
+// measures recluster with e+e- algorithms and are left to SoftDrop itself.
+class softdrop_declustering {
+public:
+  // zg and Rg are those of the splitting that passed, 0 when none did and
+  // the jet was groomed down to one particle; all are NaN for the jets
+  // SoftDrop cannot groom (no pt, or no mass with the y measure or mu_cut)
+  struct groomed {
+    double zg, Rg, mass, pt;
+  };
+
+  enum class measure { scalar_z, vector_z, y, theta_E, cos_theta_E };
+  enum class recursion { larger_pt, larger_mt, larger_m, larger_E };
+
+  softdrop_declustering(double beta, double symmetry_cut,
+                        const std::string &symmetry_measure, double R0,
+                        const std::string &recursion_choice, double mu_cut)
+      : beta_(beta), symmetry_cut_(symmetry_cut), R0sqr_(R0 * R0),
+        mu2_(mu_cut * mu_cut),
+        use_mu_(mu_cut != std::numeric_limits<double>::infinity()),
+        measure_(parse_measure(symmetry_measure)),
+        recursion_(parse_recursion(recursion_choice)) {
+    if (!walks_history()) {
+      softdrop_ = make_softdrop(beta, symmetry_cut, symmetry_measure, R0,
+                                recursion_choice, mu_cut);
+    }
+  }
+
+  bool walks_history() const {
+    return measure_ != measure::theta_E && measure_ != measure::cos_theta_E;
+  }
+
+  groomed groom(const fj::ClusterSequence &cs, const fj::PseudoJet &jet) const {
+    if (!walks_history()) {
+      fj::PseudoJet soft = softdrop_->result(jet);
+      if (soft == 0) {
+        return failed();
+      }
+      const auto &structure = soft.structure_of<fastjet::contrib::SoftDrop>();
+      return {structure.symmetry(), structure.delta_R(), soft.m(), soft.pt()};
+    }
+    if (cs.jet_def().jet_algorithm() == fj::cambridge_algorithm) {
+      return decluster(cs, jet);
+    }
+    // SoftDrop reclusters with C/A at the largest R, keeping the recombiner
+    fj::JetDefinition ca(fj::cambridge_algorithm,
+                         fj::JetDefinition::max_allowable_R);
+    ca.set_recombiner(cs.jet_def());
+    auto constituents = cs.constituents(jet);
+    if (constituents.empty()) {
+      return failed();
+    }
+    const auto &reclustered = reusable_sequence::for_this_thread().cluster(
+        constituents.data(), constituents.data() + constituents.size(), ca);
+    // the last merging is the whole jet with the beam
+    const auto &history = reclustered.history();
+    int whole = history.back().parent1;
+    return decluster(reclustered,
+                     reclustered.jets()[history[whole].jetp_index]);
+  }
+
+private:
+  static measure parse_measure(const std::string &name) {
+    static const std::map<std::string, measure> measures = {
+        {"scalar_z", measure::scalar_z},
+        {"vector_z", measure::vector_z},
+        {"y", measure::y},
+        {"theta_E", measure::theta_E},
+        {"cos_theta_E", measure::cos_theta_E}};
+    auto found = measures.find(name);
+    if (found == measures.end()) {
+      throw std::invalid_argument("Unknown symmetry measure " + name +
+                                  "; expected scalar_z, vector_z, y, "
+                                  "theta_E or cos_theta_E");
+    }
+    return found->second;
+  }
+
+  static recursion parse_recursion(const std::string &name) {
+    static const std::map<std::string, recursion> choices = {
+        {"larger_pt", recursion::larger_pt},
+        {"larger_mt", recursion::larger_mt},
+        {"larger_m", recursion::larger_m},
+        {"larger_E", recursion::larger_E}};
+    auto found = choices.find(name);
+    if (found == choices.end()) {
+      throw std::invalid_argument("Unknown recursion choice " + name +
+                                  "; expected larger_pt, larger_mt, "
+                                  "larger_m or larger_E");
+    }
+    return found->second;
+  }
+
+  static groomed failed() {
+    double nan = std::numeric_limits<double>::quiet_NaN();
+    return {nan, nan, nan, nan};
+  }
+
+  double harder_by(const fj::PseudoJet &p) const {
+    switch (recursion_) {
+    case recursion::larger_mt:
+      return p.mperp2();
+    case recursion::larger_m:
+      return p.m2();
+    case recursion::larger_E:
+      return p.E();
+    default:
+      return p.pt2();
+    }
+  }
+
+  groomed decluster(const fj::ClusterSequence &cs, fj::PseudoJet subjet) const {
+    fj::PseudoJet piece1, piece2;
+    while (cs.has_parents(subjet, piece1, piece2)) {
+      if (subjet.pt2() <= 0) {
+        return failed();
+      }
+      double delta_R2 = piece1.squared_distance(piece2);
+      double symmetry;
+      if (measure_ == measure::y) {
+        if (subjet.m2() <= 0) {
+          return failed();
         }
-        auto px = py::array(py::buffer_info(nullptr, sizeof(double), py::format_descriptor<double>::value, 1, {jk}, {sizeof(double)}));
-        auto bufpx = px.request();
-        double *ptrpx = (double *)bufpx.ptr;
-
-        auto py = py::array(py::buffer_info(nullptr, sizeof(double), py::format_descriptor<double>::value, 1, {jk}, {sizeof(double)}));
-        auto bufpy = py.request();
-        double *ptrpy = (double *)bufpy.ptr;
-
-        auto pz = py::array(py::buffer_info(nullptr, sizeof(double), py::format_descriptor<double>::value, 1, {jk}, {sizeof(double)}));
-        auto bufpz = pz.request();
-        double *ptrpz = (double *)bufpz.ptr;
-
-        auto E = py::array(py::buffer_info(nullptr, sizeof(double), py::format_descriptor<double>::value, 1, {jk}, {sizeof(double)}));
-        auto bufE = E.request();
-        double *ptrE = (double *)bufE.ptr;
-
-        auto off = py::array(py::buffer_info(nullptr, sizeof(int), py::format_descriptor<int>::value, 1, {len+1}, {sizeof(int)}));
-        auto bufoff = off.request();
-        int *ptroff = (int *)bufoff.ptr;
-        size_t idxe = 0;
-        *ptroff = 0;
-        ptroff++;
-        for(int i = 0; i < len; i++){
-        auto jets = ow.cse[i]->exclusive_jets_ycut(ycut);
-        for (unsigned int j = 0; j < jets.size(); j++){
-          ptrpx[idxe] = jets[j].px();
-          ptrpy[idxe] = jets[j].py();
-          ptrpz[idxe] = jets[j].pz();
-          ptrE[idxe] = jets[j].E();
-          idxe++;
+        symmetry = std::min(piece1.pt2(), piece2.pt2()) * delta_R2 /
+                   subjet.m2();
+      } else {
+        double pt1 = piece1.pt(), pt2 = piece2.pt();
+        double total = measure_ == measure::vector_z ? subjet.pt() : pt1 + pt2;
+        // fjcontrib takes pieces without pt for a recursion issue
+        if (total <= 0) {
+          return failed();
         }
-        *ptroff = jets.size()+*(ptroff-1);
-        ptroff++;
+        symmetry = std::min(pt1, pt2) / total;
+      }
+      bool passes =
+          symmetry > symmetry_cut_ * std::pow(delta_R2 / R0sqr_, 0.5 * beta_);
+      if (passes && use_mu_) {
+        if (subjet.m2() <= 0) {
+          return failed();
         }
-        return std::make_tuple(
-            px,
-            py,
-            pz,
-            E,
-            off
-          );
-      }, "dcut"_a = 100, R"pbdoc(
-        Retrieves the exclusive jets upto the given dcut from multievent clustering and converts them to numpy arrays.
+        passes = std::max(piece1.m2(), piece2.m2()) < mu2_ * subjet.m2();
+      }
+      if (passes) {
+        return {symmetry, std::sqrt(delta_R2), subjet.m(), subjet.pt()};
+      }
+      subjet = harder_by(piece2) > harder_by(piece1) ? piece2 : piece1;
+    }
+    return {0, 0, subjet.m(), subjet.pt()};
+  }
+
+  double beta_, symmetry_cut_, R0sqr_, mu2_;
+  bool use_mu_;
+  measure measure_;
+  recursion recursion_;
+  std::shared_ptr<fastjet::contrib::SoftDrop> softdrop_;
+};
+
+// Energy correlator function selected by (case-insensitive) name; null for
+// an unknown name.
+std::shared_ptr<fastjet::FunctionOfPseudoJet<double>>
+make_energy_correlator(double beta, double npoint, int angles, double alpha,
+                       std::string func, bool normalized) {
+  std::transform(func.begin(), func.end(), func.begin(),
+    [](unsigned char c){ return std::tolower(c); });
+  auto energy_correlator = std::shared_ptr<fastjet::FunctionOfPseudoJet<double>>(nullptr);
+  if ( func == "ratio" ) {
+    energy_correlator = std::make_shared<fastjet::contrib::EnergyCorrelatorRatio>(npoint, beta); }
+  else if ( func == "doubleratio" ) {
+    energy_correlator = std::make_shared<fastjet::contrib::EnergyCorrelatorDoubleRatio>(npoint, beta); }
+  else if ( func == "c1" ) {
+    energy_correlator = std::make_shared<fastjet::contrib::EnergyCorrelatorC1>(beta);}
+  else if ( func == "c2" ) {
+    energy_correlator = std::make_shared<fastjet::contrib::EnergyCorrelatorC2>(beta);}
+  else if ( func == "d2" ) {
+    energy_correlator = std::make_shared<fastjet::contrib::EnergyCorrelatorD2>(beta);}
+  else if ( func == "generalized" ) {
+    energy_correlator = std::make_shared<fastjet::contrib::EnergyCorrelatorGeneralized>(angles, npoint, beta);}
+  else if (func == "generalizedd2") {
+    energy_correlator = std::make_shared<fastjet::contrib::EnergyCorrelatorGeneralizedD2>(alpha, beta);}
+  else if (func == "nseries") {
+    energy_correlator = std::make_shared<fastjet::contrib::EnergyCorrelatorNseries>(npoint, beta);}
+  else if (func == "n2") {
+    energy_correlator = std::make_shared<fastjet::contrib::EnergyCorrelatorN2>(beta);}
+  else if (func == "n3") {
+    energy_correlator = std::make_shared<fastjet::contrib::EnergyCorrelatorN3>(beta);}
+  else if (func == "mseries") {
+    energy_correlator = std::make_shared<fastjet::contrib::EnergyCorrelatorMseries>(npoint, beta);}
+  else if (func == "m2") {
+    energy_correlator = std::make_shared<fastjet::contrib::EnergyCorrelatorM2>(beta);}
+  else if (func == "cseries") {
+    energy_correlator = std::make_shared<fastjet::contrib::EnergyCorrelatorCseries>(npoint, beta);}
+  else if (func == "useries") {
+    energy_correlator = std::make_shared<fastjet::contrib::EnergyCorrelatorUseries>(npoint, beta);}
+  else if (func == "u1") {
+    energy_correlator = std::make_shared<fastjet::contrib::EnergyCorrelatorU1>(beta);}
+  else if (func == "u2") {
+    energy_correlator = std::make_shared<fastjet::contrib::EnergyCorrelatorU2>(beta);}
+  else if (func == "u3") {
+    energy_correlator = std::make_shared<fastjet::contrib::EnergyCorrelatorU3>(beta);}
+  else if (func == "generic" && normalized == false) {
+    energy_correlator = std::make_shared<fastjet::contrib::EnergyCorrelator>(npoint, beta);} // The generic energy correlator is not normalized; i.e. does not use a momentum fraction when being calculated.
+  else if (func == "generic" && normalized == true) {
+    energy_correlator = std::make_shared<fastjet::contrib::EnergyCorrelatorGeneralized>(angles, npoint, beta);} //Using the Generalized class with angles=-1 returns a generic ECF that has been normalized
+  return energy_correlator;
+}
+
+// N-jettiness routine for the named measure and axes definitions. Njettiness
+// keeps its own copies of both, so the definitions can live on the stack.
+std::shared_ptr<fastjet::contrib::Njettiness>
+make_njettiness(const std::string &measure_definition,
+                const std::string &axes_definition, double beta, double R0,
+                double Rcutoff, int nPass, double akAxesR0) {
+  auto maybe_measdef = njettiness::measure_def_names_to_enum.find(measure_definition);
+  const auto measdefenum = maybe_measdef == njettiness::measure_def_names_to_enum.end() ? njettiness::NormalizedMeasure : maybe_measdef->second;
+
+  auto maybe_axesdef = njettiness::axis_def_names_to_enum.find(axes_definition);
+  const auto axesdefenum = maybe_axesdef == njettiness::axis_def_names_to_enum.end() ? njettiness::KT_Axes : maybe_axesdef->second;
+
+  // Get the measure definition
+  fastjet::contrib::NormalizedMeasure          normalizedMeasure        (beta, R0);
+  fastjet::contrib::UnnormalizedMeasure        unnormalizedMeasure      (beta);
+  fastjet::contrib::OriginalGeometricMeasure   geometricMeasure         (beta);
+  fastjet::contrib::NormalizedCutoffMeasure    normalizedCutoffMeasure  (beta, R0, Rcutoff);
+  fastjet::contrib::UnnormalizedCutoffMeasure  unnormalizedCutoffMeasure(beta, Rcutoff);
+
+  fastjet::contrib::MeasureDefinition const * measureDef = 0;
+  switch ( measdefenum ) {
+    case njettiness::UnnormalizedMeasure         : measureDef = &unnormalizedMeasure; break;
+    case njettiness::OriginalGeometricMeasure    : measureDef = &geometricMeasure; break;
+    case njettiness::NormalizedCutoffMeasure     : measureDef = &normalizedCutoffMeasure; break;
+    case njettiness::UnnormalizedCutoffMeasure   : measureDef = &unnormalizedCutoffMeasure; break;
+    case njettiness::NormalizedMeasure : default : measureDef = &normalizedMeasure; break;
+  }
+
+  // Get the axes definition
+  fastjet::contrib::KT_Axes             kt_axes;
+  fastjet::contrib::CA_Axes             ca_axes;
+  fastjet::contrib::AntiKT_Axes         antikt_axes        (akAxesR0);
+  fastjet::contrib::WTA_KT_Axes         wta_kt_axes;
+  fastjet::contrib::WTA_CA_Axes         wta_ca_axes;
+  fastjet::contrib::OnePass_KT_Axes     onepass_kt_axes;
+  fastjet::contrib::OnePass_CA_Axes     onepass_ca_axes;
+  fastjet::contrib::OnePass_AntiKT_Axes onepass_antikt_axes(akAxesR0);
+  fastjet::contrib::OnePass_WTA_KT_Axes onepass_wta_kt_axes;
+  fastjet::contrib::OnePass_WTA_CA_Axes onepass_wta_ca_axes;
+  fastjet::contrib::MultiPass_Axes      multipass_axes     (nPass);
+
+  fastjet::contrib::AxesDefinition const * axesDef = 0;
+  switch ( axesdefenum ) {
+    case  njettiness::KT_Axes : default   : axesDef = &kt_axes; break;
+    case  njettiness::CA_Axes             : axesDef = &ca_axes; break;
+    case  njettiness::AntiKT_Axes         : axesDef = &antikt_axes; break;
+    case  njettiness::WTA_KT_Axes         : axesDef = &wta_kt_axes; break;
+    case  njettiness::WTA_CA_Axes         : axesDef = &wta_ca_axes; break;
+    case  njettiness::OnePass_KT_Axes     : axesDef = &onepass_kt_axes; break;
+    case  njettiness::OnePass_CA_Axes     : axesDef = &onepass_ca_axes; break;
+    case  njettiness::OnePass_AntiKT_Axes : axesDef = &onepass_antikt_axes; break;
+    case  njettiness::OnePass_WTA_KT_Axes : axesDef = &onepass_wta_kt_axes; break;
+    case  njettiness::OnePass_WTA_CA_Axes : axesDef = &onepass_wta_ca_axes; break;
+    case  njettiness::MultiPass_Axes      : axesDef = &multipass_axes; break;
+  }
+
+  return std::make_shared<fastjet::contrib::Njettiness>(*axesDef, *measureDef);
+}
+
+// Reads an optional entry of an observable specification.
+template <typename T>
+T spec_option(py::dict spec, const char *key, T fallback) {
+  return spec.contains(key) ? spec[key].cast<T>() : fallback;
+}
+
+// One output requested from to_numpy_jet_observables. Every observable is
+// handed each selected jet once, together with the constituents of the jet
+// when it asks for them, and finally moves its columns into the output
+// record under its own field names.
+class jet_observable {
+public:
+  virtual ~jet_observable() = default;
+  virtual bool needs_constituents() const { return false; }
+  // called before the jets of each event, with the input positions of its
+  // clustered particles (nullptr when they are unchanged)
+  virtual void start_event(const int *) {}
+  virtual void fill(const fj::PseudoJet &jet,
+                    const std::vector<fj::PseudoJet> &constituents) = 0;
+  virtual void release(py::dict &fields) = 0;
+};
+
+template <typename Real> class momentum_observable : public jet_observable {
+public:
+  momentum_observable(bool with_index, momentum_coordinates coordinates)
+      : with_index_(with_index), coordinates_(coordinates) {}
+  void fill(const fj::PseudoJet &jet,
+            const std::vector<fj::PseudoJet> &) override {
+    px.push_back(jet.px());
+    py.push_back(jet.py());
+    pz.push_back(jet.pz());
+    E.push_back(jet.E());
+    if (with_index_) {
+      cluster_hist_index.push_back(jet.cluster_hist_index());
+    }
+  }
+  void release(py::dict &fields) override {
+    if (coordinates_ == momentum_coordinates::cartesian) {
+      fields["px"] = px.release();
+      fields["py"] = py.release();
+      fields["pz"] = pz.release();
+      fields["E"] = E.release();
+    } else {
+      bool with_mass = coordinates_ == momentum_coordinates::pt_eta_phi_m;
+      cylindrical_momenta<Real> cylindrical(
+          px.values.data(), py.values.data(), pz.values.data(),
+          E.values.data(), px.values.size(), with_mass);
+      auto columns = cylindrical.release(py::none());
+      fields["pt"] = columns[0];
+      fields["eta"] = columns[1];
+      fields["phi"] = columns[2];
+      if (with_mass) {
+        fields["mass"] = columns[3];
+      } else {
+        fields["E"] = E.release();
+      }
+    }
+    if (with_index_) {
+      fields["cluster_hist_index"] = cluster_hist_index.release();
+    }
+  }
+
+private:
+  bool with_index_;
+  momentum_coordinates coordinates_;
+  column<Real> px, py, pz, E;
+  column<int> cluster_hist_index;
+};
+
+class constituent_index_observable : public jet_observable {
+public:
+  explicit constituent_index_observable(std::string name)
+      : name_(std::move(name)) {
+    offsets_.push_back(0);
+  }
+  bool needs_constituents() const override { return true; }
+  void start_event(const int *positions) override { positions_ = positions; }
+  void fill(const fj::PseudoJet &,
+            const std::vector<fj::PseudoJet> &constituents) override {
+    // input particles occupy the first history entries in input order, so
+    // their history index is their position among the clustered particles
+    auto first = index_.values.size();
+    for (const auto &c : constituents) {
+      int k = c.cluster_hist_index();
+      index_.push_back(positions_ ? positions_[k] : k);
+    }
+    std::sort(index_.values.begin() + first, index_.values.end());
+    offsets_.push_back(static_cast<offset_t>(index_.values.size()));
+  }
+  void release(py::dict &fields) override {
+    fields[name_.c_str()] =
+        py::make_tuple(offsets_.release(), index_.release());
+  }
+
+private:
+  std::string name_;
+  const int *positions_ = nullptr;
+  column<offset_t> offsets_;
+  column<int> index_;
+};
+
+// Groomed kinematics under the field names of exclusive_jets_softdrop_grooming
+// (msoftdrop, ptsoftdrop, ...), with the observable name as suffix.
+class softdrop_observable : public jet_observable {
+public:
+  softdrop_observable(std::string name,
+                      std::shared_ptr<fastjet::contrib::SoftDrop> sd)
+      : name_(std::move(name)), sd_(std::move(sd)) {}
+  void fill(const fj::PseudoJet &jet,
+            const std::vector<fj::PseudoJet> &) override {
+    auto soft = sd_->result(jet);
+    if (soft == 0) {
+      // groomed jets that did not survive are reported as NaN
+      for (auto *c : {&pt_, &eta_, &phi_, &m_, &E_, &pz_, &delta_R_,
+                      &symmetry_}) {
+        c->push_back(std::numeric_limits<double>::quiet_NaN());
+      }
+      return;
+    }
+    pt_.push_back(soft.pt());
+    eta_.push_back(soft.eta());
+    phi_.push_back(soft.phi());
+    m_.push_back(soft.m());
+    E_.push_back(soft.E());
+    pz_.push_back(soft.pz());
+    const auto &structure = soft.structure_of<fastjet::contrib::SoftDrop>();
+    delta_R_.push_back(structure.delta_R());
+    symmetry_.push_back(structure.symmetry());
+  }
+  void release(py::dict &fields) override {
+    fields[("m" + name_).c_str()] = m_.release();
+    fields[("pt" + name_).c_str()] = pt_.release();
+    fields[("eta" + name_).c_str()] = eta_.release();
+    fields[("phi" + name_).c_str()] = phi_.release();
+    fields[("E" + name_).c_str()] = E_.release();
+    fields[("pz" + name_).c_str()] = pz_.release();
+    fields[("deltaR" + name_).c_str()] = delta_R_.release();
+    fields[("symmetry" + name_).c_str()] = symmetry_.release();
+  }
+
+private:
+  std::string name_;
+  std::shared_ptr<fastjet::contrib::SoftDrop> sd_;
+  column<double> pt_, eta_, phi_, m_, E_, pz_, delta_R_, symmetry_;
+};
+
+class energy_correlator_observable : public jet_observable {
+public:
+  energy_correlator_observable(
+      std::string name,
+      std::shared_ptr<fastjet::FunctionOfPseudoJet<double>> ecf)
+      : name_(std::move(name)), ecf_(std::move(ecf)) {}
+  void fill(const fj::PseudoJet &jet,
+            const std::vector<fj::PseudoJet> &) override {
+    values_.push_back(ecf_->result(jet));
+  }
+  void release(py::dict &fields) override {
+    fields[name_.c_str()] = values_.release();
+  }
+
+private:
+  std::string name_;
+  std::shared_ptr<fastjet::FunctionOfPseudoJet<double>> ecf_;
+  column<double> values_;
+};
+
+// Under the field names of the area columns of jets clustered with areas.
+class area_observable : public jet_observable {
+public:
+  void fill(const fj::PseudoJet &jet,
+            const std::vector<fj::PseudoJet> &) override {
+    if (!jet.has_area()) {
+      throw std::invalid_argument(
+          "Jet areas need the events to be clustered with an area_definition");
+    }
+    area_.push_back(jet.area());
+    auto area_4vector = jet.area_4vector();
+    area_px_.push_back(area_4vector.px());
+    area_py_.push_back(area_4vector.py());
+    area_pz_.push_back(area_4vector.pz());
+    area_E_.push_back(area_4vector.E());
+    n_ghosts_.push_back(ghost_count(jet));
+  }
+  void release(py::dict &fields) override {
+    fields["area"] = area_.release();
+    fields["area_px"] = area_px_.release();
+    fields["area_py"] = area_py_.release();
+    fields["area_pz"] = area_pz_.release();
+    fields["area_E"] = area_E_.release();
+    fields["n_ghosts"] = n_ghosts_.release();
+  }
+
+private:
+  column<double> area_, area_px_, area_py_, area_pz_, area_E_;
+  column<int> n_ghosts_;
+};
+
+class lund_observable : public jet_observable {
+public:
+  explicit lund_observable(std::string name) : name_(std::move(name)) {
+    offsets_.push_back(0);
+  }
+  void fill(const fj::PseudoJet &jet,
+            const std::vector<fj::PseudoJet> &) override {
+    for (const auto &d : generator_.result(jet)) {
+      Delta_.push_back(d.Delta());
+      kt_.push_back(d.kt());
+    }
+    offsets_.push_back(static_cast<offset_t>(Delta_.values.size()));
+  }
+  void release(py::dict &fields) override {
+    py::dict declusterings;
+    declusterings["Delta"] = Delta_.release();
+    declusterings["kt"] = kt_.release();
+    fields[name_.c_str()] = py::make_tuple(offsets_.release(), declusterings);
+  }
+
+private:
+  std::string name_;
+  fastjet::contrib::LundGenerator generator_;
+  column<offset_t> offsets_;
+  column<double> Delta_, kt_;
+};
+
+// N-subjettiness of each jet: tau_N computed on the jet's own constituents,
+// one row of len(njets) values per jet. to_numpy_njettiness computes tau_N
+// on all the particles of each event instead.
+class nsubjettiness_observable : public jet_observable {
+public:
+  nsubjettiness_observable(std::string name,
+                        std::shared_ptr<fastjet::contrib::Njettiness> routine,
+                        std::vector<unsigned int> njets)
+      : name_(std::move(name)), routine_(std::move(routine)),
+        njets_(std::move(njets)) {}
+  bool needs_constituents() const override { return true; }
+  void fill(const fj::PseudoJet &,
+            const std::vector<fj::PseudoJet> &constituents) override {
+    for (auto n : njets_) {
+      taus_.push_back(routine_->getTau(n, constituents));
+    }
+  }
+  void release(py::dict &fields) override {
+    fields[name_.c_str()] =
+        taus_.release().attr("reshape")(-1, njets_.size());
+  }
+
+private:
+  std::string name_;
+  std::shared_ptr<fastjet::contrib::Njettiness> routine_;
+  std::vector<unsigned int> njets_;
+  column<double> taus_;
+};
+
+// Builds an observable from its specification: a dict with the observable
+// kind under "observable", an optional output "name" and the keyword
+// arguments of the matching single-observable accessor.
+std::unique_ptr<jet_observable> make_jet_observable(py::dict spec,
+                                                    bool single_precision) {
+  auto kind = spec["observable"].cast<std::string>();
+  auto name = spec_option<std::string>(spec, "name", kind);
+  if (kind == "momentum") {
+    auto with_index = spec_option<bool>(spec, "cluster_hist_index", false);
+    auto coordinates = parse_coordinates(
+        spec_option<std::string>(spec, "coordinates", "cartesian"));
+    if (single_precision) {
+      return std::unique_ptr<jet_observable>(
+          new momentum_observable<float>(with_index, coordinates));
+    }
+    return std::unique_ptr<jet_observable>(
+        new momentum_observable<double>(with_index, coordinates));
+  }
+  if (kind == "constituent_index") {
+    return std::unique_ptr<jet_observable>(
+        new constituent_index_observable(name));
+  }
+  if (kind == "softdrop") {
+    auto sd = make_softdrop(
+        spec_option<double>(spec, "beta", 0),
+        spec_option<double>(spec, "symmetry_cut", 0.1),
+        spec_option<std::string>(spec, "symmetry_measure", "scalar_z"),
+        spec_option<double>(spec, "R0", 0.8),
+        spec_option<std::string>(spec, "recursion_choice", "larger_pt"),
+        spec_option<double>(spec, "mu_cut",
+                            std::numeric_limits<double>::infinity()));
+    return std::unique_ptr<jet_observable>(
+        new softdrop_observable(name, sd));
+  }
+  if (kind == "energy_correlator") {
+    auto ecf = make_energy_correlator(
+        spec_option<double>(spec, "beta", 1),
+        spec_option<double>(spec, "npoint", 0),
+        spec_option<int>(spec, "angles", -1),
+        spec_option<double>(spec, "alpha", 0),
+        spec_option<std::string>(spec, "func", "generalized"),
+        spec_option<bool>(spec, "normalized", true));
+    if (!ecf) {
+      throw std::invalid_argument("Unknown energy correlator function");
+    }
+    return std::unique_ptr<jet_observable>(
+        new energy_correlator_observable(name, ecf));
+  }
+  if (kind == "lund_declusterings") {
+    return std::unique_ptr<jet_observable>(new lund_observable(name));
+  }
+  if (kind == "area") {
+    return std::unique_ptr<jet_observable>(new area_observable());
+  }
+  if (kind == "nsubjettiness") {
+    auto routine = make_njettiness(
+        spec_option<std::string>(spec, "measure_definition",
+                                 "NormalizedMeasure"),
+        spec_option<std::string>(spec, "axes_definition", "OnePass_KT_Axes"),
+        spec_option<double>(spec, "beta", 1.0),
+        spec_option<double>(spec, "R0", 0.8),
+        spec_option<double>(spec, "Rcutoff", 999.0),
+        spec_option<int>(spec, "nPass", 999),
+        spec_option<double>(spec, "akAxesR0", 999.0));
+    auto njets = spec_option<std::vector<unsigned int>>(
+        spec, "njets", std::vector<unsigned int>{1, 2, 3, 4});
+    return std::unique_ptr<jet_observable>(
+        new nsubjettiness_observable(name, routine, njets));
+  }
+  throw std::invalid_argument("Unknown jet observable: " + kind);
+}
+
+// The observables requested in one call, filled batch after batch from the
+// same jets. One walk over the jets feeds every observable; the constituents
+// of a jet are gathered once and shared by all observables needing them.
+class jet_observable_set {
+public:
+  jet_observable_set(py::list observables, bool single_precision) {
+    for (auto spec : observables) {
+      requested_.push_back(
+          make_jet_observable(spec.cast<py::dict>(), single_precision));
+      with_constituents_ |= requested_.back()->needs_constituents();
+    }
+    event_offsets_.push_back(0);
+  }
+
+  // appends the jets of every event of ow; exclusive jets when n_jets > 0,
+  // inclusive jets above min_pt otherwise
+  void fill(const output_wrapper &ow, int n_jets, double min_pt) {
+    if (with_constituents_) {
+      ow.require_sequences("Observables of the jet constituents");
+    }
+    auto jets = n_jets > 0 ? ow.jets(jet_cache::exclusive_njets, n_jets)
+                           : ow.jets(jet_cache::inclusive, min_pt);
+    event_offsets_.values.reserve(event_offsets_.values.size() +
+                                  ow.cse.size());
+    std::vector<fj::PseudoJet> constituents;
+    for (std::size_t i = 0; i < ow.cse.size(); i++) {
+      for (auto &observable : requested_) {
+        observable->start_event(ow.input_positions_of(i));
+      }
+      for (const auto &jet : (*jets)[i]) {
+        if (with_constituents_) {
+          constituents = jet.constituents();
+        }
+        for (auto &observable : requested_) {
+          observable->fill(jet, constituents);
+        }
+        n_found_++;
+      }
+      event_offsets_.push_back(n_found_);
+    }
+  }
+
+  // dict of per-jet fields, and event offsets
+  py::tuple release() {
+    py::dict fields;
+    for (auto &observable : requested_) {
+      observable->release(fields);
+    }
+    return py::make_tuple(fields, event_offsets_.release());
+  }
+
+private:
+  std::vector<std::unique_ptr<jet_observable>> requested_;
+  bool with_constituents_ = false;
+  column<offset_t> event_offsets_;
+  offset_t n_found_ = 0;
+};
+
+// Clusters the events batch_size at a time and computes the requested
+// observables of each sub-batch before freeing its clusterings, so that the
+// resident histories and particle copies are bounded by the sub-batch
+// instead of growing with the number of input events.
+template <typename Real>
+py::tuple stream_jet_observables(
+    py::array_t<Real, py::array::c_style | py::array::forcecast> pxi,
+    py::array_t<Real, py::array::c_style | py::array::forcecast> pyi,
+    py::array_t<Real, py::array::c_style | py::array::forcecast> pzi,
+    py::array_t<Real, py::array::c_style | py::array::forcecast> Ei,
+    py::array_t<int64_t, py::array::c_style | py::array::forcecast> starts,
+    py::array_t<int64_t, py::array::c_style | py::array::forcecast> stops,
+    py::object jetdef, py::list observables, int n_jets = 0,
+    double min_pt = 0, int64_t batch_size = 1000, int n_threads = -1,
+    bool single_precision = false, const std::string &recombiner = "",
+    double recombiner_param = 1, py::object selector = py::none(),
+    py::dict cuts = py::dict(), py::object area_definition = py::none(),
+    uint64_t area_seed = 0) {
+  if (batch_size <= 0) {
+    throw std::invalid_argument("batch_size must be > 0");
+  }
+  py::buffer_info infostarts = starts.request();
+  auto startsptr = static_cast<int64_t *>(infostarts.ptr);
+  auto stopsptr = static_cast<int64_t *>(stops.request().ptr);
+  auto pxptr = static_cast<const Real *>(pxi.request().ptr);
+  auto pyptr = static_cast<const Real *>(pyi.request().ptr);
+  auto pzptr = static_cast<const Real *>(pzi.request().ptr);
+  auto Eptr = static_cast<const Real *>(Ei.request().ptr);
+  std::size_t n_events = infostarts.shape[0];
+  auto jet_def = with_recombiner(*swigtocpp<fj::JetDefinition *>(jetdef),
+                                 recombiner, recombiner_param);
+
+  particle_selection selection(selector, cuts);
+  area_clustering area(area_definition, area_seed);
+  jet_observable_set requested(observables, single_precision);
+  for (std::size_t first = 0; first < n_events; first += batch_size) {
+    std::size_t count = std::min<std::size_t>(batch_size, n_events - first);
+    output_wrapper ow;
+    cluster_events_into(ow, pxptr, pyptr, pzptr, Eptr, startsptr + first,
+                        stopsptr + first, count, &jet_def, n_threads, false,
+                        selection, area);
+    requested.fill(ow, n_jets, min_pt);
+  }
+  return requested.release();
+}
+
+PYBIND11_MODULE(_ext, m) {
+  using namespace fastjet;
+  // double first: without conversions float32 input only matches the float
+  // overload, while other dtypes are converted to double rather than float
+  m.def("interfacemulti", &interfacemulti<double>, "pxi"_a, "pyi"_a, "pzi"_a,
+        "Ei"_a, "starts"_a, "stops"_a, "jetdef"_a, "n_threads"_a = -1,
+        "single_precision"_a = false, "compact_history"_a = false,
+        "coordinates"_a = "cartesian", "recombiner"_a = "",
+        "recombiner_param"_a = 1, "selector"_a = py::none(),
+        "cuts"_a = py::dict(), "area_definition"_a = py::none(),
+        "area_seed"_a = 0, py::return_value_policy::take_ownership);
+  m.def("interfacemulti", &interfacemulti<float>, "pxi"_a, "pyi"_a, "pzi"_a,
+        "Ei"_a, "starts"_a, "stops"_a, "jetdef"_a, "n_threads"_a = -1,
+        "single_precision"_a = false, "compact_history"_a = false,
+        "coordinates"_a = "cartesian", "recombiner"_a = "",
+        "recombiner_param"_a = 1, "selector"_a = py::none(),
+        "cuts"_a = py::dict(), "area_definition"_a = py::none(),
+        "area_seed"_a = 0, py::return_value_policy::take_ownership);
+  const char *stream_jet_observables_doc = R"pbdoc(
+        Clusters a batch of events a few at a time, keeping only the requested per-jet observables.
         Args:
-          min_pt: Minimum jet pt to include. Default: 0.
+          pxi, pyi, pzi, Ei: Flat momentum columns of all particles.
+          starts, stops: Range of the particles of each event in these columns.
+          jetdef: JetDefinition.
+          observables: list of dicts, as for to_numpy_jet_observables.
+          n_jets: Number of exclusive jets; inclusive jets are used when <= 0. Default: 0.
+          min_pt: Minimum pt of the inclusive jets. Default: 0.
+          batch_size: Number of events clustered before their observables are extracted and their clusterings freed. Default: 1000.
+          n_threads: Number of threads; values < 0 select the process-wide default. Default: -1.
+          single_precision: Whether to return the jet four-momenta as float32. Default: False.
+          recombiner: Name of a compiled recombination scheme replacing that of jetdef: "wta_pt", "wta_E", "massless_E", "pt_weighted" or "generalized_wta". Default: "", keeping that of jetdef.
+          recombiner_param: delta of the "generalized_wta" scheme. Default: 1.
+          selector: Selector, applying particle by particle, that input particles must pass to be clustered. Default: None.
+          cuts: dict of pt_min, pt_max, abs_rap_min, abs_rap_max, E_min and E_max cuts on the input particles. Default: {}.
+          area_definition: AreaDefinition with which to measure the jet areas, for the "area" observable. Default: None.
+          area_seed: Seed from which the ghosts of every event are generated. Default: 0.
         Returns:
-          pt, eta, phi, m of inclusive jets.
+          dict of per-jet fields (arrays, or (offsets, values) tuples for lists per jet), and event offsets.
+      )pbdoc";
+  m.def("stream_jet_observables", &stream_jet_observables<double>, "pxi"_a,
+        "pyi"_a, "pzi"_a, "Ei"_a, "starts"_a, "stops"_a, "jetdef"_a,
+        "observables"_a, "n_jets"_a = 0, "min_pt"_a = 0,
+        "batch_size"_a = 1000, "n_threads"_a = -1,
+        "single_precision"_a = false, "recombiner"_a = "",
+        "recombiner_param"_a = 1, "selector"_a = py::none(),
+        "cuts"_a = py::dict(), "area_definition"_a = py::none(),
+        "area_seed"_a = 0, stream_jet_observables_doc);
+  m.def("stream_jet_observables", &stream_jet_observables<float>, "pxi"_a,
+        "pyi"_a, "pzi"_a, "Ei"_a, "starts"_a, "stops"_a, "jetdef"_a,
+        "observables"_a, "n_jets"_a = 0, "min_pt"_a = 0,
+        "batch_size"_a = 1000, "n_threads"_a = -1,
+        "single_precision"_a = false, "recombiner"_a = "",
+        "recombiner_param"_a = 1, "selector"_a = py::none(),
+        "cuts"_a = py::dict(), "area_definition"_a = py::none(),
+        "area_seed"_a = 0, stream_jet_observables_doc);
+  m.def("set_num_threads", &set_num_threads, "n_threads"_a, R"pbdoc(
+        Sets the process-wide default number of threads used to cluster events in the batch interface.
+        Args:
+          n_threads: Number of threads. Values <= 0 select all available cores.
+      )pbdoc");
+  m.def("get_num_threads", &get_num_threads, R"pbdoc(
+        Gets the process-wide default number of threads used by the batch interface.
+      )pbdoc");
+  m.def("set_strategy_table", &set_strategy_table, "table"_a, R"pbdoc(
+        Sets the multiplicity crossovers used to pick the clustering strategy of each event of a batch clustered with anti-kt and the Best strategy, or restores FastJet's own choice with None.
+        Args:
+          table: For each R, a list of (strategy, max_particles) pairs with increasing bounds; the last strategy has no bound.
+      )pbdoc");
+  m.def("get_strategy_table", &get_strategy_table, R"pbdoc(
+        Gets the multiplicity crossovers set with set_strategy_table, or None.
+      )pbdoc");
+  py::class_<batch_stats>(m, "BatchStats", R"pbdoc(
+        Wall time per phase of the batch interface and counts of what went through it, summed over every batch since the last reset.
+        The phases are extract_cons and correct_byteorder (reading the input columns), construct (building the input PseudoJets), cluster, jets (extracting jet lists), export (building the numpy outputs of a query) and assembly (building the awkward arrays from them). construct and cluster are summed over the threads of a batch.
       )pbdoc")
-      .def("to_numpy_exclusive_dmerge",
-      [](const output_wrapper ow, int njets = 0) {
-        auto css = ow.cse;
-        int64_t len = css.size();
-
-        auto parid = py::array(py::buffer_info(nullptr, sizeof(double), py::format_descriptor<double>::value, 1, {len}, {sizeof(double)}));
-        auto bufparid = parid.request();
-        double *ptrid = (double *)bufparid.ptr;
-
-        auto eventoffsets = py::array(py::buffer_info(nullptr, sizeof(int), py::format_descriptor<int>::value, 1, {len}, {sizeof(int)}));
-        auto bufeventoffsets = eventoffsets.request();
-        int *ptreventoffsets = (int *)bufeventoffsets.ptr;
-        size_t eventidx = 0;
-        size_t idxh = 0;
-        auto eventprev = 0;
-
-        for (unsigned int i = 0; i < css.size(); i++){
-        ptrid[idxh] = css[i]->exclusive_dmerge(njets);
-        idxh++;
-        ptreventoffsets[eventidx] = 1+eventprev;
-        eventprev = ptreventoffsets[eventidx];
-        eventidx++;
-          }
-        return std::make_tuple(
-            parid,
-            eventoffsets
-          );
-      }, "njets"_a = 0, R"pbdoc(
-        Retrieves the inclusive jets and converts them to numpy arrays.
+      .def_property("enabled", &batch_stats::enabled, &batch_stats::set_enabled,
+                    R"pbdoc(
+        Whether the phases and counts are recorded. Default: False.
+      )pbdoc")
+      .def("reset", &batch_stats::reset, R"pbdoc(
+        Sets every time and count back to zero.
+      )pbdoc")
+      .def("add_time",
+           [](batch_stats &stats, const std::string &phase, double seconds) {
+             stats.add_time(phase, seconds);
+           },
+           "phase"_a, "seconds"_a, R"pbdoc(
+        Adds the time of a phase measured outside of the extension, like the Python ones.
+      )pbdoc")
+      .def("_engine_seconds_on_thread",
+           [](const batch_stats &stats) {
+             return (stats.on_thread(batch_stats::jets) +
+                     stats.on_thread(batch_stats::export_columns)) *
+                    1e-9;
+           })
+      .def_property_readonly("seconds", &batch_stats::seconds, R"pbdoc(
+        Wall time of each phase, in seconds, as a dict.
+      )pbdoc")
+      .def_property_readonly("batches", &batch_stats::n_batches,
+                             "Number of batches clustered.")
+      .def_property_readonly("events", &batch_stats::n_events,
+                             "Number of events clustered.")
+      .def_property_readonly("particles", &batch_stats::n_particles,
+                             "Number of particles clustered.")
+      .def_property_readonly("jets", &batch_stats::n_jets,
+                             "Number of jets extracted by the queries.")
+      .def_property_readonly(
+          "bytes", &batch_stats::n_bytes,
+          "Bytes allocated for the input particles and the numpy outputs.")
+      .def("to_dict",
+           [](const batch_stats &stats) {
+             py::dict out;
+             out["seconds"] = stats.seconds();
+             out["batches"] = stats.n_batches();
+             out["events"] = stats.n_events();
+             out["particles"] = stats.n_particles();
+             out["jets"] = stats.n_jets();
+             out["bytes"] = stats.n_bytes();
+             return out;
+           },
+           R"pbdoc(
+        All the times and counts as a dict.
+      )pbdoc");
+  m.def(
+      "batch_stats", []() -> batch_stats & { return batch_stats::instance(); },
+      py::return_value_policy::reference, R"pbdoc(
+        Gets the process-wide instrumentation of the batch interface, a BatchStats.
+      )pbdoc");
+
+  /// Jet algorithm definitions
+
+  py::class_<output_wrapper> output_wrapper_class(m, "output_wrapper");
+  // every query times the building of its output columns
+  const auto timed = py::call_guard<timed_export>();
+  output_wrapper_class
+    .def_property("cse", &output_wrapper::getCluster,&output_wrapper::setCluster)
+    .def("clear_cache",
+      [](const output_wrapper &ow) {
+        ow.cache->clear();
+      }, R"pbdoc(
+        Drops the jet lists memoized by previous queries on this batch.
         Args:
-          min_pt: Minimum jet pt to include. Default: 0.
+          None.
         Returns:
-          pt, eta, phi, m of inclusive jets.
+          None.
       )pbdoc")
-      .def("to_numpy_exclusive_dmerge_max",
-      [](const output_wrapper ow, int njets = 0) {
-        auto css = ow.cse;
-        auto len = css.size();
-
-        auto parid = py::array(py::buffer_info(nullptr, sizeof(double), py::format_descriptor<double>::value, 1, {len}, {sizeof(double)}));
-        auto bufparid = parid.request();
-        double *ptrid = (double *)bufparid.ptr;
-
-        auto eventoffsets = py::array(py::buffer_info(nullptr, sizeof(int), py::format_descriptor<int>::value, 1, {len}, {sizeof(int)}));
-        auto bufeventoffsets = eventoffsets.request();
-        int *ptreventoffsets = (int *)bufeventoffsets.ptr;
-        size_t eventidx = 0;
-        size_t idxh = 0;
-        auto eventprev = 0;
-
-        for (unsigned int i = 0; i < css.size(); i++){
-        ptrid[idxh] = css[i]->exclusive_dmerge_max(njets);
-        idxh++;
-        ptreventoffsets[eventidx] = 1+eventprev;
-        eventprev = ptreventoffsets[eventidx];
-        eventidx++;
-          }
-        return std::make_tuple(
-            parid,
-            eventoffsets
-          );
-      }, "njets"_a = 0, R"pbdoc(
-        Retrieves the inclusive jets and converts them to numpy arrays.
+    .def("cache_size",
+      [](const output_wrapper &ow) {
+        return ow.cache->size();
+      }, R"pbdoc(
+        Counts the jet lists memoized by previous queries on this batch; at most the eight most recently used are kept.
         Args:
-          min_pt: Minimum jet pt to include. Default: 0.
+          None.
         Returns:
-          pt, eta, phi, m of inclusive jets.
+          The number of memoized jet lists.
       )pbdoc")
-      .def("to_numpy_exclusive_ymerge_max",
-      [](const output_wrapper ow, int njets = 0) {
-        auto css = ow.cse;
-        auto len = css.size();
-
-        auto parid = py::array(py::buffer_info(nullptr, sizeof(double), py::format_descriptor<double>::value, 1, {len}, {sizeof(double)}));
-        auto bufparid = parid.request();
-        double *ptrid = (double *)bufparid.ptr;
-
-        auto eventoffsets = py::array(py::buffer_info(nullptr, sizeof(int), py::format_descriptor<int>::value, 1, {len}, {sizeof(int)}));
-        auto bufeventoffsets = eventoffsets.request();
-        int *ptreventoffsets = (int *)bufeventoffsets.ptr;
-        size_t eventidx = 0;
-        size_t idxh = 0;
-        auto eventprev = 0;
-
-        for (unsigned int i = 0; i < css.size(); i++){
-        ptrid[idxh] = css[i]->exclusive_ymerge_max(njets);
-        idxh++;
-        ptreventoffsets[eventidx] = 1+eventprev;
-        eventprev = ptreventoffsets[eventidx];
-        eventidx++;
-          }
-        return std::make_tuple(
-            parid,
-            eventoffsets
-          );
-      }, "njets"_a = 0, R"pbdoc(
-        Retrieves the inclusive jets and converts them to numpy arrays.
+    .def("serialize", &serialized::serialize, R"pbdoc(
+        Serializes the clustering of the batch, its input particles and merge history, into one buffer.
         Args:
-          min_pt: Minimum jet pt to include. Default: 0.
+          None.
         Returns:
-          pt, eta, phi, m of inclusive jets.
+          A uint8 numpy array, which output_wrapper.deserialize restores without clustering again.
       )pbdoc")
-      .def("to_numpy_exclusive_ymerge",
-      [](const output_wrapper ow, int njets = 0) {
-        auto css = ow.cse;
-        auto len = css.size();
-
-        auto parid = py::array(py::buffer_info(nullptr, sizeof(double), py::format_descriptor<double>::value, 1, {len}, {sizeof(double)}));
-        auto bufparid = parid.request();
-        double *ptrid = (double *)bufparid.ptr;
-
-        auto eventoffsets = py::array(py::buffer_info(nullptr, sizeof(int), py::format_descriptor<int>::value, 1, {len}, {sizeof(int)}));
-        auto bufeventoffsets = eventoffsets.request();
-        int *ptreventoffsets = (int *)bufeventoffsets.ptr;
-        size_t eventidx = 0;
-        size_t idxh = 0;
-        auto eventprev = 0;
-
-        for (unsigned int i = 0; i < css.size(); i++){
-        ptrid[idxh] = css[i]->exclusive_ymerge(njets);
-        idxh++;
-        ptreventoffsets[eventidx] = 1+eventprev;
-        eventprev = ptreventoffsets[eventidx];
-        eventidx++;
-          }
-        return std::make_tuple(
-            parid,
-            eventoffsets
-          );
-      }, "njets"_a = 0, R"pbdoc(
-        Retrieves the inclusive jets and converts them to numpy arrays.
+    .def_static("deserialize", &serialized::deserialize, "buffer"_a,
+                "n_threads"_a = -1, R"pbdoc(
+        Restores a batch from the buffer made by serialize, replaying the recorded merge history of every event.
         Args:
-          min_pt: Minimum jet pt to include. Default: 0.
+          buffer: Any object exporting the serialized bytes through the buffer protocol.
+          n_threads: Number of threads restoring events concurrently. Default: -1.
         Returns:
-          pt, eta, phi, m of inclusive jets.
+          The restored output_wrapper.
       )pbdoc")
-      .def("to_numpy_q",
-      [](const output_wrapper ow) {
-        auto css = ow.cse;
-        auto len = css.size();
-
-        auto parid = py::array(py::buffer_info(nullptr, sizeof(double), py::format_descriptor<double>::value, 1, {len}, {sizeof(double)}));
-        auto bufparid = parid.request();
-        double *ptrid = (double *)bufparid.ptr;
-
-        auto eventoffsets = py::array(py::buffer_info(nullptr, sizeof(int), py::format_descriptor<int>::value, 1, {len}, {sizeof(int)}));
-        auto bufeventoffsets = eventoffsets.request();
-        int *ptreventoffsets = (int *)bufeventoffsets.ptr;
-        size_t eventidx = 0;
-        size_t idxh = 0;
-        auto eventprev = 0;
-
-        for (unsigned int i = 0; i < css.size(); i++){
-        ptrid[idxh] = css[i]->Q();
-        idxh++;
-        ptreventoffsets[eventidx] = 1+eventprev;
-        eventprev = ptreventoffsets[eventidx];
-        eventidx++;
-          }
-        return std::make_tuple(
-            parid,
-            eventoffsets
-          );
-      }, R"pbdoc(
-        Retrieves the inclusive jets and converts them to numpy arrays.
+    .def(py::pickle(
+      [](const output_wrapper &ow) {
+        return py::make_tuple(serialized::serialize(ow));
+      },
+      [](py::tuple state) {
+        if (state.size() != 1) {
+          throw std::runtime_error("Invalid output_wrapper state");
+        }
+        return serialized::deserialize(state[0].cast<py::buffer>(), -1);
+      }))
+    .def("to_numpy",
+      [](const output_wrapper &ow, double min_pt = 0) {
+        auto jets = ow.jets(jet_cache::inclusive, min_pt);
+        return export_momenta(ow, [&](std::size_t i) -> const std::vector<fj::PseudoJet> & {
+          return (*jets)[i];
+        });
+      }, "min_pt"_a = 0, timed, R"pbdoc(
+        Retrieves the inclusive jets from multievent clustering and converts them to numpy arrays.
         Args:
           min_pt: Minimum jet pt to include. Default: 0.
         Returns:
           pt, eta, phi, m of inclusive jets.
       )pbdoc")
-      .def("to_numpy_q2",
-      [](const output_wrapper ow) {
-        auto css = ow.cse;
-        auto len = css.size();
-
-        auto parid = py::array(py::buffer_info(nullptr, sizeof(double), py::format_descriptor<double>::value, 1, {len}, {sizeof(double)}));
-        auto bufparid = parid.request();
-        double *ptrid = (double *)bufparid.ptr;
-
-        auto eventoffsets = py::array(py::buffer_info(nullptr, sizeof(int), py::format_descriptor<int>::value, 1, {len}, {sizeof(int)}));
-        auto bufeventoffsets = eventoffsets.request();
-        int *ptreventoffsets = (int *)bufeventoffsets.ptr;
-        size_t eventidx = 0;
-        size_t idxh = 0;
-        auto eventprev = 0;
-
-        for (unsigned int i = 0; i < css.size(); i++){
-        ptrid[idxh] = css[i]->Q2();
-        idxh++;
-        ptreventoffsets[eventidx] = 1+eventprev;
-        eventprev = ptreventoffsets[eventidx];
-        eventidx++;
-          }
-        return std::make_tuple(
-            parid,
-            eventoffsets
-          );
-      }, R"pbdoc(
+      .def("to_numpy_with_constituents",
+      [](const output_wrapper &ow, double min_pt = 0) {
+        auto jets = ow.jets(jet_cache::inclusive, min_pt);
+        return export_nested_columns(ow.cse.size(), [&](std::size_t i) {
+          return ow.visit(i, [&](const auto &cs) {
+            return constituent_indices(cs, (*jets)[i],
+                                       ow.input_positions_of(i));
+          });
+        }, extract::value);
+      }, "min_pt"_a = 0, timed, R"pbdoc(
         Retrieves the inclusive jets and converts them to numpy arrays.
         Args:
           min_pt: Minimum jet pt to include. Default: 0.
         Returns:
           pt, eta, phi, m of inclusive jets.
       )pbdoc")
-      .def("to_numpy_exclusive_subjets_dcut",
-      [](
-          const output_wrapper ow,
-          py::array_t<double, py::array::c_style | py::array::forcecast> pxi,
-          py::array_t<double, py::array::c_style | py::array::forcecast> pyi,
-          py::array_t<double, py::array::c_style | py::array::forcecast> pzi,
-          py::array_t<double, py::array::c_style | py::array::forcecast> Ei,
-          double dcut = 0
-        ) {
-        py::buffer_info infopx = pxi.request();
-        py::buffer_info infopy = pyi.request();  // requesting buffer information of the input
-        py::buffer_info infopz = pzi.request();
-        py::buffer_info infoE = Ei.request();
-
-        auto pxptr = static_cast<double *>(infopx.ptr);
-        auto pyptr = static_cast<double *>(infopy.ptr);  // pointer to the initial value
-        auto pzptr = static_cast<double *>(infopz.ptr);
-        auto Eptr = static_cast<double *>(infoE.ptr);
-
-        int dimpx = infopx.shape[0];
-        auto css = ow.cse;
-        int64_t len = css.size();
-        // Don't specify the size if using push_back.
-
-        std::vector<fj::PseudoJet> particles;
-        particles.reserve(dimpx);
-        for(int j = 0; j < dimpx; j++ ){
-          particles.push_back(fj::PseudoJet(*pxptr, *pyptr, *pzptr, *Eptr));
-          pxptr++;
-          pyptr++;
-          pzptr++;
-          Eptr++;
-          }
-        std::vector<int> indices;
-        indices.reserve(len);
-        for(unsigned int i = 0 ; i < len; i++){
-          std::unordered_map<double, int> umap;
-          auto jets = ow.cse[i]->inclusive_jets();
-          for(unsigned int j = 0 ; j < jets.size(); j++){
-            umap.insert({jets[j].rap(),j});
-          }
-          auto got = umap.find(particles[i].rap());
-          if (got == umap.end()){
-              throw "Jet Not in this ClusterSequence";
-          }
-          if(got == umap.end()){
-          }
-          indices.push_back(got->second);
-        }
-        auto jk = 0;
-        for(int i = 0; i < len; i++){
-        auto jets = ow.cse[i]->inclusive_jets();
-        jk += css[i]->exclusive_subjets(jets[indices[i]],dcut).size();
-        }
-        auto px = py::array(py::buffer_info(nullptr, sizeof(double), py::format_descriptor<double>::value, 1, {jk}, {sizeof(double)}));
-        auto bufpx = px.request();
-        double *ptrpx = (double *)bufpx.ptr;
-
-        auto py = py::array(py::buffer_info(nullptr, sizeof(double), py::format_descriptor<double>::value, 1, {jk}, {sizeof(double)}));
-        auto bufpy = py.request();
-        double *ptrpy = (double *)bufpy.ptr;
-
-        auto pz = py::array(py::buffer_info(nullptr, sizeof(double), py::format_descriptor<double>::value, 1, {jk}, {sizeof(double)}));
-        auto bufpz = pz.request();
-        double *ptrpz = (double *)bufpz.ptr;
-
-        auto E = py::array(py::buffer_info(nullptr, sizeof(double), py::format_descriptor<double>::value, 1, {jk}, {sizeof(double)}));
-        auto bufE = E.request();
-        double *ptrE = (double *)bufE.ptr;
-
-        auto off = py::array(py::buffer_info(nullptr, sizeof(int), py::format_descriptor<int>::value, 1, {len+1}, {sizeof(int)}));
-        auto bufoff = off.request();
-        int *ptroff = (int *)bufoff.ptr;
-
-        size_t idxe = 0;
-        *ptroff = 0;
-        ptroff++;
-        for(int i = 0; i < len; i++){
-        auto incjets = ow.cse[i]->inclusive_jets();
-        auto jets = css[i]->exclusive_subjets(incjets[indices[i]],dcut);
-        for (unsigned int j = 0; j < jets.size(); j++)
-        {
-          ptrpx[idxe] = jets[j].px();
-          ptrpy[idxe] = jets[j].py();
-          ptrpz[idxe] = jets[j].pz();
-          ptrE[idxe] = jets[j].E();
-          idxe++;
-        }
-        *ptroff = jets.size()+*(ptroff-1);
-        ptroff++;
-        }
-        return std::make_tuple(
-            px,
-            py,
-            pz,
-            E,
-            off
-          );
-      }, R"pbdoc(
-        Retrieves the exclusive subjets.
+      .def("to_numpy_background",
+      [](const output_wrapper &ow, py::dict options, int n_threads = -1) {
+        ow.require_sequences("Background estimation");
+        background_estimation estimation(options);
+        std::vector<background_values> values(ow.cse.size());
+        estimation.for_each_event(
+            values.size(), n_threads, [&](std::size_t begin, std::size_t end) {
+              for (std::size_t i = begin; i < end; i++) {
+                auto estimator =
+                    estimation.estimate(i, event_scratch(*ow.parts, i));
+                values[i] = estimation.values(*estimator);
+              }
+            });
+        return export_columns(values.size(), [&](std::size_t i) {
+          return std::array<background_values, 1>{{values[i]}};
+        }, [](const background_values &v) { return v.rho; },
+           [](const background_values &v) { return v.sigma; },
+           [](const background_values &v) { return v.rho_m; },
+           [](const background_values &v) { return v.sigma_m; });
+      }, "options"_a, "n_threads"_a = -1, timed, R"pbdoc(
+        Estimates the background density of every event from its input particles.
         Args:
-          min_pt: Minimum jet pt to include. Default: 0.
+          options: The estimator ("grid" or "jet_median") and its settings.
+          n_threads: Number of threads estimating events concurrently. Default: -1.
         Returns:
-          pt, eta, phi, m of inclusive jets.
+          rho, sigma, rho_m, sigma_m (zero unless rho_m is requested) and event offsets.
       )pbdoc")
-      .def("to_numpy_exclusive_subjets_nsub",
-      [](
-          const output_wrapper ow,
-          py::array_t<double, py::array::c_style | py::array::forcecast> pxi,
-          py::array_t<double, py::array::c_style | py::array::forcecast> pyi,
-          py::array_t<double, py::array::c_style | py::array::forcecast> pzi,
-          py::array_t<double, py::array::c_style | py::array::forcecast> Ei,
-          int nsub = 0
-        ) {
-        py::buffer_info infopx = pxi.request();
-        py::buffer_info infopy = pyi.request();  // requesting buffer information of the input
-        py::buffer_info infopz = pzi.request();
-        py::buffer_info infoE = Ei.request();
-
-        auto pxptr = static_cast<double *>(infopx.ptr);
-        auto pyptr = static_cast<double *>(infopy.ptr);  // pointer to the initial value
-        auto pzptr = static_cast<double *>(infopz.ptr);
-        auto Eptr = static_cast<double *>(infoE.ptr);
-
-        int dimpx = infopx.shape[0];
-        auto css = ow.cse;
-        int64_t len = css.size();
-        // Don't specify the size if using push_back.
-
-        std::vector<fj::PseudoJet> particles;
-        for(int j = 0; j < dimpx; j++ ){
-          particles.push_back(fj::PseudoJet(*pxptr, *pyptr, *pzptr, *Eptr));
-          pxptr++;
-          pyptr++;
-          pzptr++;
-          Eptr++;
-          }
-        std::vector<int> indices;
-        indices.reserve(len);
-        for(unsigned int i = 0 ; i < len; i++){
-          std::unordered_map<double, int> umap;
-          auto jets = ow.cse[i]->inclusive_jets();
-          for(unsigned int j = 0 ; j < jets.size(); j++){
-            umap.insert({jets[j].rap(),j});
-          }
-          auto got = umap.find(particles[i].rap());
-          if (got == umap.end()){
-              throw "Jet Not in this ClusterSequence";
-          }
-          if(got == umap.end()){
-          }
-          indices.push_back(got->second);
+      .def("to_numpy_subtracted_jets",
+      [](const output_wrapper &ow, py::dict options, double min_pt = 0,
+         int n_threads = -1) {
+        ow.require_sequences("Background subtraction");
+        if (!ow.with_area) {
+          throw std::invalid_argument(
+              "Background subtraction needs jet areas; cluster with an "
+              "area_definition");
         }
-        auto jk = 0;
-        for(int i = 0; i < len; i++){
-        auto jets = ow.cse[i]->inclusive_jets();
-        jk += css[i]->exclusive_subjets(jets[indices[i]],nsub).size();
-        }
-        auto px = py::array(py::buffer_info(nullptr, sizeof(double), py::format_descriptor<double>::value, 1, {jk}, {sizeof(double)}));
-        auto bufpx = px.request();
-        double *ptrpx = (double *)bufpx.ptr;
-
-        auto py = py::array(py::buffer_info(nullptr, sizeof(double), py::format_descriptor<double>::value, 1, {jk}, {sizeof(double)}));
-        auto bufpy = py.request();
-        double *ptrpy = (double *)bufpy.ptr;
-
-        auto pz = py::array(py::buffer_info(nullptr, sizeof(double), py::format_descriptor<double>::value, 1, {jk}, {sizeof(double)}));
-        auto bufpz = pz.request();
-        double *ptrpz = (double *)bufpz.ptr;
-
-        auto E = py::array(py::buffer_info(nullptr, sizeof(double), py::format_descriptor<double>::value, 1, {jk}, {sizeof(double)}));
-        auto bufE = E.request();
-        double *ptrE = (double *)bufE.ptr;
-
-        auto off = py::array(py::buffer_info(nullptr, sizeof(int), py::format_descriptor<int>::value, 1, {len+1}, {sizeof(int)}));
-        auto bufoff = off.request();
-        int *ptroff = (int *)bufoff.ptr;
-
-        size_t idxe = 0;
-        *ptroff = 0;
-        ptroff++;
-        for(int i = 0; i < len; i++){
-        auto incjets = ow.cse[i]->inclusive_jets();
-        auto jets = css[i]->exclusive_subjets(incjets[indices[i]],nsub);
-        for (unsigned int j = 0; j < jets.size(); j++)
-        {
-          ptrpx[idxe] = jets[j].px();
-          ptrpy[idxe] = jets[j].py();
-          ptrpz[idxe] = jets[j].pz();
-          ptrE[idxe] = jets[j].E();
-          idxe++;
-        }
-        *ptroff = jets.size()+*(ptroff-1);
-        ptroff++;
-        }
-        return std::make_tuple(
-            px,
-            py,
-            pz,
-            E,
-            off
-          );
-      }, R"pbdoc(
-        Retrieves the exclusive subjets.
+        background_estimation estimation(options);
+        auto jets = ow.jets(jet_cache::inclusive, 0);
+        std::vector<std::vector<fj::PseudoJet>> subtracted(ow.cse.size());
+        estimation.for_each_event(
+            subtracted.size(), n_threads,
+            [&](std::size_t begin, std::size_t end) {
+              for (std::size_t i = begin; i < end; i++) {
+                auto estimator =
+                    estimation.estimate(i, event_scratch(*ow.parts, i));
+                fj::Subtractor subtractor(estimator.get());
+                subtractor.set_use_rho_m(estimation.computes_rho_m());
+                for (const auto &jet : (*jets)[i]) {
+                  fj::PseudoJet s = subtractor(jet);
+                  if (s.pt2() >= min_pt * min_pt) {
+                    subtracted[i].push_back(s);
+                  }
+                }
+              }
+            });
+        return export_momenta(ow, [&](std::size_t i) -> const std::vector<fj::PseudoJet> & {
+          return subtracted[i];
+        });
+      }, "options"_a, "min_pt"_a = 0, "n_threads"_a = -1, timed, R"pbdoc(
+        Subtracts the background of every event from its inclusive jets, with the estimator set up as for to_numpy_background.
+        Args:
+          options: The estimator ("grid" or "jet_median") and its settings; with rho_m, the jet masses are corrected as well.
+          min_pt: Minimum subtracted jet pt to include. Default: 0.
+          n_threads: Number of threads processing events concurrently. Default: -1.
+        Returns:
+          The four-momentum and area columns of the subtracted jets, and event offsets.
+      )pbdoc")
+      .def("to_numpy_exclusive_njet",
+      [](const output_wrapper &ow, const int n_jets = 0) {
+        auto jets = ow.jets(jet_cache::exclusive_njets, n_jets);
+        return export_momenta(ow, [&](std::size_t i) -> const std::vector<fj::PseudoJet> & {
+          return (*jets)[i];
+        });
+      }, "n_jets"_a = 0, timed, R"pbdoc(
+        Retrieves the exclusive n jets from multievent clustering and converts them to numpy arrays.
+        Args:
+          n_jets: Number of exclusive jets. Default: 0.
+        Returns:
+          pt, eta, phi, m of exclusive jets.
+      )pbdoc")
+      .def("to_numpy_exclusive_njet_up_to",
+      [](const output_wrapper &ow, const int n_jets = 0) {
+        auto jets = ow.jets(jet_cache::exclusive_up_to, n_jets);
+        return export_momenta(ow, [&](std::size_t i) -> const std::vector<fj::PseudoJet> & {
+          return (*jets)[i];
+        });
+      }, "n_jets"_a = 0, timed, R"pbdoc(
+        Retrieves the exclusive jets up to n jets from multievent clustering and converts them to numpy arrays.
+        Args:
+          n_jets: Number of exclusive jets. Default: 0.
+        Returns:
+          pt, eta, phi, m of exclusive jets.
+      )pbdoc")
+      .def("to_numpy_exclusive_njet_with_constituents",
+      [](const output_wrapper &ow, const int n_jets = 0) {
+        auto jets = ow.jets(jet_cache::exclusive_njets, n_jets);
+        return export_nested_columns(ow.cse.size(), [&](std::size_t i) {
+          return ow.visit(i, [&](const auto &cs) {
+            return constituent_indices(cs, (*jets)[i],
+                                       ow.input_positions_of(i));
+          });
+        }, extract::value);
+      }, "n_jets"_a = 0, timed, R"pbdoc(
+        Retrieves the constituents of n exclusive jets from multievent clustering and converts them to numpy arrays.
+        Args:
+          n_jets: Number of exclusive subjets. Default: 0.
+        Returns:
+          jet offsets, particle indices, and event offsets
+      )pbdoc")
+      .def("to_numpy_exclusive_dcut",
+      [](const output_wrapper &ow, const double dcut = 100) {
+        auto jets = ow.jets(jet_cache::exclusive_dcut, dcut);
+        return export_momenta(ow, [&](std::size_t i) -> const std::vector<fj::PseudoJet> & {
+          return (*jets)[i];
+        });
+      }, "dcut"_a = 100, timed, R"pbdoc(
+        Retrieves the exclusive jets upto the given dcut from multievent clustering and converts them to numpy arrays.
         Args:
           min_pt: Minimum jet pt to include. Default: 0.
         Returns:
           pt, eta, phi, m of inclusive jets.
       )pbdoc")
-      .def("to_numpy_exclusive_subjets_up_to",
-      [](
-          const output_wrapper ow,
-          py::array_t<double, py::array::c_style | py::array::forcecast> pxi,
-          py::array_t<double, py::array::c_style | py::array::forcecast> pyi,
-          py::array_t<double, py::array::c_style | py::array::forcecast> pzi,
-          py::array_t<double, py::array::c_style | py::array::forcecast> Ei,
-          int nsub = 0
-        ) {
-        py::buffer_info infopx = pxi.request();
-        py::buffer_info infopy = pyi.request();  // requesting buffer information of the input
-        py::buffer_info infopz = pzi.request();
-        py::buffer_info infoE = Ei.request();
-
-        auto pxptr = static_cast<double *>(infopx.ptr);
-        auto pyptr = static_cast<double *>(infopy.ptr);  // pointer to the initial value
-        auto pzptr = static_cast<double *>(infopz.ptr);
-        auto Eptr = static_cast<double *>(infoE.ptr);
-
-        int dimpx = infopx.shape[0];
-        auto css = ow.cse;
-        int64_t len = css.size();
-        // Don't specify the size if using push_back.
-
-        std::vector<fj::PseudoJet> particles;
-        particles.reserve(dimpx);
-        for(int j = 0; j < dimpx; j++ ){
-          particles.push_back(fj::PseudoJet(*pxptr, *pyptr, *pzptr, *Eptr));
-          pxptr++;
-          pyptr++;
-          pzptr++;
-          Eptr++;
-          }
-        std::vector<int> indices;
-        indices.reserve(len);
-        for(unsigned int i = 0 ; i < len; i++){
-          std::unordered_map<double, int> umap;
-          auto jets = ow.cse[i]->inclusive_jets();
-          for(unsigned int j = 0 ; j < jets.size(); j++){
-            umap.insert({jets[j].rap(),j});
-          }
-          auto got = umap.find(particles[i].rap());
-          if (got == umap.end()){
-              throw "Jet Not in this ClusterSequence";
-          }
-          if(got == umap.end()){
-          }
-          indices.push_back(got->second);
-        }
-        auto jk = 0;
-        for(int i = 0; i < len; i++){
-        auto jets = ow.cse[i]->inclusive_jets();
-        jk += css[i]->exclusive_subjets_up_to(jets[indices[i]],nsub).size();
-        }
-        auto px = py::array(py::buffer_info(nullptr, sizeof(double), py::format_descriptor<double>::value, 1, {jk}, {sizeof(double)}));
-        auto bufpx = px.request();
-        double *ptrpx = (double *)bufpx.ptr;
-
-        auto py = py::array(py::buffer_info(nullptr, sizeof(double), py::format_descriptor<double>::value, 1, {jk}, {sizeof(double)}));
-        auto bufpy = py.request();
-        double *ptrpy = (double *)bufpy.ptr;
-
-        auto pz = py::array(py::buffer_info(nullptr, sizeof(double), py::format_descriptor<double>::value, 1, {jk}, {sizeof(double)}));
-        auto bufpz = pz.request();
-        double *ptrpz = (double *)bufpz.ptr;
-
-        auto E = py::array(py::buffer_info(nullptr, sizeof(double), py::format_descriptor<double>::value, 1, {jk}, {sizeof(double)}));
-        auto bufE = E.request();
-        double *ptrE = (double *)bufE.ptr;
-
-        auto off = py::array(py::buffer_info(nullptr, sizeof(int), py::format_descriptor<int>::value, 1, {len+1}, {sizeof(int)}));
-        auto bufoff = off.request();
-        int *ptroff = (int *)bufoff.ptr;
-
-        size_t idxe = 0;
-        *ptroff = 0;
-        ptroff++;
-        for(int i = 0; i < len; i++){
-        auto incjets = ow.cse[i]->inclusive_jets();
-        auto jets = css[i]->exclusive_subjets_up_to(incjets[indices[i]],nsub);
-        for (unsigned int j = 0; j < jets.size(); j++)
-        {
-          ptrpx[idxe] = jets[j].px();
-          ptrpy[idxe] = jets[j].py();
-          ptrpz[idxe] = jets[j].pz();
-          ptrE[idxe] = jets[j].E();
-          idxe++;
-        }
-        *ptroff = jets.size()+ *(ptroff-1);
-        ptroff++;
-        }
-        return std::make_tuple(
-            px,
-            py,
-            pz,
-            E,
-            off
-          );
-      }, R"pbdoc(
-        Retrieves the exclusive subjets.
+      .def("to_numpy_exclusive_ycut",
+      [](const output_wrapper &ow, const double ycut = 100) {
+        auto jets = ow.jets(jet_cache::exclusive_ycut, ycut);
+        return export_momenta(ow, [&](std::size_t i) -> const std::vector<fj::PseudoJet> & {
+          return (*jets)[i];
+        });
+      }, "dcut"_a = 100, timed, R"pbdoc(
+        Retrieves the exclusive jets upto the given dcut from multievent clustering and converts them to numpy arrays.
         Args:
           min_pt: Minimum jet pt to include. Default: 0.
         Returns:
           pt, eta, phi, m of inclusive jets.
       )pbdoc")
-      .def("to_numpy_exclusive_subdmerge",
-      [](
-          const output_wrapper ow,
-          py::array_t<double, py::array::c_style | py::array::forcecast> pxi,
-          py::array_t<double, py::array::c_style | py::array::forcecast> pyi,
-          py::array_t<double, py::array::c_style | py::array::forcecast> pzi,
-          py::array_t<double, py::array::c_style | py::array::forcecast> Ei,
-          int nsub = 0
-        ) {
-        py::buffer_info infopx = pxi.request();
-        py::buffer_info infopy = pyi.request();  // requesting buffer information of the input
-        py::buffer_info infopz = pzi.request();
-        py::buffer_info infoE = Ei.request();
-
-        auto pxptr = static_cast<double *>(infopx.ptr);
-        auto pyptr = static_cast<double *>(infopy.ptr);  // pointer to the initial value
-        auto pzptr = static_cast<double *>(infopz.ptr);
-        auto Eptr = static_cast<double *>(infoE.ptr);
-
-        int dimpx = infopx.shape[0];
-        int dimpy = infopy.shape[0];
-        auto css = ow.cse;
-        int64_t len = css.size();
-        // Don't specify the size if using push_back.
-
-        std::vector<fj::PseudoJet> particles;
-        particles.reserve(dimpx);
-        for(int j = 0; j < dimpx; j++ ){
-          particles.push_back(fj::PseudoJet(*pxptr, *pyptr, *pzptr, *Eptr));
-          pxptr++;
-          pyptr++;
-          pzptr++;
-          Eptr++;
-          }
-        std::vector<int> indices;
-        indices.reserve(len);
-        for(unsigned int i = 0 ; i < len; i++){
-          std::unordered_map<double, int> umap;
-          auto jets = ow.cse[i]->inclusive_jets();
-          for(unsigned int j = 0 ; j < jets.size(); j++){
-            umap.insert({jets[j].rap(),j});
-          }
-          auto got = umap.find(particles[i].rap());
-          if (got == umap.end()){
-              throw "Jet Not in this ClusterSequence";
-          }
-          if(got == umap.end()){
-          }
-          indices.push_back(got->second);
-        }
-        auto out_value = py::array(py::buffer_info(nullptr, sizeof(double), py::format_descriptor<double>::value, 1, {dimpy}, {sizeof(double)}));
-        auto bufpx = out_value.request();
-        double *ptrpx = (double *)bufpx.ptr;
-
-        auto off = py::array(py::buffer_info(nullptr, sizeof(int), py::format_descriptor<int>::value, 1, {len+1}, {sizeof(int)}));
-        auto bufoff = off.request();
-        int *ptroff = (int *)bufoff.ptr;
-
-        size_t idxe = 0;
-        *ptroff = 0;
-        ptroff++;
-        for(int i = 0; i < len; i++){
-        auto incjets = ow.cse[i]->inclusive_jets();
-        auto value = css[i]->exclusive_subdmerge(incjets[indices[i]],nsub);
-        ptrpx[idxe] = value;
-        idxe++;
-        *ptroff = 1+ *(ptroff-1);
-        ptroff++;
+      .def("to_numpy_exclusive_jets_multi",
+      [](const output_wrapper &ow, const std::vector<double> &params, const std::string &by) {
+        jet_cache::query q;
+        if (by == "njets") {
+          q = jet_cache::exclusive_njets;
+        } else if (by == "dcut") {
+          q = jet_cache::exclusive_dcut;
+        } else if (by == "ycut") {
+          q = jet_cache::exclusive_ycut;
+        } else {
+          throw std::invalid_argument("Exclusive jets are chosen by njets, dcut or ycut, not " + by);
         }
-        return std::make_tuple(
-            out_value,
-            off
-          );
-      }, R"pbdoc(
-        Retrieves the exclusive subjets.
+        return export_nested_momenta(ow, [&](std::size_t i) {
+          return ow.visit(i, [&](const auto &cs) {
+            return exclusive_jets_multi(cs, q, params);
+          });
+        });
+      }, "params"_a, "by"_a = "njets", timed, R"pbdoc(
+        Retrieves the exclusive jets for several numbers of jets, or several dcut or ycut values, undoing the clusterings of each event once for all of them.
+        Args:
+          params: Numbers of jets, or dcut or ycut values.
+          by: What params are: "njets", "dcut" or "ycut". Default: "njets".
+        Returns:
+          configuration offsets, px, py, pz, E, cluster_hist_index of the jets, and event offsets.
+      )pbdoc")
+      .def("to_numpy_exclusive_dmerge_spectrum",
+      [](const output_wrapper &ow, bool ymerge = false) {
+        typedef std::pair<double, double> merging;
+        return export_columns(ow.cse.size(), [&](std::size_t i) {
+          return ow.visit(i, [&](const auto &cs) {
+            int n = static_cast<int>(cs.n_particles());
+            double norm = ymerge ? cs.Q2() : 1.0;
+            std::vector<merging> spectrum;
+            spectrum.reserve(n);
+            for (int njets = 0; njets < n; njets++) {
+              spectrum.emplace_back(cs.exclusive_dmerge(njets) / norm,
+                                    cs.exclusive_dmerge_max(njets) / norm);
+            }
+            return spectrum;
+          });
+        }, [](const merging &m) { return m.first; },
+           [](const merging &m) { return m.second; });
+      }, "ymerge"_a = false, timed, R"pbdoc(
+        Retrieves, for every number of jets n below the number of particles, the distance of the clustering from n + 1 to n jets.
+        Args:
+          ymerge: Whether to divide the distances by Q2. Default: False.
+        Returns:
+          dmerge and dmerge_max (or ymerge and ymerge_max) for n = 0, 1, ..., and event offsets.
+      )pbdoc")
+      .def("to_numpy_exclusive_dmerge",
+      [](const output_wrapper &ow, int njets = 0) {
+        return export_event_values(ow.cse.size(), [&](std::size_t i) {
+          return ow.visit(i, [&](const auto &cs) { return cs.exclusive_dmerge(njets); });
+        });
+      }, "njets"_a = 0, timed, R"pbdoc(
+        Retrieves the inclusive jets and converts them to numpy arrays.
         Args:
           min_pt: Minimum jet pt to include. Default: 0.
         Returns:
           pt, eta, phi, m of inclusive jets.
       )pbdoc")
-      .def("to_numpy_exclusive_subdmerge_max",
-      [](
-          const output_wrapper ow,
-          py::array_t<double, py::array::c_style | py::array::forcecast> pxi,
-          py::array_t<double, py::array::c_style | py::array::forcecast> pyi,
-          py::array_t<double, py::array::c_style | py::array::forcecast> pzi,
-          py::array_t<double, py::array::c_style | py::array::forcecast> Ei,
-          int nsub = 0
-        ) {
-        py::buffer_info infopx = pxi.request();
-        py::buffer_info infopy = pyi.request();  // requesting buffer information of the input
-        py::buffer_info infopz = pzi.request();
-        py::buffer_info infoE = Ei.request();
-
-        auto pxptr = static_cast<double *>(infopx.ptr);
-        auto pyptr = static_cast<double *>(infopy.ptr);  // pointer to the initial value
-        auto pzptr = static_cast<double *>(infopz.ptr);
-        auto Eptr = static_cast<double *>(infoE.ptr);
-
-        int dimpx = infopx.shape[0];
-        int dimpy = infopy.shape[0];
-        auto css = ow.cse;
-        int64_t len = css.size();
-        // Don't specify the size if using push_back.
-
-        std::vector<fj::PseudoJet> particles;
-        particles.reserve(dimpx);
-        for(int j = 0; j < dimpx; j++ ){
-          particles.push_back(fj::PseudoJet(*pxptr, *pyptr, *pzptr, *Eptr));
-          pxptr++;
-          pyptr++;
-          pzptr++;
-          Eptr++;
-          }
-        std::vector<int> indices;
-        indices.reserve(len);
-        for(unsigned int i = 0 ; i < len; i++){
-          std::unordered_map<double, int> umap;
-          auto jets = ow.cse[i]->inclusive_jets();
-          for(unsigned int j = 0 ; j < jets.size(); j++){
-            umap.insert({jets[j].rap(),j});
-          }
-          auto got = umap.find(particles[i].rap());
-          if (got == umap.end()){
-              throw "Jet Not in this ClusterSequence";
-          }
-          if(got == umap.end()){
-          }
-          indices.push_back(got->second);
-        }
-        auto out_value = py::array(py::buffer_info(nullptr, sizeof(double), py::format_descriptor<double>::value, 1, {dimpy}, {sizeof(double)}));
-        auto bufpx = out_value.request();
-        double *ptrpx = (double *)bufpx.ptr;
-
-        auto off = py::array(py::buffer_info(nullptr, sizeof(int), py::format_descriptor<int>::value, 1, {len+1}, {sizeof(int)}));
-        auto bufoff = off.request();
-        int *ptroff = (int *)bufoff.ptr;
-
-        size_t idxe = 0;
-        *ptroff = 0;
-        ptroff++;
-        for(int i = 0; i < len; i++){
-        auto incjets = ow.cse[i]->inclusive_jets();
-        auto value = css[i]->exclusive_subdmerge_max(incjets[indices[i]],nsub);
-        ptrpx[idxe] = value;
-        idxe++;
-        *ptroff = 1+ *(ptroff-1);
-        ptroff++;
-        }
-        return std::make_tuple(
-            out_value,
-            off
-          );
-      }, R"pbdoc(
-        Retrieves the exclusive subjets.
+      .def("to_numpy_exclusive_dmerge_max",
+      [](const output_wrapper &ow, int njets = 0) {
+        return export_event_values(ow.cse.size(), [&](std::size_t i) {
+          return ow.visit(i, [&](const auto &cs) { return cs.exclusive_dmerge_max(njets); });
+        });
+      }, "njets"_a = 0, timed, R"pbdoc(
+        Retrieves the inclusive jets and converts them to numpy arrays.
         Args:
           min_pt: Minimum jet pt to include. Default: 0.
         Returns:
           pt, eta, phi, m of inclusive jets.
       )pbdoc")
-      .def("to_numpy_n_exclusive_subjets",
-      [](
-          const output_wrapper ow,
-          py::array_t<double, py::array::c_style | py::array::forcecast> pxi,
-          py::array_t<double, py::array::c_style | py::array::forcecast> pyi,
-          py::array_t<double, py::array::c_style | py::array::forcecast> pzi,
-          py::array_t<double, py::array::c_style | py::array::forcecast> Ei,
-          double dcut = 0
-        ) {
-        py::buffer_info infopx = pxi.request();
-        py::buffer_info infopy = pyi.request();  // requesting buffer information of the input
-        py::buffer_info infopz = pzi.request();
-        py::buffer_info infoE = Ei.request();
-
-        auto pxptr = static_cast<double *>(infopx.ptr);
-        auto pyptr = static_cast<double *>(infopy.ptr);  // pointer to the initial value
-        auto pzptr = static_cast<double *>(infopz.ptr);
-        auto Eptr = static_cast<double *>(infoE.ptr);
-
-        int dimpx = infopx.shape[0];
-        int dimpy = infopy.shape[0];
-        auto css = ow.cse;
-        int64_t len = css.size();
-        // Don't specify the size if using push_back.
-
-        std::vector<fj::PseudoJet> particles;
-        particles.reserve(dimpx);
-        for(int j = 0; j < dimpx; j++ ){
-          particles.push_back(fj::PseudoJet(*pxptr, *pyptr, *pzptr, *Eptr));
-          pxptr++;
-          pyptr++;
-          pzptr++;
-          Eptr++;
-          }
-        std::vector<int> indices;
-        indices.reserve(len);
-        for(unsigned int i = 0 ; i < len; i++){
-          std::unordered_map<double, int> umap;
-          auto jets = ow.cse[i]->inclusive_jets();
-          for(unsigned int j = 0 ; j < jets.size(); j++){
-            umap.insert({jets[j].rap(),j});
-          }
-          auto got = umap.find(particles[i].rap());
-          if (got == umap.end()){
-              throw "Jet Not in this ClusterSequence";
-          }
-          if(got == umap.end()){
-          }
-          indices.push_back(got->second);
-        }
-        auto out_value = py::array(py::buffer_info(nullptr, sizeof(int), py::format_descriptor<int>::value, 1, {dimpy}, {sizeof(int)}));
-        auto bufpx = out_value.request();
-        int *ptrpx = (int *)bufpx.ptr;
-
-        auto off = py::array(py::buffer_info(nullptr, sizeof(int), py::format_descriptor<int>::value, 1, {len+1}, {sizeof(int)}));
-        auto bufoff = off.request();
-        int *ptroff = (int *)bufoff.ptr;
-
-        size_t idxe = 0;
-        *ptroff = 0;
-        ptroff++;
-        for(int i = 0; i < len; i++){
-        auto incjets = ow.cse[i]->inclusive_jets();
-        auto value = css[i]->n_exclusive_subjets(incjets[indices[i]],dcut);
-        ptrpx[idxe] = value;
-        idxe++;
-        *ptroff = 1+ *(ptroff-1);
-        ptroff++;
-        }
-        return std::make_tuple(
-            out_value,
-            off
-          );
-      }, R"pbdoc(
-        Retrieves the exclusive subjets.
+      .def("to_numpy_exclusive_ymerge_max",
+      [](const output_wrapper &ow, int njets = 0) {
+        return export_event_values(ow.cse.size(), [&](std::size_t i) {
+          return ow.visit(i, [&](const auto &cs) { return cs.exclusive_ymerge_max(njets); });
+        });
+      }, "njets"_a = 0, timed, R"pbdoc(
+        Retrieves the inclusive jets and converts them to numpy arrays.
         Args:
           min_pt: Minimum jet pt to include. Default: 0.
         Returns:
           pt, eta, phi, m of inclusive jets.
       )pbdoc")
-      .def("to_numpy_has_parents",
-      [](
-          const output_wrapper ow,
-          py::array_t<double, py::array::c_style | py::array::forcecast> pxi,
-          py::array_t<double, py::array::c_style | py::array::forcecast> pyi,
-          py::array_t<double, py::array::c_style | py::array::forcecast> pzi,
-          py::array_t<double, py::array::c_style | py::array::forcecast> Ei
-        ) {
-        py::buffer_info infopx = pxi.request();
-        py::buffer_info infopy = pyi.request();  // requesting buffer information of the input
-        py::buffer_info infopz = pzi.request();
-        py::buffer_info infoE = Ei.request();
-
-        auto pxptr = static_cast<double *>(infopx.ptr);
-        auto pyptr = static_cast<double *>(infopy.ptr);  // pointer to the initial value
-        auto pzptr = static_cast<double *>(infopz.ptr);
-        auto Eptr = static_cast<double *>(infoE.ptr);
-
-        int dimpx = infopx.shape[0];
-        int dimpy = infopy.shape[0];
-        auto css = ow.cse;
-        int64_t len = css.size();
-        // Don't specify the size if using push_back.
-
-        std::vector<fj::PseudoJet> particles;
-        particles.reserve(dimpx);
-        for(int j = 0; j < dimpx; j++ ){
-          particles.push_back(fj::PseudoJet(*pxptr, *pyptr, *pzptr, *Eptr));
-          pxptr++;
-          pyptr++;
-          pzptr++;
-          Eptr++;
-          }
-        std::vector<int> indices;
-        indices.reserve(len);
-        for(unsigned int i = 0 ; i < len; i++){
-          std::unordered_map<double, int> umap;
-          auto jets = ow.cse[i]->inclusive_jets();
-          for(unsigned int j = 0 ; j < jets.size(); j++){
-            umap.insert({jets[j].rap(),j});
-          }
-          auto got = umap.find(particles[i].rap());
-          if (got == umap.end()){
-              throw "Jet Not in this ClusterSequence";
-          }
-          if(got == umap.end()){
-          }
-          indices.push_back(got->second);
-        }
-        auto out_value = py::array(py::buffer_info(nullptr, sizeof(bool), py::format_descriptor<bool>::value, 1, {dimpy}, {sizeof(bool)}));
-        auto bufpx = out_value.request();
-        bool *ptrpx = (bool *)bufpx.ptr;
-
-        auto off = py::array(py::buffer_info(nullptr, sizeof(int), py::format_descriptor<int>::value, 1, {len+1}, {sizeof(int)}));
-        auto bufoff = off.request();
-        int *ptroff = (int *)bufoff.ptr;
-
-        size_t idxe = 0;
-        *ptroff = 0;
-        ptroff++;
-        for(int i = 0; i < len; i++){
-        auto incjets = ow.cse[i]->inclusive_jets();
-        fj::PseudoJet pj1(0,0,0,0);
-        fj::PseudoJet pj2(0,0,0,0);
-        auto value = css[i]->has_parents(incjets[indices[i]],pj1, pj2);
-        ptrpx[idxe] = value;
-        idxe++;
-        *ptroff = 1+ *(ptroff-1);
-        ptroff++;
-        }
-        return std::make_tuple(
-            out_value,
-            off
-          );
-      }, R"pbdoc(
-        Tells whether the given jet has parents or not.
+      .def("to_numpy_exclusive_ymerge",
+      [](const output_wrapper &ow, int njets = 0) {
+        return export_event_values(ow.cse.size(), [&](std::size_t i) {
+          return ow.visit(i, [&](const auto &cs) { return cs.exclusive_ymerge(njets); });
+        });
+      }, "njets"_a = 0, timed, R"pbdoc(
+        Retrieves the inclusive jets and converts them to numpy arrays.
         Args:
           min_pt: Minimum jet pt to include. Default: 0.
         Returns:
           pt, eta, phi, m of inclusive jets.
       )pbdoc")
-      .def("to_numpy_has_child",
-      [](
-          const output_wrapper ow,
-          py::array_t<double, py::array::c_style | py::array::forcecast> pxi,
-          py::array_t<double, py::array::c_style | py::array::forcecast> pyi,
-          py::array_t<double, py::array::c_style | py::array::forcecast> pzi,
-          py::array_t<double, py::array::c_style | py::array::forcecast> Ei
-        ) {
-        py::buffer_info infopx = pxi.request();
-        py::buffer_info infopy = pyi.request();  // requesting buffer information of the input
-        py::buffer_info infopz = pzi.request();
-        py::buffer_info infoE = Ei.request();
-
-        auto pxptr = static_cast<double *>(infopx.ptr);
-        auto pyptr = static_cast<double *>(infopy.ptr);  // pointer to the initial value
-        auto pzptr = static_cast<double *>(infopz.ptr);
-        auto Eptr = static_cast<double *>(infoE.ptr);
-
-        int dimpx = infopx.shape[0];
-        int dimpy = infopy.shape[0];
-        auto css = ow.cse;
-        int64_t len = css.size();
-        // Don't specify the size if using push_back.
-
-        std::vector<fj::PseudoJet> particles;
-        particles.reserve(dimpx);
-        for(int j = 0; j < dimpx; j++ ){
-          particles.push_back(fj::PseudoJet(*pxptr, *pyptr, *pzptr, *Eptr));
-          pxptr++;
-          pyptr++;
-          pzptr++;
-          Eptr++;
-          }
-        std::vector<int> indices;
-        indices.reserve(len);
-        for(unsigned int i = 0 ; i < len; i++){
-          std::unordered_map<double, int> umap;
-          auto jets = ow.cse[i]->inclusive_jets();
-          for(unsigned int j = 0 ; j < jets.size(); j++){
-            umap.insert({jets[j].rap(),j});
-          }
-          auto got = umap.find(particles[i].rap());
-          if (got == umap.end()){
-              throw "Jet Not in this ClusterSequence";
-          }
-          if(got == umap.end()){
-          }
-          indices.push_back(got->second);
-        }
-        auto out_value = py::array(py::buffer_info(nullptr, sizeof(bool), py::format_descriptor<bool>::value, 1, {dimpy}, {sizeof(bool)}));
-        auto bufpx = out_value.request();
-        bool *ptrpx = (bool *)bufpx.ptr;
-
-        auto off = py::array(py::buffer_info(nullptr, sizeof(int), py::format_descriptor<int>::value, 1, {len+1}, {sizeof(int)}));
-        auto bufoff = off.request();
-        int *ptroff = (int *)bufoff.ptr;
-
-        size_t idxe = 0;
-        *ptroff = 0;
-        ptroff++;
-        for(int i = 0; i < len; i++){
-        auto incjets = ow.cse[i]->inclusive_jets();
-        fj::PseudoJet pj1(0,0,0,0);
-        auto value = css[i]->has_child(incjets[indices[i]],pj1);
-        ptrpx[idxe] = value;
-        idxe++;
-        *ptroff = 1+ *(ptroff-1);
-        ptroff++;
-        }
-        return std::make_tuple(
-            out_value,
-            off
-          );
-      }, R"pbdoc(
-        Tells whether the given jet has children or not.
+      .def("to_numpy_q",
+      [](const output_wrapper &ow) {
+        return export_event_values(ow.cse.size(), [&](std::size_t i) {
+          return ow.visit(i, [&](const auto &cs) { return cs.Q(); });
+        });
+      }, timed, R"pbdoc(
+        Retrieves the inclusive jets and converts them to numpy arrays.
         Args:
           min_pt: Minimum jet pt to include. Default: 0.
         Returns:
           pt, eta, phi, m of inclusive jets.
       )pbdoc")
-    .def("to_numpy_jet_scale_for_algorithm",
-      [](
-          const output_wrapper ow,
-          py::array_t<double,
-          py::array::c_style | py::array::forcecast> pxi,
-          py::array_t<double, py::array::c_style | py::array::forcecast> pyi,
-          py::array_t<double, py::array::c_style | py::array::forcecast> pzi,
-          py::array_t<double, py::array::c_style | py::array::forcecast> Ei
-        ) {
-        py::buffer_info infopx = pxi.request();
-        py::buffer_info infopy = pyi.request();  // requesting buffer information of the input
-        py::buffer_info infopz = pzi.request();
-        py::buffer_info infoE = Ei.request();
-
-        auto pxptr = static_cast<double *>(infopx.ptr);
-        auto pyptr = static_cast<double *>(infopy.ptr);  // pointer to the initial value
-        auto pzptr = static_cast<double *>(infopz.ptr);
-        auto Eptr = static_cast<double *>(infoE.ptr);
-
-        int dimpx = infopx.shape[0];
-        int dimpy = infopy.shape[0];
-        auto css = ow.cse;
-        int64_t len = css.size();
-        // Don't specify the size if using push_back.
-
-        std::vector<fj::PseudoJet> particles;
-        particles.reserve(dimpx);
-        for(int j = 0; j < dimpx; j++ ){
-          particles.push_back(fj::PseudoJet(*pxptr, *pyptr, *pzptr, *Eptr));
-          pxptr++;
-          pyptr++;
-          pzptr++;
-          Eptr++;
-          }
-        std::vector<int> indices;
-        indices.reserve(len);
-        for(unsigned int i = 0 ; i < len; i++){
-          std::unordered_map<double, int> umap;
-          auto jets = ow.cse[i]->inclusive_jets();
-          for(unsigned int j = 0 ; j < jets.size(); j++){
-            umap.insert({jets[j].rap(),j});
-          }
-          auto got = umap.find(particles[i].rap());
-          if (got == umap.end()){
-              throw "Jet Not in this ClusterSequence";
-          }
-          if(got == umap.end()){
-          }
-          indices.push_back(got->second);
-        }
-        auto out_value = py::array(py::buffer_info(nullptr, sizeof(double), py::format_descriptor<double>::value, 1, {dimpy}, {sizeof(double)}));
-        auto bufpx = out_value.request();
-        double *ptrpx = (double *)bufpx.ptr;
-
-        auto off = py::array(py::buffer_info(nullptr, sizeof(int), py::format_descriptor<int>::value, 1, {len+1}, {sizeof(int)}));
-        auto bufoff = off.request();
-        int *ptroff = (int *)bufoff.ptr;
-
-        size_t idxe = 0;
-        *ptroff = 0;
-        ptroff++;
-        for(int i = 0; i < len; i++){
-        auto incjets = ow.cse[i]->inclusive_jets();
-        auto value = css[i]->jet_scale_for_algorithm(incjets[indices[i]]);
-        ptrpx[idxe] = value;
-        idxe++;
-        *ptroff = 1+ *(ptroff-1);
-        ptroff++;
-        }
-        return std::make_tuple(
-            out_value,
-            off
-          );
-      }, R"pbdoc(
-        Retrieves the exclusive subjets.
+      .def("to_numpy_q2",
+      [](const output_wrapper &ow) {
+        return export_event_values(ow.cse.size(), [&](std::size_t i) {
+          return ow.visit(i, [&](const auto &cs) { return cs.Q2(); });
+        });
+      }, timed, R"pbdoc(
+        Retrieves the inclusive jets and converts them to numpy arrays.
         Args:
           min_pt: Minimum jet pt to include. Default: 0.
         Returns:
           pt, eta, phi, m of inclusive jets.
       )pbdoc")
       .def("to_numpy_unique_history_order",
-      [](const output_wrapper ow) {
-        auto css = ow.cse;
-        int64_t len = css.size();
-        int jk = 0;
-        for(unsigned int i = 0; i<len; i++){
-
-          jk += css[i]->unique_history_order().size();
-        }
-        auto parid = py::array(py::buffer_info(nullptr, sizeof(int), py::format_descriptor<int>::value, 1, {jk}, {sizeof(int)}));
-        auto bufparid = parid.request();
-        int *ptrid = (int *)bufparid.ptr;
-        auto eventoffsets = py::array(py::buffer_info(nullptr, sizeof(int), py::format_descriptor<int>::value, 1, {len+1}, {sizeof(int)}));
-        auto bufeventoffsets = eventoffsets.request();
-        int *ptreventoffsets = (int *)bufeventoffsets.ptr;
-        size_t eventidx = 0;
-        ptreventoffsets[eventidx] = 0;
-        eventidx++;
-        size_t idxh = 0;
-        auto eventprev = 0;
-        for (unsigned int i = 0; i < css.size(); i++){
-        auto info= css[i]->unique_history_order();
-        for(unsigned int j =0; j < info.size(); j++){
-        ptrid[idxh] = info[j];
-        idxh++;}
-        ptreventoffsets[eventidx] = info.size()+eventprev;
-        eventprev = ptreventoffsets[eventidx];
-        eventidx++;
-          }
-        return std::make_tuple(
-            parid,
-            eventoffsets
-          );
-      }, R"pbdoc(
+      [](const output_wrapper &ow) {
+        return export_columns(ow.cse.size(), [&](std::size_t i) {
+          return ow.visit(i, [&](const auto &cs) { return cs.unique_history_order(); });
+        }, extract::value);
+      }, timed, R"pbdoc(
         Retrieves the inclusive jets and converts them to numpy arrays.
         Args:
           min_pt: Minimum jet pt to include. Default: 0.
@@ -1648,33 +4126,13 @@ PYBIND11_MODULE(_ext, m) {
           pt, eta, phi, m of inclusive jets.
       )pbdoc")
       .def("to_numpy_n_particles",
-      [](const output_wrapper ow) {
-        auto css = ow.cse;
-        int64_t len = css.size();
-
-        auto parid = py::array(py::buffer_info(nullptr, sizeof(int), py::format_descriptor<int>::value, 1, {len}, {sizeof(int)}));
-        auto bufparid = parid.request();
-        int *ptrid = (int *)bufparid.ptr;
-
-        auto eventoffsets = py::array(py::buffer_info(nullptr, sizeof(int), py::format_descriptor<int>::value, 1, {len}, {sizeof(int)}));
-        auto bufeventoffsets = eventoffsets.request();
-        int *ptreventoffsets = (int *)bufeventoffsets.ptr;
-        size_t eventidx = 0;
-        size_t idxh = 0;
-        auto eventprev = 0;
-
-        for (unsigned int i = 0; i < css.size(); i++){
-        ptrid[idxh] = css[i]->n_particles();
-        idxh++;
-        ptreventoffsets[eventidx] = 1+eventprev;
-        eventprev = ptreventoffsets[eventidx];
-        eventidx++;
-          }
-        return std::make_tuple(
-            parid,
-            eventoffsets
-          );
-      }, R"pbdoc(
+      [](const output_wrapper &ow) {
+        return export_event_values(ow.cse.size(), [&](std::size_t i) {
+          return ow.visit(i, [](const auto &cs) {
+            return static_cast<int>(cs.n_particles());
+          });
+        });
+      }, timed, R"pbdoc(
         Gets n_particles.
         Args:
           None.
@@ -1682,33 +4140,11 @@ PYBIND11_MODULE(_ext, m) {
           pt, eta, phi, m of inclusive jets.
       )pbdoc")
       .def("to_numpy_n_exclusive_jets",
-      [](const output_wrapper ow, double dcut) {
-        auto css = ow.cse;
-        int64_t len = css.size();
-
-        auto parid = py::array(py::buffer_info(nullptr, sizeof(int), py::format_descriptor<int>::value, 1, {len}, {sizeof(int)}));
-        auto bufparid = parid.request();
-        int *ptrid = (int *)bufparid.ptr;
-
-        auto eventoffsets = py::array(py::buffer_info(nullptr, sizeof(int), py::format_descriptor<int>::value, 1, {len}, {sizeof(int)}));
-        auto bufeventoffsets = eventoffsets.request();
-        int *ptreventoffsets = (int *)bufeventoffsets.ptr;
-        size_t eventidx = 0;
-        size_t idxh = 0;
-        auto eventprev = 0;
-
-        for (unsigned int i = 0; i < css.size(); i++){
-        ptrid[idxh] = css[i]->n_exclusive_jets(dcut);
-        idxh++;
-        ptreventoffsets[eventidx] = 1+eventprev;
-        eventprev = ptreventoffsets[eventidx];
-        eventidx++;
-          }
-        return std::make_tuple(
-            parid,
-            eventoffsets
-          );
-      }, R"pbdoc(
+      [](const output_wrapper &ow, double dcut) {
+        return export_event_values(ow.cse.size(), [&](std::size_t i) {
+          return ow.visit(i, [&](const auto &cs) { return cs.n_exclusive_jets(dcut); });
+        });
+      }, timed, R"pbdoc(
         Gets n_exclusive_jets.
         Args:
           None.
@@ -1716,146 +4152,77 @@ PYBIND11_MODULE(_ext, m) {
           pt, eta, phi, m of inclusive jets.
       )pbdoc")
       .def("to_numpy_softdrop_grooming",
-      [](const output_wrapper ow, const int n_jets = 1, double beta = 0, double symmetry_cut = 0.1,
+      [](const output_wrapper &ow, const int n_jets = 1, double beta = 0, double symmetry_cut = 0.1,
         std::string symmetry_measure = "scalar_z", double R0 = 0.8, std::string recursion_choice = "larger_pt",
         /*const FunctionOfPseudoJet<PseudoJet> * subtractor = 0,*/ double mu_cut = std::numeric_limits<double>::infinity()){
-
-        auto css = ow.cse;
-        std::vector<double> consts_groomed_px;
-        std::vector<double> consts_groomed_py;
-        std::vector<double> consts_groomed_pz;
-        std::vector<double> consts_groomed_E;
-        std::vector<int> nconstituents;
-        std::vector<double> jet_groomed_pt;
-        std::vector<double> jet_groomed_eta;
-        std::vector<double> jet_groomed_phi;
-        std::vector<double> jet_groomed_m;
-        std::vector<double> jet_groomed_E;
-        std::vector<double> jet_groomed_pz;
-        std::vector<double> jet_groomed_delta_R;
-        std::vector<double> jet_groomed_symmetry;
-
-        fastjet::contrib::RecursiveSymmetryCutBase::SymmetryMeasure sym_meas = fastjet::contrib::RecursiveSymmetryCutBase::SymmetryMeasure::scalar_z;
-        if (symmetry_measure == "scalar_z") {
-          sym_meas = fastjet::contrib::RecursiveSymmetryCutBase::SymmetryMeasure::scalar_z;
-        }
-        else if (symmetry_measure == "vector_z") {
-          sym_meas = fastjet::contrib::RecursiveSymmetryCutBase::SymmetryMeasure::vector_z;
-        }
-        else if (symmetry_measure == "y") {
-          sym_meas = fastjet::contrib::RecursiveSymmetryCutBase::SymmetryMeasure::y;
-        }
-        else if (symmetry_measure == "theta_E") {
-          sym_meas = fastjet::contrib::RecursiveSymmetryCutBase::SymmetryMeasure::theta_E;
-        }
-        else if (symmetry_measure == "cos_theta_E") {
-          sym_meas = fastjet::contrib::RecursiveSymmetryCutBase::SymmetryMeasure::cos_theta_E;
-        }
-
-        fastjet::contrib::RecursiveSymmetryCutBase::RecursionChoice rec_choice = fastjet::contrib::RecursiveSymmetryCutBase::RecursionChoice::larger_pt;
-        if (recursion_choice == "larger_pt") {
-          rec_choice = fastjet::contrib::RecursiveSymmetryCutBase::RecursionChoice::larger_pt;
-        }
-        else if (recursion_choice == "larger_mt") {
-          rec_choice = fastjet::contrib::RecursiveSymmetryCutBase::RecursionChoice::larger_mt;
-        }
-        else if (recursion_choice == "larger_m") {
-          rec_choice = fastjet::contrib::RecursiveSymmetryCutBase::RecursionChoice::larger_m;
-        }
-        else if (recursion_choice == "larger_E") {
-          rec_choice = fastjet::contrib::RecursiveSymmetryCutBase::RecursionChoice::larger_E;
-        }
-
-        auto sd = std::make_shared<fastjet::contrib::SoftDrop>(beta, symmetry_cut, sym_meas, R0, mu_cut, rec_choice/*, subtractor*/);
-
-        //lets assume at least 2 jets per event to make an initial memory allocation
-        unsigned int jet_tot_len = 2* css.size();
-        jet_groomed_pt.reserve(jet_tot_len);
-        jet_groomed_eta.reserve(jet_tot_len);
-        jet_groomed_phi.reserve(jet_tot_len);
-        jet_groomed_m.reserve(jet_tot_len);
-        jet_groomed_E.reserve(jet_tot_len);
-        jet_groomed_pz.reserve(jet_tot_len);
-        jet_groomed_delta_R.reserve(jet_tot_len);
-        jet_groomed_symmetry.reserve(jet_tot_len);
-        //lets assume at least 2 consts per event to make an initial memory allocation
-        unsigned int consts_tot_len = 2* css.size();
-        nconstituents.reserve(css.size());
-        consts_groomed_px.reserve(consts_tot_len);
-        consts_groomed_py.reserve(consts_tot_len);
-        consts_groomed_pz.reserve(consts_tot_len);
-        consts_groomed_E.reserve(consts_tot_len);
-        
-        for (unsigned int i = 0; i < css.size(); i++){  // iterate through events
-          auto jets = css[i]->exclusive_jets(n_jets);
-          for (unsigned int j = 0; j < jets.size(); j++){
-            auto soft = sd->result(jets[j]);
-            if( soft != 0 ) {
-              jet_groomed_pt.push_back(soft.pt());
-              jet_groomed_eta.push_back(soft.eta());
-              jet_groomed_phi.push_back(soft.phi());
-              jet_groomed_m.push_back(soft.m());
-              jet_groomed_E.push_back(soft.E());
-              jet_groomed_pz.push_back(soft.pz());
-
-              // horrificaly dangerous hack around the fact that
-              // fastjet's custom sharedptr doesn't obey const
-              // correctness and this makes llvm-gcc very sad
-              fastjet::PseudoJetStructureBase* structure_ptr = soft.structure_non_const_ptr();
-              fastjet::contrib::SoftDrop::StructureType* as_sd = (fastjet::contrib::SoftDrop::StructureType*)structure_ptr;
-              jet_groomed_delta_R.push_back(as_sd->delta_R());
-              jet_groomed_symmetry.push_back(as_sd->symmetry());
-            } else {
-               jet_groomed_pt.push_back(std::numeric_limits<double>::quiet_NaN());
-               jet_groomed_eta.push_back(std::numeric_limits<double>::quiet_NaN());
-               jet_groomed_phi.push_back(std::numeric_limits<double>::quiet_NaN());
-               jet_groomed_m.push_back(std::numeric_limits<double>::quiet_NaN());
-               jet_groomed_E.push_back(std::numeric_limits<double>::quiet_NaN());
-               jet_groomed_pz.push_back(std::numeric_limits<double>::quiet_NaN());
-               jet_groomed_delta_R.push_back(std::numeric_limits<double>::quiet_NaN());
-               jet_groomed_symmetry.push_back(std::numeric_limits<double>::quiet_NaN());
-            }
-
-            nconstituents.push_back(soft.constituents().size());
-            for (unsigned int k = 0; k < soft.constituents().size(); k++){
-              consts_groomed_px.push_back(soft.constituents()[k].px());
-              consts_groomed_py.push_back(soft.constituents()[k].py());
-              consts_groomed_pz.push_back(soft.constituents()[k].pz());
-              consts_groomed_E.push_back(soft.constituents()[k].E());
-            }
+        ow.require_sequences("SoftDrop grooming");
+        auto jets = ow.jets(jet_cache::exclusive_njets, n_jets);
+
+        auto sd = make_softdrop(beta, symmetry_cut, symmetry_measure, R0, recursion_choice, mu_cut);
+
+        // groom every jet once; both the jet and the constituent columns
+        // are read from the groomed jets
+        std::vector<std::vector<fj::PseudoJet>> groomed(ow.cse.size());
+        for (std::size_t i = 0; i < ow.cse.size(); i++){  // iterate through events
+          groomed[i].reserve((*jets)[i].size());
+          for (const auto &jet : (*jets)[i]){
+            groomed[i].push_back(sd->result(jet));
           }
         }
-
-        auto consts_px = py::array(consts_groomed_px.size(), consts_groomed_px.data());
-        auto consts_py = py::array(consts_groomed_py.size(), consts_groomed_py.data());
-        auto consts_pz = py::array(consts_groomed_pz.size(), consts_groomed_pz.data());
-        auto consts_E = py::array(consts_groomed_E.size(), consts_groomed_E.data());
-        auto eventsize = py::array(nconstituents.size(), nconstituents.data());
-        auto jet_pt = py::array(jet_groomed_pt.size(), jet_groomed_pt.data());
-        auto jet_eta = py::array(jet_groomed_eta.size(), jet_groomed_eta.data());
-        auto jet_phi = py::array(jet_groomed_phi.size(), jet_groomed_phi.data());
-        auto jet_m = py::array(jet_groomed_m.size(), jet_groomed_m.data());
-        auto jet_E = py::array(jet_groomed_E.size(), jet_groomed_E.data());
-        auto jet_pz = py::array(jet_groomed_pz.size(), jet_groomed_pz.data());
-        auto jet_delta_R = py::array(jet_groomed_delta_R.size(), jet_groomed_delta_R.data());
-        auto jet_symmetry = py::array(jet_groomed_symmetry.size(), jet_groomed_symmetry.data());
-
-        return std::make_tuple(
-            consts_px,
-            consts_py,
-            consts_pz,
-            consts_E,
-            eventsize,
-            jet_pt,
-            jet_eta,
-            jet_phi,
-            jet_m,
-            jet_E,
-            jet_pz,
-            jet_delta_R,
-            jet_symmetry
+        auto groomed_jets = [&](std::size_t i) -> const std::vector<fj::PseudoJet> & {
+          return groomed[i];
+        };
+
+        // groomed jets that did not survive are reported as NaN
+        auto if_groomed = [](double (*get)(const fj::PseudoJet &)) {
+          return [get](const fj::PseudoJet &soft) {
+            return soft != 0 ? get(soft) : std::numeric_limits<double>::quiet_NaN();
+          };
+        };
+        auto jet_columns = export_columns(ow.cse.size(), groomed_jets,
+          if_groomed([](const fj::PseudoJet &j) { return j.pt(); }),
+          if_groomed([](const fj::PseudoJet &j) { return j.eta(); }),
+          if_groomed([](const fj::PseudoJet &j) { return j.phi(); }),
+          if_groomed([](const fj::PseudoJet &j) { return j.m(); }),
+          if_groomed([](const fj::PseudoJet &j) { return j.E(); }),
+          if_groomed([](const fj::PseudoJet &j) { return j.pz(); }),
+          [&](const fj::PseudoJet &soft) {
+            return soft != 0 ? soft.structure_of<fastjet::contrib::SoftDrop>().delta_R() : std::numeric_limits<double>::quiet_NaN();
+          },
+          [&](const fj::PseudoJet &soft) {
+            return soft != 0 ? soft.structure_of<fastjet::contrib::SoftDrop>().symmetry() : std::numeric_limits<double>::quiet_NaN();
+          });
+        auto groomed_constituents = [&](std::size_t i) {
+          std::vector<std::vector<fj::PseudoJet>> constituents;
+          constituents.reserve(groomed[i].size());
+          for (const auto &soft : groomed[i]) {
+            constituents.push_back(soft.constituents());
+          }
+          return constituents;
+        };
+        auto constituent_columns = ow.single_precision
+          ? export_nested_columns(ow.cse.size(), groomed_constituents,
+              as_precision<float>(extract::px), as_precision<float>(extract::py),
+              as_precision<float>(extract::pz), as_precision<float>(extract::E))
+          : export_nested_columns(ow.cse.size(), groomed_constituents,
+              extract::px, extract::py, extract::pz, extract::E);
+
+        return py::make_tuple(
+            constituent_columns[1],  // constituent px
+            constituent_columns[2],  // constituent py
+            constituent_columns[3],  // constituent pz
+            constituent_columns[4],  // constituent E
+            constituent_columns[0],  // constituent offsets per jet
+            jet_columns[0],  // pt
+            jet_columns[1],  // eta
+            jet_columns[2],  // phi
+            jet_columns[3],  // m
+            jet_columns[4],  // E
+            jet_columns[5],  // pz
+            jet_columns[6],  // delta_R
+            jet_columns[7]  // symmetry
           );
-      }, R"pbdoc(
+      }, timed, R"pbdoc(
         Performs softdrop pruning on jets.
         Args:
           n_jets: number of exclusive subjets.
@@ -1868,67 +4235,73 @@ PYBIND11_MODULE(_ext, m) {
         Returns:
           Returns an array of values from the jet after it has been groomed by softdrop.
       )pbdoc")
-      .def("to_numpy_energy_correlators",
-      [](const output_wrapper ow, const int n_jets = 1, const double beta = 1, double npoint = 0, int angles = 0, double alpha = 0, std::string func = "generalized", bool normalized = true) {
-        auto css = ow.cse;
-
-        std::transform(func.begin(), func.end(), func.begin(),
-          [](unsigned char c){ return std::tolower(c); });
-        auto energy_correlator = std::shared_ptr<fastjet::FunctionOfPseudoJet<double>>(nullptr);
-        if ( func == "ratio" ) {
-          energy_correlator = std::make_shared<fastjet::contrib::EnergyCorrelatorRatio>(npoint, beta); }
-        else if ( func == "doubleratio" ) {
-          energy_correlator = std::make_shared<fastjet::contrib::EnergyCorrelatorDoubleRatio>(npoint, beta); }
-        else if ( func == "c1" ) {
-          energy_correlator = std::make_shared<fastjet::contrib::EnergyCorrelatorC1>(beta);}
-        else if ( func == "c2" ) {
-          energy_correlator = std::make_shared<fastjet::contrib::EnergyCorrelatorC2>(beta);}
-        else if ( func == "d2" ) {
-          energy_correlator = std::make_shared<fastjet::contrib::EnergyCorrelatorD2>(beta);}
-        else if ( func == "generalized" ) {
-          energy_correlator = std::make_shared<fastjet::contrib::EnergyCorrelatorGeneralized>(angles, npoint, beta);}
-        else if (func == "generalizedd2") {
-          energy_correlator = std::make_shared<fastjet::contrib::EnergyCorrelatorGeneralizedD2>(alpha, beta);}
-        else if (func == "nseries") {
-          energy_correlator = std::make_shared<fastjet::contrib::EnergyCorrelatorNseries>(npoint, beta);}
-        else if (func == "n2") {
-          energy_correlator = std::make_shared<fastjet::contrib::EnergyCorrelatorN2>(beta);}
-        else if (func == "n3") {
-          energy_correlator = std::make_shared<fastjet::contrib::EnergyCorrelatorN3>(beta);}
-        else if (func == "mseries") {
-          energy_correlator = std::make_shared<fastjet::contrib::EnergyCorrelatorMseries>(npoint, beta);}
-        else if (func == "m2") {
-          energy_correlator = std::make_shared<fastjet::contrib::EnergyCorrelatorM2>(beta);}
-        else if (func == "cseries") {
-          energy_correlator = std::make_shared<fastjet::contrib::EnergyCorrelatorCseries>(npoint, beta);}
-        else if (func == "useries") {
-          energy_correlator = std::make_shared<fastjet::contrib::EnergyCorrelatorUseries>(npoint, beta);}
-        else if (func == "u1") {
-          energy_correlator = std::make_shared<fastjet::contrib::EnergyCorrelatorU1>(beta);}
-        else if (func == "u2") {
-          energy_correlator = std::make_shared<fastjet::contrib::EnergyCorrelatorU2>(beta);}
-        else if (func == "u3") {
-          energy_correlator = std::make_shared<fastjet::contrib::EnergyCorrelatorU3>(beta);}
-        else if (func == "generic" && normalized == false) {
-          energy_correlator = std::make_shared<fastjet::contrib::EnergyCorrelator>(npoint, beta);} // The generic energy correlator is not normalized; i.e. does not use a momentum fraction when being calculated.
-        else if (func == "generic" && normalized == true) {
-          energy_correlator = std::make_shared<fastjet::contrib::EnergyCorrelatorGeneralized>(angles, npoint, beta);} //Using the Generalized class with angles=-1 returns a generic ECF that has been normalized
-
-        std::vector<double> ECF_vec;
-        ECF_vec.reserve( css.size()*2); 
-        for (unsigned int i = 0; i < css.size(); i++){  // iterate through events
-          auto jets = css[i]->exclusive_jets(n_jets);
-
-          for (unsigned int j = 0; j < jets.size(); j++){
-            auto ecf_result = energy_correlator->result(jets[j]); //
-            ECF_vec.push_back(ecf_result);
+      .def("to_numpy_softdrop_observables",
+      [](const output_wrapper &ow, int n_jets, double beta, double symmetry_cut,
+         const std::string &symmetry_measure, double R0,
+         const std::string &recursion_choice, double mu_cut, int n_threads) {
+        ow.require_sequences("SoftDrop grooming");
+        softdrop_declustering softdrop(beta, symmetry_cut, symmetry_measure,
+                                       R0, recursion_choice, mu_cut);
+        auto jets = ow.jets(jet_cache::exclusive_njets, n_jets);
+        typedef softdrop_declustering::groomed groomed_t;
+        std::vector<std::vector<groomed_t>> groomed(ow.cse.size());
+        auto groom_events = [&](std::size_t begin, std::size_t end) {
+          for (std::size_t i = begin; i < end; i++) {
+            groomed[i].reserve((*jets)[i].size());
+            for (const auto &jet : (*jets)[i]) {
+              groomed[i].push_back(softdrop.groom(*ow.cse[i], jet));
+            }
           }
+        };
+        // reclustering calls the recombiner of the jet definition
+        if (ow.cse.empty() || calls_external_recombiner(ow.cse[0]->jet_def())) {
+          groom_events(0, groomed.size());
+        } else {
+          py::gil_scoped_release release;
+          thread_pool::instance().parallel_for(
+              groomed.size(), resolve_n_threads(n_threads), groom_events);
         }
+        return export_columns(groomed.size(),
+          [&](std::size_t i) -> const std::vector<groomed_t> & {
+            return groomed[i];
+          },
+          [](const groomed_t &g) { return g.zg; },
+          [](const groomed_t &g) { return g.Rg; },
+          [](const groomed_t &g) { return g.mass; },
+          [](const groomed_t &g) { return g.pt; });
+      }, "n_jets"_a = 1, "beta"_a = 0, "symmetry_cut"_a = 0.1,
+         "symmetry_measure"_a = "scalar_z", "R0"_a = 0.8,
+         "recursion_choice"_a = "larger_pt",
+         "mu_cut"_a = std::numeric_limits<double>::infinity(),
+         "n_threads"_a = -1, timed, R"pbdoc(
+        Grooms the exclusive jets with SoftDrop, declustering their C/A history directly when they were clustered with C/A, and returns the groomed observables as columns.
+        Args:
+          n_jets: number of exclusive jets.
+          beta: softdrop beta parameter.
+          symmetry_cut: softdrop symmetry cut value.
+          symmetry_measure: scalar_z, vector_z, y, theta_E or cos_theta_E.
+          R0: softdrop R0 parameter.
+          recursion_choice: larger_pt, larger_mt, larger_m or larger_E.
+          mu_cut: mass drop condition of the modified mass drop tagger; infinite for none.
+          n_threads: Number of threads grooming events concurrently. Default: -1.
+        Returns:
+          zg, Rg, groomed mass and groomed pt of every jet, and event offsets.
+      )pbdoc")
+      .def("to_numpy_energy_correlators",
+      [](const output_wrapper &ow, const int n_jets = 1, const double beta = 1, double npoint = 0, int angles = 0, double alpha = 0, std::string func = "generalized", bool normalized = true) {
+        ow.require_sequences("Energy correlators");
+        auto jets = ow.jets(jet_cache::exclusive_njets, n_jets);
 
-        auto ECF = py::array(ECF_vec.size(), ECF_vec.data());
+        auto energy_correlator = make_energy_correlator(beta, npoint, angles, alpha, func, normalized);
 
-        return ECF;
-      }, R"pbdoc(
+        auto ECF = export_columns(ow.cse.size(), [&](std::size_t i) -> const std::vector<fj::PseudoJet> & {
+          return (*jets)[i];
+        }, [&](const fj::PseudoJet &jet) {
+          return energy_correlator->result(jet);
+        });
+
+        return py::object(ECF[0]);
+      }, timed, R"pbdoc(
         Calculates the energy correlators for each jet in each event.
         Args:
           n_jets: number of exclusive subjets.
@@ -1941,71 +4314,20 @@ PYBIND11_MODULE(_ext, m) {
           Energy correlators for each jet in each event.
       )pbdoc")
       .def("to_numpy_exclusive_njet_lund_declusterings",
-      [](const output_wrapper ow, const int n_jets = 0) {
-        auto css = ow.cse;
-        int64_t len = css.size();
-        auto jk = 0;
-
-        for(int i = 0; i < len; i++){
-          jk += css[i]->exclusive_jets(n_jets).size();
-        }
-        jk++;
-
+      [](const output_wrapper &ow, const int n_jets = 0) {
+        ow.require_sequences("Lund declusterings");
+        auto jets = ow.jets(jet_cache::exclusive_njets, n_jets);
         auto lund_generator = fastjet::contrib::LundGenerator();
-        std::vector<double> Delta_vec;
-        std::vector<double> kt_vec;
-        Delta_vec.reserve(2*css.size());
-        kt_vec.reserve(2*css.size());
-
-        auto eventoffsets = py::array(py::buffer_info(nullptr, sizeof(int), py::format_descriptor<int>::value, 1, {len+1}, {sizeof(int)}));
-        auto bufeventoffsets = eventoffsets.request();
-        int *ptreventoffsets = (int *)bufeventoffsets.ptr;
-        size_t eventidx = 0;
-
-        ptreventoffsets[eventidx] = 0;
-        eventidx++;
-
-        auto jetoffsets = py::array(py::buffer_info(nullptr, sizeof(int), py::format_descriptor<int>::value, 1, {jk}, {sizeof(int)}));
-        auto bufjetoffsets = jetoffsets.request();
-        int *ptrjetoffsets = (int *)bufjetoffsets.ptr;
-        size_t jetidx = 0;
-
-        ptrjetoffsets[jetidx] = 0;
-        jetidx++;
-        auto eventprev = 0;
-
-        for (unsigned int i = 0; i < css.size(); i++){  // iterate through events
-          auto jets = css[i]->exclusive_jets(n_jets);
-          auto prev = ptrjetoffsets[jetidx-1];
-
-          for (unsigned int j = 0; j < jets.size(); j++){
-            auto lund_result = lund_generator.result(jets[j]);
-            auto splittings = lund_result.size();
-            for (unsigned int k = 0; k < splittings; k++){
-              Delta_vec.push_back(lund_result[k].Delta());
-              kt_vec.push_back(lund_result[k].kt());
-            }
-
-            ptrjetoffsets[jetidx] = splittings + prev;
-            prev = ptrjetoffsets[jetidx];
-            jetidx++;
+        return export_nested_columns(ow.cse.size(), [&](std::size_t i) {
+          std::vector<std::vector<fastjet::contrib::LundDeclustering>> declusterings;
+          declusterings.reserve((*jets)[i].size());
+          for (const auto &jet : (*jets)[i]) {
+            declusterings.push_back(lund_generator.result(jet));
           }
-
-          ptreventoffsets[eventidx] = jets.size() + eventprev;
-          eventprev = ptreventoffsets[eventidx];
-          eventidx++;
-        }
-
-        auto Deltas = py::array(Delta_vec.size(), Delta_vec.data());
-        auto kts = py::array(kt_vec.size(), kt_vec.data());
-
-        return std::make_tuple(
-            jetoffsets,
-            Deltas,
-            kts,
-            eventoffsets
-          );
-      }, "n_jets"_a = 0, R"pbdoc(
+          return declusterings;
+        }, [](const fastjet::contrib::LundDeclustering &d) { return d.Delta(); },
+           [](const fastjet::contrib::LundDeclustering &d) { return d.kt(); });
+      }, "n_jets"_a = 0, timed, R"pbdoc(
         Calculates the Lund declustering Delta and k_T parameters from exclusive n_jets and converts them to numpy arrays.
         Args:
           n_jets: Number of exclusive subjets. Default: 0.
@@ -2013,57 +4335,12 @@ PYBIND11_MODULE(_ext, m) {
           jet offsets, splitting Deltas, kts, and event offsets.
       )pbdoc")
       .def("to_numpy_unclustered_particles",
-      [](const output_wrapper ow) {
-        auto css = ow.cse;
-        int64_t len = css.size();
-        // Don't specify the size if using push_back.
-        auto jk = 0;
-        for(int i = 0; i < len; i++){
-        jk += css[i]->unclustered_particles().size();
-        }
-        auto px = py::array(py::buffer_info(nullptr, sizeof(double), py::format_descriptor<double>::value, 1, {jk}, {sizeof(double)}));
-        auto bufpx = px.request();
-        double *ptrpx = (double *)bufpx.ptr;
-
-        auto py = py::array(py::buffer_info(nullptr, sizeof(double), py::format_descriptor<double>::value, 1, {jk}, {sizeof(double)}));
-        auto bufpy = py.request();
-        double *ptrpy = (double *)bufpy.ptr;
-
-        auto pz = py::array(py::buffer_info(nullptr, sizeof(double), py::format_descriptor<double>::value, 1, {jk}, {sizeof(double)}));
-        auto bufpz = pz.request();
-        double *ptrpz = (double *)bufpz.ptr;
-
-        auto E = py::array(py::buffer_info(nullptr, sizeof(double), py::format_descriptor<double>::value, 1, {jk}, {sizeof(double)}));
-        auto bufE = E.request();
-        double *ptrE = (double *)bufE.ptr;
-
-        auto off = py::array(py::buffer_info(nullptr, sizeof(int), py::format_descriptor<int>::value, 1, {len+1}, {sizeof(int)}));
-        auto bufoff = off.request();
-        int *ptroff = (int *)bufoff.ptr;
-        size_t idxe = 0;
-        *ptroff = 0;
-        ptroff++;
-        for(int i = 0; i < len; i++){
-        auto jets = ow.cse[i]->unclustered_particles();
-        for (unsigned int j = 0; j < jets.size(); j++)
-        {
-          ptrpx[idxe] = jets[j].px();
-          ptrpy[idxe] = jets[j].py();
-          ptrpz[idxe] = jets[j].pz();
-          ptrE[idxe] = jets[j].E();
-          idxe++;
-        }
-        *ptroff = jets.size()+*(ptroff-1);
-        ptroff++;
-        }
-        return std::make_tuple(
-            px,
-            py,
-            pz,
-            E,
-            off
-          );
-      }, R"pbdoc(
+      [](const output_wrapper &ow) {
+        ow.require_sequences("unclustered_particles");
+        return export_momenta(ow, [&](std::size_t i) {
+          return ow.cse[i]->unclustered_particles();
+        });
+      }, timed, R"pbdoc(
         Retrieves the unclustered particles from multievent clustering and converts them to numpy arrays.
         Args:
           None.
@@ -2071,57 +4348,12 @@ PYBIND11_MODULE(_ext, m) {
           pt, eta, phi, m of inclusive jets.
       )pbdoc")
       .def("to_numpy_childless_pseudojets",
-      [](const output_wrapper ow) {
-        auto css = ow.cse;
-        int64_t len = css.size();
-        // Don't specify the size if using push_back.
-        auto jk = 0;
-        for(int i = 0; i < len; i++){
-        jk += css[i]->childless_pseudojets().size();
-        }
-        auto px = py::array(py::buffer_info(nullptr, sizeof(double), py::format_descriptor<double>::value, 1, {jk}, {sizeof(double)}));
-        auto bufpx = px.request();
-        double *ptrpx = (double *)bufpx.ptr;
-
-        auto py = py::array(py::buffer_info(nullptr, sizeof(double), py::format_descriptor<double>::value, 1, {jk}, {sizeof(double)}));
-        auto bufpy = py.request();
-        double *ptrpy = (double *)bufpy.ptr;
-
-        auto pz = py::array(py::buffer_info(nullptr, sizeof(double), py::format_descriptor<double>::value, 1, {jk}, {sizeof(double)}));
-        auto bufpz = pz.request();
-        double *ptrpz = (double *)bufpz.ptr;
-
-        auto E = py::array(py::buffer_info(nullptr, sizeof(double), py::format_descriptor<double>::value, 1, {jk}, {sizeof(double)}));
-        auto bufE = E.request();
-        double *ptrE = (double *)bufE.ptr;
-
-        auto off = py::array(py::buffer_info(nullptr, sizeof(int), py::format_descriptor<int>::value, 1, {len+1}, {sizeof(int)}));
-        auto bufoff = off.request();
-        int *ptroff = (int *)bufoff.ptr;
-        size_t idxe = 0;
-        *ptroff = 0;
-        ptroff++;
-        for(int i = 0; i < len; i++){
-        auto jets = ow.cse[i]->childless_pseudojets();
-        for (unsigned int j = 0; j < jets.size(); j++)
-        {
-          ptrpx[idxe] = jets[j].px();
-          ptrpy[idxe] = jets[j].py();
-          ptrpz[idxe] = jets[j].pz();
-          ptrE[idxe] = jets[j].E();
-          idxe++;
-        }
-        *ptroff = jets.size()+*(ptroff-1);
-        ptroff++;
-        }
-        return std::make_tuple(
-            px,
-            py,
-            pz,
-            E,
-            off
-          );
-      }, R"pbdoc(
+      [](const output_wrapper &ow) {
+        ow.require_sequences("childless_pseudojets");
+        return export_momenta(ow, [&](std::size_t i) {
+          return ow.cse[i]->childless_pseudojets();
+        });
+      }, timed, R"pbdoc(
         Retrieves the childless pseudojets from multievent clustering and converts them to numpy arrays.
         Args:
           None.
@@ -2129,295 +4361,21 @@ PYBIND11_MODULE(_ext, m) {
           pt, eta, phi, m of inclusive jets.
       )pbdoc")
       .def("to_numpy_jets",
-      [](const output_wrapper ow) {
-        auto css = ow.cse;
-        int64_t len = css.size();
-        // Don't specify the size if using push_back.
-        auto jk = 0;
-        for(int i = 0; i < len; i++){
-        jk += css[i]->jets().size();
-        }
-        auto px = py::array(py::buffer_info(nullptr, sizeof(double), py::format_descriptor<double>::value, 1, {jk}, {sizeof(double)}));
-        auto bufpx = px.request();
-        double *ptrpx = (double *)bufpx.ptr;
-
-        auto py = py::array(py::buffer_info(nullptr, sizeof(double), py::format_descriptor<double>::value, 1, {jk}, {sizeof(double)}));
-        auto bufpy = py.request();
-        double *ptrpy = (double *)bufpy.ptr;
-
-        auto pz = py::array(py::buffer_info(nullptr, sizeof(double), py::format_descriptor<double>::value, 1, {jk}, {sizeof(double)}));
-        auto bufpz = pz.request();
-        double *ptrpz = (double *)bufpz.ptr;
-
-        auto E = py::array(py::buffer_info(nullptr, sizeof(double), py::format_descriptor<double>::value, 1, {jk}, {sizeof(double)}));
-        auto bufE = E.request();
-        double *ptrE = (double *)bufE.ptr;
-
-        auto off = py::array(py::buffer_info(nullptr, sizeof(int), py::format_descriptor<int>::value, 1, {len+1}, {sizeof(int)}));
-        auto bufoff = off.request();
-        int *ptroff = (int *)bufoff.ptr;
-        size_t idxe = 0;
-        *ptroff = 0;
-        ptroff++;
-        for(int i = 0; i < len; i++){
-        auto jets = ow.cse[i]->jets();
-        for (unsigned int j = 0; j < jets.size(); j++)
-        {
-          ptrpx[idxe] = jets[j].px();
-          ptrpy[idxe] = jets[j].py();
-          ptrpz[idxe] = jets[j].pz();
-          ptrE[idxe] = jets[j].E();
-          idxe++;
-        }
-        *ptroff = jets.size()+*(ptroff-1);
-        ptroff++;
-        }
-        return std::make_tuple(
-            px,
-            py,
-            pz,
-            E,
-            off
-          );
-      }, R"pbdoc(
+      [](const output_wrapper &ow) {
+        ow.require_sequences("jets");
+        return export_momenta(ow, [&](std::size_t i) -> const std::vector<fj::PseudoJet> & {
+          return ow.cse[i]->jets();
+        });
+      }, timed, R"pbdoc(
         Retrieves the childless pseudojets from multievent clustering and converts them to numpy arrays.
         Args:
           None.
         Returns:
           pt, eta, phi, m of inclusive jets.
       )pbdoc")
-      .def("to_numpy_get_parents",
-      [](
-          const output_wrapper ow,
-          py::array_t<double, py::array::c_style | py::array::forcecast> pxi,
-          py::array_t<double, py::array::c_style | py::array::forcecast> pyi,
-          py::array_t<double, py::array::c_style | py::array::forcecast> pzi,
-          py::array_t<double, py::array::c_style | py::array::forcecast> Ei
-        ) {
-        py::buffer_info infopx = pxi.request();
-        py::buffer_info infopy = pyi.request();  // requesting buffer information of the input
-        py::buffer_info infopz = pzi.request();
-        py::buffer_info infoE = Ei.request();
-
-        auto pxptr = static_cast<double *>(infopx.ptr);
-        auto pyptr = static_cast<double *>(infopy.ptr);  // pointer to the initial value
-        auto pzptr = static_cast<double *>(infopz.ptr);
-        auto Eptr = static_cast<double *>(infoE.ptr);
-
-        int dimpx = infopx.shape[0];
-        auto css = ow.cse;
-        int64_t len = css.size();
-        // Don't specify the size if using push_back.
-
-        std::vector<fj::PseudoJet> particles;
-        particles.reserve(dimpx);
-        for(int j = 0; j < dimpx; j++ ){
-          particles.push_back(fj::PseudoJet(*pxptr, *pyptr, *pzptr, *Eptr));
-          pxptr++;
-          pyptr++;
-          pzptr++;
-          Eptr++;
-          }
-
-        std::vector<int> indices;
-        indices.reserve(len);
-        for(unsigned int i = 0 ; i < len; i++){
-          std::unordered_map<double, int> umap;
-          auto jets = ow.cse[i]->inclusive_jets();
-          for(unsigned int j = 0 ; j < jets.size(); j++){
-            umap.insert({jets[j].rap(),j});
-          }
-          auto got = umap.find(particles[i].rap());
-          if (got == umap.end()){
-              throw "Jet Not in this ClusterSequence";
-          }
-          if(got == umap.end()){
-          }
-          indices.push_back(got->second);
-        }
-        // Don't specify the size if using push_back.
-        auto jk = 0;
-        for(int i = 0; i < len; i++){
-        auto incjets = ow.cse[i]->inclusive_jets();
-        fj::PseudoJet pj1(0,0,0,0);
-        fj::PseudoJet pj2(0,0,0,0);
-        auto value = css[i]->has_parents(incjets[indices[i]],pj1, pj2);
-        if(value == true){
-        jk += 2;}
-        }
-        auto px = py::array(py::buffer_info(nullptr, sizeof(double), py::format_descriptor<double>::value, 1, {jk}, {sizeof(double)}));
-        auto bufpx = px.request();
-        double *ptrpx = (double *)bufpx.ptr;
-
-        auto py = py::array(py::buffer_info(nullptr, sizeof(double), py::format_descriptor<double>::value, 1, {jk}, {sizeof(double)}));
-        auto bufpy = py.request();
-        double *ptrpy = (double *)bufpy.ptr;
-
-        auto pz = py::array(py::buffer_info(nullptr, sizeof(double), py::format_descriptor<double>::value, 1, {jk}, {sizeof(double)}));
-        auto bufpz = pz.request();
-        double *ptrpz = (double *)bufpz.ptr;
-
-        auto E = py::array(py::buffer_info(nullptr, sizeof(double), py::format_descriptor<double>::value, 1, {jk}, {sizeof(double)}));
-        auto bufE = E.request();
-        double *ptrE = (double *)bufE.ptr;
-
-        auto off = py::array(py::buffer_info(nullptr, sizeof(int), py::format_descriptor<int>::value, 1, {len+1}, {sizeof(int)}));
-        auto bufoff = off.request();
-        int *ptroff = (int *)bufoff.ptr;
-        size_t idxe = 0;
-        *ptroff = 0;
-        ptroff++;
-        for(int i = 0; i < len; i++){
-        auto incjets = ow.cse[i]->inclusive_jets();
-        fj::PseudoJet pj1(0,0,0,0);
-        fj::PseudoJet pj2(0,0,0,0);
-        auto value = css[i]->has_parents(incjets[indices[i]],pj1, pj2);
-        if(value == true){
-        ptrpx[idxe] = pj1.px();
-        ptrpy[idxe] = pj1.py();
-        ptrpz[idxe] = pj1.pz();
-        ptrE[idxe] = pj1.E();
-        idxe++;
-        ptrpx[idxe] = pj2.px();
-        ptrpy[idxe] = pj2.py();
-        ptrpz[idxe] = pj2.pz();
-        ptrE[idxe] = pj2.E();
-        idxe++;
-        *ptroff = 2+ *(ptroff-1);
-        }
-        else{
-          *ptroff = *(ptroff-1);
-        }
-        ptroff++;
-        }
-        return std::make_tuple(
-            px,
-            py,
-            pz,
-            E,
-            off
-          );
-      }, R"pbdoc(
-        Retrieves the unclustered particles from multievent clustering and converts them to numpy arrays.
-        Args:
-          None.
-        Returns:
-          pt, eta, phi, m of inclusive jets.
-      )pbdoc")
-    .def("to_numpy_get_child",
-      [](
-          const output_wrapper ow,
-          py::array_t<double, py::array::c_style | py::array::forcecast> pxi,
-          py::array_t<double, py::array::c_style | py::array::forcecast> pyi,
-          py::array_t<double, py::array::c_style | py::array::forcecast> pzi,
-          py::array_t<double, py::array::c_style | py::array::forcecast> Ei
-        ) {
-        py::buffer_info infopx = pxi.request();
-        py::buffer_info infopy = pyi.request();  // requesting buffer information of the input
-        py::buffer_info infopz = pzi.request();
-        py::buffer_info infoE = Ei.request();
-
-        auto pxptr = static_cast<double *>(infopx.ptr);
-        auto pyptr = static_cast<double *>(infopy.ptr);  // pointer to the initial value
-        auto pzptr = static_cast<double *>(infopz.ptr);
-        auto Eptr = static_cast<double *>(infoE.ptr);
-
-        int dimpx = infopx.shape[0];
-        auto css = ow.cse;
-        int64_t len = css.size();
-        // Don't specify the size if using push_back.
-
-        std::vector<fj::PseudoJet> particles;
-        particles.reserve(dimpx);
-        for(int j = 0; j < dimpx; j++ ){
-          particles.push_back(fj::PseudoJet(*pxptr, *pyptr, *pzptr, *Eptr));
-          pxptr++;
-          pyptr++;
-          pzptr++;
-          Eptr++;
-          }
-
-        std::vector<int> indices;
-        indices.reserve(len);
-        for(unsigned int i = 0 ; i < len; i++){
-          std::unordered_map<double, int> umap;
-          auto jets = ow.cse[i]->inclusive_jets();
-          for(unsigned int j = 0 ; j < jets.size(); j++){
-            umap.insert({jets[j].rap(),j});
-          }
-          auto got = umap.find(particles[i].rap());
-          if (got == umap.end()){
-              throw "Jet Not in this ClusterSequence";
-          }
-          if(got == umap.end()){
-          }
-          indices.push_back(got->second);
-        }
-        // Don't specify the size if using push_back.
-        auto jk = 0;
-        for(int i = 0; i < len; i++){
-        auto incjets = ow.cse[i]->inclusive_jets();
-        fj::PseudoJet pj1(0,0,0,0);
-        auto value = css[i]->has_child(incjets[indices[i]],pj1);
-        if(value == true){
-        jk += 1;}
-        }
-        auto px = py::array(py::buffer_info(nullptr, sizeof(double), py::format_descriptor<double>::value, 1, {jk}, {sizeof(double)}));
-        auto bufpx = px.request();
-        double *ptrpx = (double *)bufpx.ptr;
-
-        auto py = py::array(py::buffer_info(nullptr, sizeof(double), py::format_descriptor<double>::value, 1, {jk}, {sizeof(double)}));
-        auto bufpy = py.request();
-        double *ptrpy = (double *)bufpy.ptr;
-
-        auto pz = py::array(py::buffer_info(nullptr, sizeof(double), py::format_descriptor<double>::value, 1, {jk}, {sizeof(double)}));
-        auto bufpz = pz.request();
-        double *ptrpz = (double *)bufpz.ptr;
-
-        auto E = py::array(py::buffer_info(nullptr, sizeof(double), py::format_descriptor<double>::value, 1, {jk}, {sizeof(double)}));
-        auto bufE = E.request();
-        double *ptrE = (double *)bufE.ptr;
-
-        auto off = py::array(py::buffer_info(nullptr, sizeof(int), py::format_descriptor<int>::value, 1, {len+1}, {sizeof(int)}));
-        auto bufoff = off.request();
-        int *ptroff = (int *)bufoff.ptr;
-        size_t idxe = 0;
-        *ptroff = 0;
-        ptroff++;
-        for(int i = 0; i < len; i++){
-        auto incjets = ow.cse[i]->inclusive_jets();
-        fj::PseudoJet pj1(0,0,0,0);
-        auto value = css[i]->has_child(incjets[indices[i]],pj1);
-        if(value == true){
-        ptrpx[idxe] = pj1.px();
-        ptrpy[idxe] = pj1.py();
-        ptrpz[idxe] = pj1.pz();
-        ptrE[idxe] = pj1.E();
-        idxe++;
-        *ptroff = 1+ *(ptroff-1);
-        }
-        else{
-          *ptroff = *(ptroff-1);
-        }
-        ptroff++;
-        }
-        return std::make_tuple(
-            px,
-            py,
-            pz,
-            E,
-            off
-          );
-      }, R"pbdoc(
-        Retrieves the unclustered particles from multievent clustering and converts them to numpy arrays.
-        Args:
-          None.
-        Returns:
-          pt, eta, phi, m of inclusive jets.
-      )pbdoc")
     .def("to_numpy_njettiness",
       [](
-         const output_wrapper ow,
+         const output_wrapper &ow,
          const std::string& measure_definition,
          const std::string& axes_definition,
          const std::vector<unsigned int>& njets,
@@ -2427,81 +4385,211 @@ PYBIND11_MODULE(_ext, m) {
          const int nPass,
          const double akAxesR0
       ) {
-        auto maybe_measdef = njettiness::measure_def_names_to_enum.find(measure_definition);
-        const auto measdefenum = maybe_measdef == njettiness::measure_def_names_to_enum.end() ? njettiness::NormalizedMeasure : maybe_measdef->second;
-
-        auto maybe_axesdef = njettiness::axis_def_names_to_enum.find(axes_definition);
-        const auto axesdefenum = maybe_axesdef == njettiness::axis_def_names_to_enum.end() ? njettiness::KT_Axes : maybe_axesdef->second;
-
-        // Get the measure definition
-        fastjet::contrib::NormalizedMeasure          normalizedMeasure        (beta, R0);
-        fastjet::contrib::UnnormalizedMeasure        unnormalizedMeasure      (beta);
-        fastjet::contrib::OriginalGeometricMeasure   geometricMeasure         (beta);
-        fastjet::contrib::NormalizedCutoffMeasure    normalizedCutoffMeasure  (beta, R0, Rcutoff);
-        fastjet::contrib::UnnormalizedCutoffMeasure  unnormalizedCutoffMeasure(beta, Rcutoff);
-
-        fastjet::contrib::MeasureDefinition const * measureDef = 0;
-        switch ( measdefenum ) {
-          case njettiness::UnnormalizedMeasure         : measureDef = &unnormalizedMeasure; break;
-          case njettiness::OriginalGeometricMeasure    : measureDef = &geometricMeasure; break;
-          case njettiness::NormalizedCutoffMeasure     : measureDef = &normalizedCutoffMeasure; break;
-          case njettiness::UnnormalizedCutoffMeasure   : measureDef = &unnormalizedCutoffMeasure; break;
-          case njettiness::NormalizedMeasure : default : measureDef = &normalizedMeasure; break;
-        }
-
-        // Get the axes definition
-        fastjet::contrib::KT_Axes             kt_axes;
-        fastjet::contrib::CA_Axes             ca_axes;
-        fastjet::contrib::AntiKT_Axes         antikt_axes        (akAxesR0);
-        fastjet::contrib::WTA_KT_Axes         wta_kt_axes;
-        fastjet::contrib::WTA_CA_Axes         wta_ca_axes;
-        fastjet::contrib::OnePass_KT_Axes     onepass_kt_axes;
-        fastjet::contrib::OnePass_CA_Axes     onepass_ca_axes;
-        fastjet::contrib::OnePass_AntiKT_Axes onepass_antikt_axes(akAxesR0);
-        fastjet::contrib::OnePass_WTA_KT_Axes onepass_wta_kt_axes;
-        fastjet::contrib::OnePass_WTA_CA_Axes onepass_wta_ca_axes;
-        fastjet::contrib::MultiPass_Axes      multipass_axes     (nPass);
-
-        fastjet::contrib::AxesDefinition const * axesDef = 0;
-        switch ( axesdefenum ) {
-          case  njettiness::KT_Axes : default   : axesDef = &kt_axes; break;
-          case  njettiness::CA_Axes             : axesDef = &ca_axes; break;
-          case  njettiness::AntiKT_Axes         : axesDef = &antikt_axes; break;
-          case  njettiness::WTA_KT_Axes         : axesDef = &wta_kt_axes; break;
-          case  njettiness::WTA_CA_Axes         : axesDef = &wta_ca_axes; break;
-          case  njettiness::OnePass_KT_Axes     : axesDef = &onepass_kt_axes; break;
-          case  njettiness::OnePass_CA_Axes     : axesDef = &onepass_ca_axes; break;
-          case  njettiness::OnePass_AntiKT_Axes : axesDef = &onepass_antikt_axes; break;
-          case  njettiness::OnePass_WTA_KT_Axes : axesDef = &onepass_wta_kt_axes; break;
-          case  njettiness::OnePass_WTA_CA_Axes : axesDef = &onepass_wta_ca_axes; break;
-          case  njettiness::MultiPass_Axes      : axesDef = &multipass_axes; break;
-        }
-
-        auto routine = std::make_shared<fastjet::contrib::Njettiness>(*axesDef, *measureDef);
-
-        const auto& constituents = ow.parts;
-        std::vector<double> taus;
-        taus.reserve( constituents.size()*njets.size() );
-
-        for (size_t i = 0; i < constituents.size(); ++i) {
-            for(size_t k = 0; k < njets.size(); ++k) {
-              auto tau = routine->getTau(njets[k], *constituents[i]);
-              taus.push_back(tau);
-            }
-        }
+        ow.require_sequences("N-jettiness");
+        auto routine = make_njettiness(measure_definition, axes_definition, beta, R0, Rcutoff, nPass, akAxesR0);
+
+        const auto& constituents = *ow.parts;
+        auto taus = export_columns(constituents.n_events(), [&](std::size_t i) {
+          const auto& event = event_scratch(constituents, i);
+          std::vector<double> event_taus;
+          event_taus.reserve(njets.size());
+          for(size_t k = 0; k < njets.size(); ++k) {
+            event_taus.push_back(routine->getTau(njets[k], event));
+          }
+          return event_taus;
+        }, extract::value);
 
-        auto taus_out = py::array(taus.size(), taus.data());
-        taus_out.resize({taus.size()/njets.size(), njets.size()});
+        auto taus_out = taus[0].attr("reshape")(constituents.n_events(), njets.size());
 
         return std::make_tuple(
           taus_out
         );
-      }, R"pbdoc(
+      }, timed, R"pbdoc(
         Calculates njettiness values from inputs and converts them to numpy arrays.
         Args:
           None.
         Returns:
           the <njets>-tuple of njettiness values for all found jets, and their offsets
+      )pbdoc")
+    .def("to_numpy_jet_observables",
+      [](const output_wrapper &ow, py::list observables, const int n_jets = 0, double min_pt = 0) {
+        jet_observable_set requested(observables, ow.single_precision);
+        requested.fill(ow, n_jets, min_pt);
+        return requested.release();
+      }, "observables"_a, "n_jets"_a = 0, "min_pt"_a = 0, timed, R"pbdoc(
+        Computes several per-jet observables of the same jets in a single pass over the events.
+        Args:
+          observables: list of dicts, each naming an "observable" (momentum, constituent_index, softdrop, energy_correlator, lund_declusterings, nsubjettiness or area), an optional output "name" and its parameters.
+          n_jets: Number of exclusive jets; inclusive jets are used when <= 0. Default: 0.
+          min_pt: Minimum pt of the inclusive jets. Default: 0.
+        Returns:
+          dict of per-jet fields (arrays, or (offsets, values) tuples for lists per jet), and event offsets.
+      )pbdoc");
+
+  typedef std::vector<fj::PseudoJet> one_jet_per_event;
+  def_jet_query<double>(output_wrapper_class, "to_numpy_exclusive_subjets_dcut",
+      [](const output_wrapper &ow, const one_jet_per_event &jets, double dcut) {
+        return export_momenta(ow, [&](std::size_t i) {
+          return ow.visit(i, [&](const auto &cs) { return cs.exclusive_subjets(jets[i], dcut); });
+        });
+      }, R"pbdoc(
+        Retrieves the exclusive subjets of one jet per event with dij above dcut.
+        Args:
+          jets: cluster_hist_index of the jet in each event, or its px, py, pz, E.
+          dcut: Distance cut.
+        Returns:
+          px, py, pz, E, cluster_hist_index of the subjets, and event offsets.
+      )pbdoc");
+  def_jet_query<int>(output_wrapper_class, "to_numpy_exclusive_subjets_nsub",
+      [](const output_wrapper &ow, const one_jet_per_event &jets, int nsub) {
+        return export_momenta(ow, [&](std::size_t i) {
+          return ow.visit(i, [&](const auto &cs) { return cs.exclusive_subjets(jets[i], nsub); });
+        });
+      }, R"pbdoc(
+        Retrieves exactly nsub exclusive subjets of one jet per event.
+        Args:
+          jets: cluster_hist_index of the jet in each event, or its px, py, pz, E.
+          nsub: Number of subjets.
+        Returns:
+          px, py, pz, E, cluster_hist_index of the subjets, and event offsets.
+      )pbdoc");
+  def_jet_query<int>(output_wrapper_class, "to_numpy_exclusive_subjets_up_to",
+      [](const output_wrapper &ow, const one_jet_per_event &jets, int nsub) {
+        return export_momenta(ow, [&](std::size_t i) {
+          return ow.visit(i, [&](const auto &cs) { return cs.exclusive_subjets_up_to(jets[i], nsub); });
+        });
+      }, R"pbdoc(
+        Retrieves up to nsub exclusive subjets of one jet per event.
+        Args:
+          jets: cluster_hist_index of the jet in each event, or its px, py, pz, E.
+          nsub: Maximum number of subjets.
+        Returns:
+          px, py, pz, E, cluster_hist_index of the subjets, and event offsets.
+      )pbdoc");
+  def_jet_query<int>(output_wrapper_class, "to_numpy_exclusive_subdmerge",
+      [](const output_wrapper &ow, const one_jet_per_event &jets, int nsub) {
+        return export_event_values(ow.cse.size(), [&](std::size_t i) {
+          return ow.visit(i, [&](const auto &cs) { return cs.exclusive_subdmerge(jets[i], nsub); });
+        });
+      }, R"pbdoc(
+        Retrieves the dij of the merging from nsub + 1 to nsub subjets of one jet per event.
+        Args:
+          jets: cluster_hist_index of the jet in each event, or its px, py, pz, E.
+          nsub: Number of subjets.
+        Returns:
+          dij per event, and event offsets.
+      )pbdoc");
+  def_jet_query<int>(output_wrapper_class, "to_numpy_exclusive_subdmerge_max",
+      [](const output_wrapper &ow, const one_jet_per_event &jets, int nsub) {
+        return export_event_values(ow.cse.size(), [&](std::size_t i) {
+          return ow.visit(i, [&](const auto &cs) { return cs.exclusive_subdmerge_max(jets[i], nsub); });
+        });
+      }, R"pbdoc(
+        Retrieves the largest dij of the mergings down to nsub subjets of one jet per event.
+        Args:
+          jets: cluster_hist_index of the jet in each event, or its px, py, pz, E.
+          nsub: Number of subjets.
+        Returns:
+          dij per event, and event offsets.
+      )pbdoc");
+  def_jet_query<double>(output_wrapper_class, "to_numpy_n_exclusive_subjets",
+      [](const output_wrapper &ow, const one_jet_per_event &jets, double dcut) {
+        return export_event_values(ow.cse.size(), [&](std::size_t i) {
+          return ow.visit(i, [&](const auto &cs) {
+            return static_cast<double>(cs.n_exclusive_subjets(jets[i], dcut));
+          });
+        });
+      }, R"pbdoc(
+        Retrieves the number of exclusive subjets of one jet per event with dij above dcut.
+        Args:
+          jets: cluster_hist_index of the jet in each event, or its px, py, pz, E.
+          dcut: Distance cut.
+        Returns:
+          number of subjets per event, and event offsets.
+      )pbdoc");
+  def_jet_query<>(output_wrapper_class, "to_numpy_has_parents",
+      [](const output_wrapper &ow, const one_jet_per_event &jets) {
+        return export_event_values(ow.cse.size(), [&](std::size_t i) {
+          fj::PseudoJet pj1(0,0,0,0);
+          fj::PseudoJet pj2(0,0,0,0);
+          return ow.visit(i, [&](const auto &cs) {
+            return cs.has_parents(jets[i], pj1, pj2);
+          });
+        });
+      }, R"pbdoc(
+        Tells whether the given jet has parents or not.
+        Args:
+          jets: cluster_hist_index of the jet in each event, or its px, py, pz, E.
+        Returns:
+          flag per event, and event offsets.
+      )pbdoc");
+  def_jet_query<>(output_wrapper_class, "to_numpy_has_child",
+      [](const output_wrapper &ow, const one_jet_per_event &jets) {
+        return export_event_values(ow.cse.size(), [&](std::size_t i) {
+          fj::PseudoJet pj1(0,0,0,0);
+          return ow.visit(i, [&](const auto &cs) {
+            return cs.has_child(jets[i], pj1);
+          });
+        });
+      }, R"pbdoc(
+        Tells whether the given jet has children or not.
+        Args:
+          jets: cluster_hist_index of the jet in each event, or its px, py, pz, E.
+        Returns:
+          flag per event, and event offsets.
+      )pbdoc");
+  def_jet_query<>(output_wrapper_class, "to_numpy_jet_scale_for_algorithm",
+      [](const output_wrapper &ow, const one_jet_per_event &jets) {
+        ow.require_sequences("jet_scale_for_algorithm");
+        return export_event_values(ow.cse.size(), [&](std::size_t i) {
+          return ow.cse[i]->jet_scale_for_algorithm(jets[i]);
+        });
+      }, R"pbdoc(
+        Retrieves the scale associated with the given jet by the clustering algorithm.
+        Args:
+          jets: cluster_hist_index of the jet in each event, or its px, py, pz, E.
+        Returns:
+          scale per event, and event offsets.
+      )pbdoc");
+  def_jet_query<>(output_wrapper_class, "to_numpy_get_parents",
+      [](const output_wrapper &ow, const one_jet_per_event &jets) {
+        return export_momenta(ow, [&](std::size_t i) {
+          std::vector<fj::PseudoJet> parents;
+          fj::PseudoJet pj1(0,0,0,0);
+          fj::PseudoJet pj2(0,0,0,0);
+          if (ow.visit(i, [&](const auto &cs) {
+                return cs.has_parents(jets[i], pj1, pj2);
+              })) {
+            parents.push_back(pj1);
+            parents.push_back(pj2);
+          }
+          return parents;
+        });
+      }, R"pbdoc(
+        Retrieves the parents of the given jet.
+        Args:
+          jets: cluster_hist_index of the jet in each event, or its px, py, pz, E.
+        Returns:
+          px, py, pz, E, cluster_hist_index of the parents, and event offsets.
+      )pbdoc");
+  def_jet_query<>(output_wrapper_class, "to_numpy_get_child",
+      [](const output_wrapper &ow, const one_jet_per_event &jets) {
+        return export_momenta(ow, [&](std::size_t i) {
+          std::vector<fj::PseudoJet> child;
+          fj::PseudoJet pj1(0,0,0,0);
+          if (ow.visit(i, [&](const auto &cs) {
+                return cs.has_child(jets[i], pj1);
+              })) {
+            child.push_back(pj1);
+          }
+          return child;
+        });
+      }, R"pbdoc(
+        Retrieves the child of the given jet.
+        Args:
+          jets: cluster_hist_index of the jet in each event, or its px, py, pz, E.
+        Returns:
+          px, py, pz, E, cluster_hist_index of the child, and event offsets.
       )pbdoc");
   py::class_<ClusterSequence>(m, "ClusterSequence")
       .def(py::init<const std::vector<PseudoJet> &, const JetDefinition &,
@@ -2511,11 +4599,4 @@ PYBIND11_MODULE(_ext, m) {
            "Create a ClusterSequence, starting from the supplied set of "
            "PseudoJets and clustering them with jet definition specified by "
            "jet_definition (which also specifies the clustering strategy)");
-  
-  py::module
-//DL hack for testing
-//class MyRecombiner : public fastjet::JetDefinition::Recombiner {
-//py::class_<MyRecombiner>(m, "MyRecombiner")
-//      .def(py::init());
-      //.def("instance", &MyRecombiner::instance);
 }
@@ -4,9 +4,19 @@ from typing import Union
 
 import awkward as ak
 
+import fastjet._cache  # noqa: F401, E402
 import fastjet._ext  # noqa: F401, E402
 import fastjet._pyjet  # noqa: F401, E402
+import fastjet._strategies  # noqa: F401, E402
 import fastjet._swig  # noqa: F401, E402
+from fastjet._cache import get_cache_dir  # noqa: F401, E402
+from fastjet._cache import set_cache_dir  # noqa: F401, E402
+from fastjet._ext import batch_stats  # noqa: F401, E402
+from fastjet._ext import get_num_threads  # noqa: F401, E402
+from fastjet._ext import set_num_threads  # noqa: F401, E402
+from fastjet._strategies import calibrate_strategies  # noqa: F401, E402
+from fastjet._strategies import get_strategy_table  # noqa: F401, E402
+from fastjet._strategies import set_strategy_table  # noqa: F401, E402
 from fastjet._swig import AreaDefinition  # noqa: F401, E402
 from fastjet._swig import BackgroundEstimatorBase  # noqa: F401, E402
 from fastjet._swig import BackgroundJetPtDensity  # noqa: F401, E402
@@ -240,15 +250,58 @@ class ClusterSequence:  # The super class
     Args:
         data(awkward.highlevel.Array): The data for clustering.
         jetdef(fastjet._swig.JetDefinition): The JetDefinition for clustering specification.
+        n_threads(int): Number of threads used to cluster the events of an Awkward or Dask-Awkward Array.
+            ``None`` uses the process-wide default (see ``fastjet.set_num_threads``), ``0`` uses every available core.
+        with_index(bool): Whether jets returned for an Awkward or Dask-Awkward Array carry their ``cluster_hist_index``.
+            Subjet and history queries given such jets look them up by this index instead of matching their momenta.
+        output_dtype(str or numpy.dtype): Floating point type, ``"float64"`` (the default) or ``"float32"``, of the jet and
+            constituent four-momenta returned for an Awkward or Dask-Awkward Array. Input of either type is read without conversion.
+        compact_history(bool): Whether to keep only the merge tree of each event of an Awkward or Dask-Awkward Array instead of
+            its full ClusterSequence. This takes much less memory and answers the inclusive, exclusive, subjet and history
+            queries; SoftDrop, energy correlators, Lund declusterings and N-jettiness then raise a RuntimeError.
+        coordinates(str): Coordinates of the jet and particle four-momenta returned for an Awkward or Dask-Awkward Array:
+            ``"cartesian"`` (px, py, pz, E; the default), ``"ptetaphim"`` (pt, eta, phi, mass) or ``"ptetaphie"`` (pt, eta, phi, E).
+        recombiner(str or tuple): Compiled recombination scheme replacing that of ``jetdef`` for an Awkward or Dask-Awkward Array:
+            ``"wta_pt"``, ``"wta_E"``, ``"massless_E"``, ``"pt_weighted"`` or ``("generalized_wta", delta)``. ``None`` keeps that of ``jetdef``.
+        particle_selection(fastjet.Selector or dict): Selection of the particles of an Awkward or Dask-Awkward Array that are clustered,
+            applied as they are read: a Selector acting particle by particle, or a dict of ``pt_min``, ``pt_max``, ``abs_rap_min``,
+            ``abs_rap_max``, ``E_min`` and ``E_max`` cuts. Constituent indices still refer to the positions of the unselected particles.
+        area_definition(fastjet.AreaDefinition): Measures the areas of the jets of an Awkward or Dask-Awkward Array, which then carry
+            ``area``, ``area_px``, ``area_py``, ``area_pz``, ``area_E`` and ``n_ghosts`` fields. ``active_area_explicit_ghosts`` is not supported.
+        area_seed(int): Seed from which the ghosts of every event are generated, so that areas do not depend on the number of threads.
     """
 
-    def __init__(self, data, jetdef):
+    def __init__(
+        self,
+        data,
+        jetdef,
+        n_threads=None,
+        with_index=False,
+        output_dtype=None,
+        compact_history=False,
+        coordinates="cartesian",
+        recombiner=None,
+        particle_selection=None,
+        area_definition=None,
+        area_seed=0,
+    ):
         if not isinstance(jetdef, fastjet._swig.JetDefinition):
             raise AttributeError("JetDefinition is not correct") from None
         if isinstance(data, ak.Array):
             self.__class__ = fastjet._pyjet.AwkwardClusterSequence
             fastjet._pyjet.AwkwardClusterSequence.__init__(
-                self, data=data, jetdef=jetdef
+                self,
+                data=data,
+                jetdef=jetdef,
+                n_threads=n_threads,
+                with_index=with_index,
+                output_dtype=output_dtype,
+                compact_history=compact_history,
+                coordinates=coordinates,
+                recombiner=recombiner,
+                particle_selection=particle_selection,
+                area_definition=area_definition,
+                area_seed=area_seed,
             )
         elif isinstance(data, list):
             self.__class__ = fastjet._swig.ClusterSequence
@@ -261,7 +314,18 @@ class ClusterSequence:  # The super class
             if dak is not None and isinstance(data, dak.Array):
                 self.__class__ = fastjet._pyjet.DaskAwkwardClusterSequence
                 fastjet._pyjet.DaskAwkwardClusterSequence.__init__(
-                    self, data=data, jetdef=jetdef
+                    self,
+                    data=data,
+                    jetdef=jetdef,
+                    n_threads=n_threads,
+                    with_index=with_index,
+                    output_dtype=output_dtype,
+                    compact_history=compact_history,
+                    coordinates=coordinates,
+                    recombiner=recombiner,
+                    particle_selection=particle_selection,
+                    area_definition=area_definition,
+                    area_seed=area_seed,
                 )
             else:
                 raise TypeError(
@@ -290,6 +354,43 @@ class ClusterSequence:  # The super class
         """
         raise AssertionError()
 
+    def background_estimate(
+        self, estimator: str = "grid", rho_m: bool = False, **options
+    ) -> ak.Array:
+        """Returns the background density of each event, estimated from its input particles.
+
+        Args:
+            estimator (str): ``"grid"`` for the median over the cells of a rapidity-azimuth grid, or ``"jet_median"`` for the median over the jets of a clustering with explicit ghosts.
+            rho_m (bool): Whether to also estimate the mass density rho_m and its fluctuation sigma_m.
+            options: ``rap_max`` (5.0) and, for the grid, ``grid_spacing`` (0.55); for ``"jet_median"``, ``jet_definition`` (kt, R = 0.4), ``area_definition`` (active_area_explicit_ghosts up to rap_max), ``rho_range`` (a fastjet.Selector acting jet by jet without a reference, by default abs(y) < rap_max - R; a Selector given here is applied with the GIL held, one event at a time) and ``seed`` for the ghosts of each event.
+
+        Returns:
+            awkward.highlevel.Array: Returns an Awkward Array of records with the fields ``rho`` and ``sigma`` (and ``rho_m`` and ``sigma_m``), one per event.
+        """
+        raise AssertionError()
+
+    def inclusive_jets_subtracted(
+        self,
+        min_pt: float = 0,
+        estimator: str = "grid",
+        rho_m: bool = False,
+        **options,
+    ) -> ak.Array:
+        """Returns the inclusive jets after subtracting the background of their event, rho times their area 4-vector.
+
+        The events must be clustered with an ``area_definition``. The background is estimated as in ``background_estimate``, event by event in the same pass.
+
+        Args:
+            min_pt (float): The minimum value of the pt of the subtracted jets.
+            estimator (str): The background estimator, ``"grid"`` or ``"jet_median"``.
+            rho_m (bool): Whether to also subtract rho_m, correcting the jet masses.
+            options: The estimator options of ``background_estimate``.
+
+        Returns:
+            awkward.highlevel.Array: Returns an Awkward Array of the same type as the input containing the subtracted inclusive jets, with their area fields.
+        """
+        raise AssertionError()
+
     def unclustered_particles(self) -> ak.Array:
         """Returns the unclustered particles after clustering in the same format as the input awkward array
 
@@ -395,6 +496,34 @@ class ClusterSequence:  # The super class
         """
         raise AssertionError()
 
+    def exclusive_jets_softdrop_observables(
+        self,
+        njets: int = 1,
+        beta: float = 0.0,
+        symmetry_cut: float = 0.1,
+        symmetry_measure: str = "scalar_z",
+        R0: float = 0.8,
+        recursion_choice: str = "larger_pt",
+        mu_cut: float = float("inf"),
+    ) -> ak.Array:
+        """Returns the SoftDrop observables of each exclusive jet, without building the groomed jets.
+
+        Jets clustered with the Cambridge/Aachen algorithm are declustered through their own clustering history; jets from other algorithms are reclustered with C/A first, as SoftDrop does. Events are groomed on ``n_threads`` threads. A finite ``mu_cut`` adds the mass drop condition of the modified mass drop tagger.
+
+        Args:
+            njets (int): The number of jets it was clustered to.
+            beta (float): The SoftDrop angular exponent.
+            symmetry_cut (float): The SoftDrop symmetry cut.
+            symmetry_measure (str): ``"scalar_z"``, ``"vector_z"``, ``"y"``, ``"theta_E"`` or ``"cos_theta_E"``.
+            R0 (float): The SoftDrop angular scale.
+            recursion_choice (str): Which branch to follow after a failed splitting: ``"larger_pt"``, ``"larger_mt"``, ``"larger_m"`` or ``"larger_E"``.
+            mu_cut (float): The mass drop parameter mu; infinite for none.
+
+        Returns:
+            awkward.highlevel.Array: Returns an Awkward Array of records with the fields ``zg`` and ``Rg`` of the splitting that passed, 0 when the jet was groomed down to one particle, and the ``mass`` and ``pt`` of the groomed jet, one per jet.
+        """
+        raise AssertionError()
+
     def exclusive_jets_energy_correlator(
         self,
         njets: int = 1,
@@ -418,6 +547,31 @@ class ClusterSequence:  # The super class
         """
         raise AssertionError()
 
+    def jet_observables(
+        self, observables: list, njets: int = None, min_pt: float = 0
+    ) -> ak.Array:
+        """Computes several observables of the same jets in a single pass over the events.
+
+        The jets, and the constituents of each jet, are extracted once and shared by
+        all requested observables, which come back as the fields of one record per jet.
+
+        Args:
+            observables (list): The observables to compute. Each entry is either the name
+                of an observable or a dict with the name under "observable", an optional
+                output field "name" and the keyword arguments of the matching method.
+                Supported observables are "momentum" (px, py, pz, E, or the fields of the
+                ClusterSequence coordinates, which a "coordinates" key overrides), "constituent_index",
+                "softdrop" (msoftdrop, ptsoftdrop, ...), "energy_correlator",
+                "lund_declusterings", "nsubjettiness" (N-subjettiness of each jet) and "area" (area,
+                area_px, area_py, area_pz, area_E, n_ghosts; needs an area_definition).
+            njets (int): The number of exclusive jets. Inclusive jets are used if None.
+            min_pt (float): The minimum pt of the inclusive jets.
+
+        Returns:
+            awkward.highlevel.Array: Returns an Awkward Array with one record per jet.
+        """
+        raise AssertionError()
+
     def exclusive_jets_lund_declusterings(self, njets: int = 10) -> ak.Array:
         """Returns the Lund declustering Delta and k_T parameters from exclusive n_jets.
 
@@ -430,6 +584,37 @@ class ClusterSequence:  # The super class
 
         raise AssertionError()
 
+    def exclusive_jets_multi(
+        self,
+        n_jets: Union[int, list, None] = None,
+        dcut: Union[float, list, None] = None,
+        ycut: Union[float, list, None] = None,
+    ) -> ak.Array:
+        """Returns the exclusive jets for several numbers of jets, or for several dcut or ycut values, undoing the clusterings of each event once for all of them.
+
+        Args:
+            n_jets (int or list): The numbers of exclusive jets.
+            dcut (float or list): The dcut values, used instead of n_jets.
+            ycut (float or list): The ycut values, used instead of n_jets.
+
+        Returns:
+            awkward.highlevel.Array: Returns an Awkward Array with, for each event, one list of jets per requested value.
+            Counting these jets (``ak.num(..., axis=2)``) gives the jet rates over a dcut or ycut grid.
+        """
+        raise AssertionError()
+
+    def exclusive_dmerge_spectrum(self, ymerge: bool = False) -> ak.Array:
+        """Returns, for every number of jets n below the number of particles, the dmin of the recombination that went from n+1 to n jets.
+
+        Args:
+            ymerge (bool): Whether to return ymerge and ymerge_max, divided by Q2, instead of dmerge and dmerge_max.
+
+        Returns:
+            awkward.highlevel.Array: Returns an Awkward Array with the fields ``dmerge`` and ``dmerge_max`` (or ``ymerge`` and
+            ``ymerge_max``) for n = 0, 1, ... in each event.
+        """
+        raise AssertionError()
+
     def exclusive_dmerge(self, njets: int = 10) -> Union[ak.Array, float]:
         """Returns the dmin corresponding to the recombination that went from n+1 to n jets.
 
@@ -676,6 +861,67 @@ class ClusterSequence:  # The super class
         raise AssertionError()
 
 
+def stream_jet_observables(
+    chunks,
+    jetdef,
+    observables,
+    njets=None,
+    min_pt=0,
+    batch_size=1000,
+    n_threads=None,
+    output_dtype=None,
+    coordinates="cartesian",
+    recombiner=None,
+    particle_selection=None,
+    area_definition=None,
+    area_seed=0,
+):
+    """Clusters chunks of events and yields only the requested per-jet observables of each chunk.
+
+    The events of a chunk are clustered ``batch_size`` at a time, and the clustering of each batch is freed as soon as its
+    observables are extracted, so the memory used does not grow with the size of the chunks or with their number.
+
+    Args:
+        chunks (iterable of awkward.highlevel.Array): Chunks of events, each an Array of lists of particles, for example
+            from ``uproot.iterate``. A single Array is treated as one chunk.
+        jetdef (fastjet._swig.JetDefinition): The JetDefinition for clustering specification.
+        observables (list): The observables to compute, as for ``ClusterSequence.jet_observables``.
+        njets (int): Number of exclusive jets per event. Inclusive jets are used when it is not given.
+        min_pt (float): The minimum pt of the inclusive jets.
+        batch_size (int): Number of events clustered before their observables are extracted.
+        n_threads (int): Number of threads, as for ``ClusterSequence``.
+        output_dtype (str or numpy.dtype): Floating point type of the jet four-momenta, as for ``ClusterSequence``.
+        coordinates (str): Coordinates of the jet four-momenta, as for ``ClusterSequence``.
+        recombiner (str or tuple): Compiled recombination scheme, as for ``ClusterSequence``.
+        particle_selection (fastjet.Selector or dict): Selection of the clustered particles, as for ``ClusterSequence``.
+        area_definition (fastjet.AreaDefinition): Measures the jet areas, for the ``"area"`` observable.
+        area_seed (int): Seed of the ghosts, as for ``ClusterSequence``.
+
+    Yields:
+        awkward.highlevel.Array: One record per jet, with one field per observable, for each chunk.
+    """
+    if not isinstance(jetdef, fastjet._swig.JetDefinition):
+        raise AttributeError("JetDefinition is not correct") from None
+    if isinstance(chunks, ak.Array):
+        chunks = (chunks,)
+    for chunk in chunks:
+        yield fastjet._multievent._stream_jet_observables(
+            chunk,
+            jetdef,
+            observables,
+            njets,
+            min_pt,
+            batch_size,
+            n_threads,
+            output_dtype,
+            coordinates,
+            recombiner,
+            particle_selection,
+            area_definition,
+            area_seed,
+        )
+
+
 class multi_inheritor(
     fastjet._swig.ClusterSequence, ClusterSequence
 ):  # class that inherits both the custom ClusterSequence and swig ClusterSequence and acts as a trampoline
@@ -0,0 +1,153 @@
+import hashlib
+import mmap
+import os
+import tempfile
+
+import numpy as np
+
+import fastjet._ext  # noqa: F401, E402
+import fastjet._swig  # noqa: F401, E402
+
+# bumped whenever the key or the serialized format changes, so that files
+# written by other versions are never read back
+_format = b"fastjet-results-2"
+
+_cache_dir = None
+
+
+def set_cache_dir(path):
+    """Keeps the results of every batch clustering in ``path``, and loads them back
+    instead of clustering again when the same inputs are clustered with the same
+    options. ``None`` turns the cache off, which is the default. Clusterings with a
+    plugin, an external recombiner, a Selector or jet areas always run.
+    """
+    global _cache_dir
+    if path is not None:
+        path = os.fspath(path)
+        os.makedirs(path, exist_ok=True)
+    _cache_dir = path
+
+
+def get_cache_dir():
+    """Returns the directory of the clustering result cache, or ``None`` when it is off."""
+    return _cache_dir
+
+
+def _option_key(value):
+    # SWIG objects by their description, which only identifies compiled ones
+    if hasattr(value, "description"):
+        return value.description()
+    if isinstance(value, dict):
+        return repr(sorted((k, _option_key(v)) for k, v in value.items()))
+    return repr(value)
+
+
+def _key(arrays, jetdef, options):
+    digest = hashlib.blake2b(_format, digest_size=20)
+    for array in arrays:
+        array = np.ascontiguousarray(array)
+        digest.update(array.dtype.str.encode())
+        digest.update(np.int64(len(array)).tobytes())
+        digest.update(memoryview(array).cast("B"))
+    digest.update(jetdef.description().encode())
+    for name in sorted(options):
+        # the number of threads does not change the results
+        if name != "n_threads":
+            digest.update(f"{name}={_option_key(options[name])};".encode())
+    return digest.hexdigest()
+
+
+class _StoredResults:
+    # Results found in the cache, restored from their file on the first query:
+    # deserialize copies the columns out of the file and replays the history
+    # of every event, so nothing refers to the file afterwards. A damaged file
+    # is clustered again and replaced.
+    def __init__(self, path, n_threads, cluster):
+        self._path = path
+        self._n_threads = n_threads
+        self._cluster = cluster
+        self._results = None
+
+    def _load(self):
+        if self._results is None:
+            try:
+                with open(self._path, "rb") as f, mmap.mmap(
+                    f.fileno(), 0, access=mmap.ACCESS_READ
+                ) as mapped:
+                    self._results = fastjet._ext.output_wrapper.deserialize(
+                        mapped, n_threads=self._n_threads
+                    )
+            except (OSError, ValueError):
+                self._results = self._cluster()
+                _try_store(self._path, self._results)
+            self._cluster = None
+        return self._results
+
+    def __getattr__(self, name):
+        if name.startswith("_"):
+            raise AttributeError(name)
+        return getattr(self._load(), name)
+
+    def __reduce__(self):
+        return (_loaded, (self._load(),))
+
+
+def _loaded(results):
+    return results
+
+
+def _store(path, results):
+    buffer = results.serialize()
+    # written next to its final name and renamed, so that concurrent readers
+    # see either no file or a complete one
+    fd, tmp = tempfile.mkstemp(dir=os.path.dirname(path), suffix=".tmp")
+    try:
+        with os.fdopen(fd, "wb") as f:
+            f.write(memoryview(buffer))
+        os.replace(tmp, path)
+    except BaseException:
+        os.unlink(tmp)
+        raise
+
+
+def _cacheable(jetdef, options):
+    # plugins, external recombiners (e.g. RecombinerPython) and Selectors, which
+    # may be a SelectorPython, are only known by a description that need not
+    # tell two of them apart; areas depend on ghosts that the serialized history
+    # does not keep
+    return (
+        jetdef.jet_algorithm() != fastjet._swig.plugin_algorithm
+        and jetdef.recombination_scheme() != fastjet._swig.external_scheme
+        and options.get("selector") is None
+        and options.get("area_definition") is None
+    )
+
+
+def _try_store(path, results):
+    # the results are there whether or not they could be kept; a cache that
+    # cannot be written to must not fail the query that filled it
+    try:
+        _store(path, results)
+    except OSError:
+        pass
+
+
+def interfacemulti(px, py, pz, E, starts, stops, jetdef, **options):
+    """Clusters a batch with fastjet._ext.interfacemulti, through the result cache
+    when one is set."""
+
+    def cluster():
+        return fastjet._ext.interfacemulti(
+            px, py, pz, E, starts, stops, jetdef, **options
+        )
+
+    directory = _cache_dir
+    if directory is None or not _cacheable(jetdef, options):
+        return cluster()
+    key = _key((px, py, pz, E, starts, stops), jetdef, options)
+    path = os.path.join(directory, key + ".fjres")
+    if os.path.exists(path):
+        return _StoredResults(path, options.get("n_threads", -1), cluster)
+    results = cluster()
+    _try_store(path, results)
+    return results
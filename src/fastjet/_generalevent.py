@@ -3,15 +3,35 @@ import warnings
 import awkward as ak
 import numpy as np
 
+import fastjet._cache
 import fastjet._ext  # noqa: F401, E402
+import fastjet._multievent
 
 _default_taus_njettiness = [1, 2, 3, 4]
 
 
+@fastjet._multievent._timed_queries
 class _classgeneralevent:
-    def __init__(self, data, jetdef):
+    def __init__(
+        self,
+        data,
+        jetdef,
+        n_threads=None,
+        with_index=False,
+        output_dtype=None,
+        compact_history=False,
+        coordinates="cartesian",
+        recombiner=None,
+        particle_selection=None,
+        area_definition=None,
+        area_seed=0,
+    ):
         self.jetdef = jetdef
         self.data = data
+        self._with_index = with_index
+        self._coordinates = fastjet._multievent._coordinates(coordinates)
+        self._n_threads = -1 if n_threads is None else n_threads
+        single_precision = fastjet._multievent._single_precision(output_dtype)
         self._mod_data = data
         self._bread_list = []
         self._clusterable_level = []
@@ -25,15 +45,33 @@ class _classgeneralevent:
                 behavior=self._clusterable_level[i].behavior,
                 attrs=self._clusterable_level[i].attrs,
             )
-            px, py, pz, E, starts, stops = self.extract_cons(self._clusterable_level[i])
-            px = self.correct_byteorder(px)
-            py = self.correct_byteorder(py)
-            pz = self.correct_byteorder(pz)
-            E = self.correct_byteorder(E)
-            starts = self.correct_byteorder(starts)
-            stops = self.correct_byteorder(stops)
+            with fastjet._multievent._phase("extract_cons"):
+                level = self._clusterable_level[i]
+                px, py, pz, E, starts, stops = self.extract_cons(level)
+            with fastjet._multievent._phase("correct_byteorder"):
+                px = self.correct_byteorder(px)
+                py = self.correct_byteorder(py)
+                pz = self.correct_byteorder(pz)
+                E = self.correct_byteorder(E)
+                starts = self.correct_byteorder(starts)
+                stops = self.correct_byteorder(stops)
             self._results.append(
-                fastjet._ext.interfacemulti(px, py, pz, E, starts, stops, jetdef)
+                fastjet._cache.interfacemulti(
+                    px,
+                    py,
+                    pz,
+                    E,
+                    starts,
+                    stops,
+                    jetdef,
+                    n_threads=self._n_threads,
+                    single_precision=single_precision,
+                    compact_history=compact_history,
+                    coordinates=self._coordinates,
+                    **fastjet._multievent._recombiner(recombiner),
+                    **fastjet._multievent._particle_selection(particle_selection),
+                    **fastjet._multievent._area(area_definition, area_seed),
+                )
             )
 
     def _check_listoffset_subtree(self, data):
@@ -482,15 +520,8 @@ class _classgeneralevent:
                 ak.Array(
                     ak.contents.ListOffsetArray(
                         ak.index.Index64(of),
-                        ak.contents.RecordArray(
-                            (
-                                ak.contents.NumpyArray(np_results[0]),
-                                ak.contents.NumpyArray(np_results[1]),
-                                ak.contents.NumpyArray(np_results[2]),
-                                ak.contents.NumpyArray(np_results[3]),
-                            ),
-                            ("px", "py", "pz", "E"),
-                            parameters={"__record__": "Momentum4D"},
+                        fastjet._multievent._momenta_record(
+                            np_results, self._with_index, self._coordinates
                         ),
                     ),
                     behavior=self.data.behavior,
@@ -654,25 +685,18 @@ class _classgeneralevent:
                 mu_cut,
             )
 
-        px = ak.unflatten(
-            ak.Array(ak.contents.NumpyArray(np_results[0])),
-            ak.Array(ak.contents.NumpyArray(np_results[4])),
-            highlevel=False,
+        offsets = ak.index.Index64(np_results[4])
+        px = ak.contents.ListOffsetArray(
+            offsets, ak.contents.NumpyArray(np_results[0])
         )
-        py = ak.unflatten(
-            ak.Array(ak.contents.NumpyArray(np_results[1])),
-            ak.Array(ak.contents.NumpyArray(np_results[4])),
-            highlevel=False,
+        py = ak.contents.ListOffsetArray(
+            offsets, ak.contents.NumpyArray(np_results[1])
         )
-        pz = ak.unflatten(
-            ak.Array(ak.contents.NumpyArray(np_results[2])),
-            ak.Array(ak.contents.NumpyArray(np_results[4])),
-            highlevel=False,
+        pz = ak.contents.ListOffsetArray(
+            offsets, ak.contents.NumpyArray(np_results[2])
         )
-        E = ak.unflatten(
-            ak.Array(ak.contents.NumpyArray(np_results[3])),
-            ak.Array(ak.contents.NumpyArray(np_results[4])),
-            highlevel=False,
+        E = ak.contents.ListOffsetArray(
+            offsets, ak.contents.NumpyArray(np_results[3])
         )
         jetpt = ak.Array(ak.contents.NumpyArray(np_results[5]))
         jeteta = ak.Array(ak.contents.NumpyArray(np_results[6]))
@@ -758,6 +782,73 @@ class _classgeneralevent:
         )
         return res
 
+    def jet_observables(self, observables, njets=None, min_pt=0):
+        if njets is not None and njets <= 0:
+            raise ValueError("Njets cannot be <= 0")
+        specs = fastjet._multievent._jet_observable_specs(
+            observables, self._with_index, self._coordinates
+        )
+
+        self._out = []
+        self._input_flag = 0
+        for i in range(len(self._clusterable_level)):
+            np_results = self._results[i].to_numpy_jet_observables(
+                specs, njets or 0, min_pt
+            )
+            self._out.append(
+                ak.Array(
+                    fastjet._multievent._jet_observables_layout(np_results, specs),
+                    behavior=self.data.behavior,
+                    attrs=self.data.attrs,
+                )
+            )
+        res = ak.Array(
+            self._replace_multi(),
+            behavior=self.data.behavior,
+            attrs=self.data.attrs,
+        )
+        return res
+
+    def exclusive_jets_softdrop_observables(
+        self,
+        njets=1,
+        beta=0.0,
+        symmetry_cut=0.1,
+        symmetry_measure="scalar_z",
+        R0=0.8,
+        recursion_choice="larger_pt",
+        mu_cut=float("inf"),
+    ):
+        if njets <= 0:
+            raise ValueError("Njets cannot be <= 0")
+
+        self._out = []
+        self._input_flag = 0
+        for i in range(len(self._clusterable_level)):
+            np_results = self._results[i].to_numpy_softdrop_observables(
+                njets,
+                beta,
+                symmetry_cut,
+                symmetry_measure,
+                R0,
+                recursion_choice,
+                mu_cut,
+                n_threads=self._n_threads,
+            )
+            self._out.append(
+                ak.Array(
+                    fastjet._multievent._softdrop_observables_layout(np_results),
+                    behavior=self.data.behavior,
+                    attrs=self.data.attrs,
+                )
+            )
+        res = ak.Array(
+            self._replace_multi(),
+            behavior=self.data.behavior,
+            attrs=self.data.attrs,
+        )
+        return res
+
     def exclusive_jets_energy_correlator(
         self,
         njets=1,
@@ -838,15 +929,8 @@ class _classgeneralevent:
                 ak.Array(
                     ak.contents.ListOffsetArray(
                         ak.index.Index64(of),
-                        ak.contents.RecordArray(
-                            (
-                                ak.contents.NumpyArray(np_results[0]),
-                                ak.contents.NumpyArray(np_results[1]),
-                                ak.contents.NumpyArray(np_results[2]),
-                                ak.contents.NumpyArray(np_results[3]),
-                            ),
-                            ("px", "py", "pz", "E"),
-                            parameters={"__record__": "Momentum4D"},
+                        fastjet._multievent._momenta_record(
+                            np_results, self._with_index, self._coordinates
                         ),
                     ),
                     behavior=self.data.behavior,
@@ -908,15 +992,8 @@ class _classgeneralevent:
                 ak.Array(
                     ak.contents.ListOffsetArray(
                         ak.index.Index64(of),
-                        ak.contents.RecordArray(
-                            (
-                                ak.contents.NumpyArray(np_results[0]),
-                                ak.contents.NumpyArray(np_results[1]),
-                                ak.contents.NumpyArray(np_results[2]),
-                                ak.contents.NumpyArray(np_results[3]),
-                            ),
-                            ("px", "py", "pz", "E"),
-                            parameters={"__record__": "Momentum4D"},
+                        fastjet._multievent._momenta_record(
+                            np_results, self._with_index, self._coordinates
                         ),
                     ),
                     behavior=self.data.behavior,
@@ -940,15 +1017,8 @@ class _classgeneralevent:
                 ak.Array(
                     ak.contents.ListOffsetArray(
                         ak.index.Index64(of),
-                        ak.contents.RecordArray(
-                            (
-                                ak.contents.NumpyArray(np_results[0]),
-                                ak.contents.NumpyArray(np_results[1]),
-                                ak.contents.NumpyArray(np_results[2]),
-                                ak.contents.NumpyArray(np_results[3]),
-                            ),
-                            ("px", "py", "pz", "E"),
-                            parameters={"__record__": "Momentum4D"},
+                        fastjet._multievent._momenta_record(
+                            np_results, self._with_index, self._coordinates
                         ),
                     ),
                     behavior=self.data.behavior,
@@ -983,15 +1053,8 @@ class _classgeneralevent:
                 ak.Array(
                     ak.contents.ListOffsetArray(
                         ak.index.Index64(of),
-                        ak.contents.RecordArray(
-                            (
-                                ak.contents.NumpyArray(np_results[0]),
-                                ak.contents.NumpyArray(np_results[1]),
-                                ak.contents.NumpyArray(np_results[2]),
-                                ak.contents.NumpyArray(np_results[3]),
-                            ),
-                            ("px", "py", "pz", "E"),
-                            parameters={"__record__": "Momentum4D"},
+                        fastjet._multievent._momenta_record(
+                            np_results, self._with_index, self._coordinates
                         ),
                     ),
                     behavior=self.data.behavior,
@@ -1018,15 +1081,8 @@ class _classgeneralevent:
                 ak.Array(
                     ak.contents.ListOffsetArray(
                         ak.index.Index64(of),
-                        ak.contents.RecordArray(
-                            (
-                                ak.contents.NumpyArray(np_results[0]),
-                                ak.contents.NumpyArray(np_results[1]),
-                                ak.contents.NumpyArray(np_results[2]),
-                                ak.contents.NumpyArray(np_results[3]),
-                            ),
-                            ("px", "py", "pz", "E"),
-                            parameters={"__record__": "Momentum4D"},
+                        fastjet._multievent._momenta_record(
+                            np_results, self._with_index, self._coordinates
                         ),
                     ),
                     behavior=self.data.behavior,
@@ -1051,15 +1107,8 @@ class _classgeneralevent:
                 ak.Array(
                     ak.contents.ListOffsetArray(
                         ak.index.Index64(of),
-                        ak.contents.RecordArray(
-                            (
-                                ak.contents.NumpyArray(np_results[0]),
-                                ak.contents.NumpyArray(np_results[1]),
-                                ak.contents.NumpyArray(np_results[2]),
-                                ak.contents.NumpyArray(np_results[3]),
-                            ),
-                            ("px", "py", "pz", "E"),
-                            parameters={"__record__": "Momentum4D"},
+                        fastjet._multievent._momenta_record(
+                            np_results, self._with_index, self._coordinates
                         ),
                     ),
                     behavior=self.data.behavior,
@@ -1095,6 +1144,102 @@ class _classgeneralevent:
         )
         return res
 
+    def exclusive_jets_multi(self, n_jets=None, dcut=None, ycut=None):
+        self._warn_for_exclusive()
+        params, by = fastjet._multievent._exclusive_jets_multi_params(
+            n_jets, dcut, ycut
+        )
+        self._out = []
+        self._input_flag = 0
+        for i in range(len(self._clusterable_level)):
+            np_results = self._results[i].to_numpy_exclusive_jets_multi(params, by)
+            self._out.append(
+                ak.Array(
+                    fastjet._multievent._exclusive_jets_multi_layout(
+                        np_results, self._with_index, self._coordinates
+                    ),
+                    behavior=self.data.behavior,
+                    attrs=self.data.attrs,
+                )
+            )
+        res = ak.Array(
+            self._replace_multi(),
+            behavior=self.data.behavior,
+            attrs=self.data.attrs,
+        )
+        return res
+
+    def background_estimate(self, estimator="grid", rho_m=False, **options):
+        self._out = []
+        self._input_flag = 0
+        for i in range(len(self._clusterable_level)):
+            np_results = self._results[i].to_numpy_background(
+                fastjet._multievent._background_options(estimator, rho_m, options),
+                n_threads=self._n_threads,
+            )
+            self._out.append(
+                ak.Array(
+                    fastjet._multievent._background_layout(np_results, rho_m),
+                    behavior=self.data.behavior,
+                    attrs=self.data.attrs,
+                )
+            )
+        res = ak.Array(
+            self._replace_multi(),
+            behavior=self.data.behavior,
+            attrs=self.data.attrs,
+        )
+        return res
+
+    def inclusive_jets_subtracted(
+        self, min_pt=0, estimator="grid", rho_m=False, **options
+    ):
+        self._out = []
+        self._input_flag = 0
+        for i in range(len(self._clusterable_level)):
+            np_results = self._results[i].to_numpy_subtracted_jets(
+                fastjet._multievent._background_options(estimator, rho_m, options),
+                min_pt=min_pt,
+                n_threads=self._n_threads,
+            )
+            self._out.append(
+                ak.Array(
+                    ak.contents.ListOffsetArray(
+                        ak.index.Index64(np_results[-1]),
+                        fastjet._multievent._momenta_record(
+                            np_results, self._with_index, self._coordinates
+                        ),
+                    ),
+                    behavior=self.data.behavior,
+                    attrs=self.data.attrs,
+                )
+            )
+        res = ak.Array(
+            self._replace_multi(),
+            behavior=self.data.behavior,
+            attrs=self.data.attrs,
+        )
+        return res
+
+    def exclusive_dmerge_spectrum(self, ymerge=False):
+        self._out = []
+        self._input_flag = 0
+        for i in range(len(self._clusterable_level)):
+            np_results = self._results[i].to_numpy_exclusive_dmerge_spectrum(ymerge)
+            self._out.append(
+                ak.Array(
+                    fastjet._multievent._dmerge_spectrum_layout(np_results, ymerge),
+                    behavior=self.data.behavior,
+                    attrs=self.data.attrs,
+                )
+            )
+        res = ak.Array(
+            self._replace_multi(),
+            behavior=self.data.behavior,
+            attrs=self.data.attrs,
+        )
+        return res
+
     def exclusive_dmerge(self, njets):
         self._out = []
         self._input_flag = 0
@@ -1220,10 +1365,7 @@ class _classgeneralevent:
         if len(self._cluster_inputs) == 0:
             raise TypeError("The Awkward Array is not valid")
         for i in range(len(self._cluster_inputs)):
-            px = self._cluster_inputs[i].px
-            py = self._cluster_inputs[i].py
-            pz = self._cluster_inputs[i].pz
-            E = self._cluster_inputs[i].E
+            jet = fastjet._multievent._jet_address(self._cluster_inputs[i])
             idx = -1
             for j in range(len(self._bread_list)):
                 if self._bread_list[j] == self._bread_list_input[i]:
@@ -1232,20 +1374,13 @@ class _classgeneralevent:
             if idx == -1:
                 continue
             assert len(self._cluster_inputs[i]) == len(self._clusterable_level[idx])
-            np_results = self._results[idx].to_numpy_get_parents(px, py, pz, E)
+            np_results = self._results[idx].to_numpy_get_parents(*jet)
             self._out.append(
                 ak.Array(
                     ak.contents.ListOffsetArray(
                         ak.index.Index64(np_results[-1]),
-                        ak.contents.RecordArray(
-                            (
-                                ak.contents.NumpyArray(np_results[0]),
-                                ak.contents.NumpyArray(np_results[1]),
-                                ak.contents.NumpyArray(np_results[2]),
-                                ak.contents.NumpyArray(np_results[3]),
-                            ),
-                            ("px", "py", "pz", "E"),
-                            parameters={"__record__": "Momentum4D"},
+                        fastjet._multievent._momenta_record(
+                            np_results, self._with_index, self._coordinates
                         ),
                     ),
                     behavior=self.data.behavior,
@@ -1271,10 +1406,7 @@ class _classgeneralevent:
         if len(self._cluster_inputs) == 0:
             raise TypeError("The Awkward Array is not valid")
         for i in range(len(self._cluster_inputs)):
-            px = self._cluster_inputs[i].px
-            py = self._cluster_inputs[i].py
-            pz = self._cluster_inputs[i].pz
-            E = self._cluster_inputs[i].E
+            jet = fastjet._multievent._jet_address(self._cluster_inputs[i])
             idx = -1
             for j in range(len(self._bread_list)):
                 if self._bread_list[j] == self._bread_list_input[i]:
@@ -1283,9 +1415,7 @@ class _classgeneralevent:
             if idx == -1:
                 continue
             assert len(self._cluster_inputs[i]) == len(self._clusterable_level[idx])
-            np_results = self._results[idx].to_numpy_exclusive_subdmerge(
-                px, py, pz, E, nsub
-            )
+            np_results = self._results[idx].to_numpy_exclusive_subdmerge(*jet, nsub)
             self._out.append(
                 ak.Array(
                     ak.contents.NumpyArray(np_results[0]),
@@ -1312,10 +1442,7 @@ class _classgeneralevent:
         if len(self._cluster_inputs) == 0:
             raise TypeError("The Awkward Array is not valid")
         for i in range(len(self._cluster_inputs)):
-            px = self._cluster_inputs[i].px
-            py = self._cluster_inputs[i].py
-            pz = self._cluster_inputs[i].pz
-            E = self._cluster_inputs[i].E
+            jet = fastjet._multievent._jet_address(self._cluster_inputs[i])
             for j in range(len(self._bread_list)):
                 if self._bread_list[j] == self._bread_list_input[i]:
                     idx = j
@@ -1329,12 +1456,12 @@ class _classgeneralevent:
                 raise ValueError("Njets cannot be 0")
             if dcut == -1 and nsub != -1:
                 np_results = self._results[idx].to_numpy_exclusive_subjets_nsub(
-                    px, py, pz, E, nsub
+                    *jet, nsub
                 )
                 of = np.insert(np_results[-1], len(np_results[-1]), len(np_results[0]))
             if nsub == -1 and dcut != -1:
                 np_results = self._results[idx].to_numpy_exclusive_subjets_dcut(
-                    px, py, pz, E, dcut
+                    *jet, dcut
                 )
                 of = np.insert(np_results[-1], len(np_results[-1]), len(np_results[0]))
             if np_results == 0 and of == 0:
@@ -1344,15 +1471,8 @@ class _classgeneralevent:
                 ak.Array(
                     ak.contents.ListOffsetArray(
                         ak.index.Index64(of),
-                        ak.contents.RecordArray(
-                            (
-                                ak.contents.NumpyArray(np_results[0]),
-                                ak.contents.NumpyArray(np_results[1]),
-                                ak.contents.NumpyArray(np_results[2]),
-                                ak.contents.NumpyArray(np_results[3]),
-                            ),
-                            ("px", "py", "pz", "E"),
-                            parameters={"__record__": "Momentum4D"},
+                        fastjet._multievent._momenta_record(
+                            np_results, self._with_index, self._coordinates
                         ),
                     ),
                     behavior=self.data.behavior,
@@ -1377,10 +1497,7 @@ class _classgeneralevent:
         if len(self._cluster_inputs) == 0:
             raise TypeError("The Awkward Array is not valid")
         for i in range(len(self._cluster_inputs)):
-            px = self._cluster_inputs[i].px
-            py = self._cluster_inputs[i].py
-            pz = self._cluster_inputs[i].pz
-            E = self._cluster_inputs[i].E
+            jet = fastjet._multievent._jet_address(self._cluster_inputs[i])
             for j in range(len(self._bread_list)):
                 if self._bread_list[j] == self._bread_list_input[i]:
                     idx = j
@@ -1388,23 +1505,14 @@ class _classgeneralevent:
             if idx == -1:
                 continue
             assert len(self._cluster_inputs[i]) == len(self._clusterable_level[idx])
-            np_results = self._results[idx].to_numpy_exclusive_subjets_up_to(
-                px, py, pz, E, nsub
-            )
+            np_results = self._results[idx].to_numpy_exclusive_subjets_up_to(*jet, nsub)
             of = np.insert(np_results[-1], len(np_results[-1]), len(np_results[0]))
             self._out.append(
                 ak.Array(
                     ak.contents.ListOffsetArray(
                         ak.index.Index64(of),
-                        ak.contents.RecordArray(
-                            (
-                                ak.contents.NumpyArray(np_results[0]),
-                                ak.contents.NumpyArray(np_results[1]),
-                                ak.contents.NumpyArray(np_results[2]),
-                                ak.contents.NumpyArray(np_results[3]),
-                            ),
-                            ("px", "py", "pz", "E"),
-                            parameters={"__record__": "Momentum4D"},
+                        fastjet._multievent._momenta_record(
+                            np_results, self._with_index, self._coordinates
                         ),
                     ),
                     behavior=self.data.behavior,
@@ -1429,10 +1537,7 @@ class _classgeneralevent:
         if len(self._cluster_inputs) == 0:
             raise TypeError("The Awkward Array is not valid")
         for i in range(len(self._cluster_inputs)):
-            px = self._cluster_inputs[i].px
-            py = self._cluster_inputs[i].py
-            pz = self._cluster_inputs[i].pz
-            E = self._cluster_inputs[i].E
+            jet = fastjet._multievent._jet_address(self._cluster_inputs[i])
             for j in range(len(self._bread_list)):
                 if self._bread_list[j] == self._bread_list_input[i]:
                     idx = j
@@ -1440,9 +1545,7 @@ class _classgeneralevent:
             if idx == -1:
                 continue
             assert len(self._cluster_inputs[i]) == len(self._clusterable_level[idx])
-            np_results = self._results[idx].to_numpy_exclusive_subdmerge_max(
-                px, py, pz, E, nsub
-            )
+            np_results = self._results[idx].to_numpy_exclusive_subdmerge_max(*jet, nsub)
             self._out.append(
                 ak.Array(
                     ak.contents.NumpyArray(np_results[0]),
@@ -1468,10 +1571,7 @@ class _classgeneralevent:
         if len(self._cluster_inputs) == 0:
             raise TypeError("The Awkward Array is not valid")
         for i in range(len(self._cluster_inputs)):
-            px = self._cluster_inputs[i].px
-            py = self._cluster_inputs[i].py
-            pz = self._cluster_inputs[i].pz
-            E = self._cluster_inputs[i].E
+            jet = fastjet._multievent._jet_address(self._cluster_inputs[i])
             for j in range(len(self._bread_list)):
                 if self._bread_list[j] == self._bread_list_input[i]:
                     idx = j
@@ -1479,9 +1579,7 @@ class _classgeneralevent:
             if idx == -1:
                 continue
             assert len(self._cluster_inputs[i]) == len(self._clusterable_level[idx])
-            np_results = self._results[idx].to_numpy_n_exclusive_subjets(
-                px, py, pz, E, dcut
-            )
+            np_results = self._results[idx].to_numpy_n_exclusive_subjets(*jet, dcut)
             self._out.append(
                 ak.Array(
                     ak.contents.NumpyArray(np_results[0]),
@@ -1507,10 +1605,7 @@ class _classgeneralevent:
         if len(self._cluster_inputs) == 0:
             raise TypeError("The Awkward Array is not valid")
         for i in range(len(self._cluster_inputs)):
-            px = self._cluster_inputs[i].px
-            py = self._cluster_inputs[i].py
-            pz = self._cluster_inputs[i].pz
-            E = self._cluster_inputs[i].E
+            jet = fastjet._multievent._jet_address(self._cluster_inputs[i])
             for j in range(len(self._bread_list)):
                 if self._bread_list[j] == self._bread_list_input[i]:
                     idx = j
@@ -1518,7 +1613,7 @@ class _classgeneralevent:
             if idx == -1:
                 continue
             assert len(self._cluster_inputs[i]) == len(self._clusterable_level[idx])
-            np_results = self._results[idx].to_numpy_has_parents(px, py, pz, E)
+            np_results = self._results[idx].to_numpy_has_parents(*jet)
             self._out.append(
                 ak.Array(
                     ak.contents.NumpyArray(np_results[0]),
@@ -1544,10 +1639,7 @@ class _classgeneralevent:
         if len(self._cluster_inputs) == 0:
             raise TypeError("The Awkward Array is not valid")
         for i in range(len(self._cluster_inputs)):
-            px = self._cluster_inputs[i].px
-            py = self._cluster_inputs[i].py
-            pz = self._cluster_inputs[i].pz
-            E = self._cluster_inputs[i].E
+            jet = fastjet._multievent._jet_address(self._cluster_inputs[i])
             for j in range(len(self._bread_list)):
                 if self._bread_list[j] == self._bread_list_input[i]:
                     idx = j
@@ -1555,7 +1647,7 @@ class _classgeneralevent:
             if idx == -1:
                 continue
             assert len(self._cluster_inputs[i]) == len(self._clusterable_level[idx])
-            np_results = self._results[idx].to_numpy_has_child(px, py, pz, E)
+            np_results = self._results[idx].to_numpy_has_child(*jet)
             self._out.append(
                 ak.Array(
                     ak.contents.NumpyArray(np_results[0]),
@@ -1581,10 +1673,7 @@ class _classgeneralevent:
         if len(self._cluster_inputs) == 0:
             raise TypeError("The Awkward Array is not valid")
         for i in range(len(self._cluster_inputs)):
-            px = self._cluster_inputs[i].px
-            py = self._cluster_inputs[i].py
-            pz = self._cluster_inputs[i].pz
-            E = self._cluster_inputs[i].E
+            jet = fastjet._multievent._jet_address(self._cluster_inputs[i])
             for j in range(len(self._bread_list)):
                 if self._bread_list[j] == self._bread_list_input[i]:
                     idx = j
@@ -1592,9 +1681,7 @@ class _classgeneralevent:
             if idx == -1:
                 continue
             assert len(self._cluster_inputs[i]) == len(self._clusterable_level[idx])
-            np_results = self._results[idx].to_numpy_jet_scale_for_algorithm(
-                px, py, pz, E
-            )
+            np_results = self._results[idx].to_numpy_jet_scale_for_algorithm(*jet)
             self._out.append(
                 ak.Array(
                     ak.contents.NumpyArray(np_results[0]),
@@ -1620,10 +1707,7 @@ class _classgeneralevent:
         if len(self._cluster_inputs) == 0:
             raise TypeError("The Awkward Array is not valid")
         for i in range(len(self._cluster_inputs)):
-            px = self._cluster_inputs[i].px
-            py = self._cluster_inputs[i].py
-            pz = self._cluster_inputs[i].pz
-            E = self._cluster_inputs[i].E
+            jet = fastjet._multievent._jet_address(self._cluster_inputs[i])
             for j in range(len(self._bread_list)):
                 if self._bread_list[j] == self._bread_list_input[i]:
                     idx = j
@@ -1631,20 +1715,13 @@ class _classgeneralevent:
             if idx == -1:
                 continue
             assert len(self._cluster_inputs[i]) == len(self._clusterable_level[idx])
-            np_results = self._results[idx].to_numpy_get_child(px, py, pz, E)
+            np_results = self._results[idx].to_numpy_get_child(*jet)
             self._out.append(
                 ak.Array(
                     ak.contents.ListOffsetArray(
                         ak.index.Index64(np_results[-1]),
-                        ak.contents.RecordArray(
-                            (
-                                ak.contents.NumpyArray(np_results[0]),
-                                ak.contents.NumpyArray(np_results[1]),
-                                ak.contents.NumpyArray(np_results[2]),
-                                ak.contents.NumpyArray(np_results[3]),
-                            ),
-                            ("px", "py", "pz", "E"),
-                            parameters={"__record__": "Momentum4D"},
+                        fastjet._multievent._momenta_record(
+                            np_results, self._with_index, self._coordinates
                         ),
                     ),
                     behavior=self.data.behavior,
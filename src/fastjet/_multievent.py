@@ -1,26 +1,429 @@
+import functools
+import threading
+import time
 import warnings
 
 import awkward as ak
 import numpy as np
 
+import fastjet._cache
 import fastjet._ext  # noqa: F401, E402
 
 _default_taus_njettiness = [1, 2, 3, 4]
 
+_stats = fastjet._ext.batch_stats()
 
+_jet_observable_kinds = (
+    "momentum",
+    "constituent_index",
+    "softdrop",
+    "energy_correlator",
+    "lund_declusterings",
+    "nsubjettiness",
+    "area",
+)
+
+_area_fields = ["area", "area_px", "area_py", "area_pz", "area_E", "n_ghosts"]
+
+
+_momentum_fields = {
+    "cartesian": ["px", "py", "pz", "E"],
+    "ptetaphim": ["pt", "eta", "phi", "mass"],
+    "ptetaphie": ["pt", "eta", "phi", "E"],
+}
+
+
+def _coordinates(coordinates):
+    # the four-momentum columns of jets and constituents, named as in vector
+    if coordinates not in _momentum_fields:
+        raise ValueError(
+            f"coordinates must be one of {', '.join(_momentum_fields)}, "
+            f"not {coordinates!r}"
+        )
+    return coordinates
+
+
+_recombiners = ("wta_pt", "wta_E", "massless_E", "pt_weighted", "generalized_wta")
+
+
+def _recombiner(recombiner):
+    # keyword arguments selecting a compiled recombination scheme, given by
+    # name or as ("generalized_wta", delta)
+    if recombiner is None:
+        return {}
+    if isinstance(recombiner, str):
+        name, params = recombiner, ()
+    else:
+        name, *params = recombiner
+    if name not in _recombiners:
+        raise ValueError(
+            f"recombiner must be one of {', '.join(_recombiners)}, not {name!r}"
+        )
+    if name == "generalized_wta":
+        if len(params) != 1 or not params[0] > 0:
+            raise ValueError('recombiner must be ("generalized_wta", delta > 0)')
+        return {"recombiner": name, "recombiner_param": float(params[0])}
+    if len(params) != 0:
+        raise ValueError(f"recombiner {name!r} takes no parameter")
+    return {"recombiner": name}
+
+
+def _particle_selection(selection):
+    # keyword arguments selecting the input particles that are clustered,
+    # given as a Selector or as a dict of pt, |y| and E cuts
+    if selection is None:
+        return {}
+    if isinstance(selection, fastjet._swig.Selector):
+        return {"selector": selection}
+    if isinstance(selection, dict):
+        return {"cuts": {key: float(value) for key, value in selection.items()}}
+    raise TypeError("particle_selection must be a fastjet.Selector or a dict of cuts")
+
+
+def _area(area_definition, area_seed):
+    # keyword arguments measuring jet areas, with the ghosts of every event
+    # generated from area_seed
+    if area_definition is None:
+        return {}
+    if not isinstance(area_definition, fastjet._swig.AreaDefinition):
+        raise TypeError("area_definition must be a fastjet.AreaDefinition")
+    return {"area_definition": area_definition, "area_seed": int(area_seed)}
+
+
+def _background_options(estimator, rho_m, options):
+    # the estimator checks the names and values of the options itself
+    return {"estimator": estimator, "rho_m": bool(rho_m), **options}
+
+
+def _background_layout(np_results, rho_m):
+    fields = ["rho", "sigma", "rho_m", "sigma_m"] if rho_m else ["rho", "sigma"]
+    return ak.contents.RecordArray(
+        [ak.contents.NumpyArray(np_results[k]) for k in range(len(fields))], fields
+    )
+
+
+def _softdrop_observables_layout(np_results):
+    fields = ["zg", "Rg", "mass", "pt"]
+    return ak.contents.ListOffsetArray(
+        ak.index.Index64(np_results[-1]),
+        ak.contents.RecordArray(
+            [ak.contents.NumpyArray(np_results[k]) for k in range(len(fields))], fields
+        ),
+    )
+
+
+def _momenta_record(np_results, with_index, coordinates="cartesian"):
+    contents = [ak.contents.NumpyArray(np_results[k]) for k in range(4)]
+    fields = list(_momentum_fields[coordinates])
+    if with_index:
+        contents.append(ak.contents.NumpyArray(np_results[4]))
+        fields.append("cluster_hist_index")
+    # batches clustered with areas export their area columns before the
+    # event offsets
+    if len(np_results) > 6:
+        contents.extend(ak.contents.NumpyArray(np_results[k]) for k in range(5, 11))
+        fields.extend(_area_fields)
+    return ak.contents.RecordArray(
+        contents, fields, parameters={"__record__": "Momentum4D"}
+    )
+
+
+def _single_precision(output_dtype):
+    # jet and constituent four-momenta come back as float64 unless float32
+    # is requested
+    if output_dtype is None:
+        return False
+    dtype = np.dtype(output_dtype)
+    if dtype not in (np.float32, np.float64):
+        raise ValueError(
+            f"output_dtype must be float32 or float64, not {output_dtype!r}"
+        )
+    return dtype == np.float32
+
+
+def _jet_address(data):
+    # jets that carry their cluster_hist_index are looked up directly in the
+    # clustering history, others are matched on their four-momenta
+    if "cluster_hist_index" in ak.fields(data):
+        return (np.asarray(data.cluster_hist_index, dtype=np.int64),)
+    try:
+        return (data.px, data.py, data.pz, data.E)
+    except AttributeError:
+        raise AttributeError("Lorentz vector not found") from None
+
+
+def _exclusive_jets_multi_params(n_jets, dcut, ycut):
+    given = [
+        (by, params)
+        for by, params in (("njets", n_jets), ("dcut", dcut), ("ycut", ycut))
+        if params is not None
+    ]
+    if len(given) != 1:
+        raise ValueError("Exactly one of n_jets, dcut or ycut must be given")
+    by, params = given[0]
+    params = [float(param) for param in np.atleast_1d(params)]
+    if by == "njets" and any(param <= 0 for param in params):
+        raise ValueError("Njets cannot be <= 0")
+    return params, by
+
+
+def _exclusive_jets_multi_layout(np_results, with_index, coordinates="cartesian"):
+    # configuration offsets, momenta, cluster_hist_index, event offsets
+    return ak.contents.ListOffsetArray(
+        ak.index.Index64(np_results[-1]),
+        ak.contents.ListOffsetArray(
+            ak.index.Index64(np_results[0]),
+            _momenta_record(np_results[1:], with_index, coordinates),
+        ),
+    )
+
+
+def _dmerge_spectrum_layout(np_results, ymerge):
+    names = ["ymerge", "ymerge_max"] if ymerge else ["dmerge", "dmerge_max"]
+    return ak.contents.ListOffsetArray(
+        ak.index.Index64(np_results[-1]),
+        ak.contents.RecordArray(
+            [ak.contents.NumpyArray(np_results[k]) for k in range(2)], names
+        ),
+    )
+
+
+def _jet_observable_fields(spec):
+    name = spec.get("name", spec["observable"])
+    if spec["observable"] == "momentum":
+        fields = list(_momentum_fields[spec.get("coordinates", "cartesian")])
+        if spec.get("cluster_hist_index", False):
+            fields.append("cluster_hist_index")
+        return fields
+    if spec["observable"] == "area":
+        return list(_area_fields)
+    if spec["observable"] == "softdrop":
+        return [
+            prefix + name
+            for prefix in ("m", "pt", "eta", "phi", "E", "pz", "deltaR", "symmetry")
+        ]
+    return [name]
+
+
+def _jet_observable_specs(observables, with_index=False, coordinates="cartesian"):
+    specs = []
+    fields = []
+    for observable in observables:
+        if isinstance(observable, str):
+            spec = {"observable": observable}
+        else:
+            spec = dict(observable)
+        if spec.get("observable") not in _jet_observable_kinds:
+            raise ValueError(f"Unknown jet observable: {spec.get('observable')!r}")
+        if spec["observable"] == "momentum":
+            spec.setdefault("cluster_hist_index", with_index)
+            spec["coordinates"] = _coordinates(spec.get("coordinates", coordinates))
+        if spec["observable"] == "nsubjettiness":
+            njets = spec.get("njets", _default_taus_njettiness)
+            if isinstance(njets, (int, float)):
+                njets = [njets]
+            if len(njets) == 0:
+                raise ValueError("Must provide at least one njets!")
+            if any(njet <= 0 for njet in njets):
+                raise ValueError("Requested njets must be > 0!")
+            spec["njets"] = list(njets)
+        spec = {key: value for key, value in spec.items() if value is not None}
+        fields.extend(_jet_observable_fields(spec))
+        specs.append(spec)
+    if len(specs) == 0:
+        raise ValueError("Must request at least one jet observable!")
+    if len(set(fields)) != len(fields):
+        raise ValueError("Requested jet observables have clashing field names")
+    return specs
+
+
+def _jet_observables_layout(np_results, specs):
+    fields, event_offsets = np_results
+    contents = []
+    for value in fields.values():
+        if isinstance(value, tuple):
+            offsets, values = value
+            if isinstance(values, dict):
+                values = ak.contents.RecordArray(
+                    [ak.contents.NumpyArray(v) for v in values.values()],
+                    list(values.keys()),
+                )
+            else:
+                values = ak.contents.NumpyArray(values)
+            contents.append(
+                ak.contents.ListOffsetArray(ak.index.Index64(offsets), values)
+            )
+        else:
+            contents.append(ak.contents.NumpyArray(value))
+    with_momentum = any(spec["observable"] == "momentum" for spec in specs)
+    return ak.contents.ListOffsetArray(
+        ak.index.Index64(event_offsets),
+        ak.contents.RecordArray(
+            contents,
+            list(fields.keys()),
+            parameters={"__record__": "Momentum4D"} if with_momentum else None,
+        ),
+    )
+
+
+class _phase:
+    # times a block into a phase of fastjet.batch_stats() when it is enabled
+    def __init__(self, name):
+        self._name = name
+        self._start = None
+
+    def __enter__(self):
+        if _stats.enabled:
+            self._start = time.perf_counter()
+        return self
+
+    def __exit__(self, *exc):
+        if self._start is not None:
+            _stats.add_time(self._name, time.perf_counter() - self._start)
+
+
+# the methods of the event classes that are not queries
+_helper_methods = {
+    "check_jaggedness",
+    "correct_byteorder",
+    "extract_cons",
+    "multi_layered_listoffset",
+    "multi_layered_listoffset_input",
+    "replace",
+    "single_to_jagged",
+}
+
+_query_depth = threading.local()
+
+
+def _timed_query(method):
+    # the time of a query outside of the extension, which times its own
+    # phases, is the assembly of its awkward output; queries made by other
+    # queries are counted once, by the outermost one
+    @functools.wraps(method)
+    def timed(self, *args, **kwargs):
+        if not _stats.enabled or getattr(_query_depth, "value", 0):
+            return method(self, *args, **kwargs)
+        start = time.perf_counter()
+        engine = _stats._engine_seconds_on_thread()
+        _query_depth.value = 1
+        try:
+            return method(self, *args, **kwargs)
+        finally:
+            _query_depth.value = 0
+            elapsed = time.perf_counter() - start
+            engine = _stats._engine_seconds_on_thread() - engine
+            _stats.add_time("assembly", max(elapsed - engine, 0.0))
+
+    return timed
+
+
+def _timed_queries(cls):
+    for name, method in list(vars(cls).items()):
+        if callable(method) and not name.startswith("_"):
+            if name not in _helper_methods:
+                setattr(cls, name, _timed_query(method))
+    return cls
+
+
+def _extract_cons(array):
+    content = ak.Array(array.layout.content, behavior=array.behavior)
+    px = np.asarray(content.px)
+    py = np.asarray(content.py)
+    pz = np.asarray(content.pz)
+    E = np.asarray(content.E)
+    starts = np.asarray(array.layout.starts)
+    stops = np.asarray(array.layout.stops)
+    return px, py, pz, E, starts, stops
+
+
+def _stream_jet_observables(
+    data,
+    jetdef,
+    observables,
+    njets,
+    min_pt,
+    batch_size,
+    n_threads,
+    output_dtype,
+    coordinates="cartesian",
+    recombiner=None,
+    particle_selection=None,
+    area_definition=None,
+    area_seed=0,
+):
+    if njets is not None and njets <= 0:
+        raise ValueError("Njets cannot be <= 0")
+    if batch_size <= 0:
+        raise ValueError("batch_size must be > 0")
+    specs = _jet_observable_specs(observables, coordinates=_coordinates(coordinates))
+    single_precision = _single_precision(output_dtype)
+    np_results = fastjet._ext.stream_jet_observables(
+        *_extract_cons(data),
+        jetdef,
+        specs,
+        n_jets=njets or 0,
+        min_pt=min_pt,
+        batch_size=batch_size,
+        n_threads=-1 if n_threads is None else n_threads,
+        single_precision=single_precision,
+        **_recombiner(recombiner),
+        **_particle_selection(particle_selection),
+        **_area(area_definition, area_seed),
+    )
+    return ak.Array(
+        _jet_observables_layout(np_results, specs),
+        behavior=data.behavior,
+        attrs=data.attrs,
+    )
+
+
+@_timed_queries
 class _classmultievent:
-    def __init__(self, data, jetdef):
+    def __init__(
+        self,
+        data,
+        jetdef,
+        n_threads=None,
+        with_index=False,
+        output_dtype=None,
+        compact_history=False,
+        coordinates="cartesian",
+        recombiner=None,
+        particle_selection=None,
+        area_definition=None,
+        area_seed=0,
+    ):
         self.jetdef = jetdef
         self.data = data
-        px, py, pz, E, starts, stops = self.extract_cons(self.data)
-        px = self.correct_byteorder(px)
-        py = self.correct_byteorder(py)
-        pz = self.correct_byteorder(pz)
-        E = self.correct_byteorder(E)
-        starts = self.correct_byteorder(starts)
-        stops = self.correct_byteorder(stops)
-        self._results = fastjet._ext.interfacemulti(
-            px, py, pz, E, starts, stops, jetdef
+        self._with_index = with_index
+        self._coordinates = _coordinates(coordinates)
+        self._n_threads = -1 if n_threads is None else n_threads
+        single_precision = _single_precision(output_dtype)
+        with _phase("extract_cons"):
+            px, py, pz, E, starts, stops = self.extract_cons(self.data)
+        with _phase("correct_byteorder"):
+            px = self.correct_byteorder(px)
+            py = self.correct_byteorder(py)
+            pz = self.correct_byteorder(pz)
+            E = self.correct_byteorder(E)
+            starts = self.correct_byteorder(starts)
+            stops = self.correct_byteorder(stops)
+        self._results = fastjet._cache.interfacemulti(
+            px,
+            py,
+            pz,
+            E,
+            starts,
+            stops,
+            jetdef,
+            n_threads=self._n_threads,
+            single_precision=single_precision,
+            compact_history=compact_history,
+            coordinates=self._coordinates,
+            **_recombiner(recombiner),
+            **_particle_selection(particle_selection),
+            **_area(area_definition, area_seed),
         )
 
     def _check_record(self, data):
@@ -34,13 +437,7 @@ class _classmultievent:
         return data
 
     def extract_cons(self, array):
-        px = np.asarray(ak.Array(array.layout.content, behavior=array.behavior).px)
-        py = np.asarray(ak.Array(array.layout.content, behavior=array.behavior).py)
-        pz = np.asarray(ak.Array(array.layout.content, behavior=array.behavior).pz)
-        E = np.asarray(ak.Array(array.layout.content, behavior=array.behavior).E)
-        starts = np.asarray(array.layout.starts)
-        stops = np.asarray(array.layout.stops)
-        return px, py, pz, E, starts, stops
+        return _extract_cons(array)
 
     def single_to_jagged(self, array):
         single = ak.Array(
@@ -88,16 +485,34 @@ class _classmultievent:
         return ak.Array(
             ak.contents.ListOffsetArray(
                 ak.index.Index64(of),
-                ak.contents.RecordArray(
-                    (
-                        ak.contents.NumpyArray(np_results[0]),
-                        ak.contents.NumpyArray(np_results[1]),
-                        ak.contents.NumpyArray(np_results[2]),
-                        ak.contents.NumpyArray(np_results[3]),
-                    ),
-                    ("px", "py", "pz", "E"),
-                    parameters={"__record__": "Momentum4D"},
-                ),
+                _momenta_record(np_results, self._with_index, self._coordinates),
+            ),
+            behavior=self.data.behavior,
+            attrs=self.data.attrs,
+        )
+
+    def background_estimate(self, estimator="grid", rho_m=False, **options):
+        np_results = self._results.to_numpy_background(
+            _background_options(estimator, rho_m, options), n_threads=self._n_threads
+        )
+        return ak.Array(
+            _background_layout(np_results, rho_m),
+            behavior=self.data.behavior,
+            attrs=self.data.attrs,
+        )
+
+    def inclusive_jets_subtracted(
+        self, min_pt=0, estimator="grid", rho_m=False, **options
+    ):
+        np_results = self._results.to_numpy_subtracted_jets(
+            _background_options(estimator, rho_m, options),
+            min_pt=min_pt,
+            n_threads=self._n_threads,
+        )
+        return ak.Array(
+            ak.contents.ListOffsetArray(
+                ak.index.Index64(np_results[-1]),
+                _momenta_record(np_results, self._with_index, self._coordinates),
             ),
             behavior=self.data.behavior,
             attrs=self.data.attrs,
@@ -109,16 +524,7 @@ class _classmultievent:
         return ak.Array(
             ak.contents.ListOffsetArray(
                 ak.index.Index64(of),
-                ak.contents.RecordArray(
-                    (
-                        ak.contents.NumpyArray(np_results[0]),
-                        ak.contents.NumpyArray(np_results[1]),
-                        ak.contents.NumpyArray(np_results[2]),
-                        ak.contents.NumpyArray(np_results[3]),
-                    ),
-                    ("px", "py", "pz", "E"),
-                    parameters={"__record__": "Momentum4D"},
-                ),
+                _momenta_record(np_results, self._with_index, self._coordinates),
             ),
             behavior=self.data.behavior,
             attrs=self.data.attrs,
@@ -141,16 +547,7 @@ class _classmultievent:
         return ak.Array(
             ak.contents.ListOffsetArray(
                 ak.index.Index64(of),
-                ak.contents.RecordArray(
-                    (
-                        ak.contents.NumpyArray(np_results[0]),
-                        ak.contents.NumpyArray(np_results[1]),
-                        ak.contents.NumpyArray(np_results[2]),
-                        ak.contents.NumpyArray(np_results[3]),
-                    ),
-                    ("px", "py", "pz", "E"),
-                    parameters={"__record__": "Momentum4D"},
-                ),
+                _momenta_record(np_results, self._with_index, self._coordinates),
             ),
             behavior=self.data.behavior,
             attrs=self.data.attrs,
@@ -165,16 +562,7 @@ class _classmultievent:
         return ak.Array(
             ak.contents.ListOffsetArray(
                 ak.index.Index64(of),
-                ak.contents.RecordArray(
-                    (
-                        ak.contents.NumpyArray(np_results[0]),
-                        ak.contents.NumpyArray(np_results[1]),
-                        ak.contents.NumpyArray(np_results[2]),
-                        ak.contents.NumpyArray(np_results[3]),
-                    ),
-                    ("px", "py", "pz", "E"),
-                    parameters={"__record__": "Momentum4D"},
-                ),
+                _momenta_record(np_results, self._with_index, self._coordinates),
             ),
             behavior=self.data.behavior,
             attrs=self.data.attrs,
@@ -186,16 +574,7 @@ class _classmultievent:
         return ak.Array(
             ak.contents.ListOffsetArray(
                 ak.index.Index64(of),
-                ak.contents.RecordArray(
-                    (
-                        ak.contents.NumpyArray(np_results[0]),
-                        ak.contents.NumpyArray(np_results[1]),
-                        ak.contents.NumpyArray(np_results[2]),
-                        ak.contents.NumpyArray(np_results[3]),
-                    ),
-                    ("px", "py", "pz", "E"),
-                    parameters={"__record__": "Momentum4D"},
-                ),
+                _momenta_record(np_results, self._with_index, self._coordinates),
             ),
             behavior=self.data.behavior,
             attrs=self.data.attrs,
@@ -249,25 +628,18 @@ class _classmultievent:
             mu_cut,
         )
 
-        px = ak.unflatten(
-            ak.Array(ak.contents.NumpyArray(np_results[0])),
-            ak.Array(ak.contents.NumpyArray(np_results[4])),
-            highlevel=False,
+        offsets = ak.index.Index64(np_results[4])
+        px = ak.contents.ListOffsetArray(
+            offsets, ak.contents.NumpyArray(np_results[0])
         )
-        py = ak.unflatten(
-            ak.Array(ak.contents.NumpyArray(np_results[1])),
-            ak.Array(ak.contents.NumpyArray(np_results[4])),
-            highlevel=False,
+        py = ak.contents.ListOffsetArray(
+            offsets, ak.contents.NumpyArray(np_results[1])
         )
-        pz = ak.unflatten(
-            ak.Array(ak.contents.NumpyArray(np_results[2])),
-            ak.Array(ak.contents.NumpyArray(np_results[4])),
-            highlevel=False,
+        pz = ak.contents.ListOffsetArray(
+            offsets, ak.contents.NumpyArray(np_results[2])
         )
-        E = ak.unflatten(
-            ak.Array(ak.contents.NumpyArray(np_results[3])),
-            ak.Array(ak.contents.NumpyArray(np_results[4])),
-            highlevel=False,
+        E = ak.contents.ListOffsetArray(
+            offsets, ak.contents.NumpyArray(np_results[3])
         )
         jetpt = ak.Array(ak.contents.NumpyArray(np_results[5]))
         jeteta = ak.Array(ak.contents.NumpyArray(np_results[6]))
@@ -334,6 +706,49 @@ class _classmultievent:
         )
         return out
 
+    def jet_observables(self, observables, njets=None, min_pt=0):
+        if njets is not None and njets <= 0:
+            raise ValueError("Njets cannot be <= 0")
+        specs = _jet_observable_specs(
+            observables, self._with_index, self._coordinates
+        )
+        np_results = self._results.to_numpy_jet_observables(
+            specs, njets or 0, min_pt
+        )
+        return ak.Array(
+            _jet_observables_layout(np_results, specs),
+            behavior=self.data.behavior,
+            attrs=self.data.attrs,
+        )
+
+    def exclusive_jets_softdrop_observables(
+        self,
+        njets=1,
+        beta=0.0,
+        symmetry_cut=0.1,
+        symmetry_measure="scalar_z",
+        R0=0.8,
+        recursion_choice="larger_pt",
+        mu_cut=float("inf"),
+    ):
+        if njets <= 0:
+            raise ValueError("Njets cannot be <= 0")
+        np_results = self._results.to_numpy_softdrop_observables(
+            njets,
+            beta,
+            symmetry_cut,
+            symmetry_measure,
+            R0,
+            recursion_choice,
+            mu_cut,
+            n_threads=self._n_threads,
+        )
+        return ak.Array(
+            _softdrop_observables_layout(np_results),
+            behavior=self.data.behavior,
+            attrs=self.data.attrs,
+        )
+
     def exclusive_jets_energy_correlator(
         self,
         njets=1,
@@ -389,6 +804,26 @@ class _classmultievent:
         )
         return out
 
+    def exclusive_jets_multi(self, n_jets=None, dcut=None, ycut=None):
+        self._warn_for_exclusive()
+        params, by = _exclusive_jets_multi_params(n_jets, dcut, ycut)
+        np_results = self._results.to_numpy_exclusive_jets_multi(params, by)
+        return ak.Array(
+            _exclusive_jets_multi_layout(
+                np_results, self._with_index, self._coordinates
+            ),
+            behavior=self.data.behavior,
+            attrs=self.data.attrs,
+        )
+
+    def exclusive_dmerge_spectrum(self, ymerge=False):
+        np_results = self._results.to_numpy_exclusive_dmerge_spectrum(ymerge)
+        return ak.Array(
+            _dmerge_spectrum_layout(np_results, ymerge),
+            behavior=self.data.behavior,
+            attrs=self.data.attrs,
+        )
+
     def exclusive_dmerge(self, njets):
         np_results = self._results.to_numpy_exclusive_dmerge(njets)
         out = ak.Array(ak.contents.NumpyArray(np_results[0]))
@@ -439,26 +874,16 @@ class _classmultievent:
         return prepared[outputs_to_inputs]
 
     def exclusive_subjets(self, data, dcut, nsub):
-        try:
-            px = data.px
-            py = data.py
-            pz = data.pz
-            E = data.E
-        except AttributeError:
-            raise AttributeError("Lorentz vector not found") from None
+        jet = _jet_address(data)
         of = 0
         np_results = 0
         if nsub == 0:
             raise ValueError("Njets cannot be 0")
         if dcut == -1 and nsub != -1:
-            np_results = self._results.to_numpy_exclusive_subjets_nsub(
-                px, py, pz, E, nsub
-            )
+            np_results = self._results.to_numpy_exclusive_subjets_nsub(*jet, nsub)
             of = np_results[-1]
         if nsub == -1 and dcut != -1:
-            np_results = self._results.to_numpy_exclusive_subjets_dcut(
-                px, py, pz, E, dcut
-            )
+            np_results = self._results.to_numpy_exclusive_subjets_dcut(*jet, dcut)
             of = np_results[-1]
         if np_results == 0 and of == 0:
             raise ValueError("Either NJets or Dcut sould be entered") from None
@@ -466,117 +891,57 @@ class _classmultievent:
         return ak.Array(
             ak.contents.ListOffsetArray(
                 ak.index.Index64(of),
-                ak.contents.RecordArray(
-                    (
-                        ak.contents.NumpyArray(np_results[0]),
-                        ak.contents.NumpyArray(np_results[1]),
-                        ak.contents.NumpyArray(np_results[2]),
-                        ak.contents.NumpyArray(np_results[3]),
-                    ),
-                    ("px", "py", "pz", "E"),
-                    parameters={"__record__": "Momentum4D"},
-                ),
+                _momenta_record(np_results, self._with_index, self._coordinates),
             ),
             behavior=self.data.behavior,
         )
 
     def exclusive_subjets_up_to(self, data, nsub):
-        try:
-            px = data.px
-            py = data.py
-            pz = data.pz
-            E = data.E
-        except AttributeError:
-            raise AttributeError("Lorentz vector not found") from None
-        np_results = self._results.to_numpy_exclusive_subjets_up_to(px, py, pz, E, nsub)
+        jet = _jet_address(data)
+        np_results = self._results.to_numpy_exclusive_subjets_up_to(*jet, nsub)
         of = np_results[-1]
         return ak.Array(
             ak.contents.ListOffsetArray(
                 ak.index.Index64(of),
-                ak.contents.RecordArray(
-                    (
-                        ak.contents.NumpyArray(np_results[0]),
-                        ak.contents.NumpyArray(np_results[1]),
-                        ak.contents.NumpyArray(np_results[2]),
-                        ak.contents.NumpyArray(np_results[3]),
-                    ),
-                    ("px", "py", "pz", "E"),
-                    parameters={"__record__": "Momentum4D"},
-                ),
+                _momenta_record(np_results, self._with_index, self._coordinates),
             ),
             behavior=self.data.behavior,
             attrs=self.data.attrs,
         )
 
     def exclusive_subdmerge(self, data, nsub):
-        try:
-            px = data.px
-            py = data.py
-            pz = data.pz
-            E = data.E
-        except AttributeError:
-            raise AttributeError("Lorentz vector not found") from None
-        np_results = self._results.to_numpy_exclusive_subdmerge(px, py, pz, E, nsub)
+        jet = _jet_address(data)
+        np_results = self._results.to_numpy_exclusive_subdmerge(*jet, nsub)
         out = ak.Array(ak.contents.NumpyArray(np_results[0]))
         return out
 
     def exclusive_subdmerge_max(self, data, nsub):
-        try:
-            px = data.px
-            py = data.py
-            pz = data.pz
-            E = data.E
-        except AttributeError:
-            raise AttributeError("Lorentz vector not found") from None
-        np_results = self._results.to_numpy_exclusive_subdmerge_max(px, py, pz, E, nsub)
+        jet = _jet_address(data)
+        np_results = self._results.to_numpy_exclusive_subdmerge_max(*jet, nsub)
         out = ak.Array(ak.contents.NumpyArray(np_results[0]))
         return out
 
     def n_exclusive_subjets(self, data, dcut):
-        try:
-            px = data.px
-            py = data.py
-            pz = data.pz
-            E = data.E
-        except AttributeError:
-            raise AttributeError("Lorentz vector not found") from None
-        np_results = self._results.to_numpy_n_exclusive_subjets(px, py, pz, E, dcut)
+        jet = _jet_address(data)
+        np_results = self._results.to_numpy_n_exclusive_subjets(*jet, dcut)
         out = ak.Array(ak.contents.NumpyArray(np_results[0]))
         return out
 
     def has_parents(self, data):
-        try:
-            px = data.px
-            py = data.py
-            pz = data.pz
-            E = data.E
-        except AttributeError:
-            raise AttributeError("Lorentz vector not found") from None
-        np_results = self._results.to_numpy_has_parents(px, py, pz, E)
+        jet = _jet_address(data)
+        np_results = self._results.to_numpy_has_parents(*jet)
         out = ak.Array(ak.contents.NumpyArray(np_results[0]))
         return out
 
     def has_child(self, data):
-        try:
-            px = data.px
-            py = data.py
-            pz = data.pz
-            E = data.E
-        except AttributeError:
-            raise AttributeError("Lorentz vector not found") from None
-        np_results = self._results.to_numpy_has_child(px, py, pz, E)
+        jet = _jet_address(data)
+        np_results = self._results.to_numpy_has_child(*jet)
         out = ak.Array(ak.contents.NumpyArray(np_results[0]))
         return out
 
     def jet_scale_for_algorithm(self, data):
-        try:
-            px = data.px
-            py = data.py
-            pz = data.pz
-            E = data.E
-        except AttributeError:
-            raise AttributeError("Lorentz vector not found") from None
-        np_results = self._results.to_numpy_jet_scale_for_algorithm(px, py, pz, E)
+        jet = _jet_address(data)
+        np_results = self._results.to_numpy_jet_scale_for_algorithm(*jet)
         out = ak.Array(ak.contents.NumpyArray(np_results[0]))
         return out
 
@@ -596,16 +961,7 @@ class _classmultievent:
         return ak.Array(
             ak.contents.ListOffsetArray(
                 ak.index.Index64(of),
-                ak.contents.RecordArray(
-                    (
-                        ak.contents.NumpyArray(np_results[0]),
-                        ak.contents.NumpyArray(np_results[1]),
-                        ak.contents.NumpyArray(np_results[2]),
-                        ak.contents.NumpyArray(np_results[3]),
-                    ),
-                    ("px", "py", "pz", "E"),
-                    parameters={"__record__": "Momentum4D"},
-                ),
+                _momenta_record(np_results, self._with_index, self._coordinates),
             ),
             behavior=self.data.behavior,
             attrs=self.data.attrs,
@@ -617,70 +973,31 @@ class _classmultievent:
         return ak.Array(
             ak.contents.ListOffsetArray(
                 ak.index.Index64(of),
-                ak.contents.RecordArray(
-                    (
-                        ak.contents.NumpyArray(np_results[0]),
-                        ak.contents.NumpyArray(np_results[1]),
-                        ak.contents.NumpyArray(np_results[2]),
-                        ak.contents.NumpyArray(np_results[3]),
-                    ),
-                    ("px", "py", "pz", "E"),
-                    parameters={"__record__": "Momentum4D"},
-                ),
+                _momenta_record(np_results, self._with_index, self._coordinates),
             ),
             behavior=self.data.behavior,
             attrs=self.data.attrs,
         )
 
     def get_parents(self, data):
-        try:
-            px = data.px
-            py = data.py
-            pz = data.pz
-            E = data.E
-        except AttributeError:
-            raise AttributeError("Lorentz vector not found") from None
-        np_results = self._results.to_numpy_get_parents(px, py, pz, E)
+        jet = _jet_address(data)
+        np_results = self._results.to_numpy_get_parents(*jet)
         return ak.Array(
             ak.contents.ListOffsetArray(
                 ak.index.Index64(np_results[-1]),
-                ak.contents.RecordArray(
-                    (
-                        ak.contents.NumpyArray(np_results[0]),
-                        ak.contents.NumpyArray(np_results[1]),
-                        ak.contents.NumpyArray(np_results[2]),
-                        ak.contents.NumpyArray(np_results[3]),
-                    ),
-                    ("px", "py", "pz", "E"),
-                    parameters={"__record__": "Momentum4D"},
-                ),
+                _momenta_record(np_results, self._with_index, self._coordinates),
             ),
             behavior=self.data.behavior,
             attrs=self.data.attrs,
         )
 
     def get_child(self, data):
-        try:
-            px = data.px
-            py = data.py
-            pz = data.pz
-            E = data.E
-        except AttributeError:
-            raise AttributeError("Lorentz vector not found") from None
-        np_results = self._results.to_numpy_get_child(px, py, pz, E)
+        jet = _jet_address(data)
+        np_results = self._results.to_numpy_get_child(*jet)
         return ak.Array(
             ak.contents.ListOffsetArray(
                 ak.index.Index64(np_results[-1]),
-                ak.contents.RecordArray(
-                    (
-                        ak.contents.NumpyArray(np_results[0]),
-                        ak.contents.NumpyArray(np_results[1]),
-                        ak.contents.NumpyArray(np_results[2]),
-                        ak.contents.NumpyArray(np_results[3]),
-                    ),
-                    ("px", "py", "pz", "E"),
-                    parameters={"__record__": "Momentum4D"},
-                ),
+                _momenta_record(np_results, self._with_index, self._coordinates),
             ),
             behavior=self.data.behavior,
             attrs=self.data.attrs,
@@ -1,3 +1,5 @@
+import threading
+
 import awkward as ak
 
 import fastjet._ext  # noqa: F401, E402
@@ -14,7 +16,20 @@ _default_taus_njettiness = [1, 2, 3, 4]
 
 
 class AwkwardClusterSequence(ClusterSequence):
-    def __init__(self, data, jetdef):
+    def __init__(
+        self,
+        data,
+        jetdef,
+        n_threads=None,
+        with_index=False,
+        output_dtype=None,
+        compact_history=False,
+        coordinates="cartesian",
+        recombiner=None,
+        particle_selection=None,
+        area_definition=None,
+        area_seed=0,
+    ):
         if not isinstance(data, ak.Array):
             raise TypeError("The input data is not an Awkward Array or Numpy Array")
         if not isinstance(jetdef, fastjet._swig.JetDefinition):
@@ -26,13 +41,46 @@ class AwkwardClusterSequence(ClusterSequence):
             self._check_listoffset_index(data)
         ):
             self._flag = 0
-            self._internalrep = fastjet._multievent._classmultievent(data, self._jetdef)
+            self._internalrep = fastjet._multievent._classmultievent(
+                data,
+                self._jetdef,
+                n_threads,
+                with_index,
+                output_dtype,
+                compact_history,
+                coordinates,
+                recombiner,
+                particle_selection,
+                area_definition,
+                area_seed,
+            )
         elif self._jagedness == 1 and data.layout.is_record:
             self._internalrep = fastjet._singleevent._classsingleevent(
-                data, self._jetdef
+                data,
+                self._jetdef,
+                with_index,
+                output_dtype,
+                compact_history,
+                coordinates,
+                recombiner,
+                particle_selection,
+                area_definition,
+                area_seed,
             )
         elif self._jagedness >= 3 or self._check_general(data):
-            self._internalrep = fastjet._generalevent._classgeneralevent(data, jetdef)
+            self._internalrep = fastjet._generalevent._classgeneralevent(
+                data,
+                jetdef,
+                n_threads,
+                with_index,
+                output_dtype,
+                compact_history,
+                coordinates,
+                recombiner,
+                particle_selection,
+                area_definition,
+                area_seed,
+            )
 
     # else:
     # raise TypeError(
@@ -125,6 +173,16 @@ class AwkwardClusterSequence(ClusterSequence):
     def inclusive_jets(self, min_pt=0):
         return self._internalrep.inclusive_jets(min_pt)
 
+    def background_estimate(self, estimator="grid", rho_m=False, **options):
+        return self._internalrep.background_estimate(estimator, rho_m, **options)
+
+    def inclusive_jets_subtracted(
+        self, min_pt=0, estimator="grid", rho_m=False, **options
+    ):
+        return self._internalrep.inclusive_jets_subtracted(
+            min_pt, estimator, rho_m, **options
+        )
+
     def unclustered_particles(self):
         return self._internalrep.unclustered_particles()
 
@@ -192,6 +250,29 @@ class AwkwardClusterSequence(ClusterSequence):
             akAxesR0=akAxesR0,
         )
 
+    def jet_observables(self, observables, njets=None, min_pt=0):
+        return self._internalrep.jet_observables(observables, njets, min_pt)
+
+    def exclusive_jets_softdrop_observables(
+        self,
+        njets=1,
+        beta=0.0,
+        symmetry_cut=0.1,
+        symmetry_measure="scalar_z",
+        R0=0.8,
+        recursion_choice="larger_pt",
+        mu_cut=float("inf"),
+    ):
+        return self._internalrep.exclusive_jets_softdrop_observables(
+            njets,
+            beta,
+            symmetry_cut,
+            symmetry_measure,
+            R0,
+            recursion_choice,
+            mu_cut,
+        )
+
     def exclusive_jets_energy_correlator(
         self,
         njets=1,
@@ -215,6 +296,12 @@ class AwkwardClusterSequence(ClusterSequence):
     def exclusive_jets_lund_declusterings(self, njets=10):
         return self._internalrep.exclusive_jets_lund_declusterings(njets)
 
+    def exclusive_jets_multi(self, n_jets=None, dcut=None, ycut=None):
+        return self._internalrep.exclusive_jets_multi(n_jets, dcut, ycut)
+
+    def exclusive_dmerge_spectrum(self, ymerge=False):
+        return self._internalrep.exclusive_dmerge_spectrum(ymerge)
+
     def exclusive_dmerge(self, njets=10):
         return self._internalrep.exclusive_dmerge(njets)
 
@@ -299,10 +386,76 @@ class AwkwardClusterSequence(ClusterSequence):
         return self._internalrep.get_child(data)
 
 
+def _hashable_options(value):
+    # the clustering options as a dictionary key, with the SWIG objects
+    # (JetDefinition, AreaDefinition) standing for their description
+    if isinstance(value, dict):
+        return tuple(sorted((k, _hashable_options(v)) for k, v in value.items()))
+    if isinstance(value, (list, tuple)):
+        return tuple(_hashable_options(v) for v in value)
+    if hasattr(value, "description"):
+        return (type(value).__name__, value.description())
+    return value
+
+
+class _PartitionSequence:
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.sequence = None
+
+
+_partition_sequences_lock = threading.Lock()
+
+
+def _partition_sequence(array, options):
+    # The clustering of a partition, shared by every query on it: the tasks
+    # reading one partition get the same array from the scheduler, so the
+    # sequences are kept on that array and go away with it.
+    if options is None:
+        return _PartitionSequence()
+    with _partition_sequences_lock:
+        try:
+            sequences = array._fastjet_sequences
+        except AttributeError:
+            sequences = {}
+            try:
+                array._fastjet_sequences = sequences
+            except (AttributeError, TypeError):
+                return _PartitionSequence()
+        try:
+            return sequences.setdefault(options, _PartitionSequence())
+        except TypeError:
+            # options that cannot be hashed
+            return _PartitionSequence()
+
+
 class _FnDelayedInternalRepCaller:
-    def __init__(self, method_name, jetdef, **kwargs):
+    def __init__(
+        self,
+        method_name,
+        jetdef,
+        n_threads=None,
+        with_index=False,
+        output_dtype=None,
+        compact_history=False,
+        coordinates="cartesian",
+        recombiner=None,
+        particle_selection=None,
+        area_definition=None,
+        area_seed=0,
+        **kwargs,
+    ):
         self.name = method_name
         self.jetdef = jetdef
+        self.n_threads = n_threads
+        self.with_index = with_index
+        self.output_dtype = output_dtype
+        self.compact_history = compact_history
+        self.coordinates = coordinates
+        self.recombiner = recombiner
+        self.particle_selection = particle_selection
+        self.area_definition = area_definition
+        self.area_seed = area_seed
         self.kwargs = kwargs
 
     def __call__(self, array, *arrays):
@@ -316,6 +469,8 @@ class _FnDelayedInternalRepCaller:
                 iarray.px.layout._touch_data(recursive=True)
                 iarray.py.layout._touch_data(recursive=True)
                 iarray.pz.layout._touch_data(recursive=True)
+                if "cluster_hist_index" in iarray.fields:
+                    iarray.cluster_hist_index.layout._touch_data(recursive=True)
             length_zero_array = ak.Array(
                 array.layout.form.length_zero_array(highlevel=False),
                 behavior=array.behavior,
@@ -326,28 +481,106 @@ class _FnDelayedInternalRepCaller:
                 )
                 for iarray in arrays
             )
-            seq = AwkwardClusterSequence(length_zero_array, self.jetdef)
+            seq = AwkwardClusterSequence(
+                length_zero_array,
+                self.jetdef,
+                with_index=self.with_index,
+                output_dtype=self.output_dtype,
+                compact_history=self.compact_history,
+                coordinates=self.coordinates,
+                recombiner=self.recombiner,
+                particle_selection=self.particle_selection,
+                area_definition=self.area_definition,
+                area_seed=self.area_seed,
+            )
             out = getattr(seq, self.name)(*lz_arrays, **self.kwargs)
             return ak.Array(
                 out.layout.to_typetracer(forget_length=True),
                 behavior=out.behavior,
             )
-        seq = AwkwardClusterSequence(array, self.jetdef)
-        return getattr(seq, self.name)(*arrays, **self.kwargs)
+        entry = _partition_sequence(array, self._options())
+        # a sequence keeps per-query state, so queries on it take turns
+        with entry.lock:
+            if entry.sequence is None:
+                entry.sequence = AwkwardClusterSequence(
+                    array,
+                    self.jetdef,
+                    self.n_threads,
+                    self.with_index,
+                    self.output_dtype,
+                    self.compact_history,
+                    self.coordinates,
+                    self.recombiner,
+                    self.particle_selection,
+                    self.area_definition,
+                    self.area_seed,
+                )
+            return getattr(entry.sequence, self.name)(*arrays, **self.kwargs)
+
+    def _options(self):
+        # everything but n_threads, which does not change the clustering, or
+        # None when a plugin, an external recombiner (e.g. RecombinerPython) or
+        # a Selector (possibly a SelectorPython) is involved: their description
+        # does not tell two of them apart, so their sequences are not shared
+        if (
+            self.jetdef.jet_algorithm() == fastjet.plugin_algorithm
+            or self.jetdef.recombination_scheme() == fastjet.external_scheme
+            or isinstance(self.particle_selection, fastjet._swig.Selector)
+        ):
+            return None
+        return _hashable_options(
+            (
+                self.jetdef,
+                self.with_index,
+                self.output_dtype,
+                self.compact_history,
+                self.coordinates,
+                self.recombiner,
+                self.particle_selection,
+                self.area_definition,
+                self.area_seed,
+            )
+        )
 
 
 def _dak_dispatch(cluseq, method_name, *arrays, **kwargs):
     from dask_awkward.utils import hyphenize
 
     return cluseq._data.map_partitions(
-        _FnDelayedInternalRepCaller(method_name, cluseq._jetdef, **kwargs),
+        _FnDelayedInternalRepCaller(
+            method_name,
+            cluseq._jetdef,
+            cluseq._n_threads,
+            cluseq._with_index,
+            cluseq._output_dtype,
+            cluseq._compact_history,
+            cluseq._coordinates,
+            cluseq._recombiner,
+            cluseq._particle_selection,
+            cluseq._area_definition,
+            cluseq._area_seed,
+            **kwargs,
+        ),
         *arrays,
         label=hyphenize(method_name),
     )
 
 
 class DaskAwkwardClusterSequence(ClusterSequence):
-    def __init__(self, data, jetdef):
+    def __init__(
+        self,
+        data,
+        jetdef,
+        n_threads=None,
+        with_index=False,
+        output_dtype=None,
+        compact_history=False,
+        coordinates="cartesian",
+        recombiner=None,
+        particle_selection=None,
+        area_definition=None,
+        area_seed=0,
+    ):
         import dask_awkward as dak
 
         if not isinstance(data, dak.Array):
@@ -355,6 +588,15 @@ class DaskAwkwardClusterSequence(ClusterSequence):
         if not isinstance(jetdef, fastjet._swig.JetDefinition):
             raise TypeError("JetDefinition is not of valid type")
         self._jetdef = jetdef
+        self._n_threads = n_threads
+        self._with_index = with_index
+        self._output_dtype = output_dtype
+        self._compact_history = compact_history
+        self._coordinates = coordinates
+        self._recombiner = recombiner
+        self._particle_selection = particle_selection
+        self._area_definition = area_definition
+        self._area_seed = area_seed
         self._data = data
         self._jagedness = self._check_jaggedness(data._meta)
         self._flag = 1
@@ -367,15 +609,42 @@ class DaskAwkwardClusterSequence(ClusterSequence):
         ):
             self._flag = 0
             self._internalrep = fastjet._multievent._classmultievent(
-                length_zero_data, self._jetdef
+                length_zero_data,
+                self._jetdef,
+                with_index=with_index,
+                output_dtype=output_dtype,
+                compact_history=compact_history,
+                coordinates=coordinates,
+                recombiner=recombiner,
+                particle_selection=particle_selection,
+                area_definition=area_definition,
+                area_seed=area_seed,
             )
         elif self._jagedness == 1 and data.layout.is_record:
             self._internalrep = fastjet._singleevent._classsingleevent(
-                length_zero_data, self._jetdef
+                length_zero_data,
+                self._jetdef,
+                with_index,
+                output_dtype,
+                compact_history,
+                coordinates,
+                recombiner,
+                particle_selection,
+                area_definition,
+                area_seed,
             )
         elif self._jagedness >= 3 or self._check_general(data):
             self._internalrep = fastjet._generalevent._classgeneralevent(
-                length_zero_data, jetdef
+                length_zero_data,
+                jetdef,
+                with_index=with_index,
+                output_dtype=output_dtype,
+                compact_history=compact_history,
+                coordinates=coordinates,
+                recombiner=recombiner,
+                particle_selection=particle_selection,
+                area_definition=area_definition,
+                area_seed=area_seed,
             )
 
     # else:
@@ -469,6 +738,23 @@ class DaskAwkwardClusterSequence(ClusterSequence):
     def inclusive_jets(self, min_pt=0):
         return _dak_dispatch(self, "inclusive_jets", min_pt=min_pt)
 
+    def background_estimate(self, estimator="grid", rho_m=False, **options):
+        return _dak_dispatch(
+            self, "background_estimate", estimator=estimator, rho_m=rho_m, **options
+        )
+
+    def inclusive_jets_subtracted(
+        self, min_pt=0, estimator="grid", rho_m=False, **options
+    ):
+        return _dak_dispatch(
+            self,
+            "inclusive_jets_subtracted",
+            min_pt=min_pt,
+            estimator=estimator,
+            rho_m=rho_m,
+            **options,
+        )
+
     def unclustered_particles(self):
         return _dak_dispatch(self, "unclustered_particles")
 
@@ -541,6 +827,37 @@ class DaskAwkwardClusterSequence(ClusterSequence):
             akAxesR0=akAxesR0,
         )
 
+    def jet_observables(self, observables, njets=None, min_pt=0):
+        return _dak_dispatch(
+            self,
+            "jet_observables",
+            observables=observables,
+            njets=njets,
+            min_pt=min_pt,
+        )
+
+    def exclusive_jets_softdrop_observables(
+        self,
+        njets=1,
+        beta=0.0,
+        symmetry_cut=0.1,
+        symmetry_measure="scalar_z",
+        R0=0.8,
+        recursion_choice="larger_pt",
+        mu_cut=float("inf"),
+    ):
+        return _dak_dispatch(
+            self,
+            "exclusive_jets_softdrop_observables",
+            njets=njets,
+            beta=beta,
+            symmetry_cut=symmetry_cut,
+            symmetry_measure=symmetry_measure,
+            R0=R0,
+            recursion_choice=recursion_choice,
+            mu_cut=mu_cut,
+        )
+
     def exclusive_jets_energy_correlator(
         self,
         njets=1,
@@ -566,6 +883,14 @@ class DaskAwkwardClusterSequence(ClusterSequence):
     def exclusive_jets_lund_declusterings(self, njets=10):
         return _dak_dispatch(self, "exclusive_jets_lund_declusterings", njets=njets)
 
+    def exclusive_jets_multi(self, n_jets=None, dcut=None, ycut=None):
+        return _dak_dispatch(
+            self, "exclusive_jets_multi", n_jets=n_jets, dcut=dcut, ycut=ycut
+        )
+
+    def exclusive_dmerge_spectrum(self, ymerge=False):
+        return _dak_dispatch(self, "exclusive_dmerge_spectrum", ymerge=ymerge)
+
     def exclusive_dmerge(self, njets=10):
         return _dak_dispatch(self, "exclusive_dmerge", njets=njets)
 
@@ -3,24 +3,56 @@ import warnings
 import awkward as ak
 import numpy as np
 
+import fastjet._cache
 import fastjet._ext  # noqa: F401, E402
+import fastjet._multievent
 
 _default_taus_njettiness = [1, 2, 3, 4]
 
 
+@fastjet._multievent._timed_queries
 class _classsingleevent:
-    def __init__(self, data, jetdef):
+    def __init__(
+        self,
+        data,
+        jetdef,
+        with_index=False,
+        output_dtype=None,
+        compact_history=False,
+        coordinates="cartesian",
+        recombiner=None,
+        particle_selection=None,
+        area_definition=None,
+        area_seed=0,
+    ):
         self.jetdef = jetdef
+        self._with_index = with_index
+        self._coordinates = fastjet._multievent._coordinates(coordinates)
+        single_precision = fastjet._multievent._single_precision(output_dtype)
         self.data = self.single_to_jagged(data)
-        px, py, pz, E, starts, stops = self.extract_cons(self.data)
-        px = self.correct_byteorder(px)
-        py = self.correct_byteorder(py)
-        pz = self.correct_byteorder(pz)
-        E = self.correct_byteorder(E)
-        starts = self.correct_byteorder(starts)
-        stops = self.correct_byteorder(stops)
-        self._results = fastjet._ext.interfacemulti(
-            px, py, pz, E, starts, stops, jetdef
+        with fastjet._multievent._phase("extract_cons"):
+            px, py, pz, E, starts, stops = self.extract_cons(self.data)
+        with fastjet._multievent._phase("correct_byteorder"):
+            px = self.correct_byteorder(px)
+            py = self.correct_byteorder(py)
+            pz = self.correct_byteorder(pz)
+            E = self.correct_byteorder(E)
+            starts = self.correct_byteorder(starts)
+            stops = self.correct_byteorder(stops)
+        self._results = fastjet._cache.interfacemulti(
+            px,
+            py,
+            pz,
+            E,
+            starts,
+            stops,
+            jetdef,
+            single_precision=single_precision,
+            compact_history=compact_history,
+            coordinates=self._coordinates,
+            **fastjet._multievent._recombiner(recombiner),
+            **fastjet._multievent._particle_selection(particle_selection),
+            **fastjet._multievent._area(area_definition, area_seed),
         )
 
     def correct_byteorder(self, data):
@@ -89,15 +121,29 @@ class _classsingleevent:
     def inclusive_jets(self, min_pt):
         np_results = self._results.to_numpy(min_pt)
         return ak.Array(
-            ak.contents.RecordArray(
-                (
-                    ak.contents.NumpyArray(np_results[0]),
-                    ak.contents.NumpyArray(np_results[1]),
-                    ak.contents.NumpyArray(np_results[2]),
-                    ak.contents.NumpyArray(np_results[3]),
-                ),
-                ("px", "py", "pz", "E"),
-                parameters={"__record__": "Momentum4D"},
+            fastjet._multievent._momenta_record(
+                np_results, self._with_index, self._coordinates
+            ),
+            behavior=self.data.behavior,
+        )
+
+    def background_estimate(self, estimator="grid", rho_m=False, **options):
+        np_results = self._results.to_numpy_background(
+            fastjet._multievent._background_options(estimator, rho_m, options)
+        )
+        out = ak.Array(fastjet._multievent._background_layout(np_results, rho_m))
+        return out[0]
+
+    def inclusive_jets_subtracted(
+        self, min_pt=0, estimator="grid", rho_m=False, **options
+    ):
+        np_results = self._results.to_numpy_subtracted_jets(
+            fastjet._multievent._background_options(estimator, rho_m, options),
+            min_pt=min_pt,
+        )
+        return ak.Array(
+            fastjet._multievent._momenta_record(
+                np_results, self._with_index, self._coordinates
             ),
             behavior=self.data.behavior,
         )
@@ -105,15 +151,8 @@ class _classsingleevent:
     def unclustered_particles(self):
         np_results = self._results.to_numpy_unclustered_particles()
         return ak.Array(
-            ak.contents.RecordArray(
-                (
-                    ak.contents.NumpyArray(np_results[0]),
-                    ak.contents.NumpyArray(np_results[1]),
-                    ak.contents.NumpyArray(np_results[2]),
-                    ak.contents.NumpyArray(np_results[3]),
-                ),
-                ("px", "py", "pz", "E"),
-                parameters={"__record__": "Momentum4D"},
+            fastjet._multievent._momenta_record(
+                np_results, self._with_index, self._coordinates
             ),
             behavior=self.data.behavior,
         )
@@ -130,15 +169,8 @@ class _classsingleevent:
         if np_results == 0:
             raise ValueError("Either Dcut or Njets should be entered") from None
         return ak.Array(
-            ak.contents.RecordArray(
-                (
-                    ak.contents.NumpyArray(np_results[0]),
-                    ak.contents.NumpyArray(np_results[1]),
-                    ak.contents.NumpyArray(np_results[2]),
-                    ak.contents.NumpyArray(np_results[3]),
-                ),
-                ("px", "py", "pz", "E"),
-                parameters={"__record__": "Momentum4D"},
+            fastjet._multievent._momenta_record(
+                np_results, self._with_index, self._coordinates
             ),
             behavior=self.data.behavior,
         )
@@ -149,15 +181,8 @@ class _classsingleevent:
             raise ValueError("Njets cannot be 0") from None
         np_results = self._results.to_numpy_exclusive_njet_up_to(n_jets)
         return ak.Array(
-            ak.contents.RecordArray(
-                (
-                    ak.contents.NumpyArray(np_results[0]),
-                    ak.contents.NumpyArray(np_results[1]),
-                    ak.contents.NumpyArray(np_results[2]),
-                    ak.contents.NumpyArray(np_results[3]),
-                ),
-                ("px", "py", "pz", "E"),
-                parameters={"__record__": "Momentum4D"},
+            fastjet._multievent._momenta_record(
+                np_results, self._with_index, self._coordinates
             ),
             behavior=self.data.behavior,
         )
@@ -166,15 +191,8 @@ class _classsingleevent:
         self._warn_for_exclusive()
         np_results = self._results.to_numpy_exclusive_ycut(ycut)
         return ak.Array(
-            ak.contents.RecordArray(
-                (
-                    ak.contents.NumpyArray(np_results[0]),
-                    ak.contents.NumpyArray(np_results[1]),
-                    ak.contents.NumpyArray(np_results[2]),
-                    ak.contents.NumpyArray(np_results[3]),
-                ),
-                ("px", "py", "pz", "E"),
-                parameters={"__record__": "Momentum4D"},
+            fastjet._multievent._momenta_record(
+                np_results, self._with_index, self._coordinates
             ),
             behavior=self.data.behavior,
         )
@@ -227,25 +245,18 @@ class _classsingleevent:
             mu_cut,
         )
 
-        px = ak.unflatten(
-            ak.Array(ak.contents.NumpyArray(np_results[0])),
-            ak.Array(ak.contents.NumpyArray(np_results[4])),
-            highlevel=False,
+        offsets = ak.index.Index64(np_results[4])
+        px = ak.contents.ListOffsetArray(
+            offsets, ak.contents.NumpyArray(np_results[0])
         )
-        py = ak.unflatten(
-            ak.Array(ak.contents.NumpyArray(np_results[1])),
-            ak.Array(ak.contents.NumpyArray(np_results[4])),
-            highlevel=False,
+        py = ak.contents.ListOffsetArray(
+            offsets, ak.contents.NumpyArray(np_results[1])
         )
-        pz = ak.unflatten(
-            ak.Array(ak.contents.NumpyArray(np_results[2])),
-            ak.Array(ak.contents.NumpyArray(np_results[4])),
-            highlevel=False,
+        pz = ak.contents.ListOffsetArray(
+            offsets, ak.contents.NumpyArray(np_results[2])
         )
-        E = ak.unflatten(
-            ak.Array(ak.contents.NumpyArray(np_results[3])),
-            ak.Array(ak.contents.NumpyArray(np_results[4])),
-            highlevel=False,
+        E = ak.contents.ListOffsetArray(
+            offsets, ak.contents.NumpyArray(np_results[3])
         )
         jetpt = ak.Array(ak.contents.NumpyArray(np_results[5]))
         jeteta = ak.Array(ak.contents.NumpyArray(np_results[6]))
@@ -310,6 +321,45 @@ class _classsingleevent:
         )
         return out
 
+    def jet_observables(self, observables, njets=None, min_pt=0):
+        if njets is not None and njets <= 0:
+            raise ValueError("Njets cannot be <= 0")
+        specs = fastjet._multievent._jet_observable_specs(
+            observables, self._with_index, self._coordinates
+        )
+        np_results = self._results.to_numpy_jet_observables(
+            specs, njets or 0, min_pt
+        )
+        out = ak.Array(
+            fastjet._multievent._jet_observables_layout(np_results, specs),
+            behavior=self.data.behavior,
+        )
+        return out[0]
+
+    def exclusive_jets_softdrop_observables(
+        self,
+        njets=1,
+        beta=0.0,
+        symmetry_cut=0.1,
+        symmetry_measure="scalar_z",
+        R0=0.8,
+        recursion_choice="larger_pt",
+        mu_cut=float("inf"),
+    ):
+        if njets <= 0:
+            raise ValueError("Njets cannot be <= 0")
+        np_results = self._results.to_numpy_softdrop_observables(
+            njets,
+            beta,
+            symmetry_cut,
+            symmetry_measure,
+            R0,
+            recursion_choice,
+            mu_cut,
+        )
+        out = ak.Array(fastjet._multievent._softdrop_observables_layout(np_results))
+        return out[0]
+
     def exclusive_jets_energy_correlator(
         self,
         njets=1,
@@ -399,6 +449,25 @@ class _classsingleevent:
         prepared = self.data[:, np.newaxis][duplicate]
         return prepared[outputs_to_inputs][0]
 
+    def exclusive_jets_multi(self, n_jets=None, dcut=None, ycut=None):
+        self._warn_for_exclusive()
+        params, by = fastjet._multievent._exclusive_jets_multi_params(
+            n_jets, dcut, ycut
+        )
+        np_results = self._results.to_numpy_exclusive_jets_multi(params, by)
+        out = ak.Array(
+            fastjet._multievent._exclusive_jets_multi_layout(
+                np_results, self._with_index, self._coordinates
+            ),
+            behavior=self.data.behavior,
+        )
+        return out[0]
+
+    def exclusive_dmerge_spectrum(self, ymerge=False):
+        np_results = self._results.to_numpy_exclusive_dmerge_spectrum(ymerge)
+        out = ak.Array(fastjet._multievent._dmerge_spectrum_layout(np_results, ymerge))
+        return out[0]
+
     def exclusive_dmerge(self, njets):
         np_results = self._results.to_numpy_exclusive_dmerge(njets)
         out = np_results[0]
@@ -436,137 +505,71 @@ class _classsingleevent:
         return out
 
     def exclusive_subjets(self, data, dcut, nsub):
-        try:
-            px = data.px
-            py = data.py
-            pz = data.pz
-            E = data.E
-        except AttributeError:
-            raise AttributeError("Lorentz vector not found") from None
+        jet = fastjet._multievent._jet_address(data)
         np_results = 0
         if nsub == 0:
             raise ValueError("Nsub cannot be 0")
         if dcut == -1 and nsub != -1:
-            np_results = self._results.to_numpy_exclusive_subjets_nsub(
-                px, py, pz, E, nsub
-            )
+            np_results = self._results.to_numpy_exclusive_subjets_nsub(*jet, nsub)
         if nsub == -1 and dcut != -1:
-            np_results = self._results.to_numpy_exclusive_subjets_dcut(
-                px, py, pz, E, dcut
-            )
+            np_results = self._results.to_numpy_exclusive_subjets_dcut(*jet, dcut)
         if np_results == 0:
             raise ValueError("Either Dcut or Njets should be entered") from None
         return ak.Array(
-            ak.contents.RecordArray(
-                [
-                    ak.contents.NumpyArray(np_results[0]),
-                    ak.contents.NumpyArray(np_results[1]),
-                    ak.contents.NumpyArray(np_results[2]),
-                    ak.contents.NumpyArray(np_results[3]),
-                ],
-                ["px", "py", "pz", "E"],
-                parameters={"__record__": "Momentum4D"},
+            fastjet._multievent._momenta_record(
+                np_results, self._with_index, self._coordinates
             ),
             behavior=self.data.behavior,
         )
 
     def exclusive_subjets_up_to(self, data, nsub):
-        try:
-            px = data.px
-            py = data.py
-            pz = data.pz
-            E = data.E
-        except AttributeError:
-            raise AttributeError("Lorentz vector not found") from None
-        np_results = self._results.to_numpy_exclusive_subjets_up_to(px, py, pz, E, nsub)
+        jet = fastjet._multievent._jet_address(data)
+        np_results = self._results.to_numpy_exclusive_subjets_up_to(*jet, nsub)
         return ak.Array(
-            ak.contents.RecordArray(
-                [
-                    ak.contents.NumpyArray(np_results[0]),
-                    ak.contents.NumpyArray(np_results[1]),
-                    ak.contents.NumpyArray(np_results[2]),
-                    ak.contents.NumpyArray(np_results[3]),
-                ],
-                ["px", "py", "pz", "E"],
-                parameters={"__record__": "Momentum4D"},
+            fastjet._multievent._momenta_record(
+                np_results, self._with_index, self._coordinates
             ),
             behavior=self.data.behavior,
         )
 
     def exclusive_subdmerge(self, data, nsub):
-        try:
-            px = data.px
-            py = data.py
-            pz = data.pz
-            E = data.E
-        except AttributeError:
-            raise AttributeError("Lorentz vector not found") from None
-        np_results = self._results.to_numpy_exclusive_subdmerge(px, py, pz, E, nsub)
+        jet = fastjet._multievent._jet_address(data)
+        np_results = self._results.to_numpy_exclusive_subdmerge(*jet, nsub)
         out = np_results[0]
         out = out[0]
         return out
 
     def exclusive_subdmerge_max(self, data, nsub):
-        try:
-            px = data.px
-            py = data.py
-            pz = data.pz
-            E = data.E
-        except AttributeError:
-            raise AttributeError("Lorentz vector not found") from None
-        np_results = self._results.to_numpy_exclusive_subdmerge_max(px, py, pz, E, nsub)
+        jet = fastjet._multievent._jet_address(data)
+        np_results = self._results.to_numpy_exclusive_subdmerge_max(*jet, nsub)
         out = np_results[0]
         out = out[0]
         return out
 
     def n_exclusive_subjets(self, data, dcut):
-        try:
-            px = data.px
-            py = data.py
-            pz = data.pz
-            E = data.E
-        except AttributeError:
-            raise AttributeError("Lorentz vector not found") from None
-        np_results = self._results.to_numpy_n_exclusive_subjets(px, py, pz, E, dcut)
+        jet = fastjet._multievent._jet_address(data)
+        np_results = self._results.to_numpy_n_exclusive_subjets(*jet, dcut)
         out = np_results[0]
         out = out[0]
         return out
 
     def has_parents(self, data):
-        try:
-            px = data.px
-            py = data.py
-            pz = data.pz
-            E = data.E
-        except AttributeError:
-            raise AttributeError("Lorentz vector not found") from None
-        np_results = self._results.to_numpy_has_parents(px, py, pz, E)
+        jet = fastjet._multievent._jet_address(data)
+        np_results = self._results.to_numpy_has_parents(*jet)
         out = np_results[0]
         out = out[0]
         return out
 
     def has_child(self, data):
-        try:
-            px = data.px
-            py = data.py
-            pz = data.pz
-            E = data.E
-        except AttributeError:
-            raise AttributeError("Lorentz vector not found") from None
-        np_results = self._results.to_numpy_has_child(px, py, pz, E)
+        jet = fastjet._multievent._jet_address(data)
+        np_results = self._results.to_numpy_has_child(*jet)
         out = np_results[0]
         out = out[0]
         return out
 
     def jet_scale_for_algorithm(self, data):
-        try:
-            px = data.px
-            py = data.py
-            pz = data.pz
-            E = data.E
-        except AttributeError:
-            raise AttributeError("Lorentz vector not found") from None
-        np_results = self._results.to_numpy_jet_scale_for_algorithm(px, py, pz, E)
+        jet = fastjet._multievent._jet_address(data)
+        np_results = self._results.to_numpy_jet_scale_for_algorithm(*jet)
         out = np_results[0]
         out = out[0]
         return out
@@ -586,15 +589,8 @@ class _classsingleevent:
     def childless_pseudojets(self):
         np_results = self._results.to_numpy_childless_pseudojets()
         return ak.Array(
-            ak.contents.RecordArray(
-                (
-                    ak.contents.NumpyArray(np_results[0]),
-                    ak.contents.NumpyArray(np_results[1]),
-                    ak.contents.NumpyArray(np_results[2]),
-                    ak.contents.NumpyArray(np_results[3]),
-                ),
-                ("px", "py", "pz", "E"),
-                parameters={"__record__": "Momentum4D"},
+            fastjet._multievent._momenta_record(
+                np_results, self._with_index, self._coordinates
             ),
             behavior=self.data.behavior,
         )
@@ -602,61 +598,28 @@ class _classsingleevent:
     def jets(self):
         np_results = self._results.to_numpy_jets()
         return ak.Array(
-            ak.contents.RecordArray(
-                (
-                    ak.contents.NumpyArray(np_results[0]),
-                    ak.contents.NumpyArray(np_results[1]),
-                    ak.contents.NumpyArray(np_results[2]),
-                    ak.contents.NumpyArray(np_results[3]),
-                ),
-                ("px", "py", "pz", "E"),
-                parameters={"__record__": "Momentum4D"},
+            fastjet._multievent._momenta_record(
+                np_results, self._with_index, self._coordinates
             ),
             behavior=self.data.behavior,
         )
 
     def get_parents(self, data):
-        try:
-            px = data.px
-            py = data.py
-            pz = data.pz
-            E = data.E
-        except AttributeError:
-            raise AttributeError("Lorentz vector not found") from None
-        np_results = self._results.to_numpy_get_parents(px, py, pz, E)
+        jet = fastjet._multievent._jet_address(data)
+        np_results = self._results.to_numpy_get_parents(*jet)
         return ak.Array(
-            ak.contents.RecordArray(
-                (
-                    ak.contents.NumpyArray(np_results[0]),
-                    ak.contents.NumpyArray(np_results[1]),
-                    ak.contents.NumpyArray(np_results[2]),
-                    ak.contents.NumpyArray(np_results[3]),
-                ),
-                ("px", "py", "pz", "E"),
-                parameters={"__record__": "Momentum4D"},
+            fastjet._multievent._momenta_record(
+                np_results, self._with_index, self._coordinates
             ),
             behavior=self.data.behavior,
         )
 
     def get_child(self, data):
-        try:
-            px = data.px
-            py = data.py
-            pz = data.pz
-            E = data.E
-        except AttributeError:
-            raise AttributeError("Lorentz vector not found") from None
-        np_results = self._results.to_numpy_get_child(px, py, pz, E)
+        jet = fastjet._multievent._jet_address(data)
+        np_results = self._results.to_numpy_get_child(*jet)
         return ak.Array(
-            ak.contents.RecordArray(
-                (
-                    ak.contents.NumpyArray(np_results[0]),
-                    ak.contents.NumpyArray(np_results[1]),
-                    ak.contents.NumpyArray(np_results[2]),
-                    ak.contents.NumpyArray(np_results[3]),
-                ),
-                ("px", "py", "pz", "E"),
-                parameters={"__record__": "Momentum4D"},
+            fastjet._multievent._momenta_record(
+                np_results, self._with_index, self._coordinates
             ),
             behavior=self.data.behavior,
         )
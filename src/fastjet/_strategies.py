@@ -0,0 +1,133 @@
+import time
+
+import numpy as np
+
+import fastjet._ext  # noqa: F401, E402
+import fastjet._swig
+
+_default_multiplicities = (10, 20, 50, 100, 200, 500, 1000, 2000, 5000)
+_default_strategies = ("N2Plain", "N2Tiled", "N2MHTLazy9", "N2MHTLazy25", "NlnN")
+
+
+def set_strategy_table(table):
+    """Sets the clustering strategy of each event of a batch clustered with anti-kt and
+    the ``Best`` strategy from its number of particles, in place of FastJet's own
+    choice. Other algorithms, whose crossovers differ, keep FastJet's choice. Only the
+    time taken changes, except that strategies may break exact ties between pair
+    distances differently.
+
+    Args:
+        table (dict): For each R, a list of ``(strategy, max_particles)`` pairs in order
+            of increasing ``max_particles``, the last one ``None``; events use the row
+            of the closest R. ``None`` restores FastJet's own choice. Strategies that
+            cannot run here, like NlnN without CGAL, raise a ValueError.
+    """
+    if table is None:
+        fastjet._ext.set_strategy_table(None)
+        return
+    fastjet._ext.set_strategy_table(
+        {
+            float(R): [
+                (name, -1 if bound is None else int(bound)) for name, bound in row
+            ]
+            for R, row in table.items()
+        }
+    )
+
+
+def get_strategy_table():
+    """Returns the strategy table in use, or ``None`` when FastJet chooses."""
+    table = fastjet._ext.get_strategy_table()
+    if table is None:
+        return None
+    return {
+        R: [(name, None if bound < 0 else bound) for name, bound in row]
+        for R, row in table.items()
+    }
+
+
+def _uniform_events(rng, n_particles, n_events):
+    # a flat soft background, as pileup-dominated events look like
+    size = n_particles * n_events
+    pt = rng.exponential(1.0, size) + 0.1
+    rap = rng.uniform(-4.0, 4.0, size)
+    phi = rng.uniform(-np.pi, np.pi, size)
+    px, py = pt * np.cos(phi), pt * np.sin(phi)
+    pz, E = pt * np.sinh(rap), pt * np.cosh(rap)
+    starts = np.arange(n_events, dtype=np.int64) * n_particles
+    return px, py, pz, E, starts, starts + n_particles
+
+
+def _crossovers(multiplicities, fastest):
+    # merges runs of multiplicities with the same fastest strategy; the bound
+    # between two runs is the geometric mean of the multiplicities on either side
+    row = []
+    for k, name in enumerate(fastest):
+        if row and row[-1][0] == name:
+            continue
+        if row:
+            row[-1] = (
+                row[-1][0],
+                int(np.sqrt(multiplicities[k - 1] * multiplicities[k])),
+            )
+        row.append((name, None))
+    return row
+
+
+def calibrate_strategies(
+    R=(0.4, 0.8),
+    multiplicities=_default_multiplicities,
+    strategies=_default_strategies,
+    particles_per_point=200000,
+    repeat=3,
+    seed=0,
+    apply=True,
+):
+    """Measures on this machine which clustering strategy is fastest for anti-kt events
+    of each multiplicity and R, and returns the crossovers as a table for
+    ``set_strategy_table``.
+
+    Args:
+        R (sequence of float): The jet radii to calibrate.
+        multiplicities (sequence of int): The numbers of particles per event to time, in
+            increasing order.
+        strategies (sequence of str): The candidate strategies. Those that cannot run
+            here, like NlnN without CGAL, are left out.
+        particles_per_point (int): The number of particles clustered for each timing.
+        repeat (int): Each timing is the best of this many runs.
+        seed (int): Seed of the random events.
+        apply (bool): Whether to set the table for the following clusterings.
+
+    Returns:
+        dict: The table, for each R a list of ``(strategy, max_particles)`` pairs.
+    """
+    rng = np.random.default_rng(seed)
+    table = {}
+    for radius in R:
+        fastest = []
+        for n in multiplicities:
+            events = _uniform_events(rng, n, max(1, particles_per_point // n))
+            timings = {}
+            for name in strategies:
+                jetdef = fastjet._swig.JetDefinition(
+                    fastjet._swig.antikt_algorithm,
+                    radius,
+                    fastjet._swig.E_scheme,
+                    getattr(fastjet._swig, name),
+                )
+                best = float("inf")
+                try:
+                    for _ in range(repeat):
+                        start = time.perf_counter()
+                        fastjet._ext.interfacemulti(*events, jetdef, n_threads=1)
+                        best = min(best, time.perf_counter() - start)
+                except Exception:  # noqa: BLE001
+                    continue
+                timings[name] = best
+            if not timings:
+                raise RuntimeError("None of the strategies can run here")
+            fastest.append(min(timings, key=timings.get))
+        table[float(radius)] = _crossovers(multiplicities, fastest)
+    if apply:
+        set_strategy_table(table)
+    return table
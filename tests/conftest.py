@@ -0,0 +1,75 @@
+import awkward as ak
+import numpy as np
+import pytest
+
+# a hard particle with a softer one nearby, a very soft and a forward particle
+# and a hard particle recoiling in the other hemisphere; all of them have
+# E >= |p|, so that every coordinate system applies
+_particles = [
+    {"px": 1.2, "py": 3.2, "pz": 5.4, "E": 6.5},
+    {"px": 1.25, "py": 3.15, "pz": 5.4, "E": 6.4},
+    {"px": 0.1, "py": 0.2, "pz": 0.3, "E": 0.4},
+    {"px": 0.5, "py": 0.3, "pz": 40.0, "E": 40.1},
+    {"px": 32.2, "py": 64.21, "pz": 543.34, "E": 548.12},
+    {"px": -32.45, "py": 63.21, "pz": -543.14, "E": 548.56},
+]
+
+
+def _vector_behavior():
+    # the batches are vectors whichever test registered vector globally first
+    return pytest.importorskip("vector").backends.awkward.behavior
+
+
+@pytest.fixture
+def particles():
+    """The particles the events of the batch tests are cut from."""
+    return list(_particles)
+
+
+@pytest.fixture
+def events(particles):
+    """Three events of 6, 5 and 4 particles, enough for up to 4 exclusive jets."""
+    return ak.Array(
+        [particles, particles[1:], particles[:4]],
+        with_name="Momentum4D",
+        behavior=_vector_behavior(),
+    )
+
+
+@pytest.fixture
+def random_events():
+    """Builds events of counts[i] random particles, exponential in pt around mean_pt
+    and flat in phi and in rapidity up to rap_max, to which the (pt, rapidity, phi)
+    particles of hard are added."""
+
+    def make(counts, mean_pt=5.0, rap_max=2.5, hard=(), seed=42):
+        rng = np.random.default_rng(seed)
+        counts = np.asarray(counts, dtype=np.int64)
+        size = int(counts.sum())
+        pt = rng.exponential(mean_pt, size) + 0.1
+        rap = rng.uniform(-rap_max, rap_max, size)
+        phi = rng.uniform(-np.pi, np.pi, size)
+        if len(hard) > 0:
+            hard = np.asarray(hard, dtype=np.float64)
+            starts = np.cumsum(counts)
+            columns = []
+            for soft, extra in zip((pt, rap, phi), hard.T):
+                pieces = np.split(soft, starts[:-1])
+                columns.append(
+                    np.concatenate([np.append(piece, extra) for piece in pieces])
+                )
+            pt, rap, phi = columns
+            counts = counts + len(hard)
+        flat = ak.zip(
+            {
+                "px": pt * np.cos(phi),
+                "py": pt * np.sin(phi),
+                "pz": pt * np.sinh(rap),
+                "E": pt * np.cosh(rap),
+            },
+            with_name="Momentum4D",
+            behavior=_vector_behavior(),
+        )
+        return ak.unflatten(flat, counts)
+
+    return make
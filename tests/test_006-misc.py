@@ -412,3 +412,29 @@ def test_constituent_index_min_pt():
     )
     is_close = ak.ravel(ak.isclose(array_flat_expected, array_flat, rtol=1e-12, atol=0))
     assert ak.all(is_close)
+
+
+def test_jet_cache_is_bounded():
+    array = ak.Array(
+        [
+            [
+                {"px": 1.2, "py": 3.2, "pz": 5.4, "E": 2.5, "ex": 0.78},
+                {"px": 32.2, "py": 64.21, "pz": 543.34, "E": 24.12, "ex": 0.35},
+                {"px": 32.45, "py": 63.21, "pz": 543.14, "E": 24.56, "ex": 0.0},
+            ],
+            [
+                {"px": 1.2, "py": 3.2, "pz": 5.4, "E": 2.5, "ex": 0.78},
+                {"px": 32.45, "py": 63.21, "pz": 543.14, "E": 24.56, "ex": 0.0},
+            ],
+        ],
+    )
+    jetdef = fastjet.JetDefinition(fastjet.kt_algorithm, 0.6)
+    cluster = fastjet._pyjet.AwkwardClusterSequence(array, jetdef)
+    results = cluster._internalrep._results
+    expected = cluster.exclusive_jets(dcut=1.0).to_list()
+    for dcut in np.linspace(2.0, 40.0, 20):
+        cluster.exclusive_jets(dcut=float(dcut))
+    assert results.cache_size() == 8
+    assert cluster.exclusive_jets(dcut=1.0).to_list() == expected
+    results.clear_cache()
+    assert results.cache_size() == 0
@@ -273,3 +273,52 @@ def dask_multi_test_exclusive_jets_softdrop_grooming():
         )
 
         assert ak.all(is_close)
+
+
+def test_partition_clustered_once(monkeypatch):
+    import dask
+
+    array = ak.Array(
+        [
+            [
+                {"px": 1.2, "py": 3.2, "pz": 5.4, "E": 2.5},
+                {"px": 32.2, "py": 64.21, "pz": 543.34, "E": 24.12},
+                {"px": 32.45, "py": 63.21, "pz": 543.14, "E": 24.56},
+            ]
+        ]
+        * 2
+    )
+    jetdef = fastjet.JetDefinition(fastjet.antikt_algorithm, 0.6)
+    made = []
+
+    class CountingClusterSequence(fastjet._pyjet.AwkwardClusterSequence):
+        def __init__(self, *args, **kwargs):
+            made.append(args[0])
+            super().__init__(*args, **kwargs)
+
+    monkeypatch.setattr(
+        fastjet._pyjet, "AwkwardClusterSequence", CountingClusterSequence
+    )
+    caller = fastjet._pyjet._FnDelayedInternalRepCaller
+    jets = caller("inclusive_jets", jetdef)(array)
+    constituents = caller("constituents", jetdef)(array)
+    assert len(made) == 1
+    assert ak.num(jets).to_list() == ak.num(constituents).to_list()
+    # another clustering of the same partition is kept apart
+    other = fastjet.JetDefinition(fastjet.kt_algorithm, 0.6)
+    caller("inclusive_jets", other)(array)
+    assert len(made) == 2
+    # a Selector, which may be a SelectorPython, is only known by a description
+    # that does not tell two of them apart, so its clusterings are not shared
+    for cut in [1.0, 50.0]:
+        selector = fastjet.SelectorPython(lambda particle, cut=cut: particle.pt() > cut)
+        caller("inclusive_jets", jetdef, particle_selection=selector)(array)
+    assert len(made) == 4
+
+    darray = dak.from_awkward(array, 1)
+    cluster = fastjet._pyjet.DaskAwkwardClusterSequence(darray, jetdef)
+    jets, constituents = dask.compute(
+        cluster.inclusive_jets(), cluster.constituents(), scheduler="sync"
+    )
+    assert ak.num(jets).to_list() == [2, 2]
+    assert ak.num(constituents, axis=2).to_list() == [[1, 2], [1, 2]]
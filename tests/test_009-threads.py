@@ -0,0 +1,45 @@
+import awkward as ak  # noqa: F401
+import numpy as np  # noqa: F401
+import pytest  # noqa: F401
+
+import fastjet._pyjet  # noqa: F401
+
+vector = pytest.importorskip("vector")  # noqa: F401
+
+
+def test_threads_match_serial(random_events):
+    # at least two particles per event, for the exclusive jets
+    array = random_events([2 + k % 28 for k in range(50)])
+    jetdef = fastjet.JetDefinition(fastjet.antikt_algorithm, 0.4)
+    serial = fastjet._pyjet.AwkwardClusterSequence(array, jetdef, n_threads=1)
+    for n_threads in [2, 4, 0]:
+        threaded = fastjet._pyjet.AwkwardClusterSequence(
+            array, jetdef, n_threads=n_threads
+        )
+        assert serial.inclusive_jets().to_list() == threaded.inclusive_jets().to_list()
+        assert serial.constituent_index().to_list() == (
+            threaded.constituent_index().to_list()
+        )
+        assert serial.exclusive_jets(n_jets=2).to_list() == (
+            threaded.exclusive_jets(n_jets=2).to_list()
+        )
+
+
+def test_threads_sliced_input(random_events):
+    array = random_events([2 + k % 28 for k in range(50)])[7:31]
+    jetdef = fastjet.JetDefinition(fastjet.kt_algorithm, 0.6)
+    serial = fastjet.ClusterSequence(array, jetdef, n_threads=1)
+    threaded = fastjet.ClusterSequence(array, jetdef, n_threads=3)
+    assert serial.inclusive_jets().to_list() == threaded.inclusive_jets().to_list()
+    assert len(threaded.inclusive_jets()) == len(array)
+
+
+def test_default_num_threads():
+    previous = fastjet.get_num_threads()
+    try:
+        fastjet.set_num_threads(2)
+        assert fastjet.get_num_threads() == 2
+        fastjet.set_num_threads(0)
+        assert fastjet.get_num_threads() >= 1
+    finally:
+        fastjet.set_num_threads(previous)
@@ -0,0 +1,104 @@
+import awkward as ak
+import numpy as np
+import pytest
+
+import fastjet
+
+vector = pytest.importorskip("vector")  # noqa: F841
+
+
+def test_jet_observables_match_single_calls(events):
+    jetdef = fastjet.JetDefinition(fastjet.cambridge_algorithm, 0.8)
+    cluster = fastjet._pyjet.AwkwardClusterSequence(events, jetdef)
+
+    out = cluster.jet_observables(
+        [
+            "momentum",
+            "constituent_index",
+            {"observable": "softdrop", "beta": 0.0, "symmetry_cut": 0.1},
+            {
+                "observable": "energy_correlator",
+                "name": "ecg2",
+                "func": "generalized",
+                "npoint": 2,
+                "angles": 1,
+            },
+            "lund_declusterings",
+        ],
+        njets=2,
+    )
+
+    jets = cluster.exclusive_jets(n_jets=2)
+    assert out[["px", "py", "pz", "E"]].to_list() == jets.to_list()
+    assert (
+        out.constituent_index.to_list()
+        == cluster.exclusive_jets_constituent_index(njets=2).to_list()
+    )
+
+    softdrop = cluster.exclusive_jets_softdrop_grooming(njets=2)
+    assert ak.all(
+        ak.isclose(
+            ak.flatten(out.msoftdrop),
+            softdrop.msoftdrop,
+            rtol=1e-12,
+            atol=0,
+            equal_nan=True,
+        )
+    )
+
+    ecg2 = cluster.exclusive_jets_energy_correlator(
+        njets=2, func="generalized", npoint=2, angles=1
+    )
+    assert np.allclose(ak.to_numpy(ak.flatten(out.ecg2)), ak.to_numpy(ecg2))
+
+    assert (
+        out.lund_declusterings.to_list()
+        == cluster.exclusive_jets_lund_declusterings(2).to_list()
+    )
+
+
+def test_jet_observables_inclusive_njettiness(events):
+    jetdef = fastjet.JetDefinition(fastjet.antikt_algorithm, 0.6)
+    cluster = fastjet._pyjet.AwkwardClusterSequence(events, jetdef)
+
+    out = cluster.jet_observables(
+        ["momentum", {"observable": "nsubjettiness", "name": "tau", "njets": [1, 2]}]
+    )
+
+    assert out[["px", "py", "pz", "E"]].to_list() == cluster.inclusive_jets().to_list()
+    assert ak.all(ak.num(out.tau, axis=2) == 2)
+    # a single-particle jet is described exactly by one axis
+    n_constituents = ak.num(cluster.constituent_index(), axis=2)
+    single = ak.flatten(out.tau[n_constituents == 1])
+    assert ak.all(single[:, 0] == 0)
+
+
+def test_jet_observables_nsubjettiness_matches_njettiness(events):
+    jetdef = fastjet.JetDefinition(fastjet.kt_algorithm, 0.6)
+    cluster = fastjet._pyjet.AwkwardClusterSequence(events, jetdef)
+
+    # one exclusive jet holds all the particles of its event
+    out = cluster.jet_observables(
+        [{"observable": "nsubjettiness", "name": "tau", "njets": [1, 2, 3]}],
+        njets=1,
+    )
+    taus = cluster.njettiness(njets=[1, 2, 3])
+
+    assert ak.all(ak.num(out.tau) == 1)
+    assert np.allclose(ak.to_numpy(out.tau[:, 0]), ak.to_numpy(taus))
+
+
+def test_jet_observables_bad_requests(events):
+    jetdef = fastjet.JetDefinition(fastjet.antikt_algorithm, 0.6)
+    cluster = fastjet._pyjet.AwkwardClusterSequence(events, jetdef)
+
+    with pytest.raises(ValueError):
+        cluster.jet_observables([])
+    with pytest.raises(ValueError):
+        cluster.jet_observables(["not_an_observable"])
+    with pytest.raises(ValueError):
+        cluster.jet_observables(["njettiness"])
+    with pytest.raises(ValueError):
+        cluster.jet_observables(["softdrop", {"observable": "softdrop"}])
+    with pytest.raises(ValueError):
+        cluster.jet_observables(["momentum"], njets=0)
@@ -0,0 +1,63 @@
+import awkward as ak
+import numpy as np
+import pytest
+
+import fastjet
+import fastjet._pyjet  # noqa: F401
+
+vector = pytest.importorskip("vector")  # noqa: F841
+
+
+def _mirrored_events():
+    # two jets back to back in phi, hence with the same rapidity
+    event = [
+        {"px": 10.0, "py": 1.0, "pz": 5.0, "E": 15.0},
+        {"px": 10.0, "py": -1.0, "pz": 5.0, "E": 15.0},
+        {"px": -10.0, "py": 1.0, "pz": 5.0, "E": 15.0},
+        {"px": -10.0, "py": -1.0, "pz": 5.0, "E": 15.0},
+    ]
+    return ak.Array([event, event], with_name="Momentum4D")
+
+
+def test_jets_carry_cluster_hist_index():
+    array = _mirrored_events()
+    jetdef = fastjet.JetDefinition(fastjet.antikt_algorithm, 0.6)
+    plain = fastjet.ClusterSequence(array, jetdef)
+    indexed = fastjet.ClusterSequence(array, jetdef, with_index=True)
+
+    jets = indexed.inclusive_jets()
+    assert "cluster_hist_index" not in plain.inclusive_jets().fields
+    assert jets[["px", "py", "pz", "E"]].to_list() == plain.inclusive_jets().to_list()
+    # four inputs merged pairwise: the jets are the last two history entries
+    assert sorted(ak.to_list(jets.cluster_hist_index[0])) == [4, 5]
+
+
+def test_queries_by_cluster_hist_index():
+    array = _mirrored_events()
+    jetdef = fastjet.JetDefinition(fastjet.antikt_algorithm, 0.6)
+    cluster = fastjet.ClusterSequence(array, jetdef, with_index=True)
+    jets = cluster.inclusive_jets()
+
+    for k in range(2):
+        jet = jets[:, k]
+        # a momentum lookup would pick the first jet of equal rapidity
+        parents = cluster.get_parents(jet)
+        parents_px = ak.to_numpy(ak.sum(parents.px, axis=1))
+        assert np.allclose(parents_px, ak.to_numpy(jet.px))
+        subjets = cluster.exclusive_subjets(jet, nsub=2)
+        subjets_px = ak.to_numpy(ak.sum(subjets.px, axis=1))
+        assert np.allclose(subjets_px, ak.to_numpy(jet.px))
+        assert ak.all(cluster.has_parents(jet))
+        assert not ak.any(cluster.has_child(jet))
+
+
+def test_bad_cluster_hist_index():
+    array = _mirrored_events()
+    jetdef = fastjet.JetDefinition(fastjet.antikt_algorithm, 0.6)
+    cluster = fastjet.ClusterSequence(array, jetdef, with_index=True)
+
+    bad = ak.Array(
+        [{"px": 0.0, "py": 0.0, "pz": 0.0, "E": 0.0, "cluster_hist_index": 99}] * 2
+    )
+    with pytest.raises(IndexError):
+        cluster.get_parents(bad)
@@ -0,0 +1,39 @@
+import awkward as ak
+import numpy as np
+import pytest
+
+import fastjet
+
+vector = pytest.importorskip("vector")  # noqa: F841
+
+
+def test_float32_input(events):
+    jetdef = fastjet.JetDefinition(fastjet.antikt_algorithm, 0.6)
+    events = ak.with_name(ak.values_astype(events, np.float32), "Momentum4D")
+    single = fastjet.ClusterSequence(events, jetdef)
+    double = fastjet.ClusterSequence(ak.values_astype(events, np.float64), jetdef)
+    assert single.inclusive_jets().to_list() == double.inclusive_jets().to_list()
+    assert single.constituent_index().to_list() == double.constituent_index().to_list()
+
+
+def test_float32_output(events):
+    jetdef = fastjet.JetDefinition(fastjet.antikt_algorithm, 0.6)
+    cluster = fastjet.ClusterSequence(events, jetdef, output_dtype="float32")
+    reference = fastjet.ClusterSequence(events, jetdef)
+
+    jets = cluster.inclusive_jets()
+    for field in ("px", "py", "pz", "E"):
+        assert ak.flatten(jets[field]).layout.dtype == np.float32
+        assert np.allclose(
+            ak.to_numpy(ak.flatten(jets[field])),
+            ak.to_numpy(ak.flatten(reference.inclusive_jets()[field])),
+            rtol=1e-6,
+        )
+    parents = cluster.get_parents(jets[:, 0])
+    assert ak.flatten(parents.px).layout.dtype == np.float32
+
+
+def test_bad_output_dtype(events):
+    jetdef = fastjet.JetDefinition(fastjet.antikt_algorithm, 0.6)
+    with pytest.raises(ValueError):
+        fastjet.ClusterSequence(events, jetdef, output_dtype="int32")
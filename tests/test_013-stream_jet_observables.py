@@ -0,0 +1,47 @@
+import awkward as ak
+import pytest
+
+import fastjet
+
+vector = pytest.importorskip("vector")
+
+
+@pytest.mark.parametrize("batch_size", [1, 2, 1000])
+def test_stream_matches_jet_observables(batch_size, particles):
+    array = ak.Array(
+        [particles, particles[1:], [], particles[:3], particles[2:]],
+        with_name="Momentum4D",
+        behavior=vector.backends.awkward.behavior,
+    )
+    jetdef = fastjet.JetDefinition(fastjet.cambridge_algorithm, 0.8)
+    observables = [
+        "momentum",
+        "constituent_index",
+        {"observable": "softdrop", "beta": 0.0, "symmetry_cut": 0.1},
+    ]
+    reference = fastjet.ClusterSequence(array, jetdef).jet_observables(observables)
+
+    chunks = [array[:2], array[2:]]
+    streamed = list(
+        fastjet.stream_jet_observables(
+            chunks, jetdef, observables, batch_size=batch_size
+        )
+    )
+    assert len(streamed) == 2
+    assert ak.concatenate(streamed).to_list() == reference.to_list()
+
+
+def test_stream_exclusive_jets(events):
+    jetdef = fastjet.JetDefinition(fastjet.kt_algorithm, 0.6)
+    cluster = fastjet.ClusterSequence(events, jetdef)
+
+    (streamed,) = fastjet.stream_jet_observables(
+        events, jetdef, ["momentum"], njets=2, batch_size=2
+    )
+    assert streamed.to_list() == cluster.exclusive_jets(n_jets=2).to_list()
+
+
+def test_stream_bad_batch_size(events):
+    jetdef = fastjet.JetDefinition(fastjet.antikt_algorithm, 0.6)
+    with pytest.raises(ValueError):
+        next(fastjet.stream_jet_observables(events, jetdef, ["momentum"], batch_size=0))
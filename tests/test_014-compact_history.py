@@ -0,0 +1,86 @@
+import pytest
+
+import fastjet
+
+vector = pytest.importorskip("vector")  # noqa: F841
+
+
+@pytest.mark.parametrize(
+    "algorithm",
+    [fastjet.kt_algorithm, fastjet.cambridge_algorithm, fastjet.antikt_algorithm],
+)
+def test_compact_history_matches_cluster_sequence(algorithm, events):
+    jetdef = fastjet.JetDefinition(algorithm, 0.6)
+    full = fastjet.ClusterSequence(events, jetdef, with_index=True)
+    compact = fastjet.ClusterSequence(
+        events, jetdef, with_index=True, compact_history=True
+    )
+
+    for query, kwargs in [
+        ("inclusive_jets", {}),
+        ("inclusive_jets", {"min_pt": 5.0}),
+        ("exclusive_jets", {"n_jets": 2}),
+        ("exclusive_jets", {"dcut": 10.0}),
+        ("exclusive_jets_up_to", {"n_jets": 3}),
+        ("exclusive_jets_ycut", {"ycut": 0.01}),
+        ("exclusive_dmerge", {"njets": 2}),
+        ("exclusive_dmerge_max", {"njets": 2}),
+        ("exclusive_ymerge", {"njets": 2}),
+        ("Q", {}),
+        ("unique_history_order", {}),
+        ("n_particles", {}),
+        ("n_exclusive_jets", {"dcut": 10.0}),
+        ("constituent_index", {}),
+        ("exclusive_jets_constituent_index", {"njets": 2}),
+    ]:
+        expected = getattr(full, query)(**kwargs).to_list()
+        assert getattr(compact, query)(**kwargs).to_list() == expected, query
+
+    jet = full.exclusive_jets(n_jets=1)[:, 0]
+    for query, kwargs in [
+        ("exclusive_subjets", {"nsub": 2}),
+        ("exclusive_subjets", {"dcut": 10.0}),
+        ("exclusive_subjets_up_to", {"nsub": 3}),
+        ("exclusive_subdmerge", {"nsub": 2}),
+        ("exclusive_subdmerge_max", {"nsub": 2}),
+        ("n_exclusive_subjets", {"dcut": 10.0}),
+        ("has_parents", {}),
+        ("get_parents", {}),
+        ("has_child", {}),
+        ("get_child", {}),
+    ]:
+        expected = getattr(full, query)(jet, **kwargs).to_list()
+        assert getattr(compact, query)(jet, **kwargs).to_list() == expected, query
+
+
+def test_compact_history_needs_sequences_for_substructure(events):
+    jetdef = fastjet.JetDefinition(fastjet.cambridge_algorithm, 0.8)
+    compact = fastjet.ClusterSequence(events, jetdef, compact_history=True)
+    with pytest.raises(RuntimeError):
+        compact.exclusive_jets_softdrop_grooming(njets=1)
+    with pytest.raises(RuntimeError):
+        compact.jet_observables(["momentum", "constituent_index"])
+    assert (
+        compact.jet_observables(["momentum"]).to_list()
+        == compact.inclusive_jets().to_list()
+    )
+
+
+@pytest.mark.parametrize("strategy", ["Best", "N2Plain", "N2Tiled", "N2MHTLazy9"])
+def test_compact_history_reused_sequences(strategy, random_events):
+    # events of very different sizes are clustered one after the other on
+    # the same thread, which reuses one sequence for all of them
+    events = random_events([120, 3, 0, 60, 1, 200, 15], seed=7)
+    jetdef = fastjet.JetDefinition(
+        fastjet.antikt_algorithm, 0.4, fastjet.E_scheme, getattr(fastjet, strategy)
+    )
+    full = fastjet.ClusterSequence(events, jetdef, n_threads=1)
+    for _ in range(2):
+        compact = fastjet.ClusterSequence(
+            events, jetdef, n_threads=1, compact_history=True
+        )
+        assert compact.inclusive_jets().to_list() == full.inclusive_jets().to_list()
+        assert (
+            compact.exclusive_dmerge_spectrum().to_list()
+            == full.exclusive_dmerge_spectrum().to_list()
+        )
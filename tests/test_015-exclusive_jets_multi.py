@@ -0,0 +1,64 @@
+import awkward as ak
+import numpy as np
+import pytest
+
+import fastjet
+
+vector = pytest.importorskip("vector")  # noqa: F841
+
+
+@pytest.mark.parametrize("compact_history", [False, True])
+def test_exclusive_jets_multi(compact_history, events):
+    jetdef = fastjet.JetDefinition(fastjet.kt_algorithm, 0.6)
+    cluster = fastjet.ClusterSequence(events, jetdef, compact_history=compact_history)
+
+    # in any order, and repeated: the walk reaches them in its own order
+    n_jets = [3, 1, 4, 2, 3]
+    multi = cluster.exclusive_jets_multi(n_jets=n_jets)
+    assert ak.all(ak.num(multi, axis=1) == len(n_jets))
+    for k, n in enumerate(n_jets):
+        assert multi[:, k].to_list() == cluster.exclusive_jets(n_jets=n).to_list()
+
+    dcuts = [100.0, 1.0, 10.0, 0.0, 1e9]
+    multi = cluster.exclusive_jets_multi(dcut=dcuts)
+    for k, dcut in enumerate(dcuts):
+        assert multi[:, k].to_list() == cluster.exclusive_jets(dcut=dcut).to_list()
+        assert ak.num(multi[:, k]).to_list() == cluster.n_exclusive_jets(dcut).to_list()
+
+    ycuts = [0.01, 0.001]
+    multi = cluster.exclusive_jets_multi(ycut=ycuts)
+    for k, ycut in enumerate(ycuts):
+        assert multi[:, k].to_list() == cluster.exclusive_jets_ycut(ycut).to_list()
+
+
+@pytest.mark.parametrize("compact_history", [False, True])
+def test_exclusive_dmerge_spectrum(compact_history, events):
+    jetdef = fastjet.JetDefinition(fastjet.kt_algorithm, 0.6)
+    cluster = fastjet.ClusterSequence(events, jetdef, compact_history=compact_history)
+
+    spectrum = cluster.exclusive_dmerge_spectrum()
+    assert ak.num(spectrum).to_list() == cluster.n_particles().to_list()
+    for n in range(1, 4):
+        assert np.allclose(
+            ak.to_numpy(spectrum.dmerge[:, n]), ak.to_numpy(cluster.exclusive_dmerge(n))
+        )
+        assert np.allclose(
+            ak.to_numpy(spectrum.dmerge_max[:, n]),
+            ak.to_numpy(cluster.exclusive_dmerge_max(n)),
+        )
+
+    yspectrum = cluster.exclusive_dmerge_spectrum(ymerge=True)
+    assert np.allclose(
+        ak.to_numpy(yspectrum.ymerge[:, 2]), ak.to_numpy(cluster.exclusive_ymerge(2))
+    )
+
+
+def test_exclusive_jets_multi_bad_requests(events):
+    jetdef = fastjet.JetDefinition(fastjet.kt_algorithm, 0.6)
+    cluster = fastjet.ClusterSequence(events, jetdef)
+    with pytest.raises(ValueError):
+        cluster.exclusive_jets_multi()
+    with pytest.raises(ValueError):
+        cluster.exclusive_jets_multi(n_jets=[2], dcut=[1.0])
+    with pytest.raises(ValueError):
+        cluster.exclusive_jets_multi(n_jets=[0, 2])
@@ -0,0 +1,62 @@
+import awkward as ak
+import numpy as np
+import pytest
+
+import fastjet
+
+vector = pytest.importorskip("vector")  # noqa: F841
+
+
+@pytest.mark.parametrize("output_dtype", [None, "float32"])
+def test_ptetaphim_jets_match_vector(output_dtype, events):
+    jetdef = fastjet.JetDefinition(fastjet.antikt_algorithm, 0.6)
+    cartesian = fastjet.ClusterSequence(events, jetdef, output_dtype=output_dtype)
+    cylindrical = fastjet.ClusterSequence(
+        events, jetdef, output_dtype=output_dtype, coordinates="ptetaphim"
+    )
+
+    expected = cartesian.inclusive_jets()
+    jets = cylindrical.inclusive_jets()
+    assert jets.fields == ["pt", "eta", "phi", "mass"]
+    rtol = 1e-5 if output_dtype == "float32" else 1e-12
+    for field in jets.fields:
+        assert np.allclose(
+            ak.to_numpy(ak.flatten(jets[field])),
+            ak.to_numpy(ak.flatten(getattr(expected, field))),
+            rtol=rtol,
+            atol=rtol,
+        )
+    # the records are still vectors, and keep working as jets
+    assert np.allclose(
+        ak.to_numpy(ak.flatten(jets.px)), ak.to_numpy(ak.flatten(expected.px))
+    )
+    assert (
+        ak.num(cylindrical.exclusive_subjets(jets[:, 0], nsub=1)).to_list()
+        == ak.num(cartesian.exclusive_subjets(expected[:, 0], nsub=1)).to_list()
+    )
+
+
+def test_ptetaphie_and_jet_observables(events):
+    jetdef = fastjet.JetDefinition(fastjet.kt_algorithm, 0.6)
+    cluster = fastjet.ClusterSequence(events, jetdef, coordinates="ptetaphie")
+    cartesian = fastjet.ClusterSequence(events, jetdef)
+
+    jets = cluster.exclusive_jets(n_jets=2)
+    assert jets.fields == ["pt", "eta", "phi", "E"]
+    assert jets.E.to_list() == cartesian.exclusive_jets(n_jets=2).E.to_list()
+
+    out = cluster.jet_observables(["momentum", "constituent_index"], njets=2)
+    assert out.fields == ["pt", "eta", "phi", "E", "constituent_index"]
+    out = cartesian.jet_observables(
+        [{"observable": "momentum", "coordinates": "ptetaphim"}], njets=2
+    )
+    assert out.fields == ["pt", "eta", "phi", "mass"]
+
+
+def test_bad_coordinates(events):
+    jetdef = fastjet.JetDefinition(fastjet.antikt_algorithm, 0.6)
+    with pytest.raises(ValueError):
+        fastjet.ClusterSequence(events, jetdef, coordinates="ptetaphirapidity")
+    cluster = fastjet.ClusterSequence(events, jetdef)
+    with pytest.raises(ValueError):
+        cluster.jet_observables([{"observable": "momentum", "coordinates": "xyz"}])
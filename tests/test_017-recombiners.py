@@ -0,0 +1,71 @@
+import awkward as ak
+import numpy as np
+import pytest
+
+import fastjet
+
+vector = pytest.importorskip("vector")  # noqa: F841
+
+
+def _jets(array, jetdef, **kwargs):
+    cluster = fastjet.ClusterSequence(array, jetdef, **kwargs)
+    return cluster.exclusive_jets(n_jets=2)
+
+
+def _assert_close(jets, expected, rtol=1e-10):
+    for field in ("px", "py", "pz", "E"):
+        assert np.allclose(
+            ak.to_numpy(ak.flatten(jets[field])),
+            ak.to_numpy(ak.flatten(expected[field])),
+            rtol=rtol,
+            atol=rtol,
+        )
+
+
+def test_named_recombiners_match_jet_definition_schemes(events):
+    jetdef = fastjet.JetDefinition(fastjet.kt_algorithm, 0.6)
+    for name, scheme in (
+        ("wta_pt", fastjet.WTA_pt_scheme),
+        ("pt_weighted", fastjet.pt_scheme),
+    ):
+        expected = _jets(
+            events, fastjet.JetDefinition(fastjet.kt_algorithm, 0.6, scheme)
+        )
+        _assert_close(_jets(events, jetdef, recombiner=name), expected)
+
+    # the generalized scheme spans the two
+    pt_weighted = _jets(events, jetdef, recombiner="pt_weighted")
+    wta_pt = _jets(events, jetdef, recombiner="wta_pt")
+    _assert_close(_jets(events, jetdef, recombiner=("generalized_wta", 1)), pt_weighted)
+    _assert_close(
+        _jets(events, jetdef, recombiner=("generalized_wta", 1e4)), wta_pt, 1e-6
+    )
+
+
+def test_compiled_recombiners(events):
+    jetdef = fastjet.JetDefinition(fastjet.kt_algorithm, 0.6)
+    plain = _jets(events, jetdef)
+
+    massless = _jets(events, jetdef, recombiner="massless_E", n_threads=2)
+    assert np.allclose(ak.to_numpy(ak.flatten(massless.mass)), 0, atol=1e-6)
+    assert np.allclose(
+        ak.to_numpy(ak.flatten(massless.px)), ak.to_numpy(ak.flatten(plain.px))
+    )
+
+    wta_E = _jets(events, jetdef, recombiner="wta_E", n_threads=2)
+    assert np.allclose(
+        ak.to_numpy(ak.flatten(wta_E.E)), ak.to_numpy(ak.flatten(plain.E))
+    )
+    assert np.allclose(ak.to_numpy(ak.flatten(wta_E.mass)), 0, atol=1e-6)
+
+
+def test_bad_recombiners(events):
+    jetdef = fastjet.JetDefinition(fastjet.kt_algorithm, 0.6)
+    with pytest.raises(ValueError):
+        fastjet.ClusterSequence(events, jetdef, recombiner="winner")
+    with pytest.raises(ValueError):
+        fastjet.ClusterSequence(events, jetdef, recombiner="generalized_wta")
+    with pytest.raises(ValueError):
+        fastjet.ClusterSequence(events, jetdef, recombiner=("generalized_wta", -1))
+    with pytest.raises(ValueError):
+        fastjet.ClusterSequence(events, jetdef, recombiner=("wta_E", 2))
@@ -0,0 +1,80 @@
+import awkward as ak
+import pytest
+
+import fastjet
+
+vector = pytest.importorskip("vector")
+
+
+@pytest.fixture
+def events(particles):
+    # overrides the shared batch with a reversed event and one that the cuts empty
+    return ak.Array(
+        [particles, particles[1:], particles[::-1], particles[3:4]],
+        with_name="Momentum4D",
+        behavior=vector.backends.awkward.behavior,
+    )
+
+
+def _check_selection(array, keep, **kwargs):
+    jetdef = fastjet.JetDefinition(fastjet.antikt_algorithm, 0.6)
+    selected = fastjet.ClusterSequence(array, jetdef, **kwargs)
+    expected = fastjet.ClusterSequence(array[keep], jetdef)
+
+    assert selected.inclusive_jets().to_list() == expected.inclusive_jets().to_list()
+    # constituent indices refer to the unselected input
+    original = ak.local_index(array)[keep].to_list()
+    mapped = [
+        [[positions[k] for k in jet] for jet in event]
+        for positions, event in zip(original, expected.constituent_index().to_list())
+    ]
+    assert selected.constituent_index().to_list() == mapped
+    assert selected.constituents().to_list() == expected.constituents().to_list()
+
+
+def test_particle_cuts(events):
+    keep = (events.pt > 1) & (abs(events.rapidity) < 2.5)
+    _check_selection(events, keep, particle_selection={"pt_min": 1, "abs_rap_max": 2.5})
+    _check_selection(
+        events,
+        events.E < 30,
+        particle_selection={"E_max": 30},
+        compact_history=True,
+    )
+
+
+def test_particle_selector(events):
+    _check_selection(
+        events, events.pt >= 1, particle_selection=fastjet.SelectorPtMin(1.0)
+    )
+
+
+def test_python_particle_selector(events):
+    # evaluated with the GIL held however many threads cluster the batch
+    selector = fastjet.SelectorPython(lambda particle: particle.pt() >= 1)
+    _check_selection(events, events.pt >= 1, particle_selection=selector, n_threads=4)
+    _check_selection(
+        events,
+        (events.pt >= 1) & (events.E < 30),
+        particle_selection=selector & fastjet.SelectorEMax(30.0),
+        n_threads=4,
+    )
+
+
+def test_particle_selection_in_jet_observables(events):
+    jetdef = fastjet.JetDefinition(fastjet.antikt_algorithm, 0.6)
+    cluster = fastjet.ClusterSequence(events, jetdef, particle_selection={"pt_min": 1})
+    out = cluster.jet_observables(["constituent_index"])
+    assert out.constituent_index.to_list() == cluster.constituent_index().to_list()
+
+
+def test_bad_particle_selection(events):
+    jetdef = fastjet.JetDefinition(fastjet.antikt_algorithm, 0.6)
+    with pytest.raises(ValueError):
+        fastjet.ClusterSequence(events, jetdef, particle_selection={"pt": 1})
+    with pytest.raises(ValueError):
+        fastjet.ClusterSequence(
+            events, jetdef, particle_selection=fastjet.SelectorNHardest(2)
+        )
+    with pytest.raises(TypeError):
+        fastjet.ClusterSequence(events, jetdef, particle_selection=[1.0])
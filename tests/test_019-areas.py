@@ -0,0 +1,63 @@
+import awkward as ak
+import numpy as np
+import pytest
+
+import fastjet
+
+vector = pytest.importorskip("vector")  # noqa: F841
+
+
+def _area_definition():
+    return fastjet.AreaDefinition(fastjet.active_area, fastjet.GhostedAreaSpec(4.0))
+
+
+def test_jets_carry_areas(events):
+    jetdef = fastjet.JetDefinition(fastjet.antikt_algorithm, 0.4)
+    cluster = fastjet.ClusterSequence(
+        events, jetdef, area_definition=_area_definition()
+    )
+    jets = cluster.inclusive_jets(min_pt=20)
+    assert set(jets.fields) >= {"area", "area_px", "area_E", "n_ghosts"}
+    # isolated anti-kt jets are close to circles of radius R
+    area = ak.to_numpy(ak.flatten(jets.area))
+    assert np.allclose(area, np.pi * 0.4**2, rtol=0.1)
+    assert ak.all(jets.n_ghosts > 0)
+    ghost_area = ak.flatten(jets.area) / ak.flatten(jets.n_ghosts)
+    assert np.allclose(ak.to_numpy(ghost_area), 0.01, rtol=0.05)
+
+    out = cluster.jet_observables(["momentum", "area"], min_pt=20)
+    assert out.area.to_list() == jets.area.to_list()
+    assert out.n_ghosts.to_list() == jets.n_ghosts.to_list()
+
+
+def test_areas_do_not_depend_on_threads(events):
+    jetdef = fastjet.JetDefinition(fastjet.antikt_algorithm, 0.4)
+    areas = [
+        fastjet.ClusterSequence(
+            events,
+            jetdef,
+            n_threads=n_threads,
+            area_definition=_area_definition(),
+            area_seed=7,
+        )
+        .inclusive_jets()
+        .area.to_list()
+        for n_threads in (1, 3)
+    ]
+    assert areas[0] == areas[1]
+
+
+def test_bad_area_requests(events):
+    jetdef = fastjet.JetDefinition(fastjet.antikt_algorithm, 0.4)
+    with pytest.raises(ValueError):
+        fastjet.ClusterSequence(
+            events, jetdef, area_definition=_area_definition(), compact_history=True
+        )
+    explicit = fastjet.AreaDefinition(
+        fastjet.active_area_explicit_ghosts, fastjet.GhostedAreaSpec(4.0)
+    )
+    with pytest.raises(ValueError):
+        fastjet.ClusterSequence(events, jetdef, area_definition=explicit)
+    cluster = fastjet.ClusterSequence(events, jetdef)
+    with pytest.raises(ValueError):
+        cluster.jet_observables(["area"])
@@ -0,0 +1,93 @@
+import awkward as ak
+import numpy as np
+import pytest
+
+import fastjet
+
+vector = pytest.importorskip("vector")  # noqa: F841
+
+
+@pytest.fixture
+def events(random_events):
+    # a uniform soft background with two hard jets on top
+    return random_events(
+        [300] * 3,
+        mean_pt=1.0,
+        hard=[(100.0, 0.5, 0.0), (80.0, -0.5, np.pi)],
+        seed=7,
+    )
+
+
+def _area_definition():
+    return fastjet.AreaDefinition(fastjet.active_area, fastjet.GhostedAreaSpec(3.0))
+
+
+@pytest.mark.parametrize("estimator", ["grid", "jet_median"])
+def test_background_estimate(estimator, events):
+    jetdef = fastjet.JetDefinition(fastjet.antikt_algorithm, 0.4)
+    cluster = fastjet.ClusterSequence(events, jetdef)
+
+    background = cluster.background_estimate(
+        estimator=estimator, rho_m=True, rap_max=2.5, seed=1
+    )
+    assert background.fields == ["rho", "sigma", "rho_m", "sigma_m"]
+    assert len(background) == len(events)
+    assert ak.all(background.rho > 0)
+    assert ak.all(background.sigma >= 0)
+    # the same seed gives the same estimate, whatever the thread scheduling
+    again = fastjet.ClusterSequence(events, jetdef, n_threads=1).background_estimate(
+        estimator=estimator, rho_m=True, rap_max=2.5, seed=1
+    )
+    assert again.to_list() == background.to_list()
+    assert cluster.background_estimate(rap_max=2.5).fields == ["rho", "sigma"]
+
+
+def test_python_rho_range(events):
+    # a Python Selector is evaluated with the GIL held, one event at a time
+    jetdef = fastjet.JetDefinition(fastjet.antikt_algorithm, 0.4)
+    cluster = fastjet.ClusterSequence(events, jetdef, n_threads=4)
+    options = {"estimator": "jet_median", "rap_max": 2.5, "seed": 1}
+
+    python = cluster.background_estimate(
+        rho_range=fastjet.SelectorPython(lambda jet: abs(jet.rap()) <= 2.1),
+        **options,
+    )
+    compiled = cluster.background_estimate(
+        rho_range=fastjet.SelectorAbsRapMax(2.1), **options
+    )
+    assert python.to_list() == compiled.to_list()
+
+
+def test_inclusive_jets_subtracted(events):
+    jetdef = fastjet.JetDefinition(fastjet.antikt_algorithm, 0.4)
+    cluster = fastjet.ClusterSequence(
+        events, jetdef, area_definition=_area_definition(), area_seed=1
+    )
+
+    jets = cluster.inclusive_jets(min_pt=20)
+    subtracted = cluster.inclusive_jets_subtracted(min_pt=20, rap_max=2.5)
+    assert ak.num(subtracted).to_list() == ak.num(jets).to_list()
+    assert ak.all(subtracted.pt < jets.pt)
+    rho = cluster.background_estimate(rap_max=2.5).rho
+    expected = jets.pt - rho * jets.area
+    assert np.allclose(
+        ak.to_numpy(ak.flatten(subtracted.pt)),
+        ak.to_numpy(ak.flatten(expected)),
+        rtol=0.05,
+    )
+
+
+def test_bad_background_options(events):
+    jetdef = fastjet.JetDefinition(fastjet.antikt_algorithm, 0.4)
+    cluster = fastjet.ClusterSequence(events[:1], jetdef)
+    with pytest.raises(ValueError):
+        cluster.background_estimate(estimator="area_median")
+    with pytest.raises(ValueError):
+        cluster.background_estimate(grid_size=0.5)
+    # rho_range selects jets one by one, without a reference jet
+    for rho_range in [fastjet.SelectorNHardest(2), fastjet.SelectorCircle(1.0)]:
+        with pytest.raises(ValueError):
+            cluster.background_estimate(estimator="jet_median", rho_range=rho_range)
+    # subtraction needs the jet areas
+    with pytest.raises(ValueError):
+        cluster.inclusive_jets_subtracted()
@@ -0,0 +1,108 @@
+import pickle
+
+import numpy as np
+import pytest
+
+import fastjet
+
+vector = pytest.importorskip("vector")  # noqa: F841
+
+
+def _restore(cluster):
+    # serves the queries from a pickled copy of the clustering results
+    internal = cluster._internalrep
+    internal._results = pickle.loads(pickle.dumps(internal._results))
+    return cluster
+
+
+@pytest.mark.parametrize("compact_history", [False, True])
+def test_pickled_results_answer_queries(compact_history, events):
+    jetdef = fastjet.JetDefinition(fastjet.kt_algorithm, 0.6)
+    cluster = fastjet.ClusterSequence(
+        events, jetdef, with_index=True, compact_history=compact_history
+    )
+    jets = cluster.inclusive_jets().to_list()
+    exclusive = cluster.exclusive_jets(n_jets=2).to_list()
+    dmerge = cluster.exclusive_dmerge_spectrum().to_list()
+    constituents = cluster.constituent_index().to_list()
+
+    restored = _restore(cluster)
+    assert restored.inclusive_jets().to_list() == jets
+    assert restored.exclusive_jets(n_jets=2).to_list() == exclusive
+    assert restored.exclusive_dmerge_spectrum().to_list() == dmerge
+    assert restored.constituent_index().to_list() == constituents
+
+
+@pytest.mark.parametrize(
+    "algorithm", [fastjet.cambridge_algorithm, fastjet.antikt_algorithm]
+)
+@pytest.mark.parametrize("recombiner", ["wta_E", ("generalized_wta", 2.0), "wta_pt"])
+def test_restored_jet_definition(algorithm, recombiner, random_events):
+    # the algorithm and the recombiner come back with the history, for the
+    # queries that use them rather than the recorded merges
+    events = random_events(list(range(6, 30, 4)), mean_pt=10.0, rap_max=1.0, seed=3)
+    jetdef = fastjet.JetDefinition(algorithm, 0.8)
+    cluster = fastjet.ClusterSequence(events, jetdef, recombiner=recombiner)
+    scale = cluster.jet_scale_for_algorithm(cluster.inclusive_jets()).to_list()
+    softdrop = cluster.exclusive_jets_softdrop_observables(njets=2).to_list()
+
+    restored = _restore(cluster)
+    jets = restored.inclusive_jets()
+    assert restored.jet_scale_for_algorithm(jets).to_list() == scale
+    assert restored.exclusive_jets_softdrop_observables(njets=2).to_list() == softdrop
+
+
+def test_serialized_buffer(events):
+    jetdef = fastjet.JetDefinition(fastjet.antikt_algorithm, 0.6)
+    cluster = fastjet.ClusterSequence(events, jetdef, output_dtype="float32")
+    results = cluster._internalrep._results
+
+    buffer = results.serialize()
+    assert buffer.dtype == np.uint8
+    restored = type(results).deserialize(memoryview(buffer), n_threads=1)
+    assert np.array_equal(restored.to_numpy()[0], results.to_numpy()[0])
+    assert restored.to_numpy()[0].dtype == np.float32
+    # the unclustered inputs are restored too
+    assert len(restored.to_numpy_unclustered_particles()[0]) == 0
+
+    with pytest.raises(ValueError):
+        type(results).deserialize(buffer[: len(buffer) // 2])
+    with pytest.raises(ValueError):
+        type(results).deserialize(np.zeros(64, dtype=np.uint8))
+
+
+def test_corrupt_buffers(events):
+    jetdef = fastjet.JetDefinition(fastjet.kt_algorithm, 0.6)
+    cluster = fastjet.ClusterSequence(events, jetdef, compact_history=True)
+    results = cluster._internalrep._results
+    buffer = results.serialize()
+    restore = type(results).deserialize
+
+    # the 112-byte header ends with the numbers of events, particles and history
+    # entries; sizes beyond the buffer are rejected before anything is allocated
+    huge = buffer.copy()
+    huge.view(np.uint64)[11] = 2**62
+    with pytest.raises(ValueError):
+        restore(huge)
+    # the momentum coordinates follow the magic, version and flags
+    coordinates = buffer.copy()
+    coordinates.view(np.uint32)[3] = 3
+    with pytest.raises(ValueError):
+        restore(coordinates)
+    # a compact batch continues with its history offsets and the first parents;
+    # the last clustering of the first event, of 6 particles, cannot refer to a
+    # later entry
+    parents = (112 + 8 * (len(events) + 1)) // 4
+    restore(buffer)
+    bad = buffer.copy()
+    bad.view(np.int32)[parents + 11] = 20
+    with pytest.raises(ValueError):
+        restore(bad)
+
+
+def test_areas_are_not_serialized(events):
+    jetdef = fastjet.JetDefinition(fastjet.antikt_algorithm, 0.6)
+    areadef = fastjet.AreaDefinition(fastjet.active_area, fastjet.GhostedAreaSpec(5.0))
+    cluster = fastjet.ClusterSequence(events, jetdef, area_definition=areadef)
+    with pytest.raises(ValueError):
+        pickle.dumps(cluster._internalrep._results)
@@ -0,0 +1,81 @@
+import pytest
+
+import fastjet
+
+vector = pytest.importorskip("vector")  # noqa: F841
+
+
+@pytest.fixture
+def cache_dir(tmp_path):
+    fastjet.set_cache_dir(tmp_path)
+    yield tmp_path
+    fastjet.set_cache_dir(None)
+
+
+def test_repeated_clustering_is_loaded(cache_dir, monkeypatch, events):
+    jetdef = fastjet.JetDefinition(fastjet.antikt_algorithm, 0.4)
+    assert fastjet.get_cache_dir() == str(cache_dir)
+
+    expected = fastjet.ClusterSequence(events, jetdef)
+    jets = expected.inclusive_jets().to_list()
+    constituents = expected.constituent_index().to_list()
+    assert len(list(cache_dir.glob("*.fjres"))) == 1
+
+    def no_clustering(*args, **kwargs):
+        raise AssertionError("clustered again")
+
+    monkeypatch.setattr(fastjet._ext, "interfacemulti", no_clustering)
+    cached = fastjet.ClusterSequence(events, jetdef, n_threads=2)
+    assert cached.inclusive_jets().to_list() == jets
+    assert cached.constituent_index().to_list() == constituents
+
+    # other inputs or options miss the cache
+    with pytest.raises(AssertionError):
+        fastjet.ClusterSequence(events[:2], jetdef)
+    with pytest.raises(AssertionError):
+        fastjet.ClusterSequence(
+            events, fastjet.JetDefinition(fastjet.kt_algorithm, 0.4)
+        )
+
+
+def test_damaged_file_is_replaced(cache_dir, events):
+    jetdef = fastjet.JetDefinition(fastjet.antikt_algorithm, 0.4)
+    jets = fastjet.ClusterSequence(events, jetdef).inclusive_jets().to_list()
+    (path,) = cache_dir.glob("*.fjres")
+    path.write_bytes(path.read_bytes()[:40])
+
+    assert fastjet.ClusterSequence(events, jetdef).inclusive_jets().to_list() == jets
+    assert fastjet.ClusterSequence(events, jetdef).inclusive_jets().to_list() == jets
+
+
+def test_selectors_are_not_cached(cache_dir, events):
+    # a Selector is only known by its description, which does not tell two
+    # SelectorPython apart
+    jetdef = fastjet.JetDefinition(fastjet.antikt_algorithm, 0.4)
+    for cut in [1.0, 10.0]:
+        selector = fastjet.SelectorPython(lambda particle, cut=cut: particle.pt() > cut)
+        selected = fastjet.ClusterSequence(events, jetdef, particle_selection=selector)
+        expected = fastjet.ClusterSequence(events[events.pt > cut], jetdef)
+        assert (
+            selected.inclusive_jets().to_list() == expected.inclusive_jets().to_list()
+        )
+    # only the unselected clusterings were stored
+    assert len(list(cache_dir.glob("*.fjres"))) == 2
+
+
+def test_failed_store_is_ignored(cache_dir, monkeypatch, events):
+    jetdef = fastjet.JetDefinition(fastjet.antikt_algorithm, 0.4)
+    jets = fastjet.ClusterSequence(events, jetdef).inclusive_jets().to_list()
+    (path,) = cache_dir.glob("*.fjres")
+    path.write_bytes(path.read_bytes()[:40])
+
+    def read_only(*args, **kwargs):
+        raise PermissionError("read-only cache")
+
+    # the damaged file is clustered again on the first query, which must not
+    # fail because the new results cannot be written
+    monkeypatch.setattr(fastjet._cache, "_store", read_only)
+    assert fastjet.ClusterSequence(events, jetdef).inclusive_jets().to_list() == jets
+    # and new results are still returned
+    cluster = fastjet.ClusterSequence(events[:2], jetdef)
+    assert cluster.inclusive_jets().to_list() == jets[:2]
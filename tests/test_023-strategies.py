@@ -0,0 +1,69 @@
+import awkward as ak
+import pytest
+
+import fastjet
+
+vector = pytest.importorskip("vector")
+
+
+@pytest.fixture
+def events(particles):
+    # events on both sides of the table bound, and an empty one
+    return ak.Array(
+        [particles, particles[1:], particles[:3], []],
+        with_name="Momentum4D",
+        behavior=vector.backends.awkward.behavior,
+    )
+
+
+@pytest.fixture
+def reset_table():
+    yield
+    fastjet.set_strategy_table(None)
+
+
+@pytest.mark.parametrize(
+    "algorithm",
+    [fastjet.kt_algorithm, fastjet.cambridge_algorithm, fastjet.antikt_algorithm],
+)
+def test_table_does_not_change_jets(algorithm, reset_table, events):
+    jetdef = fastjet.JetDefinition(algorithm, 0.6)
+    expected = fastjet.ClusterSequence(events, jetdef)
+    jets = expected.inclusive_jets().to_list()
+    dmerge = expected.exclusive_dmerge_spectrum().to_list()
+
+    # every event with at most 3 particles goes to N2Plain, the others to N2Tiled
+    fastjet.set_strategy_table(
+        {0.4: [("N2Plain", 3), ("N2Tiled", None)], 1.0: [("N2MHTLazy9", None)]}
+    )
+    cluster = fastjet.ClusterSequence(events, jetdef)
+    assert cluster.inclusive_jets().to_list() == jets
+    assert cluster.exclusive_dmerge_spectrum().to_list() == dmerge
+
+
+def test_invalid_tables(reset_table):
+    with pytest.raises(ValueError):
+        fastjet.set_strategy_table({0.4: [("Fastest", None)]})
+    with pytest.raises(ValueError):
+        fastjet.set_strategy_table(
+            {0.4: [("N2Plain", 50), ("N2Tiled", 20), ("NlnN", None)]}
+        )
+    with pytest.raises(ValueError):
+        fastjet.set_strategy_table({0.4: []})
+    assert fastjet.get_strategy_table() is None
+
+
+def test_calibrate(reset_table):
+    table = fastjet.calibrate_strategies(
+        R=(0.4,),
+        multiplicities=(5, 50),
+        strategies=("N2Plain", "N2Tiled"),
+        particles_per_point=500,
+        repeat=1,
+    )
+    assert list(table) == [0.4]
+    assert table[0.4][-1][1] is None
+    assert fastjet.get_strategy_table() == table
+
+    fastjet.set_strategy_table(None)
+    assert fastjet.get_strategy_table() is None
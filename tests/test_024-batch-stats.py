@@ -0,0 +1,60 @@
+import awkward as ak
+import pytest
+
+import fastjet
+
+vector = pytest.importorskip("vector")  # noqa: F841
+
+
+@pytest.fixture
+def stats():
+    stats = fastjet.batch_stats()
+    stats.reset()
+    stats.enabled = True
+    yield stats
+    stats.enabled = False
+    stats.reset()
+
+
+def test_phases_and_counts(stats, events):
+    jetdef = fastjet.JetDefinition(fastjet.antikt_algorithm, 0.6)
+    cluster = fastjet.ClusterSequence(events, jetdef)
+    jets = cluster.inclusive_jets()
+
+    assert stats.batches == 1
+    assert stats.events == len(events)
+    assert stats.particles == ak.count(events.px)
+    assert stats.jets == ak.count(jets.px)
+    assert stats.bytes > 0
+    seconds = stats.seconds
+    assert set(seconds) == {
+        "extract_cons",
+        "correct_byteorder",
+        "construct",
+        "cluster",
+        "jets",
+        "export",
+        "assembly",
+    }
+    assert all(value >= 0 for value in seconds.values())
+    assert seconds["cluster"] > 0
+    assert stats.to_dict()["seconds"] == seconds
+
+    # jet lists already extracted are not counted twice
+    cluster.inclusive_jets()
+    assert stats.jets == ak.count(jets.px)
+
+    stats.reset()
+    assert stats.to_dict()["events"] == 0
+    assert sum(stats.seconds.values()) == 0
+
+
+def test_disabled_records_nothing(stats, events):
+    stats.enabled = False
+    jetdef = fastjet.JetDefinition(fastjet.antikt_algorithm, 0.6)
+    fastjet.ClusterSequence(events, jetdef).inclusive_jets()
+    assert stats.batches == 0
+    assert sum(stats.seconds.values()) == 0
+
+    with pytest.raises(ValueError):
+        stats.add_time("reading", 1.0)
@@ -0,0 +1,54 @@
+import awkward as ak
+import numpy as np
+import pytest
+
+import fastjet
+
+vector = pytest.importorskip("vector")  # noqa: F841
+
+
+@pytest.fixture
+def events(random_events):
+    # dense enough for jets of R = 0.8 to have several splittings
+    return random_events(list(range(4, 40, 2)), mean_pt=10.0, rap_max=1.0, seed=3)
+
+
+@pytest.mark.parametrize(
+    "algorithm", [fastjet.cambridge_algorithm, fastjet.antikt_algorithm]
+)
+@pytest.mark.parametrize(
+    "kwargs",
+    [
+        {},
+        {"beta": 1.0, "symmetry_cut": 0.2, "R0": 0.4},
+        {"symmetry_measure": "vector_z", "recursion_choice": "larger_m"},
+        {"symmetry_measure": "y", "symmetry_cut": 0.05, "mu_cut": 0.7},
+    ],
+)
+def test_softdrop_observables_match_grooming(algorithm, kwargs, events):
+    jetdef = fastjet.JetDefinition(algorithm, 0.8)
+    cluster = fastjet.ClusterSequence(events, jetdef, n_threads=2)
+    observables = cluster.exclusive_jets_softdrop_observables(njets=2, **kwargs)
+    groomed = cluster.exclusive_jets_softdrop_grooming(njets=2, **kwargs)
+
+    assert ak.all(ak.num(observables) == 2)
+    observables = ak.flatten(observables)
+    assert np.allclose(observables.mass, groomed.msoftdrop, rtol=1e-10, atol=1e-10)
+    assert np.allclose(observables.pt, groomed.ptsoftdrop, rtol=1e-10, atol=1e-10)
+    # the groomed jets of SoftDrop only have a structure when a splitting passed
+    passed = groomed.deltaRsoftdrop > 0
+    assert np.allclose(observables.Rg[passed], groomed.deltaRsoftdrop[passed])
+    assert np.allclose(observables.zg[passed], groomed.symmetrysoftdrop[passed])
+
+
+def test_softdrop_observables_errors(events):
+    jetdef = fastjet.JetDefinition(fastjet.cambridge_algorithm, 0.8)
+    cluster = fastjet.ClusterSequence(events[:3], jetdef)
+    with pytest.raises(ValueError):
+        cluster.exclusive_jets_softdrop_observables(symmetry_measure="z")
+    with pytest.raises(ValueError):
+        cluster.exclusive_jets_softdrop_observables(recursion_choice="larger_y")
+
+    compact = fastjet.ClusterSequence(events[:3], jetdef, compact_history=True)
+    with pytest.raises(RuntimeError):
+        compact.exclusive_jets_softdrop_observables()